@@ -16,7 +16,21 @@ typedef struct
     int quiet;
     int console_source;
     int scale;
+    int idle_skip;
+    int gte_bench;
+    int gpu_bench;
+    int jit_bench;
+    int instances;
+    int state_check;
+    int rewind_budget;
+    int hle;
+    int gpu_thread;
+    int gpu_raster_threads;
+    int arena;
+    int huge_pages;
     const char *snap_path;
+    const char *boot_cache;
+    const char *state_path;
     const char *settings_path;
     const char *bios;
     const char *bios_search;
@@ -26,6 +40,7 @@ typedef struct
     const char *psxe_version;
     const char *cd_path;
     const char *exp_path;
+    const char *cpu;
 } psxe_config_t;
 
 psxe_config_t *psxe_cfg_create(void);
@@ -0,0 +1,29 @@
+#ifndef INSTANCES_H
+#define INSTANCES_H
+
+#include "frontend/config.h"
+
+#define PSXE_INSTANCES_FRAMES 600
+
+/*
+    Runs one emulator instance to completion on the calling thread,
+    then N more concurrently on their own threads, all with the same
+    configuration. Each instance hashes its RAM, VRAM and CPU state
+    after the last frame, any instance that doesn't match the serial
+    run counts as a mismatch. Returns the number of mismatches, or -1
+    if the serial run couldn't be started.
+*/
+int psxe_instances_check(psxe_config_t *, int instances, int frames);
+
+#define PSXE_STATE_CAPTURES 100
+
+/*
+    Runs an instance for a number of frames and captures its state,
+    then checks that restoring it in place and loading it from path
+    into a new instance both run on to the same machine as the
+    original. Captures again right after the restore to make sure it
+    produces the same bytes. Returns the number of mismatches.
+*/
+int psxe_state_check(psxe_config_t *, int frames, const char *path);
+
+#endif
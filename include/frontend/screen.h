@@ -2,7 +2,9 @@
 #define SCREEN_H
 
 #include "psx/psx.h"
+#include "psx/rewind.h"
 #include "frontend/common.h"
+#include "frontend/state_io.h"
 
 #include <string.h>
 
@@ -31,6 +33,18 @@ typedef struct
     int debug_mode;
     int open;
 
+    // Backspace held steps back through the rewind history, one
+    // capture per frame. Both only act between frames, see
+    // psxe_screen_end_frame
+    psx_rewind_t *rewind;
+    int rewinding;
+    int frame_done;
+
+    // F7 saves to state_path, F8 loads it back
+    psxe_state_io_t *state_io;
+    const char *state_path;
+    int save_requested;
+
     SDL_Gamepad *gamepad;
 } psxe_screen_t;
 
@@ -42,6 +56,9 @@ void psxe_screen_update(psxe_screen_t *);
 void psxe_screen_destroy(psxe_screen_t *);
 void psxe_screen_set_scale(psxe_screen_t *, unsigned int);
 void psxe_screen_toggle_debug_mode(psxe_screen_t *);
+void psxe_screen_set_rewind(psxe_screen_t *, psx_rewind_t *);
+void psxe_screen_set_state_io(psxe_screen_t *, psxe_state_io_t *, const char *path);
+void psxe_screen_end_frame(psxe_screen_t *);
 
 // GPU event handlers
 void psxe_gpu_dmode_event_cb(psx_gpu_t *);
@@ -0,0 +1,52 @@
+#ifndef STATE_IO_H
+#define STATE_IO_H
+
+#include "psx/psx.h"
+
+#define SDL_MAIN_HANDLED
+#include <SDL3/SDL.h>
+
+enum
+{
+    PSXE_STATE_IO_IDLE,
+    PSXE_STATE_IO_SAVE,
+    PSXE_STATE_IO_LOAD,
+    PSXE_STATE_IO_LOADED
+};
+
+/*
+    Save states on a worker thread. Saving captures the machine into
+    the worker's buffer, which is all the emulation thread pays for,
+    then the worker compresses and writes it. Loading reads and
+    decompresses on the worker, psxe_state_io_update swaps the result
+    in between frames. One job runs at a time.
+*/
+typedef struct
+{
+    SDL_Thread *thread;
+    SDL_Mutex *mutex;
+    SDL_Condition *cond;
+
+    // Owned by the worker while a job is running
+    psx_state_t state;
+    char *path;
+    int job;
+    int ret;
+    int quit;
+} psxe_state_io_t;
+
+psxe_state_io_t *psxe_state_io_create(void);
+int psxe_state_io_init(psxe_state_io_t *);
+
+// Both return 1 if a job is still running
+int psxe_state_io_save(psxe_state_io_t *, psx_t *, const char *path);
+int psxe_state_io_load(psxe_state_io_t *, const char *path);
+
+// Applies a finished load, call between updates. Returns 1 if a state
+// was loaded
+int psxe_state_io_update(psxe_state_io_t *, psx_t *);
+
+// Finishes a pending save before returning
+void psxe_state_io_destroy(psxe_state_io_t *);
+
+#endif
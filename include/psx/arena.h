@@ -0,0 +1,39 @@
+#ifndef ARENA_H
+#define ARENA_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+// Every allocation starts on its own cache line
+#define PSX_ARENA_ALIGN 64
+
+// Huge pages are 2 MiB on x86-64 and most ARM64 configurations
+#define PSX_ARENA_HUGE_PAGE 0x200000
+
+#define PSX_ARENA_HUGE 1
+
+typedef struct
+{
+    uint8_t *base;
+    size_t size;
+    size_t used;
+    int huge;
+} psx_arena_t;
+
+/*
+    Maps a zeroed, page-aligned block of at least size bytes. With
+    PSX_ARENA_HUGE the block is rounded up to whole huge pages and
+    backed by them if the system allows it, otherwise regular pages
+    are used. Returns 0 on success.
+*/
+int psx_arena_init(psx_arena_t *, size_t size, int flags);
+void *psx_arena_alloc(psx_arena_t *, size_t size);
+void psx_arena_destroy(psx_arena_t *);
+
+// Bytes psx_arena_alloc takes out of the arena for a given size
+static inline size_t psx_arena_footprint(size_t size)
+{
+    return (size + PSX_ARENA_ALIGN - 1) & ~(size_t)(PSX_ARENA_ALIGN - 1);
+}
+
+#endif
@@ -3,10 +3,14 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
+
 struct psx_bus_t;
 
 typedef struct psx_bus_t psx_bus_t;
 
+typedef void (*psx_bus_code_write_cb_t)(void*, uint32_t);
+
 psx_bus_t* psx_bus_create(void);
 void psx_bus_init(psx_bus_t*);
 uint32_t psx_bus_read32(psx_bus_t*, uint32_t);
@@ -16,6 +20,11 @@ void psx_bus_write32(psx_bus_t*, uint32_t, uint32_t);
 void psx_bus_write16(psx_bus_t*, uint32_t, uint32_t);
 void psx_bus_write8(psx_bus_t*, uint32_t, uint32_t);
 uint32_t psx_bus_get_access_cycles(psx_bus_t*);
+const uint8_t* psx_bus_get_read_page(psx_bus_t*, uint32_t, uint32_t*);
+void psx_bus_set_code_write_cb(psx_bus_t*, psx_bus_code_write_cb_t, void*);
+void psx_bus_protect_code(psx_bus_t*, uint32_t);
+void psx_bus_save_state(psx_bus_t*, psx_state_t*);
+int psx_bus_load_state(psx_bus_t*, psx_state_t*);
 void psx_bus_destroy(psx_bus_t*);
 
 #endif
\ No newline at end of file
@@ -18,6 +18,43 @@
 #include "psx/dev/pad.h"
 #include "psx/dev/mdec.h"
 
+// The masked physical address space (0x00000000-0x1fffffff) is split into
+// 4 KiB pages. Pages backed by plain memory (RAM, BIOS) hold a host pointer,
+// everything else is dispatched to a device through a per-page device ID.
+#define PSX_BUS_PAGE_SHIFT 12
+#define PSX_BUS_PAGE_SIZE (1 << PSX_BUS_PAGE_SHIFT)
+#define PSX_BUS_PAGE_MASK (PSX_BUS_PAGE_SIZE - 1)
+#define PSX_BUS_PHYS_SIZE 0x20000000
+#define PSX_BUS_PAGE_COUNT (PSX_BUS_PHYS_SIZE >> PSX_BUS_PAGE_SHIFT)
+
+// Scratchpad and I/O ports share pages with other devices and unmapped
+// holes, so these two pages are resolved with word granularity instead
+#define PSX_BUS_IO_BEGIN 0x1f800000
+#define PSX_BUS_IO_SIZE 0x2000
+
+enum
+{
+    PSX_BUS_NONE,
+    PSX_BUS_IO,
+    PSX_BUS_PARTIAL,
+    PSX_BUS_BIOS,
+    PSX_BUS_RAM,
+    PSX_BUS_DMA,
+    PSX_BUS_EXP1,
+    PSX_BUS_EXP2,
+    PSX_BUS_MC1,
+    PSX_BUS_MC2,
+    PSX_BUS_MC3,
+    PSX_BUS_IC,
+    PSX_BUS_SCRATCHPAD,
+    PSX_BUS_GPU,
+    PSX_BUS_SPU,
+    PSX_BUS_TIMER,
+    PSX_BUS_CDROM,
+    PSX_BUS_PAD,
+    PSX_BUS_MDEC
+};
+
 struct psx_bus_t
 {
     psx_bios_t *bios;
@@ -38,6 +75,25 @@ struct psx_bus_t
     psx_mdec_t *mdec;
 
     uint32_t access_cycles;
+
+    // SIO control register, not emulated beyond reading it back
+    uint16_t sio_ctrl;
+
+    uint8_t *read_page[PSX_BUS_PAGE_COUNT];
+    uint8_t *write_page[PSX_BUS_PAGE_COUNT];
+    uint8_t page_dev[PSX_BUS_PAGE_COUNT];
+    uint8_t page_delay[PSX_BUS_PAGE_COUNT];
+    uint8_t io_dev[PSX_BUS_IO_SIZE >> 2];
+
+    // Bumped on every page table rebuild, so host pointers taken
+    // from read_page can be checked for staleness
+    uint32_t page_table_gen;
+
+    // RAM pages holding cached code are mapped without a write pointer,
+    // the first write to one of them is reported through code_write_cb
+    uint8_t code_page[PSX_RAM_SIZE >> PSX_BUS_PAGE_SHIFT];
+    psx_bus_code_write_cb_t code_write_cb;
+    void *code_write_udata;
 };
 
 void psx_bus_init_bios(psx_bus_t *, psx_bios_t *);
@@ -56,5 +112,6 @@ void psx_bus_init_timer(psx_bus_t *, psx_timer_t *);
 void psx_bus_init_cdrom(psx_bus_t *, psx_cdrom_t *);
 void psx_bus_init_pad(psx_bus_t *, psx_pad_t *);
 void psx_bus_init_mdec(psx_bus_t *, psx_mdec_t *);
+void psx_bus_init_page_table(psx_bus_t *);
 
 #endif
\ No newline at end of file
@@ -5,16 +5,87 @@
 #include <stdio.h>
 
 #include "psx/bus.h"
+#include "psx/state.h"
 
 #define PSX_CPU_CPS 33868800    // 33868800 Clocks/s
 #define PSX_CPU_FREQ 33.868800f // 33.868800 MHz
 
 struct psx_cpu_t;
+struct psx_jit_t;
 
 typedef struct psx_cpu_t psx_cpu_t;
 
 typedef void (*psx_cpu_kcall_hook_t)(psx_cpu_t *);
 
+// Handlers return the cycles taken, or 0 for an illegal
+// instruction (same as psx_cpu_execute)
+typedef int (*psx_cpu_handler_t)(psx_cpu_t *);
+
+enum
+{
+    PSX_CPU_INTERPRETER,
+    PSX_CPU_CACHED,
+    PSX_CPU_JIT
+};
+
+// The cached interpreter keeps decoded blocks for code in RAM and
+// BIOS, indexed by 4 KiB page and by word within the page. BIOS pages
+// cover the 1 MiB SCPH-5903 BIOS too
+#define PSX_CPU_CACHE_PAGE_SHIFT 12
+#define PSX_CPU_CACHE_PAGE_SIZE (1 << PSX_CPU_CACHE_PAGE_SHIFT)
+#define PSX_CPU_CACHE_RAM_PAGES (0x800000 >> PSX_CPU_CACHE_PAGE_SHIFT)
+#define PSX_CPU_CACHE_BIOS_PAGES (0x100000 >> PSX_CPU_CACHE_PAGE_SHIFT)
+#define PSX_CPU_CACHE_PAGES (PSX_CPU_CACHE_RAM_PAGES + PSX_CPU_CACHE_BIOS_PAGES)
+
+typedef struct
+{
+    psx_cpu_handler_t handler;
+    uint32_t opcode;
+} psx_cpu_insn_t;
+
+// Straight-line run of instructions starting at a given address,
+// blocks never cross a page so they can be invalidated per page
+typedef struct
+{
+    uint32_t size;
+    uint32_t fetch_cycles;
+    psx_cpu_insn_t insn[];
+} psx_cpu_block_t;
+
+// Instruction pairs the cached interpreter runs as one handler
+enum
+{
+    PSX_CPU_FUSED_LUI_ORI,
+    PSX_CPU_FUSED_LUI_ADDIU,
+    PSX_CPU_FUSED_LUI_LW,
+    PSX_CPU_FUSED_SLT_BRANCH,
+    PSX_CPU_FUSED_COUNT
+};
+
+// Longest loop body (including the delay slot) considered for idle
+// skipping, games usually wait on VBlank with 3 to 6 instructions
+#define PSX_CPU_IDLE_LOOP_MAX 16
+
+// Short backward loop that only polls memory and computes nothing
+// that carries over between iterations, running it again without
+// a device update in between can't change anything
+typedef struct
+{
+    uint32_t pc;
+    uint32_t size;
+    uint32_t loads;
+
+    // Checked again before skipping, the code may have been replaced
+    uint32_t opcode[PSX_CPU_IDLE_LOOP_MAX];
+
+    struct
+    {
+        int base;
+        int32_t offset;
+        uint32_t width;
+    } load[PSX_CPU_IDLE_LOOP_MAX];
+} psx_cpu_idle_loop_t;
+
 /*
     cop0r0      - N/A
     cop0r1      - N/A
@@ -64,7 +135,7 @@ typedef void (*psx_cpu_kcall_hook_t)(psx_cpu_t *);
   -          hi,lo    Multiply/divide results, may be changed by subroutines
 */
 
-typedef struct __attribute__((__packed__))
+typedef struct
 {
     union
     {
@@ -75,7 +146,7 @@ typedef struct __attribute__((__packed__))
     int16_t z;
 } gte_vertex_t;
 
-typedef struct __attribute__((__packed__))
+typedef struct
 {
     union
     {
@@ -84,12 +155,12 @@ typedef struct __attribute__((__packed__))
     };
 } gte_vec2_t;
 
-typedef struct __attribute__((__packed__))
+typedef struct
 {
     int32_t x, y, z;
 } gte_vec3_t;
 
-typedef struct __attribute__((__packed__))
+typedef struct
 {
     union
     {
@@ -98,7 +169,7 @@ typedef struct __attribute__((__packed__))
     };
 } gte_color_t;
 
-typedef struct __attribute__((__packed__))
+typedef struct
 {
     union
     {
@@ -109,20 +180,41 @@ typedef struct __attribute__((__packed__))
     int16_t m33;
 } gte_matrix_t;
 
-struct __attribute__((__packed__)) psx_cpu_t
+/*
+    Computes (t << 12) + m * v[k] for n vectors, checking the first
+    two partial sums of each row for 44-bit overflow the way the GTE
+    does. Final sums are stored unchecked, returns the FLAG bits
+    raised by the partial sums.
+*/
+typedef uint32_t (*psx_gte_mul_t)(int64_t (*)[3], const gte_matrix_t *, const gte_vec3_t *, int16_t (*)[3], int);
+
+#define PSX_CPU_CACHE_LINE 64
+
+/*
+    Laid out in three cache line aligned blocks: state touched by
+    every instruction, GTE state, and host-side state. Everything
+    before bus is guest state and goes into state files as is.
+
+    GTE registers are only accessed through gte_read_register and
+    gte_write_register, so the GTE blocks don't need to match the
+    hardware register layout.
+*/
+struct psx_cpu_t
 {
-    uint32_t r[32];
-    uint32_t opcode;
+    _Alignas(PSX_CPU_CACHE_LINE) uint32_t r[32];
     uint32_t pc, next_pc, saved_pc;
+    uint32_t opcode;
     uint32_t hi, lo;
     uint32_t load_d, load_v;
     uint32_t last_cycles;
+    uint32_t last_instructions;
     uint32_t total_cycles;
     int branch, delay_slot, branch_taken;
 
+    // SR and CAUSE are checked for IRQs on every instruction
     uint32_t cop0_r[16];
 
-    struct
+    _Alignas(PSX_CPU_CACHE_LINE) struct
     {
         gte_vertex_t v[3];
         gte_color_t rgbc;
@@ -161,10 +253,44 @@ struct __attribute__((__packed__)) psx_cpu_t
     int64_t s_mac0;
     int64_t s_mac3;
 
-    psx_bus_t *bus;
+    // rand() seed while the HLE layer services rand/srand
+    uint32_t hle_seed;
+
+    // Fetch and dispatch state, used every instruction too
+    _Alignas(PSX_CPU_CACHE_LINE) psx_bus_t *bus;
+
+    int mode;
+
+    psx_cpu_block_t *block;
+    uint32_t block_pc;
+    uint32_t block_index;
+
+    // Cycles until the next device event, set before every step.
+    // Pairs are only fused when no event falls between the two
+    uint64_t sched_budget;
+
+    // Host pointer for the page PC is fetching from, refreshed when
+    // PC leaves the page or the bus page table is rebuilt
+    const uint8_t *fetch_ptr;
+    uint32_t fetch_page;
+    uint32_t fetch_gen;
+    uint32_t fetch_cycles;
+
+    struct psx_jit_t *jit;
+
+    // SIMD matrix-vector kernel, NULL uses the scalar path
+    psx_gte_mul_t gte_mul;
+
+    // Service hot BIOS kernel calls natively, see hle.c
+    int hle;
+
+    // Times each fused pair ran
+    uint64_t fused[PSX_CPU_FUSED_COUNT];
 
     psx_cpu_kcall_hook_t a_function_hook;
     psx_cpu_kcall_hook_t b_function_hook;
+
+    psx_cpu_block_t **block_page[PSX_CPU_CACHE_PAGES];
 };
 
 /*
@@ -236,16 +362,35 @@ struct __attribute__((__packed__)) psx_cpu_t
 #define SR_CU3 0x80000000
 
 psx_cpu_t *psx_cpu_create(void);
+
+// Sets up a CPU in storage aligned for psx_cpu_t, see psx_cpu_release
+psx_cpu_t *psx_cpu_create_at(void *);
+
+// Frees what the CPU allocated, but not the CPU itself
+void psx_cpu_release(psx_cpu_t *);
 void psx_cpu_init(psx_cpu_t *, psx_bus_t *);
 void psx_cpu_destroy(psx_cpu_t *);
 void psx_cpu_cycle(psx_cpu_t *);
 void psx_cpu_set_irq_pending(psx_cpu_t *);
-void psx_cpu_load_state(psx_cpu_t *, FILE *);
-void psx_cpu_save_state(psx_cpu_t *, FILE *);
+void psx_cpu_save_state(psx_cpu_t *, psx_state_t *);
+int psx_cpu_load_state(psx_cpu_t *, psx_state_t *);
 void psx_cpu_fetch(psx_cpu_t *);
 void psx_cpu_set_a_kcall_hook(psx_cpu_t *, psx_cpu_kcall_hook_t);
 void psx_cpu_set_b_kcall_hook(psx_cpu_t *, psx_cpu_kcall_hook_t);
 int psx_cpu_execute(psx_cpu_t *);
+void psx_cpu_set_mode(psx_cpu_t *, int);
+void psx_cpu_set_gte_simd(psx_cpu_t *, int);
+void psx_cpu_set_hle(psx_cpu_t *, int);
+uint64_t psx_cpu_get_fused_count(psx_cpu_t *, int);
+uint32_t psx_cpu_read_gte(psx_cpu_t *, int);
+void psx_cpu_write_gte(psx_cpu_t *, int, uint32_t);
+void psx_cpu_flush_cache(psx_cpu_t *);
+int psx_cpu_check_irq(psx_cpu_t *);
+int psx_cpu_get_code_page(psx_cpu_t *, uint32_t);
+psx_cpu_handler_t psx_cpu_decode(uint32_t);
+int psx_cpu_execute_decoded(psx_cpu_t *, psx_cpu_handler_t, uint32_t);
+int psx_cpu_find_idle_loop(psx_cpu_t *, uint32_t, psx_cpu_idle_loop_t *);
+int psx_cpu_check_idle_loop(psx_cpu_t *, psx_cpu_idle_loop_t *);
 
 /*
     00h INT     Interrupt
@@ -4,8 +4,12 @@
 #include <stdint.h>
 
 #include "psx/log.h"
+#include "psx/image.h"
 
 #define PSX_BIOS_SIZE 0x80000
+
+// SCPH-5903 (Video CD) BIOS
+#define PSX_BIOS_MAX_SIZE 0x100000
 #define PSX_BIOS_BEGIN 0x1fc00000
 #define PSX_BIOS_END 0x1fc7ffff
 
@@ -14,7 +18,9 @@ typedef struct
     uint32_t bus_delay;
     uint32_t io_base, io_size;
 
+    // Points into the image, which is mapped read-only
     uint8_t *buf;
+    psx_image_t *image;
 } psx_bios_t;
 
 psx_bios_t *psx_bios_create(void);
@@ -6,6 +6,8 @@
 #include "psx/dev/cdrom/queue.h"
 #include "psx/dev/cdrom/disc.h"
 #include "psx/dev/ic.h"
+#include "psx/sched.h"
+#include "psx/state.h"
 
 #define PSX_CDROM_BEGIN 0x1f801800
 #define PSX_CDROM_END 0x1f801803
@@ -209,6 +211,7 @@ typedef struct
     uint32_t io_base, io_size;
     psx_disc_t *disc;
     psx_ic_t *ic;
+    psx_sched_t *sched;
     int disc_type;
     int version;
     int region;
@@ -296,7 +299,7 @@ void cdrom_set_int(psx_cdrom_t *cdrom, int n);
 void cdrom_process_setloc(psx_cdrom_t *cdrom);
 
 psx_cdrom_t *psx_cdrom_create(void);
-void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic);
+void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic, psx_sched_t *sched);
 void psx_cdrom_reset(psx_cdrom_t *cdrom);
 void psx_cdrom_set_version(psx_cdrom_t *cdrom, int version);
 void psx_cdrom_set_region(psx_cdrom_t *cdrom, int region);
@@ -310,6 +313,8 @@ void psx_cdrom_write16(psx_cdrom_t *cdrom, uint32_t addr, uint32_t value);
 void psx_cdrom_write8(psx_cdrom_t *cdrom, uint32_t addr, uint32_t value);
 void psx_cdrom_update(psx_cdrom_t *cdrom, int cycles);
 void psx_cdrom_get_audio_samples(psx_cdrom_t *cdrom, void *buf, size_t size);
+void psx_cdrom_save_state(psx_cdrom_t *cdrom, psx_state_t *state);
+int psx_cdrom_load_state(psx_cdrom_t *cdrom, psx_state_t *state);
 void psx_cdrom_destroy(psx_cdrom_t *cdrom);
 
 #endif
\ No newline at end of file
@@ -3,6 +3,7 @@
 
 #include "psx/dev/cdrom/list.h"
 #include "psx/dev/cdrom/disc.h"
+#include "psx/image.h"
 
 #include <stdint.h>
 #include <stddef.h>
@@ -65,6 +66,9 @@ typedef struct
     size_t size;
     uint32_t start;
     list_t *tracks;
+
+    // Backs buf in LD_BUFFERED mode
+    psx_image_t *image;
 } cue_file_t;
 
 typedef struct
@@ -9,6 +9,8 @@
 
 #include "psx/bus.h"
 #include "psx/dev/ic.h"
+#include "psx/sched.h"
+#include "psx/state.h"
 
 typedef struct
 {
@@ -24,6 +26,7 @@ typedef struct
 
     psx_bus_t *bus;
     psx_ic_t *ic;
+    psx_sched_t *sched;
 
     dma_channel_t mdec_in;
     dma_channel_t mdec_out;
@@ -45,7 +48,7 @@ typedef struct
 } psx_dma_t;
 
 psx_dma_t *psx_dma_create(void);
-void psx_dma_init(psx_dma_t *, psx_bus_t *, psx_ic_t *);
+void psx_dma_init(psx_dma_t *, psx_bus_t *, psx_ic_t *, psx_sched_t *);
 void psx_dma_do_mdec_in(psx_dma_t *);
 void psx_dma_do_mdec_out(psx_dma_t *);
 void psx_dma_do_gpu(psx_dma_t *);
@@ -60,6 +63,8 @@ uint8_t psx_dma_read8(psx_dma_t *, uint32_t);
 void psx_dma_write32(psx_dma_t *, uint32_t, uint32_t);
 void psx_dma_write16(psx_dma_t *, uint32_t, uint16_t);
 void psx_dma_write8(psx_dma_t *, uint32_t, uint8_t);
+void psx_dma_save_state(psx_dma_t *, psx_state_t *);
+int psx_dma_load_state(psx_dma_t *, psx_state_t *);
 void psx_dma_destroy(psx_dma_t *);
 void psx_dma_update(psx_dma_t *, int);
 
@@ -6,6 +6,9 @@
 #include <string.h>
 
 #include "psx/dev/ic.h"
+#include "psx/dirty.h"
+#include "psx/sched.h"
+#include "psx/state.h"
 
 #define PSX_GPU_BEGIN 0x1f801810
 #define PSX_GPU_SIZE 0x8
@@ -20,6 +23,12 @@
 // 0x100000 * 2
 #define PSX_GPU_VRAM_SIZE (0x200000)
 
+// VRAM followed by the blank display buffer
+#define PSX_GPU_BUF_SIZE (PSX_GPU_VRAM_SIZE * 2)
+
+// Keeps data written by different threads apart
+#define PSX_GPU_CACHE_LINE 64
+
 #define PSX_GPU_CLOCK_NTSC 53693175        // 53.693175 MHz
 #define PSX_GPU_CLOCK_FREQ_NTSC 53.693175f // 53.693175 MHz
 #define PSX_GPU_CLOCK_FREQ_PAL 53.203425f  // 53.203425 MHz
@@ -45,6 +54,16 @@ struct psx_gpu_t;
 
 typedef struct psx_gpu_t psx_gpu_t;
 
+struct psx_gpu_thread_t;
+
+typedef struct psx_gpu_thread_t psx_gpu_thread_t;
+
+struct psx_gpu_raster_t;
+struct psx_gpu_batch_t;
+
+typedef struct psx_gpu_raster_t psx_gpu_raster_t;
+typedef struct psx_gpu_batch_t psx_gpu_batch_t;
+
 typedef void (*psx_gpu_cmd_t)(psx_gpu_t *);
 typedef void (*psx_gpu_event_callback_t)(psx_gpu_t *);
 
@@ -94,6 +113,70 @@ typedef struct
     uint16_t width, height;
 } rect_data_t;
 
+// Attributes are interpolated with 12 fractional bits, like the hardware
+#define PSX_GPU_FRAC_BITS 12
+
+/*
+    One row of a primitive, shaded by a span kernel. Colours are in
+    12-bit fixed point and step once per pixel, texels are fetched
+    ahead by the rasterizer since texture lookups don't vectorize.
+*/
+typedef struct
+{
+    int32_t r, g, b;
+    int32_t dr, dg, db;
+
+    // 0x00bbggrr, used when the span isn't shaded
+    uint32_t color;
+
+    // Dither offsets from the first pixel on, repeating every 4 pixels
+    int8_t dither[4];
+
+    // PA_* flags, textured spans with PA_TRANSP only blend texels
+    // with bit 15 set
+    int attrib;
+    int transp_mode;
+
+    // Set on every pixel written, pixels that have check_mask set
+    // are left alone
+    uint16_t set_mask;
+    uint16_t check_mask;
+} psx_gpu_span_t;
+
+// Shades count pixels into dst. Texels of textured spans are in
+// texels, 0 is transparent
+typedef void (*psx_gpu_span_fn_t)(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *);
+
+/*
+    Span kernels are specialized on the span's attributes and blending
+    mode, and picked once per primitive from a table of these:
+
+      bits 0-2  PA_RAW, PA_TRANSP, PA_TEXTURED
+      bit 3     PA_SHADED
+      bits 4-5  transp_mode
+*/
+#define PSX_GPU_SPAN_KERNELS 64
+
+#define PSX_GPU_SPAN_INDEX(attrib, mode)                                                                       \
+    (((attrib) & (PA_RAW | PA_TRANSP | PA_TEXTURED)) | (((attrib) & PA_SHADED) ? 8 : 0) | (((mode) & 3) << 4))
+
+#define PSX_GPU_SPAN_ATTRIB(index) (((index) & 7) | (((index) & 8) ? PA_SHADED : 0))
+#define PSX_GPU_SPAN_MODE(index) (((index) >> 4) & 3)
+
+// Expands X(index) for every kernel, for building the tables
+#define PSX_GPU_SPAN_LIST(X)                        \
+    X(0) X(1) X(2) X(3) X(4) X(5) X(6) X(7)         \
+    X(8) X(9) X(10) X(11) X(12) X(13) X(14) X(15)   \
+    X(16) X(17) X(18) X(19) X(20) X(21) X(22) X(23) \
+    X(24) X(25) X(26) X(27) X(28) X(29) X(30) X(31) \
+    X(32) X(33) X(34) X(35) X(36) X(37) X(38) X(39) \
+    X(40) X(41) X(42) X(43) X(44) X(45) X(46) X(47) \
+    X(48) X(49) X(50) X(51) X(52) X(53) X(54) X(55) \
+    X(56) X(57) X(58) X(59) X(60) X(61) X(62) X(63)
+
+// Scalar kernels, indexed by PSX_GPU_SPAN_INDEX
+extern const psx_gpu_span_fn_t g_psx_gpu_span_kernels[PSX_GPU_SPAN_KERNELS];
+
 struct psx_gpu_t
 {
     uint32_t bus_delay;
@@ -103,8 +186,24 @@ struct psx_gpu_t
 
     uint16_t *vram;
     uint16_t *empty;
+
+    // One bit per VRAM line, host-side
+    uint8_t dirty[PSX_DIRTY_SIZE(PSX_GPU_FB_HEIGHT)];
+
+    // Span kernels picked for the host CPU, PSX_GPU_SPAN_KERNELS
+    // of them
+    const psx_gpu_span_fn_t *shade_span;
     int display_enable;
 
+    // Draws GP0 commands on a worker thread when set, VRAM is only
+    // valid on this side after psx_gpu_sync
+    psx_gpu_thread_t *thread;
+
+    // Draws primitives in batches, split into bands of lines across
+    // a thread pool when set
+    psx_gpu_raster_t *raster;
+    psx_gpu_batch_t *batch;
+
     // State data
     uint32_t buf[16];
     uint32_t recv_data;
@@ -169,8 +268,8 @@ struct psx_gpu_t
     uint32_t disp_x1, disp_x2;
     uint32_t disp_y1, disp_y2;
 
-    // Timing and IRQs
-    float cycles;
+    // Timing and IRQs, cycles is in 16.16 fixed-point GPU cycles
+    uint64_t cycles;
     int line;
 
     psx_ic_t *ic;
@@ -179,17 +278,43 @@ struct psx_gpu_t
 };
 
 psx_gpu_t *psx_gpu_create(void);
-void psx_gpu_init(psx_gpu_t *, psx_ic_t *);
+void psx_gpu_init(psx_gpu_t *, psx_ic_t *, psx_sched_t *, void *buf);
 uint32_t psx_gpu_read32(psx_gpu_t *, uint32_t);
 uint16_t psx_gpu_read16(psx_gpu_t *, uint32_t);
 uint8_t psx_gpu_read8(psx_gpu_t *, uint32_t);
 void psx_gpu_write32(psx_gpu_t *, uint32_t, uint32_t);
 void psx_gpu_write16(psx_gpu_t *, uint32_t, uint16_t);
 void psx_gpu_write8(psx_gpu_t *, uint32_t, uint8_t);
+void psx_gpu_save_state(psx_gpu_t *, psx_state_t *);
+int psx_gpu_load_state(psx_gpu_t *, psx_state_t *);
 void psx_gpu_destroy(psx_gpu_t *);
 void psx_gpu_set_udata(psx_gpu_t *, int, void *);
 void psx_gpu_set_event_callback(psx_gpu_t *, int, psx_gpu_event_callback_t);
 void *psx_gpu_get_display_buffer(psx_gpu_t *);
 void psx_gpu_update(psx_gpu_t *, int);
 
+// VRAM lines written since the last clear, PSX_GPU_FB_HEIGHT of them
+const uint8_t *psx_gpu_get_dirty(psx_gpu_t *);
+void psx_gpu_clear_dirty(psx_gpu_t *);
+
+// Scalar span kernel for any attributes, the reference the
+// specialized and SIMD kernels must match
+void psx_gpu_shade_span(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *);
+
+// Uses the SIMD span kernels if the host supports them, on by default
+void psx_gpu_set_simd(psx_gpu_t *, int);
+
+// Moves GP0 drawing to a worker thread, off by default
+void psx_gpu_set_thread(psx_gpu_t *, int);
+
+// Splits drawing across this many threads, 1 or less draws on the
+// thread running GP0, the default
+void psx_gpu_set_raster_threads(psx_gpu_t *, int);
+
+// Waits for the worker threads to catch up before VRAM is read
+void psx_gpu_sync(psx_gpu_t *);
+
+// Stops the worker threads, for GPUs living in an arena
+void psx_gpu_release(psx_gpu_t *);
+
 #endif
\ No newline at end of file
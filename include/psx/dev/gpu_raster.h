@@ -0,0 +1,63 @@
+#ifndef GPU_RASTER_H
+#define GPU_RASTER_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "psx/dev/gpu.h"
+
+// Threads drawing bands, including the one that asks for them
+#define PSX_GPU_RASTER_MAX_THREADS 16
+
+typedef void (*psx_gpu_raster_fn_t)(void *udata, int band);
+
+/*
+    A pool of threads for drawing bands of VRAM lines. The thread
+    calling psx_gpu_raster_run draws bands too, and only returns once
+    every band is done. Workers claim bands from a counter tagged with
+    the run it belongs to, so a worker late from one run can't pick up
+    a band of the next.
+*/
+struct psx_gpu_raster_t
+{
+    // Run number in the upper 32 bits, next band in the lower ones
+    _Alignas(PSX_GPU_CACHE_LINE) _Atomic uint64_t work;
+    _Alignas(PSX_GPU_CACHE_LINE) _Atomic int done;
+
+    // Written with the lock held, before work
+    uint32_t run;
+    int bands;
+    int quit;
+    psx_gpu_raster_fn_t fn;
+    void *udata;
+
+    int count;
+
+#ifdef _WIN32
+    HANDLE threads[PSX_GPU_RASTER_MAX_THREADS];
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t threads[PSX_GPU_RASTER_MAX_THREADS];
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+};
+
+// Starts threads - 1 workers, NULL on failure
+psx_gpu_raster_t *psx_gpu_raster_create(int threads);
+
+// Calls fn for every band in [0, bands), returns when all are drawn
+void psx_gpu_raster_run(psx_gpu_raster_t *, int bands, psx_gpu_raster_fn_t fn, void *udata);
+
+int psx_gpu_raster_get_threads(psx_gpu_raster_t *);
+
+void psx_gpu_raster_destroy(psx_gpu_raster_t *);
+
+#endif
@@ -0,0 +1,22 @@
+#ifndef GPU_SIMD_H
+#define GPU_SIMD_H
+
+#include "psx/dev/gpu.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PSX_GPU_SIMD_X86
+#endif
+
+enum
+{
+    PSX_GPU_SIMD_NONE,
+    PSX_GPU_SIMD_SSE41,
+    PSX_GPU_SIMD_AVX2
+};
+
+// Returns the fastest span kernels up to level supported by the
+// host CPU, indexed by PSX_GPU_SPAN_INDEX, or NULL if only the
+// scalar path is available
+const psx_gpu_span_fn_t *psx_gpu_simd_select(int level);
+
+#endif
@@ -0,0 +1,75 @@
+#ifndef GPU_THREAD_H
+#define GPU_THREAD_H
+
+#include <stdatomic.h>
+#include <stdint.h>
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <pthread.h>
+#endif
+
+#include "psx/dev/gpu.h"
+
+// GP0 words in flight, a power of 2
+#define PSX_GPU_THREAD_RING_SIZE 0x10000
+#define PSX_GPU_THREAD_RING_MASK (PSX_GPU_THREAD_RING_SIZE - 1)
+
+/*
+    Runs GP0 drawing on a worker thread. The emulation thread keeps
+    parsing GP0 on its own psx_gpu_t, so GPUSTAT and GPUREAD stay
+    exact, but skips drawing and pushes every word into a single
+    producer, single consumer ring. The worker replays the words on a
+    copy of the GPU that shares VRAM. Words are published to the worker
+    at the end of each packet, or when the ring fills up.
+
+    The emulation thread only touches VRAM after psx_gpu_thread_sync,
+    which waits for the worker to drain the ring.
+*/
+struct psx_gpu_thread_t
+{
+    // Written by the emulation thread. head is the last published
+    // word, next the last one pushed
+    _Alignas(PSX_GPU_CACHE_LINE) _Atomic uint32_t head;
+    uint32_t next;
+    uint32_t tail_cache;
+
+    // Written by the worker
+    _Alignas(PSX_GPU_CACHE_LINE) _Atomic uint32_t tail;
+    _Atomic int sleeping;
+
+    _Alignas(PSX_GPU_CACHE_LINE) _Atomic int quit;
+
+    // Worker side GPU, draws into the emulation thread's VRAM
+    psx_gpu_t *gpu;
+
+#ifdef _WIN32
+    HANDLE thread;
+    SRWLOCK lock;
+    CONDITION_VARIABLE cond;
+#else
+    pthread_t thread;
+    pthread_mutex_t lock;
+    pthread_cond_t cond;
+#endif
+
+    uint32_t ring[PSX_GPU_THREAD_RING_SIZE];
+};
+
+// Starts a worker on a copy of gpu, NULL on failure
+psx_gpu_thread_t *psx_gpu_thread_create(psx_gpu_t *gpu);
+
+void psx_gpu_thread_push(psx_gpu_thread_t *, uint32_t value);
+void psx_gpu_thread_publish(psx_gpu_thread_t *);
+
+// Publishes pending words and waits until the worker has run them
+void psx_gpu_thread_sync(psx_gpu_thread_t *);
+
+// Makes the worker's copy match gpu again, call after a sync
+void psx_gpu_thread_reset(psx_gpu_thread_t *, psx_gpu_t *gpu);
+
+// Runs the remaining words, then stops the worker
+void psx_gpu_thread_destroy(psx_gpu_thread_t *);
+
+#endif
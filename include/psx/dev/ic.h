@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
 #include "psx/cpu.h"
 
 #define PSX_IC_BEGIN 0x1f801070
@@ -64,6 +65,8 @@ void psx_ic_write32(psx_ic_t *, uint32_t, uint32_t);
 void psx_ic_write16(psx_ic_t *, uint32_t, uint16_t);
 void psx_ic_write8(psx_ic_t *, uint32_t, uint8_t);
 void psx_ic_irq(psx_ic_t *, int);
+void psx_ic_save_state(psx_ic_t *, psx_state_t *);
+int psx_ic_load_state(psx_ic_t *, psx_state_t *);
 void psx_ic_destroy(psx_ic_t *);
 
 #endif
\ No newline at end of file
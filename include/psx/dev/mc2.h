@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
+
 #define PSX_MC2_BEGIN 0x1f801060
 #define PSX_MC2_SIZE  0x4
 #define PSX_MC2_END   0x1F801063
@@ -22,6 +24,8 @@ uint8_t psx_mc2_read8(psx_mc2_t*, uint32_t);
 void psx_mc2_write32(psx_mc2_t*, uint32_t, uint32_t);
 void psx_mc2_write16(psx_mc2_t*, uint32_t, uint16_t);
 void psx_mc2_write8(psx_mc2_t*, uint32_t, uint8_t);
+void psx_mc2_save_state(psx_mc2_t*, psx_state_t*);
+int psx_mc2_load_state(psx_mc2_t*, psx_state_t*);
 void psx_mc2_destroy(psx_mc2_t*);
 
 #endif
\ No newline at end of file
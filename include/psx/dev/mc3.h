@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
+
 #define PSX_MC3_BEGIN 0xfffe0130
 #define PSX_MC3_SIZE  0x4
 #define PSX_MC3_END   0xfffe0133
@@ -22,6 +24,8 @@ uint8_t psx_mc3_read8(psx_mc3_t*, uint32_t);
 void psx_mc3_write32(psx_mc3_t*, uint32_t, uint32_t);
 void psx_mc3_write16(psx_mc3_t*, uint32_t, uint16_t);
 void psx_mc3_write8(psx_mc3_t*, uint32_t, uint8_t);
+void psx_mc3_save_state(psx_mc3_t*, psx_state_t*);
+int psx_mc3_load_state(psx_mc3_t*, psx_state_t*);
 void psx_mc3_destroy(psx_mc3_t*);
 
 #endif
\ No newline at end of file
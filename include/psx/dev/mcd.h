@@ -6,6 +6,8 @@
 #include <string.h>
 #include <stdio.h>
 
+#include "psx/state.h"
+
 #define MCD_MEMORY_SIZE 0x20000 // 128 KB
 
 enum {
@@ -59,6 +61,8 @@ uint8_t psx_mcd_read(psx_mcd_t*);
 void psx_mcd_write(psx_mcd_t*, uint8_t);
 int psx_mcd_query(psx_mcd_t*);
 void psx_mcd_reset(psx_mcd_t*);
+void psx_mcd_save_state(psx_mcd_t*, psx_state_t*);
+int psx_mcd_load_state(psx_mcd_t*, psx_state_t*);
 void psx_mcd_destroy(psx_mcd_t*);
 
 #endif
\ No newline at end of file
@@ -3,7 +3,9 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
 #include "psx/dev/ic.h"
+#include "psx/sched.h"
 #include "psx/dev/input.h"
 #include "psx/dev/mcd.h"
 
@@ -111,6 +113,7 @@ typedef struct
     uint32_t io_base, io_size;
 
     psx_ic_t *ic;
+    psx_sched_t *sched;
     psx_input_t *joy_slot[2];
     psx_mcd_t *mcd_slot[2];
 
@@ -124,13 +127,15 @@ typedef struct
 } psx_pad_t;
 
 psx_pad_t *psx_pad_create(void);
-void psx_pad_init(psx_pad_t *, psx_ic_t *);
+void psx_pad_init(psx_pad_t *, psx_ic_t *, psx_sched_t *);
 uint32_t psx_pad_read32(psx_pad_t *, uint32_t);
 uint16_t psx_pad_read16(psx_pad_t *, uint32_t);
 uint8_t psx_pad_read8(psx_pad_t *, uint32_t);
 void psx_pad_write32(psx_pad_t *, uint32_t, uint32_t);
 void psx_pad_write16(psx_pad_t *, uint32_t, uint16_t);
 void psx_pad_write8(psx_pad_t *, uint32_t, uint8_t);
+void psx_pad_save_state(psx_pad_t *, psx_state_t *);
+int psx_pad_load_state(psx_pad_t *, psx_state_t *);
 void psx_pad_destroy(psx_pad_t *);
 void psx_pad_button_press(psx_pad_t *, int, uint32_t);
 void psx_pad_button_release(psx_pad_t *, int, uint32_t);
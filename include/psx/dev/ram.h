@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "psx/dirty.h"
+#include "psx/state.h"
 #include "psx/log.h"
 #include "psx/dev/mc2.h"
 
@@ -16,6 +18,10 @@
 #define RAM_SIZE_4MB 0x400000
 #define RAM_SIZE_8MB 0x800000
 
+// Dirty tracking granularity, same as a bus page
+#define PSX_RAM_PAGE_SHIFT 12
+#define PSX_RAM_PAGE_COUNT (PSX_RAM_SIZE >> PSX_RAM_PAGE_SHIFT)
+
 typedef struct
 {
     uint32_t bus_delay;
@@ -26,16 +32,26 @@ typedef struct
     psx_mc2_t *mc2;
 
     uint8_t *buf;
+
+    // Host-side, not part of the machine state
+    uint8_t dirty[PSX_DIRTY_SIZE(PSX_RAM_PAGE_COUNT)];
 } psx_ram_t;
 
 psx_ram_t *psx_ram_create(void);
-void psx_ram_init(psx_ram_t *, psx_mc2_t *, int size);
+void psx_ram_init(psx_ram_t *, psx_mc2_t *, int size, uint8_t *buf);
 uint32_t psx_ram_read32(psx_ram_t *, uint32_t);
 uint16_t psx_ram_read16(psx_ram_t *, uint32_t);
 uint8_t psx_ram_read8(psx_ram_t *, uint32_t);
 void psx_ram_write32(psx_ram_t *, uint32_t, uint32_t);
 void psx_ram_write16(psx_ram_t *, uint32_t, uint16_t);
 void psx_ram_write8(psx_ram_t *, uint32_t, uint8_t);
+
+// Pages written since the last clear, ram->size >> PSX_RAM_PAGE_SHIFT of them
+const uint8_t *psx_ram_get_dirty(psx_ram_t *);
+void psx_ram_mark_dirty(psx_ram_t *, uint32_t offset, uint32_t size);
+void psx_ram_clear_dirty(psx_ram_t *);
+void psx_ram_save_state(psx_ram_t *, psx_state_t *);
+int psx_ram_load_state(psx_ram_t *, psx_state_t *);
 void psx_ram_destroy(psx_ram_t *);
 
 #endif
\ No newline at end of file
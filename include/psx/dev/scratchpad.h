@@ -3,6 +3,7 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
 #include "psx/dev/mc1.h"
 
 #define PSX_SCRATCHPAD_BEGIN 0x1f800000
@@ -18,13 +19,15 @@ typedef struct
 } psx_scratchpad_t;
 
 psx_scratchpad_t *psx_scratchpad_create(void);
-void psx_scratchpad_init(psx_scratchpad_t *);
+void psx_scratchpad_init(psx_scratchpad_t *, uint8_t *buf);
 uint32_t psx_scratchpad_read32(psx_scratchpad_t *, uint32_t);
 uint16_t psx_scratchpad_read16(psx_scratchpad_t *, uint32_t);
 uint8_t psx_scratchpad_read8(psx_scratchpad_t *, uint32_t);
 void psx_scratchpad_write32(psx_scratchpad_t *, uint32_t, uint32_t);
 void psx_scratchpad_write16(psx_scratchpad_t *, uint32_t, uint16_t);
 void psx_scratchpad_write8(psx_scratchpad_t *, uint32_t, uint8_t);
+void psx_scratchpad_save_state(psx_scratchpad_t *, psx_state_t *);
+int psx_scratchpad_load_state(psx_scratchpad_t *, psx_state_t *);
 void psx_scratchpad_destroy(psx_scratchpad_t *);
 
 #endif
\ No newline at end of file
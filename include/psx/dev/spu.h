@@ -3,6 +3,8 @@
 
 #include <stdint.h>
 
+#include "psx/dirty.h"
+#include "psx/state.h"
 #include "psx/dev/ic.h"
 
 #define PSX_SPU_BEGIN 0x1f801c00
@@ -11,6 +13,10 @@
 
 #define SPU_RAM_SIZE 0x80000
 
+// Dirty tracking granularity
+#define SPU_RAM_PAGE_SHIFT 12
+#define SPU_RAM_PAGE_COUNT (SPU_RAM_SIZE >> SPU_RAM_PAGE_SHIFT)
+
 /*
     1F801D88h - Voice 0..23 Key ON (Start Attack/Decay/Sustain) (KON) (W)
     1F801D8Ch - Voice 0..23 Key OFF (Start Release) (KOFF) (W)
@@ -121,6 +127,9 @@ typedef struct __attribute__((__packed__))
     int lrsr;
     int even_cycle;
 
+    // Capture IRQs are raised every other CDDA buffer update
+    int cdda_irq_counter;
+
     struct
     {
         int playing;
@@ -173,18 +182,27 @@ typedef struct __attribute__((__packed__))
         int adsr_sustain_level;
         uint32_t envctl;
     } data[24];
+
+    // Host-side, not part of the machine state
+    uint8_t dirty[PSX_DIRTY_SIZE(SPU_RAM_PAGE_COUNT)];
 } psx_spu_t;
 
 psx_spu_t *psx_spu_create(void);
-void psx_spu_init(psx_spu_t *, psx_ic_t *);
+void psx_spu_init(psx_spu_t *, psx_ic_t *, uint8_t *buf);
 uint32_t psx_spu_read32(psx_spu_t *, uint32_t);
 uint16_t psx_spu_read16(psx_spu_t *, uint32_t);
 uint8_t psx_spu_read8(psx_spu_t *, uint32_t);
 void psx_spu_write32(psx_spu_t *, uint32_t, uint32_t);
 void psx_spu_write16(psx_spu_t *, uint32_t, uint16_t);
 void psx_spu_write8(psx_spu_t *, uint32_t, uint8_t);
+void psx_spu_save_state(psx_spu_t *, psx_state_t *);
+int psx_spu_load_state(psx_spu_t *, psx_state_t *);
 void psx_spu_destroy(psx_spu_t *);
 void psx_spu_update_cdda_buffer(psx_spu_t *, void *);
 uint32_t psx_spu_get_sample(psx_spu_t *);
 
+// SPU RAM pages written since the last clear, SPU_RAM_PAGE_COUNT of them
+const uint8_t *psx_spu_get_dirty(psx_spu_t *);
+void psx_spu_clear_dirty(psx_spu_t *);
+
 #endif
\ No newline at end of file
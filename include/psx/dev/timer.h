@@ -3,8 +3,10 @@
 
 #include <stdint.h>
 
+#include "psx/state.h"
 #include "psx/dev/ic.h"
 #include "psx/dev/gpu.h"
+#include "psx/sched.h"
 
 #define PSX_TIMER_BEGIN 0x1f801100
 #define PSX_TIMER_SIZE 0x30
@@ -93,13 +95,18 @@ typedef struct
 
     psx_ic_t *ic;
     psx_gpu_t *gpu;
+    psx_sched_t *sched;
+
+    // Timers advance 2 ticks per retired instruction
+    uint64_t last_instructions;
 
     int hblank, prev_hblank;
     int vblank, prev_vblank;
 
     struct
     {
-        float counter;
+        // 16.16 fixed-point
+        uint64_t counter;
         uint32_t target;
         int sync_enable;
         int sync_mode;
@@ -121,7 +128,7 @@ typedef struct
 } psx_timer_t;
 
 psx_timer_t *psx_timer_create(void);
-void psx_timer_init(psx_timer_t *, psx_ic_t *, psx_gpu_t *);
+void psx_timer_init(psx_timer_t *, psx_ic_t *, psx_gpu_t *, psx_sched_t *);
 uint32_t psx_timer_read32(psx_timer_t *, uint32_t);
 uint16_t psx_timer_read16(psx_timer_t *, uint32_t);
 uint8_t psx_timer_read8(psx_timer_t *, uint32_t);
@@ -129,6 +136,8 @@ void psx_timer_write32(psx_timer_t *, uint32_t, uint32_t);
 void psx_timer_write16(psx_timer_t *, uint32_t, uint16_t);
 void psx_timer_write8(psx_timer_t *, uint32_t, uint8_t);
 void psx_timer_update(psx_timer_t *, int);
+void psx_timer_save_state(psx_timer_t *, psx_state_t *);
+int psx_timer_load_state(psx_timer_t *, psx_state_t *);
 void psx_timer_destroy(psx_timer_t *);
 
 // GPU event handlers
@@ -0,0 +1,63 @@
+#ifndef DIRTY_H
+#define DIRTY_H
+
+#include <stdint.h>
+#include <string.h>
+
+/*
+    One bit per page of guest memory, set by every write to it. RAM,
+    VRAM and SPU RAM each keep one, consumers read them and clear them
+    once they've caught up. Byte-sized words keep the bitmaps usable
+    inside packed device structs.
+*/
+#define PSX_DIRTY_SIZE(pages) (((pages) + 7) >> 3)
+
+static inline void psx_dirty_set(uint8_t *map, uint32_t page)
+{
+    map[page >> 3] |= 1 << (page & 7);
+}
+
+static inline int psx_dirty_test(const uint8_t *map, uint32_t page)
+{
+    return (map[page >> 3] >> (page & 7)) & 1;
+}
+
+static inline void psx_dirty_set_range(uint8_t *map, uint32_t page, uint32_t count)
+{
+    while (count--)
+        psx_dirty_set(map, page++);
+}
+
+// Returns the first dirty page at or after page, or pages if there's none
+static inline uint32_t psx_dirty_next(const uint8_t *map, uint32_t pages, uint32_t page)
+{
+    while (page < pages)
+    {
+        // Skip clean bytes whole
+        if (!(page & 7) && !map[page >> 3])
+        {
+            page += 8;
+
+            continue;
+        }
+
+        if (psx_dirty_test(map, page))
+            return page;
+
+        ++page;
+    }
+
+    return pages;
+}
+
+static inline uint32_t psx_dirty_count(const uint8_t *map, uint32_t pages)
+{
+    uint32_t count = 0;
+
+    for (uint32_t page = 0; page < pages; page++)
+        count += psx_dirty_test(map, page);
+
+    return count;
+}
+
+#endif
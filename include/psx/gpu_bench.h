@@ -0,0 +1,20 @@
+#ifndef GPU_BENCH_H
+#define GPU_BENCH_H
+
+#define PSX_GPU_BENCH_PRIMITIVES 20000
+#define PSX_GPU_BENCH_FRAMES 60
+
+// Raster threads used when none are configured
+#define PSX_GPU_BENCH_THREADS 4
+
+/*
+    Renders a random stream of polygons and rectangles with the SIMD
+    and the scalar span kernels and compares VRAM after every batch,
+    then times a set of fill-rate bound scenes on both. The stream is
+    also checked on a GPU thread and split across threads raster
+    threads, which are timed too. Prints mismatches and the time per
+    frame, returns the number of mismatches.
+*/
+int psx_gpu_bench_run(int primitives, int frames, int threads);
+
+#endif
@@ -0,0 +1,15 @@
+#ifndef GTE_BENCH_H
+#define GTE_BENCH_H
+
+#define PSX_GTE_BENCH_RANDOM_STATES 100000
+#define PSX_GTE_BENCH_ITERATIONS 1000000
+
+/*
+    Runs every GTE operation on a set of recorded register states and
+    checks the results against stored hashes, then on random states
+    through both the SIMD and the scalar path. Prints mismatches and
+    the time per operation, returns the number of mismatches.
+*/
+int psx_gte_bench_run(int random_states, int iterations);
+
+#endif
@@ -0,0 +1,16 @@
+#ifndef GTE_SIMD_H
+#define GTE_SIMD_H
+
+#include <stdint.h>
+
+#include "psx/cpu.h"
+
+#if (defined(__x86_64__) || defined(__i386__)) && defined(__GNUC__)
+#define PSX_GTE_SIMD_X86
+#endif
+
+// Returns the fastest matrix-vector kernel supported by the
+// host CPU, or NULL if only the scalar path is available
+psx_gte_mul_t psx_gte_simd_select(void);
+
+#endif
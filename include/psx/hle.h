@@ -0,0 +1,28 @@
+#ifndef HLE_H
+#define HLE_H
+
+#include <stdint.h>
+
+#include "psx/cpu.h"
+
+// Kernel calls jump to one of these with the function number in t1
+#define PSX_HLE_A0 0x000000a0
+#define PSX_HLE_B0 0x000000b0
+#define PSX_HLE_C0 0x000000c0
+
+static inline int psx_hle_is_vector(uint32_t pc)
+{
+    pc &= 0x3fffffff;
+
+    return (pc == PSX_HLE_A0) || (pc == PSX_HLE_B0) || (pc == PSX_HLE_C0);
+}
+
+/*
+    Services the kernel call the CPU is about to enter natively and
+    returns to the caller with v0 set, as the BIOS routine would.
+    Returns the approximate cycles the BIOS would have taken, or 0 if
+    the call isn't serviced and the BIOS has to run it.
+*/
+int psx_hle_call(psx_cpu_t *);
+
+#endif
@@ -0,0 +1,31 @@
+#ifndef IMAGE_H
+#define IMAGE_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+/*
+    Read-only file mappings shared by every instance in the process.
+    Opening a path that's already open returns the same image with its
+    reference count bumped, the file is unmapped when the last
+    reference is closed. Used for BIOS ROMs and disc track files.
+*/
+typedef struct psx_image_t
+{
+    char *path;
+    const uint8_t *buf;
+    size_t size;
+    int refs;
+
+#ifdef _WIN32
+    void *file;
+    void *mapping;
+#endif
+
+    struct psx_image_t *next;
+} psx_image_t;
+
+psx_image_t *psx_image_open(const char *path);
+void psx_image_close(psx_image_t *);
+
+#endif
@@ -0,0 +1,55 @@
+#ifndef JIT_H
+#define JIT_H
+
+#include <stdint.h>
+#include <stddef.h>
+
+#include "psx/cpu.h"
+
+#if defined(__x86_64__) || defined(_M_X64)
+#define PSX_JIT_X64
+#endif
+
+#define PSX_JIT_CODE_SIZE 0x2000000 // 32 MiB
+#define PSX_JIT_BLOCK_SIZE 0x8000   // Worst case for a single block
+#define PSX_JIT_PAGE_SIZE 0x1000   // Granularity of W^X switches
+#define PSX_JIT_MAX_INSNS 64
+#define PSX_JIT_MAX_CYCLES 256
+
+typedef void (*psx_jit_block_t)(psx_cpu_t *);
+
+typedef struct
+{
+    uint32_t pc;
+    psx_jit_block_t entry;
+} psx_jit_entry_t;
+
+/*
+    Translated blocks live in a single code buffer. Blocks are
+    never freed on their own, invalidating a page only drops its entry
+    points, the buffer is reset as a whole once it fills up. Pages
+    are only writable while a block is being emitted into them.
+*/
+struct psx_jit_t
+{
+    psx_cpu_t *cpu;
+
+    uint8_t *code;
+    size_t code_used;
+
+    psx_jit_entry_t *entry_page[PSX_CPU_CACHE_PAGES];
+
+    // Set when a page is invalidated, running blocks bail out
+    int invalidated;
+};
+
+typedef struct psx_jit_t psx_jit_t;
+
+psx_jit_t *psx_jit_create(void);
+int psx_jit_init(psx_jit_t *, psx_cpu_t *);
+int psx_jit_run(psx_jit_t *);
+void psx_jit_invalidate_page(psx_jit_t *, int);
+void psx_jit_flush(psx_jit_t *);
+void psx_jit_destroy(psx_jit_t *);
+
+#endif
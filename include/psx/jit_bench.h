@@ -0,0 +1,17 @@
+#ifndef JIT_BENCH_H
+#define JIT_BENCH_H
+
+#define PSX_JIT_BENCH_PROGRAMS 20000
+#define PSX_JIT_BENCH_LENGTH 256
+#define PSX_JIT_BENCH_PASSES 16
+
+/*
+    Runs random programs from RAM on a JIT CPU and on the interpreter
+    and compares registers, COP0 and the memory they write. Each
+    program is length instructions long and loops passes times.
+    Prints mismatches and the time per program on both cores, returns
+    the number of mismatches.
+*/
+int psx_jit_bench_run(int programs, int length, int passes);
+
+#endif
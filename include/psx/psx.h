@@ -1,9 +1,12 @@
 #ifndef PSX_H
 #define PSX_H
 
+#include "psx/arena.h"
 #include "psx/cpu.h"
 #include "psx/log.h"
 #include "psx/exe.h"
+#include "psx/sched.h"
+#include "psx/state.h"
 #include "psx/dev/spu.h"
 
 #include <stdint.h>
@@ -15,6 +18,9 @@
 #define PSXE_COMMIT STR(REP_COMMIT_HASH)
 #define PSXE_BUILD_OS STR(OS_INFO)
 
+// Where the BIOS hands over to the shell, EXEs are sideloaded here
+#define PSX_SHELL_ENTRY 0x80030000
+
 typedef struct
 {
     psx_bios_t *bios;
@@ -35,19 +41,56 @@ typedef struct
     psx_cdrom_t *cdrom;
     psx_pad_t *pad;
     psx_mdec_t *mdec;
+    psx_sched_t *sched;
+
+    // Backs everything above except cdrom, pad and mdec, unless base is NULL
+    psx_arena_t arena;
+
+    // Key for save files
+    uint64_t bios_hash;
+
+    // Worked out on load like bios_hash, part of the boot key
+    uint64_t exp1_hash;
+
+    // Idle loop skipping, see psx_update
+    psx_cpu_idle_loop_t idle;
+    uint64_t idle_now;
+    uint64_t idle_instructions;
+    uint64_t idle_skipped;
+    int idle_skip;
+    int idle_dirty;
 } psx_t;
 
 psx_t *psx_create(void);
+psx_t *psx_create_arena(int flags);
 int psx_init(psx_t *, const char *, const char *);
 int psx_load_expansion(psx_t *, const char *);
 int psx_load_bios(psx_t *, const char *);
 void psx_hard_reset(psx_t *);
 void psx_soft_reset(psx_t *);
-void psx_load_state(psx_t *, const char *);
-void psx_save_state(psx_t *, const char *);
+int psx_load_state(psx_t *, const char *);
+int psx_save_state(psx_t *, const char *);
+int psx_capture_state(psx_t *, psx_state_t *, uint64_t key);
+int psx_restore_state(psx_t *, psx_state_t *, uint64_t *key);
+
+// The halves of psx_save_state and psx_load_state that need the
+// machine, for callers doing the file I/O on another thread. Apply
+// keeps the running machine if the state doesn't restore
+int psx_capture_save_state(psx_t *, psx_state_t *);
+int psx_apply_save_state(psx_t *, psx_state_t *, const char *path);
+
+// Hash of the BIOS, expansion ROM and machine config a boot depends on
+uint64_t psx_get_boot_key(psx_t *);
+
+// Runs to the shell handoff, or restores the snapshot in cache_path if
+// it was taken with the same boot key. Returns 1 after a cold boot
+int psx_boot_to_shell(psx_t *, const char *cache_path);
 void psx_load_exe(psx_t *, const char *);
 void psx_update(psx_t *);
 void psx_run_frame(psx_t *);
+void psx_set_idle_skip(psx_t *, int);
+uint64_t psx_get_idle_skipped_cycles(psx_t *);
+void psx_clear_idle_skipped_cycles(psx_t *);
 void *psx_get_display_buffer(psx_t *);
 void *psx_get_vram(psx_t *);
 uint32_t psx_get_dmode_width(psx_t *);
@@ -76,6 +119,7 @@ psx_cdrom_t *psx_get_cdrom(psx_t *);
 psx_pad_t *psx_get_pad(psx_t *);
 psx_mdec_t *psx_get_mdec(psx_t *);
 psx_cpu_t *psx_get_cpu(psx_t *);
+psx_sched_t *psx_get_sched(psx_t *);
 void psx_destroy(psx_t *);
 
 #endif
\ No newline at end of file
@@ -0,0 +1,62 @@
+#ifndef REWIND_H
+#define REWIND_H
+
+#include <stddef.h>
+#include <stdint.h>
+
+#include "psx/psx.h"
+
+// Frames between captures
+#define PSX_REWIND_INTERVAL 6
+
+#define PSX_REWIND_MAX_ENTRIES 4096
+
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+
+    // Size of the older state this delta rebuilds
+    size_t base_size;
+} psx_rewind_entry_t;
+
+/*
+    History of machine states for stepping backwards. Only the newest
+    capture is kept whole, every older one is stored as the XOR of it
+    and the capture after it, run-length encoded. Most of the state
+    doesn't change between captures, so the deltas are mostly runs of
+    zeroes. The oldest deltas are dropped to stay within the budget.
+*/
+typedef struct
+{
+    psx_state_t current;
+    psx_state_t next;
+
+    psx_rewind_entry_t *entries;
+    int head;
+    int count;
+
+    size_t used;
+    size_t budget;
+
+    int interval;
+    int frames;
+
+    // Worst case for one delta, see rewind_encode
+    uint8_t *scratch;
+    size_t scratch_size;
+} psx_rewind_t;
+
+psx_rewind_t *psx_rewind_create(void);
+void psx_rewind_init(psx_rewind_t *, size_t budget, int interval);
+
+// Call once per frame, captures every interval frames
+void psx_rewind_frame(psx_rewind_t *, psx_t *);
+
+// Goes back to the newest capture, or the one before it if the
+// machine is still there. Returns 1 if there is nothing to go back to
+int psx_rewind_step(psx_rewind_t *, psx_t *);
+void psx_rewind_clear(psx_rewind_t *);
+void psx_rewind_destroy(psx_rewind_t *);
+
+#endif
@@ -0,0 +1,67 @@
+#ifndef SCHED_H
+#define SCHED_H
+
+#include <stdint.h>
+
+#include "psx/state.h"
+
+#define PSX_SCHED_NEVER UINT64_MAX
+
+// Events are dispatched in this order when due at the same time
+enum
+{
+    PSX_SCHED_CDROM = 0,
+    PSX_SCHED_GPU,
+    PSX_SCHED_PAD,
+    PSX_SCHED_TIMER,
+    PSX_SCHED_DMA,
+    PSX_SCHED_EVENT_COUNT
+};
+
+// Brings a device up to date, receives the cycles elapsed since
+// its last update
+typedef void (*psx_sched_update_t)(void *, int);
+
+// Returns the cycles until the device has to be updated again,
+// or PSX_SCHED_NEVER if nothing is pending
+typedef uint64_t (*psx_sched_next_t)(void *);
+
+typedef struct
+{
+    uint64_t time;
+    uint64_t last;
+    psx_sched_update_t update;
+    psx_sched_next_t next;
+    void *udata;
+    int index;
+} psx_sched_event_t;
+
+/*
+    Devices register one event each and are only updated when their
+    deadline is reached, or when they sync themselves on a register
+    access. Deadlines are absolute CPU cycle counts kept in a min-heap.
+*/
+typedef struct
+{
+    uint64_t now;
+    uint64_t instructions;
+
+    // Time of the earliest pending event
+    uint64_t deadline;
+
+    psx_sched_event_t event[PSX_SCHED_EVENT_COUNT];
+    int heap[PSX_SCHED_EVENT_COUNT];
+    int heap_size;
+} psx_sched_t;
+
+psx_sched_t *psx_sched_create(void);
+void psx_sched_init(psx_sched_t *);
+void psx_sched_register(psx_sched_t *, int, psx_sched_update_t, psx_sched_next_t, void *);
+void psx_sched_sync(psx_sched_t *, int);
+void psx_sched_reschedule(psx_sched_t *, int);
+void psx_sched_run(psx_sched_t *);
+void psx_sched_save_state(psx_sched_t *, psx_state_t *);
+int psx_sched_load_state(psx_sched_t *, psx_state_t *);
+void psx_sched_destroy(psx_sched_t *);
+
+#endif
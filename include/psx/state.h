@@ -0,0 +1,125 @@
+#ifndef STATE_H
+#define STATE_H
+
+#include <stddef.h>
+#include <stdint.h>
+#include <string.h>
+
+#define PSX_STATE_MAGIC 0x53585350 // "PSXS"
+#define PSX_STATE_FILE_MAGIC 0x5a585350 // "PSXZ"
+
+// Bump whenever the meaning of saved state changes
+#define PSX_STATE_VERSION 2
+
+#define PSX_STATE_ID(a, b, c, d) \
+    ((uint32_t)(a) | ((uint32_t)(b) << 8) | ((uint32_t)(c) << 16) | ((uint32_t)(d) << 24))
+
+// Chunks are stored in this order
+#define PSX_STATE_SCHED PSX_STATE_ID('S', 'C', 'H', 'D')
+#define PSX_STATE_CPU PSX_STATE_ID('C', 'P', 'U', ' ')
+#define PSX_STATE_BUS PSX_STATE_ID('B', 'U', 'S', ' ')
+#define PSX_STATE_RAM PSX_STATE_ID('R', 'A', 'M', ' ')
+#define PSX_STATE_SCRATCHPAD PSX_STATE_ID('S', 'P', 'A', 'D')
+#define PSX_STATE_MC1 PSX_STATE_ID('M', 'C', '1', ' ')
+#define PSX_STATE_MC2 PSX_STATE_ID('M', 'C', '2', ' ')
+#define PSX_STATE_MC3 PSX_STATE_ID('M', 'C', '3', ' ')
+#define PSX_STATE_EXP2 PSX_STATE_ID('E', 'X', 'P', '2')
+#define PSX_STATE_IC PSX_STATE_ID('I', 'C', ' ', ' ')
+#define PSX_STATE_DMA PSX_STATE_ID('D', 'M', 'A', ' ')
+#define PSX_STATE_TIMER PSX_STATE_ID('T', 'I', 'M', 'R')
+#define PSX_STATE_GPU PSX_STATE_ID('G', 'P', 'U', ' ')
+#define PSX_STATE_SPU PSX_STATE_ID('S', 'P', 'U', ' ')
+#define PSX_STATE_CDROM PSX_STATE_ID('C', 'D', 'R', 'M')
+#define PSX_STATE_PAD PSX_STATE_ID('P', 'A', 'D', ' ')
+#define PSX_STATE_MCD PSX_STATE_ID('M', 'C', 'D', ' ')
+#define PSX_STATE_MDEC PSX_STATE_ID('M', 'D', 'E', 'C')
+
+typedef struct
+{
+    uint32_t magic;
+    uint32_t version;
+
+    // Hash of the struct layouts the chunks were written with
+    uint32_t layout;
+    uint32_t size;
+
+    // Caller-defined, psx_save_state stores the BIOS hash here
+    uint64_t key;
+} psx_state_header_t;
+
+typedef struct
+{
+    uint32_t id;
+    uint32_t size;
+} psx_state_chunk_t;
+
+// State files are the state compressed, after this header
+typedef struct
+{
+    uint32_t magic;
+    uint32_t reserved;
+    uint64_t size;
+} psx_state_file_header_t;
+
+/*
+    A machine snapshot in memory: a header followed by one chunk per
+    device. Devices copy their structs in whole and clear the host
+    pointers in the copy, so the same machine state always produces
+    the same bytes. The buffer is kept across captures.
+*/
+typedef struct
+{
+    uint8_t *buf;
+    size_t size;
+    size_t cap;
+
+    // Read cursor, and where the open chunk and the last write start
+    size_t pos;
+    size_t chunk;
+    size_t last;
+
+    // Set when the buffer couldn't grow, writes are dropped until the
+    // next begin and psx_state_end fails
+    int error;
+} psx_state_t;
+
+void psx_state_init(psx_state_t *);
+
+// Sets the size of the raw buffer, keeping what fits. Returns non-zero
+// and leaves the state alone if the buffer can't grow
+int psx_state_resize(psx_state_t *, size_t);
+void psx_state_begin(psx_state_t *, uint32_t layout, uint64_t key);
+void psx_state_begin_chunk(psx_state_t *, uint32_t id);
+void psx_state_write(psx_state_t *, const void *, size_t);
+
+// Zeroes size bytes at offset into the data just written
+void psx_state_clear(psx_state_t *, size_t offset, size_t size);
+void psx_state_end_chunk(psx_state_t *);
+
+// Returns non-zero if any write was dropped, the state is left empty
+int psx_state_end(psx_state_t *);
+
+// Checks the header and the chunk framing, rewinds to the first chunk
+int psx_state_open(psx_state_t *, uint32_t layout, uint64_t *key);
+
+// Opens the next chunk, returns its payload size or -1 if the id doesn't match
+int psx_state_next_chunk(psx_state_t *, uint32_t id);
+void psx_state_read(psx_state_t *, void *, size_t);
+void psx_state_skip(psx_state_t *, size_t);
+
+// Opens the next chunk and reads it into a struct if the size matches
+int psx_state_read_chunk(psx_state_t *, uint32_t id, void *, size_t);
+
+// Whole state to and from disk, read_file leaves the state to be opened.
+// Both compress or decompress on the calling thread and only touch the
+// state passed in, so they can run off the emulation thread. Files are
+// replaced atomically
+int psx_state_write_file(psx_state_t *, const char *path);
+int psx_state_read_file(psx_state_t *, const char *path);
+void psx_state_destroy(psx_state_t *);
+
+// Clears a host-only field in the struct that was just written
+#define PSX_STATE_CLEAR(state, type, field) \
+    psx_state_clear(state, offsetof(type, field), sizeof(((type *)0)->field))
+
+#endif
@@ -99,6 +99,22 @@ void psxe_cfg_load_defaults(psxe_config_t *cfg)
     cfg->quiet = 0;
     cfg->cd_path = NULL;
     cfg->exp_path = NULL;
+    cfg->cpu = "interpreter";
+    cfg->idle_skip = 1;
+    cfg->gte_bench = 0;
+    cfg->gpu_bench = 0;
+    cfg->jit_bench = 0;
+    cfg->instances = 0;
+    cfg->state_check = 0;
+    cfg->rewind_budget = 64;
+    cfg->hle = 0;
+    cfg->gpu_thread = 0;
+    // The raster pool has no measured multi-core gain yet, keep it opt-in
+    cfg->gpu_raster_threads = 0;
+    cfg->arena = 0;
+    cfg->huge_pages = 0;
+    cfg->boot_cache = "boot.state";
+    cfg->state_path = "quick.state";
 }
 
 void psxe_cfg_load(psxe_config_t *cfg, int argc, const char *argv[])
@@ -113,6 +129,21 @@ void psxe_cfg_load(psxe_config_t *cfg, int argc, const char *argv[])
     int quiet = 0;
     int console_source = 0;
     int scale = 0;
+    int no_idle_skip = 0;
+    int gte_bench = 0;
+    int gpu_bench = 0;
+    int jit_bench = 0;
+    int instances = 0;
+    int state_check = 0;
+    int rewind_budget = -1;
+    int hle = 0;
+    int gpu_thread = 0;
+    int gpu_raster_threads = 0;
+    int arena = 0;
+    int huge_pages = 0;
+    int no_boot_cache = 0;
+    const char *boot_cache = NULL;
+    const char *state_path = NULL;
     const char *settings_path = NULL;
     const char *bios = NULL;
     const char *bios_search = NULL;
@@ -122,6 +153,7 @@ void psxe_cfg_load(psxe_config_t *cfg, int argc, const char *argv[])
     const char *psxe_version = NULL;
     const char *cd_path = NULL;
     const char *exp_path = NULL;
+    const char *cpu = NULL;
 
     static const char *const usages[] = {
         "psxe [options] path-to-cdrom",
@@ -147,6 +179,22 @@ void psxe_cfg_load(psxe_config_t *cfg, int argc, const char *argv[])
         OPT_BOOLEAN('q', "quiet", &quiet, "Silence all logs (ignores -L)"),
         OPT_STRING('x', "exe", &exe, "Launch a PS-X EXE file"),
         OPT_STRING(0, "cdrom", &cd_path, "Specify a CDROM image"),
+        OPT_STRING(0, "cpu", &cpu, "Select CPU core (interpreter, cached, jit)"),
+        OPT_BOOLEAN(0, "no-idle-skip", &no_idle_skip, "Don't fast-forward through idle loops"),
+        OPT_BOOLEAN(0, "hle", &hle, "Run hot BIOS kernel calls natively"),
+        OPT_BOOLEAN(0, "gpu-thread", &gpu_thread, "Draw GPU commands on a separate thread"),
+        OPT_INTEGER(0, "gpu-raster-threads", &gpu_raster_threads, "Split GPU drawing into bands across N threads (experimental, off by default)"),
+        OPT_BOOLEAN(0, "arena", &arena, "Allocate the console and its memory as one block"),
+        OPT_BOOLEAN(0, "huge-pages", &huge_pages, "Back the arena with huge pages (implies --arena)"),
+        OPT_INTEGER(0, "rewind-budget", &rewind_budget, "Memory for rewind history in MiB, 0 disables rewinding"),
+        OPT_STRING(0, "boot-cache", &boot_cache, "Snapshot file for skipping the BIOS boot"),
+        OPT_BOOLEAN(0, "no-boot-cache", &no_boot_cache, "Always boot the BIOS from reset"),
+        OPT_STRING(0, "state", &state_path, "File F7 saves the machine to and F8 loads it from"),
+        OPT_BOOLEAN(0, "gte-bench", &gte_bench, "Check and time the GTE, then exit"),
+        OPT_BOOLEAN(0, "gpu-bench", &gpu_bench, "Check and time the GPU span kernels, then exit"),
+        OPT_BOOLEAN(0, "jit-bench", &jit_bench, "Check the JIT against the interpreter and time both, then exit"),
+        OPT_INTEGER(0, "instance-check", &instances, "Run N instances concurrently against a serial run, then exit"),
+        OPT_INTEGER(0, "state-check", &state_check, "Check a state round trip after N frames, then exit"),
         OPT_END()};
 
     struct argparse argparse;
@@ -304,6 +352,54 @@ void psxe_cfg_load(psxe_config_t *cfg, int argc, const char *argv[])
 
     if (scale)
         cfg->scale = scale;
+
+    if (cpu)
+        cfg->cpu = cpu;
+
+    if (no_idle_skip)
+        cfg->idle_skip = 0;
+
+    if (gte_bench)
+        cfg->gte_bench = 1;
+
+    if (gpu_bench)
+        cfg->gpu_bench = 1;
+
+    if (jit_bench)
+        cfg->jit_bench = 1;
+
+    if (instances)
+        cfg->instances = instances;
+
+    if (state_check)
+        cfg->state_check = state_check;
+
+    if (hle)
+        cfg->hle = 1;
+
+    if (gpu_thread)
+        cfg->gpu_thread = 1;
+
+    if (gpu_raster_threads)
+        cfg->gpu_raster_threads = gpu_raster_threads;
+
+    if (arena || huge_pages)
+        cfg->arena = 1;
+
+    if (huge_pages)
+        cfg->huge_pages = 1;
+
+    if (rewind_budget >= 0)
+        cfg->rewind_budget = rewind_budget;
+
+    if (boot_cache)
+        cfg->boot_cache = boot_cache;
+
+    if (no_boot_cache)
+        cfg->boot_cache = NULL;
+
+    if (state_path)
+        cfg->state_path = state_path;
 }
 
 // To-do: Implement BIOS searching
@@ -0,0 +1,294 @@
+#include "frontend/instances.h"
+
+#include "psx/psx.h"
+#include "psx/log.h"
+
+#include <stdio.h>
+#include <string.h>
+#include <stdlib.h>
+
+#define SDL_MAIN_HANDLED
+#include <SDL3/SDL.h>
+
+typedef struct
+{
+    psxe_config_t *cfg;
+    int frames;
+    int ret;
+    uint64_t hash;
+} psxe_instance_t;
+
+static uint64_t instance_hash(uint64_t hash, const void *buf, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+static void instance_log_lock(bool lock, void *udata)
+{
+    if (lock)
+    {
+        SDL_LockMutex((SDL_Mutex *)udata);
+    }
+    else
+    {
+        SDL_UnlockMutex((SDL_Mutex *)udata);
+    }
+}
+
+static psx_t *instance_create(psxe_config_t *cfg)
+{
+    psx_t *psx = NULL;
+
+    if (cfg->arena)
+        psx = psx_create_arena(cfg->huge_pages ? PSX_ARENA_HUGE : 0);
+
+    if (!psx)
+        psx = psx_create();
+
+    if (psx_init(psx, cfg->bios, cfg->exp_path))
+    {
+        psx_destroy(psx);
+
+        return NULL;
+    }
+
+    psx_cpu_t *cpu = psx_get_cpu(psx);
+
+    if (!strcmp(cfg->cpu, "cached"))
+    {
+        psx_cpu_set_mode(cpu, PSX_CPU_CACHED);
+    }
+    else if (!strcmp(cfg->cpu, "jit"))
+    {
+        psx_cpu_set_mode(cpu, PSX_CPU_JIT);
+    }
+
+    psx_set_idle_skip(psx, cfg->idle_skip);
+    psx_cpu_set_hle(cpu, cfg->hle);
+    psx_gpu_set_thread(psx_get_gpu(psx), cfg->gpu_thread);
+    psx_gpu_set_raster_threads(psx_get_gpu(psx), cfg->gpu_raster_threads);
+
+    if (cfg->cd_path)
+        psx_cdrom_open(psx_get_cdrom(psx), cfg->cd_path);
+
+    return psx;
+}
+
+static uint64_t instance_hash_machine(psx_t *psx)
+{
+    psx_cpu_t *cpu = psx_get_cpu(psx);
+    psx_ram_t *ram = psx_get_ram(psx);
+
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    hash = instance_hash(hash, ram->buf, ram->size);
+    hash = instance_hash(hash, psx_get_vram(psx), PSX_GPU_VRAM_SIZE);
+    hash = instance_hash(hash, cpu->r, sizeof(cpu->r));
+    hash = instance_hash(hash, &cpu->pc, sizeof(cpu->pc));
+    hash = instance_hash(hash, &cpu->total_cycles, sizeof(cpu->total_cycles));
+
+    return hash;
+}
+
+static int instance_check_hash(const char *name, psx_t *psx, uint64_t expected)
+{
+    uint64_t hash = instance_hash_machine(psx);
+
+    if (hash == expected)
+        return 0;
+
+    printf("%s: mismatch (%016llx, expected %016llx)\n", name,
+        (unsigned long long)hash,
+        (unsigned long long)expected
+    );
+
+    return 1;
+}
+
+static int instance_run(void *udata)
+{
+    psxe_instance_t *inst = (psxe_instance_t *)udata;
+
+    psx_t *psx = instance_create(inst->cfg);
+
+    if (!psx)
+    {
+        inst->ret = 1;
+
+        return 1;
+    }
+
+    for (int i = 0; i < inst->frames; i++)
+        psx_run_frame(psx);
+
+    inst->hash = instance_hash_machine(psx);
+    inst->ret = 0;
+
+    psx_destroy(psx);
+
+    return 0;
+}
+
+int psxe_instances_check(psxe_config_t *cfg, int instances, int frames)
+{
+    psxe_instance_t serial;
+
+    serial.cfg = cfg;
+    serial.frames = frames;
+
+    instance_run(&serial);
+
+    if (serial.ret)
+    {
+        log_fatal("Couldn't start the serial instance");
+
+        return -1;
+    }
+
+    // The logger is shared by every instance
+    SDL_Mutex *log_mutex = SDL_CreateMutex();
+
+    log_set_lock(instance_log_lock, log_mutex);
+
+    psxe_instance_t *inst = malloc(instances * sizeof(psxe_instance_t));
+    SDL_Thread **threads = malloc(instances * sizeof(SDL_Thread *));
+
+    for (int i = 0; i < instances; i++)
+    {
+        inst[i].cfg = cfg;
+        inst[i].frames = frames;
+        inst[i].ret = 1;
+
+        threads[i] = SDL_CreateThread(instance_run, "psxe-instance", &inst[i]);
+    }
+
+    int mismatches = 0;
+
+    for (int i = 0; i < instances; i++)
+    {
+        if (threads[i])
+        {
+            SDL_WaitThread(threads[i], NULL);
+        }
+        else
+        {
+            log_error("Couldn't create thread for instance %u: %s", i, SDL_GetError());
+        }
+
+        if (inst[i].ret || (inst[i].hash != serial.hash))
+        {
+            printf("instance %u: mismatch (%016llx, expected %016llx)\n", i,
+                (unsigned long long)inst[i].hash,
+                (unsigned long long)serial.hash
+            );
+
+            ++mismatches;
+        }
+    }
+
+    printf("%u/%u instances match the serial run after %u frames\n",
+        instances - mismatches, instances, frames
+    );
+
+    log_set_lock(NULL, NULL);
+
+    SDL_DestroyMutex(log_mutex);
+
+    free(threads);
+    free(inst);
+
+    return mismatches;
+}
+
+int psxe_state_check(psxe_config_t *cfg, int frames, const char *path)
+{
+    psx_t *psx = instance_create(cfg);
+
+    if (!psx)
+    {
+        log_fatal("Couldn't start the instance");
+
+        return -1;
+    }
+
+    for (int i = 0; i < frames; i++)
+        psx_run_frame(psx);
+
+    psx_state_t state, again;
+
+    psx_state_init(&state);
+    psx_state_init(&again);
+
+    // The first capture sizes the buffer, time the ones after it
+    psx_capture_state(psx, &state, 0);
+
+    Uint64 start = SDL_GetPerformanceCounter();
+
+    for (int i = 0; i < PSXE_STATE_CAPTURES; i++)
+        psx_capture_state(psx, &state, 0);
+
+    double capture = (double)(SDL_GetPerformanceCounter() - start) * 1000.0 /
+        ((double)SDL_GetPerformanceFrequency() * PSXE_STATE_CAPTURES);
+
+    int mismatches = psx_save_state(psx, path);
+
+    for (int i = 0; i < frames; i++)
+        psx_run_frame(psx);
+
+    uint64_t hash = instance_hash_machine(psx);
+
+    // Same machine, restored in place
+    psx_restore_state(psx, &state, NULL);
+    psx_capture_state(psx, &again, 0);
+
+    if ((again.size != state.size) || memcmp(again.buf, state.buf, state.size))
+    {
+        printf("restore: capturing again gives different bytes\n");
+
+        ++mismatches;
+    }
+
+    for (int i = 0; i < frames; i++)
+        psx_run_frame(psx);
+
+    mismatches += instance_check_hash("restore", psx, hash);
+
+    psx_destroy(psx);
+
+    // Fresh machine, loaded from the file
+    psx = instance_create(cfg);
+
+    if (!psx || psx_load_state(psx, path))
+    {
+        ++mismatches;
+    }
+    else
+    {
+        for (int i = 0; i < frames; i++)
+            psx_run_frame(psx);
+
+        mismatches += instance_check_hash("load", psx, hash);
+    }
+
+    if (psx)
+        psx_destroy(psx);
+
+    remove(path);
+
+    printf("state: %zu bytes, captured in %.3f ms, round trip %s after %u frames\n",
+        state.size, capture, mismatches ? "failed" : "matches", frames
+    );
+
+    psx_state_destroy(&again);
+    psx_state_destroy(&state);
+
+    return mismatches;
+}
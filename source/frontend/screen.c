@@ -218,6 +218,9 @@ void psxe_screen_toggle_debug_mode(psxe_screen_t *screen)
 {
     screen->debug_mode = !screen->debug_mode;
 
+    if (!screen->debug_mode)
+        SDL_SetWindowTitle(screen->window, "psxe " STR(REP_VERSION) "-" STR(REP_COMMIT_HASH));
+
     psxe_screen_set_scale(screen, screen->saved_scale);
 
     screen->texture_width = PSX_GPU_FB_WIDTH;
@@ -277,6 +280,21 @@ void psxe_screen_update(psxe_screen_t *screen)
 
     SDL_RenderPresent(screen->renderer);
 
+    // Show how much of the last frame was spent in idle loops
+    if (screen->debug_mode)
+    {
+        char title[128];
+
+        uint64_t skipped = psx_get_idle_skipped_cycles(screen->psx);
+
+        snprintf(title, sizeof(title), "psxe " STR(REP_VERSION) "-" STR(REP_COMMIT_HASH) " | idle skip: %llu cycles",
+            (unsigned long long)skipped);
+
+        SDL_SetWindowTitle(screen->window, title);
+    }
+
+    psx_clear_idle_skipped_cycles(screen->psx);
+
     SDL_Event event;
 
     while (SDL_PollEvent(&event))
@@ -355,6 +373,25 @@ void psxe_screen_update(psxe_screen_t *screen)
             }
             break;
 
+            case SDLK_BACKSPACE:
+            {
+                screen->rewinding = screen->rewind != NULL;
+            }
+            break;
+
+            case SDLK_F7:
+            {
+                screen->save_requested = screen->state_io != NULL;
+            }
+            break;
+
+            case SDLK_F8:
+            {
+                if (screen->state_io && psxe_state_io_load(screen->state_io, screen->state_path))
+                    log_warn("Still busy with the last state");
+            }
+            break;
+
             case SDLK_F6:
             {
                 psx_swap_disc(screen->psx, ".\\roms\\Street Fighter II Movie (Japan) (Disc 2)\\Street Fighter II Movie (Japan) (Disc 2).cue");
@@ -499,6 +536,9 @@ void psxe_screen_update(psxe_screen_t *screen)
 
         case SDL_EVENT_KEY_UP:
         {
+            if (event.key.key == SDLK_BACKSPACE)
+                screen->rewinding = 0;
+
             uint32_t mask = screen_get_button(event.key.key);
 
             psx_pad_button_release(screen->pad, 0, mask);
@@ -508,6 +548,44 @@ void psxe_screen_update(psxe_screen_t *screen)
     }
 }
 
+void psxe_screen_set_rewind(psxe_screen_t *screen, psx_rewind_t *rewind)
+{
+    screen->rewind = rewind;
+}
+
+void psxe_screen_set_state_io(psxe_screen_t *screen, psxe_state_io_t *io, const char *path)
+{
+    screen->state_io = io;
+    screen->state_path = path;
+}
+
+void psxe_screen_end_frame(psxe_screen_t *screen)
+{
+    screen->frame_done = 0;
+
+    if (screen->state_io)
+    {
+        if (screen->save_requested && psxe_state_io_save(screen->state_io, screen->psx, screen->state_path))
+            log_warn("Still busy with the last state");
+
+        screen->save_requested = 0;
+
+        psxe_state_io_update(screen->state_io, screen->psx);
+    }
+
+    if (!screen->rewind)
+        return;
+
+    if (screen->rewinding)
+    {
+        psx_rewind_step(screen->rewind, screen->psx);
+    }
+    else
+    {
+        psx_rewind_frame(screen->rewind, screen->psx);
+    }
+}
+
 void psxe_screen_set_scale(psxe_screen_t *screen, unsigned int scale)
 {
     if (screen->debug_mode)
@@ -638,5 +716,7 @@ void psxe_gpu_vblank_event_cb(psx_gpu_t *gpu)
 
     psxe_screen_update(screen);
 
+    screen->frame_done = 1;
+
     psxe_gpu_vblank_timer_event_cb(gpu);
 }
\ No newline at end of file
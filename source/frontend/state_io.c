@@ -0,0 +1,192 @@
+#include "frontend/state_io.h"
+
+#include "psx/log.h"
+
+#include <stdlib.h>
+#include <string.h>
+
+static int state_io_run(void *udata)
+{
+    psxe_state_io_t *io = (psxe_state_io_t *)udata;
+
+    SDL_LockMutex(io->mutex);
+
+    while (1)
+    {
+        while (!io->quit && ((io->job == PSXE_STATE_IO_IDLE) || (io->job == PSXE_STATE_IO_LOADED)))
+            SDL_WaitCondition(io->cond, io->mutex);
+
+        // Quitting waits for the running job
+        if ((io->job != PSXE_STATE_IO_SAVE) && (io->job != PSXE_STATE_IO_LOAD))
+            break;
+
+        int job = io->job;
+
+        SDL_UnlockMutex(io->mutex);
+
+        int ret;
+
+        if (job == PSXE_STATE_IO_SAVE)
+        {
+            ret = psx_state_write_file(&io->state, io->path);
+
+            if (ret)
+            {
+                log_error("Couldn\'t write state \'%s\'", io->path);
+            }
+            else
+            {
+                log_info("Saved state \'%s\'", io->path);
+            }
+        }
+        else
+        {
+            ret = psx_state_read_file(&io->state, io->path);
+
+            if (ret)
+                log_error("Couldn\'t load state \'%s\'", io->path);
+        }
+
+        SDL_LockMutex(io->mutex);
+
+        io->ret = ret;
+        io->job = ((job == PSXE_STATE_IO_LOAD) && !ret) ? PSXE_STATE_IO_LOADED : PSXE_STATE_IO_IDLE;
+    }
+
+    SDL_UnlockMutex(io->mutex);
+
+    return 0;
+}
+
+psxe_state_io_t *psxe_state_io_create(void)
+{
+    return (psxe_state_io_t *)malloc(sizeof(psxe_state_io_t));
+}
+
+int psxe_state_io_init(psxe_state_io_t *io)
+{
+    memset(io, 0, sizeof(psxe_state_io_t));
+
+    psx_state_init(&io->state);
+
+    io->mutex = SDL_CreateMutex();
+    io->cond = SDL_CreateCondition();
+    io->thread = SDL_CreateThread(state_io_run, "psxe-state-io", io);
+
+    if (!io->thread)
+    {
+        log_error("Couldn\'t create state I/O thread: %s", SDL_GetError());
+
+        return 1;
+    }
+
+    return 0;
+}
+
+// Takes the job slot if it's free, the path is copied
+static int state_io_begin(psxe_state_io_t *io, const char *path)
+{
+    SDL_LockMutex(io->mutex);
+
+    int busy = io->job != PSXE_STATE_IO_IDLE;
+
+    SDL_UnlockMutex(io->mutex);
+
+    if (busy)
+        return 1;
+
+    size_t len = strlen(path) + 1;
+
+    free(io->path);
+
+    io->path = (char *)malloc(len);
+
+    memcpy(io->path, path, len);
+
+    return 0;
+}
+
+static void state_io_start(psxe_state_io_t *io, int job)
+{
+    SDL_LockMutex(io->mutex);
+
+    io->job = job;
+
+    SDL_SignalCondition(io->cond);
+    SDL_UnlockMutex(io->mutex);
+}
+
+int psxe_state_io_save(psxe_state_io_t *io, psx_t *psx, const char *path)
+{
+    if (!io->thread || state_io_begin(io, path))
+        return 1;
+
+    if (psx_capture_save_state(psx, &io->state))
+    {
+        log_error("Couldn\'t capture state for \'%s\'", path);
+
+        return 1;
+    }
+
+    state_io_start(io, PSXE_STATE_IO_SAVE);
+
+    return 0;
+}
+
+int psxe_state_io_load(psxe_state_io_t *io, const char *path)
+{
+    if (!io->thread || state_io_begin(io, path))
+        return 1;
+
+    state_io_start(io, PSXE_STATE_IO_LOAD);
+
+    return 0;
+}
+
+int psxe_state_io_update(psxe_state_io_t *io, psx_t *psx)
+{
+    SDL_LockMutex(io->mutex);
+
+    int loaded = io->job == PSXE_STATE_IO_LOADED;
+
+    SDL_UnlockMutex(io->mutex);
+
+    if (!loaded)
+        return 0;
+
+    int ret = psx_apply_save_state(psx, &io->state, io->path);
+
+    if (!ret)
+        log_info("Loaded state \'%s\'", io->path);
+
+    SDL_LockMutex(io->mutex);
+
+    io->job = PSXE_STATE_IO_IDLE;
+
+    SDL_UnlockMutex(io->mutex);
+
+    return !ret;
+}
+
+void psxe_state_io_destroy(psxe_state_io_t *io)
+{
+    if (io->thread)
+    {
+        SDL_LockMutex(io->mutex);
+
+        io->quit = 1;
+
+        SDL_SignalCondition(io->cond);
+        SDL_UnlockMutex(io->mutex);
+
+        SDL_WaitThread(io->thread, NULL);
+    }
+
+    SDL_DestroyCondition(io->cond);
+    SDL_DestroyMutex(io->mutex);
+
+    psx_state_destroy(&io->state);
+
+    free(io->path);
+    free(io);
+}
@@ -1,4 +1,7 @@
 #include "psx/psx.h"
+#include "psx/gte_bench.h"
+#include "psx/gpu_bench.h"
+#include "psx/jit_bench.h"
 #include "psx/input/sda.h"
 #include "psx/input/guncon.h"
 #include "psx/dev/cdrom/cdrom.h"
@@ -6,6 +9,7 @@
 
 #include "frontend/screen.h"
 #include "frontend/config.h"
+#include "frontend/instances.h"
 
 void audio_callback(void *userdata, SDL_AudioStream *stream, int additional_amount, int total_amount)
 {
@@ -45,9 +49,80 @@ int main(int argc, char *argv[])
 
     log_set_level(cfg->log_level);
 
-    psx_t *psx = psx_create();
+    if (cfg->gte_bench)
+    {
+        int mismatches = psx_gte_bench_run(PSX_GTE_BENCH_RANDOM_STATES, PSX_GTE_BENCH_ITERATIONS);
+
+        psxe_cfg_destroy(cfg);
+
+        return mismatches ? 1 : 0;
+    }
+
+    if (cfg->gpu_bench)
+    {
+        int mismatches = psx_gpu_bench_run(PSX_GPU_BENCH_PRIMITIVES, PSX_GPU_BENCH_FRAMES, (cfg->gpu_raster_threads > 1) ? cfg->gpu_raster_threads : PSX_GPU_BENCH_THREADS);
+
+        psxe_cfg_destroy(cfg);
+
+        return mismatches ? 1 : 0;
+    }
+
+    if (cfg->jit_bench)
+    {
+        int mismatches = psx_jit_bench_run(PSX_JIT_BENCH_PROGRAMS, PSX_JIT_BENCH_LENGTH, PSX_JIT_BENCH_PASSES);
+
+        psxe_cfg_destroy(cfg);
+
+        return mismatches ? 1 : 0;
+    }
+
+    if (cfg->instances > 0)
+    {
+        int mismatches = psxe_instances_check(cfg, cfg->instances, PSXE_INSTANCES_FRAMES);
+
+        psxe_cfg_destroy(cfg);
+
+        return mismatches ? 1 : 0;
+    }
+
+    if (cfg->state_check > 0)
+    {
+        int mismatches = psxe_state_check(cfg, cfg->state_check, "state-check.state");
+
+        psxe_cfg_destroy(cfg);
+
+        return mismatches ? 1 : 0;
+    }
+
+    psx_t *psx = NULL;
+
+    if (cfg->arena)
+        psx = psx_create_arena(cfg->huge_pages ? PSX_ARENA_HUGE : 0);
+
+    // Fall back on separate allocations if the arena can't be mapped
+    if (!psx)
+        psx = psx_create();
+
     psx_init(psx, cfg->bios, cfg->exp_path);
 
+    if (!strcmp(cfg->cpu, "cached"))
+    {
+        psx_cpu_set_mode(psx_get_cpu(psx), PSX_CPU_CACHED);
+    }
+    else if (!strcmp(cfg->cpu, "jit"))
+    {
+        psx_cpu_set_mode(psx_get_cpu(psx), PSX_CPU_JIT);
+    }
+    else if (strcmp(cfg->cpu, "interpreter"))
+    {
+        log_error("Unknown CPU core \'%s\', using interpreter", cfg->cpu);
+    }
+
+    psx_set_idle_skip(psx, cfg->idle_skip);
+    psx_cpu_set_hle(psx_get_cpu(psx), cfg->hle);
+    psx_gpu_set_thread(psx_get_gpu(psx), cfg->gpu_thread);
+    psx_gpu_set_raster_threads(psx_get_gpu(psx), cfg->gpu_raster_threads);
+
     psx_cdrom_t *cdrom = psx_get_cdrom(psx);
 
     // To-do: Set CDROM firmware version and region based
@@ -104,19 +179,41 @@ int main(int argc, char *argv[])
     psx_pad_attach_mcd(psx->pad, 1, "slot2.mcd");
 
     if (cfg->exe)
-    {
         SDL_PauseAudioStreamDevice(stream); // fixes high pitch noise
-        while (psx->cpu->pc != 0x80030000)
-            psx_update(psx);
 
+    // Disc boots skip the kernel init this way, the shell still runs
+    if (cfg->exe || cfg->boot_cache)
+        psx_boot_to_shell(psx, cfg->boot_cache);
+
+    if (cfg->exe)
         psx_load_exe(psx, cfg->exe);
+
+    psx_rewind_t *rewind = NULL;
+
+    if (cfg->rewind_budget > 0)
+    {
+        rewind = psx_rewind_create();
+
+        psx_rewind_init(rewind, (size_t)cfg->rewind_budget << 20, PSX_REWIND_INTERVAL);
+        psxe_screen_set_rewind(screen, rewind);
     }
 
+    psxe_state_io_t *state_io = psxe_state_io_create();
+
+    psxe_state_io_init(state_io);
+    psxe_screen_set_state_io(screen, state_io, cfg->state_path);
+
     psxe_cfg_destroy(cfg);
 
     while (psxe_screen_is_open(screen))
+    {
         psx_update(psx);
 
+        // States can only be captured or restored between updates
+        if (screen->frame_done)
+            psxe_screen_end_frame(screen);
+    }
+
     if (stream)
         SDL_DestroyAudioStream(stream);
 
@@ -134,6 +231,12 @@ int main(int argc, char *argv[])
     log_fatal("gp=%08x sp=%08x fp=%08x ra=%08x", cpu->r[28], cpu->r[29], cpu->r[30], cpu->r[31]);
     log_fatal("pc=%08x hi=%08x lo=%08x ep=%08x", cpu->pc, cpu->hi, cpu->lo, cpu->cop0_r[COP0_EPC]);
 
+    // Lets a save in flight reach the disk
+    psxe_state_io_destroy(state_io);
+
+    if (rewind)
+        psx_rewind_destroy(rewind);
+
     psx_pad_detach_joy(psx->pad, 0);
     psx_destroy(psx);
     psxe_screen_destroy(screen);
@@ -0,0 +1,115 @@
+// Needed for MAP_ANONYMOUS and madvise
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/arena.h"
+#include "psx/log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+
+static uint8_t *arena_map(size_t size, int huge)
+{
+#ifdef _WIN32
+    if (huge)
+    {
+        // Needs SeLockMemoryPrivilege, which most accounts don't have
+        void *buf = VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE | MEM_LARGE_PAGES, PAGE_READWRITE);
+
+        if (buf)
+            return (uint8_t *)buf;
+
+        log_warn("Couldn't map arena with large pages, using regular pages");
+    }
+
+    return (uint8_t *)VirtualAlloc(NULL, size, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    void *buf;
+
+#ifdef MAP_HUGETLB
+    if (huge)
+    {
+        // Only succeeds if huge pages have been reserved
+        buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS | MAP_HUGETLB, -1, 0);
+
+        if (buf != MAP_FAILED)
+            return (uint8_t *)buf;
+    }
+#endif
+
+    buf = mmap(NULL, size, PROT_READ | PROT_WRITE, MAP_PRIVATE | MAP_ANONYMOUS, -1, 0);
+
+    if (buf == MAP_FAILED)
+        return NULL;
+
+#ifdef MADV_HUGEPAGE
+    // Fall back on transparent huge pages
+    if (huge)
+        madvise(buf, size, MADV_HUGEPAGE);
+#endif
+
+    return (uint8_t *)buf;
+#endif
+}
+
+int psx_arena_init(psx_arena_t *arena, size_t size, int flags)
+{
+    memset(arena, 0, sizeof(psx_arena_t));
+
+    arena->huge = (flags & PSX_ARENA_HUGE) != 0;
+
+    if (arena->huge)
+        size = (size + PSX_ARENA_HUGE_PAGE - 1) & ~(size_t)(PSX_ARENA_HUGE_PAGE - 1);
+
+    arena->base = arena_map(size, arena->huge);
+
+    if (!arena->base)
+    {
+        log_error("Couldn't map %zu byte arena", size);
+
+        return 1;
+    }
+
+    arena->size = size;
+
+    return 0;
+}
+
+void *psx_arena_alloc(psx_arena_t *arena, size_t size)
+{
+    size = psx_arena_footprint(size);
+
+    if (size > (arena->size - arena->used))
+    {
+        log_fatal("Arena exhausted (%zu of %zu bytes used, %zu requested)", arena->used, arena->size, size);
+
+        exit(1);
+    }
+
+    void *ptr = arena->base + arena->used;
+
+    arena->used += size;
+
+    return ptr;
+}
+
+void psx_arena_destroy(psx_arena_t *arena)
+{
+    if (!arena->base)
+        return;
+
+#ifdef _WIN32
+    VirtualFree(arena->base, 0, MEM_RELEASE);
+#else
+    munmap(arena->base, arena->size);
+#endif
+
+    arena->base = NULL;
+}
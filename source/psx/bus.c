@@ -1,5 +1,6 @@
 #include <stdint.h>
 #include <stdlib.h>
+#include <string.h>
 
 #include "psx/bus.h"
 #include "psx/bus_init.h"
@@ -16,26 +17,140 @@ psx_bus_t *psx_bus_create(void)
     return (psx_bus_t *)malloc(sizeof(psx_bus_t));
 }
 
-// Does nothing for now
-void psx_bus_init(psx_bus_t *bus) {}
+void psx_bus_init(psx_bus_t *bus)
+{
+    memset(bus, 0, sizeof(psx_bus_t));
+}
 
 void psx_bus_destroy(psx_bus_t *bus)
 {
     free(bus);
 }
 
-#define HANDLE_READ(dev, bits)                                                   \
-    if (RANGE(addr, bus->dev->io_base, (bus->dev->io_base + bus->dev->io_size))) \
-    {                                                                            \
-        bus->access_cycles = bus->dev->bus_delay;                                \
-        return psx_##dev##_read##bits(bus->dev, addr - bus->dev->io_base);       \
+// Point every mirror of a physical RAM page at the buffer, or
+// clear the pointers so writes go through psx_bus_code_write
+static void psx_bus_map_ram_page(psx_bus_t *bus, uint32_t offset, int writable)
+{
+    for (uint32_t addr = offset; addr < bus->ram->io_size; addr += bus->ram->size)
+    {
+        uint32_t page = (bus->ram->io_base + addr) >> PSX_BUS_PAGE_SHIFT;
+
+        if (bus->page_dev[page] != PSX_BUS_RAM)
+            continue;
+
+        bus->write_page[page] = writable ? (bus->ram->buf + offset) : NULL;
+    }
+}
+
+static inline void psx_bus_code_write(psx_bus_t *bus, uint32_t addr)
+{
+    uint32_t offset = (addr - bus->ram->io_base) & (bus->ram->size - 1);
+
+    offset &= ~PSX_BUS_PAGE_MASK;
+
+    if (!bus->code_page[offset >> PSX_BUS_PAGE_SHIFT])
+        return;
+
+    bus->code_page[offset >> PSX_BUS_PAGE_SHIFT] = 0;
+
+    psx_bus_map_ram_page(bus, offset, 1);
+
+    if (bus->code_write_cb)
+        bus->code_write_cb(bus->code_write_udata, offset);
+}
+
+#define HANDLE_READ(id, dev, bits)                                         \
+    case id:                                                               \
+    {                                                                      \
+        bus->access_cycles = bus->dev->bus_delay;                          \
+        return psx_##dev##_read##bits(bus->dev, addr - bus->dev->io_base); \
     }
-#define HANDLE_WRITE(dev, bits)                                                  \
+#define HANDLE_WRITE(id, dev, bits)                                         \
+    case id:                                                                \
+    {                                                                       \
+        bus->access_cycles = bus->dev->bus_delay;                           \
+        psx_##dev##_write##bits(bus->dev, addr - bus->dev->io_base, value); \
+        return;                                                             \
+    }
+#define HANDLE_DEVICES(handler, bits)             \
+    handler(PSX_BUS_BIOS, bios, bits)             \
+    handler(PSX_BUS_RAM, ram, bits)               \
+    handler(PSX_BUS_DMA, dma, bits)               \
+    handler(PSX_BUS_EXP1, exp1, bits)             \
+    handler(PSX_BUS_EXP2, exp2, bits)             \
+    handler(PSX_BUS_MC1, mc1, bits)               \
+    handler(PSX_BUS_MC2, mc2, bits)               \
+    handler(PSX_BUS_MC3, mc3, bits)               \
+    handler(PSX_BUS_IC, ic, bits)                 \
+    handler(PSX_BUS_SCRATCHPAD, scratchpad, bits) \
+    handler(PSX_BUS_GPU, gpu, bits)               \
+    handler(PSX_BUS_SPU, spu, bits)               \
+    handler(PSX_BUS_TIMER, timer, bits)           \
+    handler(PSX_BUS_CDROM, cdrom, bits)           \
+    handler(PSX_BUS_PAD, pad, bits)               \
+    handler(PSX_BUS_MDEC, mdec, bits)
+
+#define HANDLE_RANGE(id, dev, bits)                                                 \
     if (RANGE(addr, bus->dev->io_base, (bus->dev->io_base + bus->dev->io_size))) \
-    {                                                                            \
-        bus->access_cycles = bus->dev->bus_delay;                                \
-        psx_##dev##_write##bits(bus->dev, addr - bus->dev->io_base, value);      \
-        return;                                                                  \
+        return id;
+
+// Range scan in dispatch order, for pages only partly covered by a device
+static int psx_bus_find_device(psx_bus_t *bus, uint32_t addr)
+{
+    HANDLE_DEVICES(HANDLE_RANGE, 0);
+
+    return PSX_BUS_NONE;
+}
+
+static inline int psx_bus_get_device(psx_bus_t *bus, uint32_t addr)
+{
+    if (addr >= PSX_BUS_PHYS_SIZE)
+    {
+        if (RANGE(addr, bus->mc3->io_base, (bus->mc3->io_base + bus->mc3->io_size)))
+            return PSX_BUS_MC3;
+
+        return PSX_BUS_NONE;
+    }
+
+    int dev = bus->page_dev[addr >> PSX_BUS_PAGE_SHIFT];
+
+    if (dev == PSX_BUS_IO)
+        dev = bus->io_dev[(addr - PSX_BUS_IO_BEGIN) >> 2];
+
+    if (dev == PSX_BUS_PARTIAL)
+        dev = psx_bus_find_device(bus, addr);
+
+    return dev;
+}
+
+// Fast path for pages backed by host memory
+#define HANDLE_READ_PAGE(type)                                    \
+    if (addr < PSX_BUS_PHYS_SIZE)                                 \
+    {                                                             \
+        uint32_t page = addr >> PSX_BUS_PAGE_SHIFT;               \
+        uint8_t *ptr = bus->read_page[page];                      \
+                                                                  \
+        if (ptr)                                                  \
+        {                                                         \
+            bus->access_cycles = bus->page_delay[page];           \
+            return *((type *)(ptr + (addr & PSX_BUS_PAGE_MASK))); \
+        }                                                         \
+    }
+// Only RAM pages are writable through the table, and a bus page is
+// a RAM dirty page
+#define HANDLE_WRITE_PAGE(type)                                                                    \
+    if (addr < PSX_BUS_PHYS_SIZE)                                                                  \
+    {                                                                                              \
+        uint32_t page = addr >> PSX_BUS_PAGE_SHIFT;                                                \
+        uint8_t *ptr = bus->write_page[page];                                                      \
+                                                                                                   \
+        if (ptr)                                                                                   \
+        {                                                                                          \
+            bus->access_cycles = bus->page_delay[page];                                            \
+            psx_dirty_set(bus->ram->dirty, (uint32_t)(ptr - bus->ram->buf) >> PSX_RAM_PAGE_SHIFT); \
+            *((type *)(ptr + (addr & PSX_BUS_PAGE_MASK))) = value;                                 \
+            return;                                                                                \
+        }                                                                                          \
     }
 
 uint32_t psx_bus_read32(psx_bus_t *bus, uint32_t addr)
@@ -49,22 +164,12 @@ uint32_t psx_bus_read32(psx_bus_t *bus, uint32_t addr)
         log_fatal("Unaligned 32-bit read from %08x:%08x", vaddr, addr);
     }
 
-    HANDLE_READ(bios, 32);
-    HANDLE_READ(ram, 32);
-    HANDLE_READ(dma, 32);
-    HANDLE_READ(exp1, 32);
-    HANDLE_READ(exp2, 32);
-    HANDLE_READ(mc1, 32);
-    HANDLE_READ(mc2, 32);
-    HANDLE_READ(mc3, 32);
-    HANDLE_READ(ic, 32);
-    HANDLE_READ(scratchpad, 32);
-    HANDLE_READ(gpu, 32);
-    HANDLE_READ(spu, 32);
-    HANDLE_READ(timer, 32);
-    HANDLE_READ(cdrom, 32);
-    HANDLE_READ(pad, 32);
-    HANDLE_READ(mdec, 32);
+    HANDLE_READ_PAGE(uint32_t);
+
+    switch (psx_bus_get_device(bus, addr))
+    {
+        HANDLE_DEVICES(HANDLE_READ, 32);
+    }
 
     log_fatal("Unhandled 32-bit read from %08x:%08x", vaddr, addr);
 
@@ -73,8 +178,6 @@ uint32_t psx_bus_read32(psx_bus_t *bus, uint32_t addr)
     return 0x00000000;
 }
 
-static uint16_t sio_ctrl;
-
 uint16_t psx_bus_read16(psx_bus_t *bus, uint32_t addr)
 {
     bus->access_cycles = 2;
@@ -88,25 +191,15 @@ uint16_t psx_bus_read16(psx_bus_t *bus, uint32_t addr)
         log_fatal("Unaligned 16-bit read from %08x:%08x", vaddr, addr);
     }
 
-    HANDLE_READ(bios, 16);
-    HANDLE_READ(ram, 16);
-    HANDLE_READ(dma, 16);
-    HANDLE_READ(exp1, 16);
-    HANDLE_READ(exp2, 16);
-    HANDLE_READ(mc1, 16);
-    HANDLE_READ(mc2, 16);
-    HANDLE_READ(mc3, 16);
-    HANDLE_READ(ic, 16);
-    HANDLE_READ(scratchpad, 16);
-    HANDLE_READ(gpu, 16);
-    HANDLE_READ(spu, 16);
-    HANDLE_READ(timer, 16);
-    HANDLE_READ(cdrom, 16);
-    HANDLE_READ(pad, 16);
-    HANDLE_READ(mdec, 16);
+    HANDLE_READ_PAGE(uint16_t);
+
+    switch (psx_bus_get_device(bus, addr))
+    {
+        HANDLE_DEVICES(HANDLE_READ, 16);
+    }
 
     if (addr == 0x1f80105a)
-        return sio_ctrl;
+        return bus->sio_ctrl;
 
     if (addr == 0x1f801054)
         return 0x05;
@@ -132,22 +225,12 @@ uint8_t psx_bus_read8(psx_bus_t *bus, uint32_t addr)
 
     addr &= g_psx_bus_region_mask_table[addr >> 29];
 
-    HANDLE_READ(bios, 8);
-    HANDLE_READ(ram, 8);
-    HANDLE_READ(dma, 8);
-    HANDLE_READ(exp1, 8);
-    HANDLE_READ(exp2, 8);
-    HANDLE_READ(mc1, 8);
-    HANDLE_READ(mc2, 8);
-    HANDLE_READ(mc3, 8);
-    HANDLE_READ(ic, 8);
-    HANDLE_READ(scratchpad, 8);
-    HANDLE_READ(gpu, 8);
-    HANDLE_READ(spu, 8);
-    HANDLE_READ(timer, 8);
-    HANDLE_READ(cdrom, 8);
-    HANDLE_READ(pad, 8);
-    HANDLE_READ(mdec, 8);
+    HANDLE_READ_PAGE(uint8_t);
+
+    switch (psx_bus_get_device(bus, addr))
+    {
+        HANDLE_DEVICES(HANDLE_READ, 8);
+    }
 
     // printf("Unhandled 8-bit read from %08x:%08x\n", vaddr, addr);
 
@@ -169,22 +252,17 @@ void psx_bus_write32(psx_bus_t *bus, uint32_t addr, uint32_t value)
         log_fatal("Unaligned 32-bit write to %08x:%08x (%08x)", vaddr, addr, value);
     }
 
-    HANDLE_WRITE(bios, 32);
-    HANDLE_WRITE(ram, 32);
-    HANDLE_WRITE(dma, 32);
-    HANDLE_WRITE(exp1, 32);
-    HANDLE_WRITE(exp2, 32);
-    HANDLE_WRITE(mc1, 32);
-    HANDLE_WRITE(mc2, 32);
-    HANDLE_WRITE(mc3, 32);
-    HANDLE_WRITE(ic, 32);
-    HANDLE_WRITE(scratchpad, 32);
-    HANDLE_WRITE(gpu, 32);
-    HANDLE_WRITE(spu, 32);
-    HANDLE_WRITE(timer, 32);
-    HANDLE_WRITE(cdrom, 32);
-    HANDLE_WRITE(pad, 32);
-    HANDLE_WRITE(mdec, 32);
+    HANDLE_WRITE_PAGE(uint32_t);
+
+    int dev = psx_bus_get_device(bus, addr);
+
+    if (dev == PSX_BUS_RAM)
+        psx_bus_code_write(bus, addr);
+
+    switch (dev)
+    {
+        HANDLE_DEVICES(HANDLE_WRITE, 32);
+    }
 
     printf("Unhandled 32-bit write to %08x:%08x (%08x)\n", vaddr, addr, value);
 
@@ -204,24 +282,19 @@ void psx_bus_write16(psx_bus_t *bus, uint32_t addr, uint32_t value)
         log_fatal("Unaligned 16-bit write to %08x:%08x (%04x)", vaddr, addr, value);
     }
 
-    HANDLE_WRITE(bios, 16);
-    HANDLE_WRITE(ram, 16);
-    HANDLE_WRITE(dma, 16);
-    HANDLE_WRITE(exp1, 16);
-    HANDLE_WRITE(exp2, 16);
-    HANDLE_WRITE(mc1, 16);
-    HANDLE_WRITE(mc2, 16);
-    HANDLE_WRITE(mc3, 16);
-    HANDLE_WRITE(ic, 16);
-    HANDLE_WRITE(scratchpad, 16);
-    HANDLE_WRITE(gpu, 16);
-    HANDLE_WRITE(spu, 16);
-    HANDLE_WRITE(timer, 16);
-    HANDLE_WRITE(cdrom, 16);
-    HANDLE_WRITE(pad, 16);
-    HANDLE_WRITE(mdec, 16);
-
-    // if (addr == 0x1f80105a) { sio_ctrl = value; return; }
+    HANDLE_WRITE_PAGE(uint16_t);
+
+    int dev = psx_bus_get_device(bus, addr);
+
+    if (dev == PSX_BUS_RAM)
+        psx_bus_code_write(bus, addr);
+
+    switch (dev)
+    {
+        HANDLE_DEVICES(HANDLE_WRITE, 16);
+    }
+
+    // if (addr == 0x1f80105a) { bus->sio_ctrl = value; return; }
 
     printf("Unhandled 16-bit write to %08x:%08x (%04x)\n", vaddr, addr, value);
 
@@ -236,28 +309,132 @@ void psx_bus_write8(psx_bus_t *bus, uint32_t addr, uint32_t value)
 
     addr &= g_psx_bus_region_mask_table[addr >> 29];
 
-    HANDLE_WRITE(bios, 8);
-    HANDLE_WRITE(ram, 8);
-    HANDLE_WRITE(dma, 8);
-    HANDLE_WRITE(exp1, 8);
-    HANDLE_WRITE(exp2, 8);
-    HANDLE_WRITE(mc1, 8);
-    HANDLE_WRITE(mc2, 8);
-    HANDLE_WRITE(mc3, 8);
-    HANDLE_WRITE(ic, 8);
-    HANDLE_WRITE(scratchpad, 8);
-    HANDLE_WRITE(gpu, 8);
-    HANDLE_WRITE(spu, 8);
-    HANDLE_WRITE(timer, 8);
-    HANDLE_WRITE(cdrom, 8);
-    HANDLE_WRITE(pad, 8);
-    HANDLE_WRITE(mdec, 8);
+    HANDLE_WRITE_PAGE(uint8_t);
+
+    int dev = psx_bus_get_device(bus, addr);
+
+    if (dev == PSX_BUS_RAM)
+        psx_bus_code_write(bus, addr);
+
+    switch (dev)
+    {
+        HANDLE_DEVICES(HANDLE_WRITE, 8);
+    }
 
     printf("Unhandled 8-bit write to %08x:%08x (%02x)\n", vaddr, addr, value);
 
     // exit(1);
 }
 
+static void psx_bus_map_device(psx_bus_t *bus, int id, uint32_t base, uint32_t size, uint32_t delay)
+{
+    for (uint32_t addr = base; addr < (base + size); addr += 4)
+    {
+        if (addr >= PSX_BUS_PHYS_SIZE)
+            return;
+
+        uint32_t page = addr >> PSX_BUS_PAGE_SHIFT;
+
+        if (RANGE(addr, PSX_BUS_IO_BEGIN, PSX_BUS_IO_BEGIN + PSX_BUS_IO_SIZE))
+        {
+            bus->page_dev[page] = PSX_BUS_IO;
+            bus->io_dev[(addr - PSX_BUS_IO_BEGIN) >> 2] = id;
+
+            continue;
+        }
+
+        uint32_t page_base = addr & ~PSX_BUS_PAGE_MASK;
+
+        // Only pages the device covers entirely go through the table,
+        // the rest of a partly covered page stays unhandled
+        if ((page_base >= base) && ((page_base + PSX_BUS_PAGE_SIZE) <= (base + size)))
+        {
+            bus->page_dev[page] = id;
+            bus->page_delay[page] = delay;
+        }
+        else
+        {
+            bus->page_dev[page] = PSX_BUS_PARTIAL;
+        }
+
+        addr = (addr | PSX_BUS_PAGE_MASK) - 3;
+    }
+}
+
+#define MAP_DEVICE(id, dev)                                                                \
+    psx_bus_map_device(bus, id, bus->dev->io_base, bus->dev->io_size, bus->dev->bus_delay)
+
+// Has to be called after all devices have been initialized, and again
+// whenever a device is reinitialized or a memory buffer is reallocated
+void psx_bus_init_page_table(psx_bus_t *bus)
+{
+    memset(bus->read_page, 0, sizeof(bus->read_page));
+    memset(bus->write_page, 0, sizeof(bus->write_page));
+    memset(bus->page_dev, PSX_BUS_NONE, sizeof(bus->page_dev));
+    memset(bus->page_delay, 0, sizeof(bus->page_delay));
+    memset(bus->io_dev, PSX_BUS_NONE, sizeof(bus->io_dev));
+
+    bus->page_table_gen++;
+
+    // Map in reverse order so the first device in the original
+    // dispatch order wins if two ranges ever overlap
+    MAP_DEVICE(PSX_BUS_MDEC, mdec);
+    MAP_DEVICE(PSX_BUS_PAD, pad);
+    MAP_DEVICE(PSX_BUS_CDROM, cdrom);
+    MAP_DEVICE(PSX_BUS_TIMER, timer);
+    MAP_DEVICE(PSX_BUS_SPU, spu);
+    MAP_DEVICE(PSX_BUS_GPU, gpu);
+    MAP_DEVICE(PSX_BUS_SCRATCHPAD, scratchpad);
+    MAP_DEVICE(PSX_BUS_IC, ic);
+    MAP_DEVICE(PSX_BUS_MC3, mc3);
+    MAP_DEVICE(PSX_BUS_MC2, mc2);
+    MAP_DEVICE(PSX_BUS_MC1, mc1);
+    MAP_DEVICE(PSX_BUS_EXP2, exp2);
+    MAP_DEVICE(PSX_BUS_EXP1, exp1);
+    MAP_DEVICE(PSX_BUS_DMA, dma);
+    MAP_DEVICE(PSX_BUS_RAM, ram);
+    MAP_DEVICE(PSX_BUS_BIOS, bios);
+
+    // RAM is mirrored across the whole 8 MB window. Reads above 4 MB
+    // depend on the RAM_SIZE register, so those stay on the slow path
+    if (bus->ram->buf)
+    {
+        for (uint32_t addr = 0; addr < bus->ram->io_size; addr += PSX_BUS_PAGE_SIZE)
+        {
+            uint32_t page = (bus->ram->io_base + addr) >> PSX_BUS_PAGE_SHIFT;
+            uint8_t *ptr = bus->ram->buf + (addr & (bus->ram->size - 1));
+
+            if (bus->page_dev[page] != PSX_BUS_RAM)
+                continue;
+
+            if (addr < 0x400000)
+                bus->read_page[page] = ptr;
+
+            if (!bus->code_page[(addr & (bus->ram->size - 1)) >> PSX_BUS_PAGE_SHIFT])
+                bus->write_page[page] = ptr;
+        }
+    }
+
+    // BIOS writes are not handled, they always go through the device
+    if (bus->bios->buf)
+    {
+        for (uint32_t addr = 0; addr < bus->bios->io_size; addr += PSX_BUS_PAGE_SIZE)
+        {
+            if ((bus->bios->io_base + addr) >= PSX_BUS_PHYS_SIZE)
+                break;
+
+            uint32_t page = (bus->bios->io_base + addr) >> PSX_BUS_PAGE_SHIFT;
+
+            if (bus->page_dev[page] != PSX_BUS_BIOS)
+                continue;
+
+            bus->read_page[page] = bus->bios->buf + addr;
+        }
+    }
+}
+
+#undef MAP_DEVICE
+
 void psx_bus_init_bios(psx_bus_t *bus, psx_bios_t *bios)
 {
     bus->bios = bios;
@@ -338,6 +515,43 @@ void psx_bus_init_mdec(psx_bus_t *bus, psx_mdec_t *mdec)
     bus->mdec = mdec;
 }
 
+void psx_bus_set_code_write_cb(psx_bus_t *bus, psx_bus_code_write_cb_t cb, void *udata)
+{
+    bus->code_write_cb = cb;
+    bus->code_write_udata = udata;
+}
+
+// Make the RAM page containing addr report its next write
+void psx_bus_protect_code(psx_bus_t *bus, uint32_t addr)
+{
+    addr &= g_psx_bus_region_mask_table[addr >> 29];
+
+    if (psx_bus_get_device(bus, addr) != PSX_BUS_RAM)
+        return;
+
+    uint32_t offset = (addr - bus->ram->io_base) & (bus->ram->size - 1);
+
+    offset &= ~PSX_BUS_PAGE_MASK;
+
+    bus->code_page[offset >> PSX_BUS_PAGE_SHIFT] = 1;
+
+    psx_bus_map_ram_page(bus, offset, 0);
+}
+
+// Host pointer to the page holding addr and its access cycles, or
+// NULL if reads from that page have to go through the device
+const uint8_t *psx_bus_get_read_page(psx_bus_t *bus, uint32_t addr, uint32_t *cycles)
+{
+    addr &= g_psx_bus_region_mask_table[addr >> 29];
+
+    if (addr >= PSX_BUS_PHYS_SIZE)
+        return NULL;
+
+    *cycles = bus->page_delay[addr >> PSX_BUS_PAGE_SHIFT];
+
+    return bus->read_page[addr >> PSX_BUS_PAGE_SHIFT];
+}
+
 uint32_t psx_bus_get_access_cycles(psx_bus_t *bus)
 {
     uint32_t cycles = bus->access_cycles;
@@ -347,5 +561,31 @@ uint32_t psx_bus_get_access_cycles(psx_bus_t *bus)
     return cycles;
 }
 
+void psx_bus_save_state(psx_bus_t *bus, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_BUS);
+    psx_state_write(state, &bus->access_cycles, sizeof(bus->access_cycles));
+    psx_state_write(state, &bus->sio_ctrl, sizeof(bus->sio_ctrl));
+    psx_state_end_chunk(state);
+}
+
+int psx_bus_load_state(psx_bus_t *bus, psx_state_t *state)
+{
+    if (psx_state_next_chunk(state, PSX_STATE_BUS) != (int)(sizeof(bus->access_cycles) + sizeof(bus->sio_ctrl)))
+        return 1;
+
+    psx_state_read(state, &bus->access_cycles, sizeof(bus->access_cycles));
+    psx_state_read(state, &bus->sio_ctrl, sizeof(bus->sio_ctrl));
+
+    // The code cache is flushed on load, nothing is protected anymore
+    memset(bus->code_page, 0, sizeof(bus->code_page));
+
+    return 0;
+}
+
 #undef HANDLE_READ
-#undef HANDLE_WRITE
\ No newline at end of file
+#undef HANDLE_WRITE
+#undef HANDLE_DEVICES
+#undef HANDLE_READ_PAGE
+#undef HANDLE_WRITE_PAGE
+#undef HANDLE_RANGE
\ No newline at end of file
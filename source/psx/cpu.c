@@ -1,12 +1,27 @@
 #include "psx/cpu.h"
 #include "psx/bus.h"
+#include "psx/bus_init.h"
+#include "psx/gte_simd.h"
+#include "psx/hle.h"
+#include "psx/jit.h"
 #include "psx/log.h"
 
+#include <stddef.h>
 #include <stdlib.h>
 #include <string.h>
 
+#ifdef _WIN32
+#include <malloc.h>
+#endif
+
 #include "psx/cpu_debug.h"
 
+// Labels as values are a GCC/Clang extension, other compilers
+// always use the switch based decoder
+#if defined(PSX_CPU_COMPUTED_GOTO) && defined(__GNUC__)
+#define PSX_CPU_USE_COMPUTED_GOTO
+#endif
+
 static const uint32_t g_psx_cpu_cop0_write_mask_table[] = {
     0x00000000, // cop0r0   - N/A
     0x00000000, // cop0r1   - N/A
@@ -26,6 +41,12 @@ static const uint32_t g_psx_cpu_cop0_write_mask_table[] = {
     0x00000000  // PRID     - Processor ID (R)
 };
 
+static const char *g_psx_cpu_fused_names[] = {
+    "lui+ori",
+    "lui+addiu",
+    "lui+lw",
+    "slt+branch"};
+
 static const uint8_t g_psx_gte_unr_table[] = {
     0xff, 0xfd, 0xfb, 0xf9, 0xf7, 0xf5, 0xf3, 0xf1,
     0xef, 0xee, 0xec, 0xea, 0xe8, 0xe6, 0xe4, 0xe3,
@@ -84,6 +105,9 @@ static inline void psx_gte_i_gpf(psx_cpu_t *);
 static inline void psx_gte_i_gpl(psx_cpu_t *);
 static inline void psx_gte_i_ncct(psx_cpu_t *);
 
+static inline psx_cpu_insn_t *psx_cpu_fetch_cached(psx_cpu_t *);
+static void psx_cpu_code_write_cb(void *, uint32_t);
+
 #define OP ((cpu->opcode >> 26) & 0x3f)
 #define S ((cpu->opcode >> 21) & 0x1f)
 #define T ((cpu->opcode >> 16) & 0x1f)
@@ -95,9 +119,6 @@ static inline void psx_gte_i_ncct(psx_cpu_t *);
 #define IMM16 (cpu->opcode & 0xffff)
 #define IMM16S ((int32_t)((int16_t)IMM16))
 
-#define COP2_DR(idx) ((uint32_t *)(&cpu->cop2_dr))[idx]
-#define COP2_CR(idx) ((uint32_t *)(&cpu->cop2_cr))[idx]
-
 #define R_R0 (cpu->r[0])
 #define R_A0 (cpu->r[4])
 #define R_RA (cpu->r[31])
@@ -175,17 +196,83 @@ void cpu_b_kcall_hook(psx_cpu_t *cpu)
     }
 }
 
+#ifdef CPU_TRACE
+static void psx_cpu_trace_kcall(psx_cpu_t *cpu)
+{
+    const char **table = NULL;
+    uint32_t size = 0;
+
+    switch (cpu->pc & 0x3fffffff)
+    {
+    case PSX_HLE_A0:
+        table = g_psx_cpu_a_kcall_symtable;
+        size = sizeof(g_psx_cpu_a_kcall_symtable) / sizeof(const char *);
+        break;
+    case PSX_HLE_B0:
+        table = g_psx_cpu_b_kcall_symtable;
+        size = sizeof(g_psx_cpu_b_kcall_symtable) / sizeof(const char *);
+        break;
+    case PSX_HLE_C0:
+        table = g_psx_cpu_c_kcall_symtable;
+        size = sizeof(g_psx_cpu_c_kcall_symtable) / sizeof(const char *);
+        break;
+    }
+
+    if (cpu->r[9] < size)
+        log_trace(table[cpu->r[9]], cpu->r[4], cpu->r[5], cpu->r[6], cpu->r[7]);
+}
+#endif
+
 psx_cpu_t *psx_cpu_create(void)
 {
-    return (psx_cpu_t *)malloc(sizeof(psx_cpu_t));
+    // sizeof is always a multiple of the alignment
+#ifdef _WIN32
+    psx_cpu_t *cpu = (psx_cpu_t *)_aligned_malloc(sizeof(psx_cpu_t), _Alignof(psx_cpu_t));
+#else
+    psx_cpu_t *cpu = (psx_cpu_t *)aligned_alloc(_Alignof(psx_cpu_t), sizeof(psx_cpu_t));
+#endif
+
+    return psx_cpu_create_at(cpu);
+}
+
+psx_cpu_t *psx_cpu_create_at(void *buf)
+{
+    psx_cpu_t *cpu = (psx_cpu_t *)buf;
+
+    // The block cache has to start out empty, psx_cpu_init flushes it
+    memset(cpu, 0, sizeof(psx_cpu_t));
+
+    cpu->gte_mul = psx_gte_simd_select();
+
+    return cpu;
 }
 
 void cpu_a_kcall_hook(psx_cpu_t *);
 void cpu_b_kcall_hook(psx_cpu_t *);
 
+void psx_cpu_release(psx_cpu_t *cpu)
+{
+    for (int i = 0; i < PSX_CPU_FUSED_COUNT; i++)
+        if (cpu->fused[i])
+            log_info("Fused %s ran %llu times", g_psx_cpu_fused_names[i], (unsigned long long)cpu->fused[i]);
+
+    psx_cpu_flush_cache(cpu);
+
+    if (cpu->jit)
+        psx_jit_destroy(cpu->jit);
+
+    cpu->jit = NULL;
+}
+
 void psx_cpu_destroy(psx_cpu_t *cpu)
 {
+    psx_cpu_release(cpu);
+
+#ifdef _WIN32
+    _aligned_free(cpu);
+#else
     free(cpu);
+#endif
 }
 
 void psx_cpu_set_a_kcall_hook(psx_cpu_t *cpu, psx_cpu_kcall_hook_t hook)
@@ -198,29 +285,49 @@ void psx_cpu_set_b_kcall_hook(psx_cpu_t *cpu, psx_cpu_kcall_hook_t hook)
     cpu->b_function_hook = hook;
 }
 
-void psx_cpu_save_state(psx_cpu_t *cpu, FILE *file)
+void psx_cpu_save_state(psx_cpu_t *cpu, psx_state_t *state)
 {
-    fwrite((char *)cpu, sizeof(*cpu) - sizeof(psx_bus_t *), 1, file);
+    psx_state_begin_chunk(state, PSX_STATE_CPU);
+    psx_state_write(state, cpu, offsetof(psx_cpu_t, bus));
+    psx_state_end_chunk(state);
 }
 
-void psx_cpu_load_state(psx_cpu_t *cpu, FILE *file)
+int psx_cpu_load_state(psx_cpu_t *cpu, psx_state_t *state)
 {
-    if (!fread((char *)cpu, sizeof(*cpu) - sizeof(psx_bus_t *), 1, file))
-    {
-        perror("Error reading CPU state");
+    if (psx_state_read_chunk(state, PSX_STATE_CPU, cpu, offsetof(psx_cpu_t, bus)))
+        return 1;
 
-        exit(1);
-    }
+    // Translated code belongs to the memory we're replacing
+    psx_cpu_flush_cache(cpu);
+
+    cpu->fetch_page = 0xffffffff;
+
+    return 0;
 }
 
 void psx_cpu_init(psx_cpu_t *cpu, psx_bus_t *bus)
 {
+    int mode = cpu->mode;
+    struct psx_jit_t *jit = cpu->jit;
+    psx_gte_mul_t gte_mul = cpu->gte_mul;
+    int hle = cpu->hle;
+
+    psx_cpu_flush_cache(cpu);
+
     memset(cpu, 0, sizeof(psx_cpu_t));
 
+    cpu->mode = mode;
+    cpu->jit = jit;
+    cpu->gte_mul = gte_mul;
+    cpu->hle = hle;
+
+    psx_bus_set_code_write_cb(bus, psx_cpu_code_write_cb, cpu);
+
     psx_cpu_set_a_kcall_hook(cpu, cpu_a_kcall_hook);
     psx_cpu_set_b_kcall_hook(cpu, cpu_b_kcall_hook);
 
     cpu->bus = bus;
+    cpu->fetch_page = 0xffffffff;
     cpu->pc = 0xbfc00000;
     cpu->next_pc = cpu->pc + 4;
 
@@ -228,7 +335,7 @@ void psx_cpu_init(psx_cpu_t *cpu, psx_bus_t *bus)
     cpu->cop0_r[COP0_PRID] = 0x00000002;
 }
 
-static inline int psx_cpu_check_irq(psx_cpu_t *cpu)
+int psx_cpu_check_irq(psx_cpu_t *cpu)
 {
     return (cpu->cop0_r[COP0_SR] & SR_IEC) &&
            (cpu->cop0_r[COP0_SR] & cpu->cop0_r[COP0_CAUSE] & 0x00000700);
@@ -260,9 +367,59 @@ static inline void psx_cpu_exception(psx_cpu_t *cpu, uint32_t cause)
     cpu->next_pc = cpu->pc + 4;
 }
 
+// RAM and BIOS fetches read the page directly, RAM pages always
+// hold the current code so self-modifying code is still seen
+static inline uint32_t psx_cpu_fetch_opcode(psx_cpu_t *cpu)
+{
+    if (((cpu->pc >> PSX_BUS_PAGE_SHIFT) != cpu->fetch_page) || (cpu->fetch_gen != cpu->bus->page_table_gen))
+    {
+        cpu->fetch_page = cpu->pc >> PSX_BUS_PAGE_SHIFT;
+        cpu->fetch_gen = cpu->bus->page_table_gen;
+        cpu->fetch_ptr = psx_bus_get_read_page(cpu->bus, cpu->pc, &cpu->fetch_cycles);
+    }
+
+    if (cpu->fetch_ptr)
+    {
+        // Same as reading the access cycles through the bus
+        cpu->bus->access_cycles = 0;
+        cpu->last_cycles = cpu->fetch_cycles;
+
+        return *((const uint32_t *)(cpu->fetch_ptr + (cpu->pc & PSX_BUS_PAGE_MASK)));
+    }
+
+    uint32_t opcode = psx_bus_read32(cpu->bus, cpu->pc);
+
+    cpu->last_cycles = psx_bus_get_access_cycles(cpu->bus);
+
+    return opcode;
+}
+
 void psx_cpu_cycle(psx_cpu_t *cpu)
 {
+    // Falls back to the interpreter for this step if no block can run
+    if (cpu->mode == PSX_CPU_JIT)
+        if (psx_jit_run(cpu->jit))
+            return;
+
     cpu->last_cycles = 0;
+    cpu->last_instructions = 1;
+
+    // Serviced kernel calls return straight to the caller
+    if (cpu->hle && !cpu->branch && psx_hle_is_vector(cpu->pc))
+    {
+#ifdef CPU_TRACE
+        psx_cpu_trace_kcall(cpu);
+#endif
+
+        cpu->last_cycles = psx_hle_call(cpu);
+
+        if (cpu->last_cycles)
+        {
+            cpu->total_cycles += cpu->last_cycles;
+
+            return;
+        }
+    }
 
     if ((cpu->pc & 0x3fffffff) == 0x000000b4)
         if (cpu->b_function_hook)
@@ -276,8 +433,20 @@ void psx_cpu_cycle(psx_cpu_t *cpu)
     if (cpu->saved_pc & 3)
         psx_cpu_exception(cpu, CAUSE_ADEL);
 
-    cpu->opcode = psx_bus_read32(cpu->bus, cpu->pc);
-    cpu->last_cycles = psx_bus_get_access_cycles(cpu->bus);
+    psx_cpu_insn_t *insn = NULL;
+
+    if (cpu->mode == PSX_CPU_CACHED)
+        insn = psx_cpu_fetch_cached(cpu);
+
+    if (insn)
+    {
+        cpu->opcode = insn->opcode;
+        cpu->last_cycles = cpu->block->fetch_cycles;
+    }
+    else
+    {
+        cpu->opcode = psx_cpu_fetch_opcode(cpu);
+    }
 
     cpu->pc = cpu->next_pc;
     cpu->next_pc += 4;
@@ -397,7 +566,7 @@ void psx_cpu_cycle(psx_cpu_t *cpu)
         return;
     }
 
-    int cyc = psx_cpu_execute(cpu);
+    int cyc = insn ? insn->handler(cpu) : psx_cpu_execute(cpu);
 
     if (!cyc)
     {
@@ -2132,50 +2301,111 @@ static inline void psx_gte_i_invalid(psx_cpu_t *cpu)
 #define R_LB2 cpu->cop2_cr.lr.m[3].c[1]
 #define R_LB3 cpu->cop2_cr.lr.m33
 
-#define GTE_RTP_DQ(i)                                                                                                                                                                                     \
-    {                                                                                                                                                                                                     \
-        int64_t vx = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[0]);                                                                                                                                          \
-        int64_t vy = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[1]);                                                                                                                                          \
-        int64_t vz = (int64_t)cpu->cop2_dr.v[i].z;                                                                                                                                                        \
-        R_MAC1 = gte_clamp_mac(cpu, 1, gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (((int64_t)R_TRX) << 12) + (I64((int16_t)R_RT11) * vx)) + (I64((int16_t)R_RT12) * vy)) + (I64((int16_t)R_RT13) * vz)); \
-        R_MAC2 = gte_clamp_mac(cpu, 2, gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (((int64_t)R_TRY) << 12) + (I64((int16_t)R_RT21) * vx)) + (I64((int16_t)R_RT22) * vy)) + (I64((int16_t)R_RT23) * vz)); \
-        R_MAC3 = gte_clamp_mac(cpu, 3, gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (((int64_t)R_TRZ) << 12) + (I64((int16_t)R_RT31) * vx)) + (I64((int16_t)R_RT32) * vy)) + (I64((int16_t)R_RT33) * vz)); \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                                \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                                \
-        R_IR3 = gte_clamp_ir_z(cpu, cpu->s_mac3, cpu->gte_sf, cpu->gte_lm);                                                                                                                               \
-        R_SZ0 = R_SZ1;                                                                                                                                                                                    \
-        R_SZ1 = R_SZ2;                                                                                                                                                                                    \
-        R_SZ2 = R_SZ3;                                                                                                                                                                                    \
-        R_SZ3 = gte_clamp_sz3(cpu, cpu->s_mac3 >> 12);                                                                                                                                                    \
-        int32_t div = gte_divide(cpu, R_H, R_SZ3);                                                                                                                                                        \
-        R_SXY0 = R_SXY1;                                                                                                                                                                                  \
-        R_SXY1 = R_SXY2;                                                                                                                                                                                  \
-        R_SX2 = gte_clamp_sxy(cpu, 1, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFX) + ((int64_t)R_IR1 * div)) >> 16));                                                                                   \
-        R_SY2 = gte_clamp_sxy(cpu, 2, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFY) + ((int64_t)R_IR2 * div)) >> 16));                                                                                   \
-        R_MAC0 = gte_clamp_mac0(cpu, ((int64_t)R_DQB) + (((int64_t)R_DQA) * div));                                                                                                                        \
-        R_IR0 = gte_clamp_ir0(cpu, cpu->s_mac0 >> 12);                                                                                                                                                    \
-    }
-
-#define GTE_RTP(i)                                                                                                                                                                                        \
-    {                                                                                                                                                                                                     \
-        int64_t vx = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[0]);                                                                                                                                          \
-        int64_t vy = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[1]);                                                                                                                                          \
-        int64_t vz = (int64_t)cpu->cop2_dr.v[i].z;                                                                                                                                                        \
-        R_MAC1 = gte_clamp_mac(cpu, 1, gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (((int64_t)R_TRX) << 12) + (I64((int16_t)R_RT11) * vx)) + (I64((int16_t)R_RT12) * vy)) + (I64((int16_t)R_RT13) * vz)); \
-        R_MAC2 = gte_clamp_mac(cpu, 2, gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (((int64_t)R_TRY) << 12) + (I64((int16_t)R_RT21) * vx)) + (I64((int16_t)R_RT22) * vy)) + (I64((int16_t)R_RT23) * vz)); \
-        R_MAC3 = gte_clamp_mac(cpu, 3, gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (((int64_t)R_TRZ) << 12) + (I64((int16_t)R_RT31) * vx)) + (I64((int16_t)R_RT32) * vy)) + (I64((int16_t)R_RT33) * vz)); \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                                \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                                \
-        R_IR3 = gte_clamp_ir_z(cpu, cpu->s_mac3, cpu->gte_sf, cpu->gte_lm);                                                                                                                               \
-        R_SZ0 = R_SZ1;                                                                                                                                                                                    \
-        R_SZ1 = R_SZ2;                                                                                                                                                                                    \
-        R_SZ2 = R_SZ3;                                                                                                                                                                                    \
-        R_SZ3 = gte_clamp_sz3(cpu, cpu->s_mac3 >> 12);                                                                                                                                                    \
-        int32_t div = gte_divide(cpu, R_H, R_SZ3);                                                                                                                                                        \
-        R_SXY0 = R_SXY1;                                                                                                                                                                                  \
-        R_SXY1 = R_SXY2;                                                                                                                                                                                  \
-        R_SX2 = gte_clamp_sxy(cpu, 1, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFX) + ((int64_t)R_IR1 * div)) >> 16));                                                                                   \
-        R_SY2 = gte_clamp_sxy(cpu, 2, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFY) + ((int64_t)R_IR2 * div)) >> 16));                                                                                   \
+static const gte_vec3_t gte_zero = {0};
+
+static inline void gte_load_vertices(psx_cpu_t *cpu, int16_t (*v)[3], int n)
+{
+    for (int k = 0; k < n; k++)
+    {
+        v[k][0] = cpu->cop2_dr.v[k].p[0];
+        v[k][1] = cpu->cop2_dr.v[k].p[1];
+        v[k][2] = cpu->cop2_dr.v[k].z;
+    }
+}
+
+/*
+    (t << 12) + m * v[k] for n vectors. The vectors of RTPT, NCCT
+    and NCDT don't depend on each other, so their products are done
+    in one go, vertex by vertex work happens afterwards.
+
+    The SIMD kernels have to match the scalar loop bit for bit. A
+    lone product, like RTPS and MVMVA do, is faster on the scalar
+    loop, see --gte-bench.
+*/
+static inline void gte_mul_scalar(psx_cpu_t *cpu, int64_t (*mac)[3], const gte_matrix_t *m, const gte_vec3_t *t, int16_t (*v)[3], int n)
+{
+    for (int k = 0; k < n; k++)
+    {
+        int64_t vx = v[k][0];
+        int64_t vy = v[k][1];
+        int64_t vz = v[k][2];
+
+        mac[k][0] = gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (I64(t->x) << 12) + (I64(m->m[0].c[0]) * vx)) + (I64(m->m[0].c[1]) * vy)) + (I64(m->m[1].c[0]) * vz);
+        mac[k][1] = gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (I64(t->y) << 12) + (I64(m->m[1].c[1]) * vx)) + (I64(m->m[2].c[0]) * vy)) + (I64(m->m[2].c[1]) * vz);
+        mac[k][2] = gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (I64(t->z) << 12) + (I64(m->m[3].c[0]) * vx)) + (I64(m->m[3].c[1]) * vy)) + (I64(m->m33) * vz);
+    }
+}
+
+static inline void gte_mul(psx_cpu_t *cpu, int64_t (*mac)[3], const gte_matrix_t *m, const gte_vec3_t *t, int16_t (*v)[3], int n)
+{
+    if (cpu->gte_mul)
+    {
+        R_FLAG |= cpu->gte_mul(mac, m, t, v, n);
+
+        return;
+    }
+
+    gte_mul_scalar(cpu, mac, m, t, v, n);
+}
+
+// Light matrix and light color stages of NCCS and NCDS, leaves the
+// unchecked light color sums in mac
+static inline void gte_light(psx_cpu_t *cpu, int64_t (*mac)[3], int n)
+{
+    int16_t v[3][3];
+    int16_t ir[3][3];
+
+    gte_load_vertices(cpu, v, n);
+    gte_mul(cpu, mac, &cpu->cop2_cr.l, &gte_zero, v, n);
+
+    for (int k = 0; k < n; k++)
+    {
+        ir[k][0] = gte_clamp_ir(cpu, 1, gte_clamp_mac(cpu, 1, mac[k][0]), cpu->gte_lm);
+        ir[k][1] = gte_clamp_ir(cpu, 2, gte_clamp_mac(cpu, 2, mac[k][1]), cpu->gte_lm);
+        ir[k][2] = gte_clamp_ir(cpu, 3, gte_clamp_mac(cpu, 3, mac[k][2]), cpu->gte_lm);
+    }
+
+    gte_mul(cpu, mac, &cpu->cop2_cr.lr, &cpu->cop2_cr.bk, ir, n);
+}
+
+#define GTE_RTP_DQ(mac)                                                                                                 \
+    {                                                                                                                   \
+        R_MAC1 = gte_clamp_mac(cpu, 1, mac[0]);                                                                         \
+        R_MAC2 = gte_clamp_mac(cpu, 2, mac[1]);                                                                         \
+        R_MAC3 = gte_clamp_mac(cpu, 3, mac[2]);                                                                         \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                              \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                              \
+        R_IR3 = gte_clamp_ir_z(cpu, cpu->s_mac3, cpu->gte_sf, cpu->gte_lm);                                             \
+        R_SZ0 = R_SZ1;                                                                                                  \
+        R_SZ1 = R_SZ2;                                                                                                  \
+        R_SZ2 = R_SZ3;                                                                                                  \
+        R_SZ3 = gte_clamp_sz3(cpu, cpu->s_mac3 >> 12);                                                                  \
+        int32_t div = gte_divide(cpu, R_H, R_SZ3);                                                                      \
+        R_SXY0 = R_SXY1;                                                                                                \
+        R_SXY1 = R_SXY2;                                                                                                \
+        R_SX2 = gte_clamp_sxy(cpu, 1, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFX) + ((int64_t)R_IR1 * div)) >> 16)); \
+        R_SY2 = gte_clamp_sxy(cpu, 2, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFY) + ((int64_t)R_IR2 * div)) >> 16)); \
+        R_MAC0 = gte_clamp_mac0(cpu, ((int64_t)R_DQB) + (((int64_t)R_DQA) * div));                                      \
+        R_IR0 = gte_clamp_ir0(cpu, cpu->s_mac0 >> 12);                                                                  \
+    }
+
+#define GTE_RTP(mac)                                                                                                    \
+    {                                                                                                                   \
+        R_MAC1 = gte_clamp_mac(cpu, 1, mac[0]);                                                                         \
+        R_MAC2 = gte_clamp_mac(cpu, 2, mac[1]);                                                                         \
+        R_MAC3 = gte_clamp_mac(cpu, 3, mac[2]);                                                                         \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                              \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                              \
+        R_IR3 = gte_clamp_ir_z(cpu, cpu->s_mac3, cpu->gte_sf, cpu->gte_lm);                                             \
+        R_SZ0 = R_SZ1;                                                                                                  \
+        R_SZ1 = R_SZ2;                                                                                                  \
+        R_SZ2 = R_SZ3;                                                                                                  \
+        R_SZ3 = gte_clamp_sz3(cpu, cpu->s_mac3 >> 12);                                                                  \
+        int32_t div = gte_divide(cpu, R_H, R_SZ3);                                                                      \
+        R_SXY0 = R_SXY1;                                                                                                \
+        R_SXY1 = R_SXY2;                                                                                                \
+        R_SX2 = gte_clamp_sxy(cpu, 1, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFX) + ((int64_t)R_IR1 * div)) >> 16)); \
+        R_SY2 = gte_clamp_sxy(cpu, 2, (gte_clamp_mac0(cpu, (int64_t)((int32_t)R_OFY) + ((int64_t)R_IR2 * div)) >> 16)); \
     }
 
 #define DPCT1                                                                                                         \
@@ -2200,35 +2430,26 @@ static inline void psx_gte_i_invalid(psx_cpu_t *cpu)
         R_BC2 = gte_clamp_rgb(cpu, 3, R_MAC3 >> 4);                                                                   \
     }
 
-#define NCCS(i)                                                                                                                                                                               \
-    {                                                                                                                                                                                         \
-        int64_t vx = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[0]);                                                                                                                              \
-        int64_t vy = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[1]);                                                                                                                              \
-        int64_t vz = (int64_t)cpu->cop2_dr.v[i].z;                                                                                                                                            \
-        R_MAC1 = gte_clamp_mac(cpu, 1, (I64(R_L11) * vx) + (I64(R_L12) * vy) + (I64(R_L13) * vz));                                                                                            \
-        R_MAC2 = gte_clamp_mac(cpu, 2, (I64(R_L21) * vx) + (I64(R_L22) * vy) + (I64(R_L23) * vz));                                                                                            \
-        R_MAC3 = gte_clamp_mac(cpu, 3, (I64(R_L31) * vx) + (I64(R_L32) * vy) + (I64(R_L33) * vz));                                                                                            \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
-        R_MAC1 = gte_clamp_mac(cpu, 1, gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (I64(R_RBK) << 12) + (I64(R_LR1) * I64(R_IR1))) + (I64(R_LR2) * I64(R_IR2))) + (I64(R_LR3) * I64(R_IR3))); \
-        R_MAC2 = gte_clamp_mac(cpu, 2, gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (I64(R_GBK) << 12) + (I64(R_LG1) * I64(R_IR1))) + (I64(R_LG2) * I64(R_IR2))) + (I64(R_LG3) * I64(R_IR3))); \
-        R_MAC3 = gte_clamp_mac(cpu, 3, gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (I64(R_BBK) << 12) + (I64(R_LB1) * I64(R_IR1))) + (I64(R_LB2) * I64(R_IR2))) + (I64(R_LB3) * I64(R_IR3))); \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
-        R_MAC1 = gte_clamp_mac(cpu, 1, (I64(R_RC) * I64(R_IR1)) << 4);                                                                                                                        \
-        R_MAC2 = gte_clamp_mac(cpu, 2, (I64(R_GC) * I64(R_IR2)) << 4);                                                                                                                        \
-        R_MAC3 = gte_clamp_mac(cpu, 3, (I64(R_BC) * I64(R_IR3)) << 4);                                                                                                                        \
-        R_RGB0 = R_RGB1;                                                                                                                                                                      \
-        R_RGB1 = R_RGB2;                                                                                                                                                                      \
-        R_CD2 = R_CODE;                                                                                                                                                                       \
-        R_RC2 = gte_clamp_rgb(cpu, 1, R_MAC1 >> 4);                                                                                                                                           \
-        R_GC2 = gte_clamp_rgb(cpu, 2, R_MAC2 >> 4);                                                                                                                                           \
-        R_BC2 = gte_clamp_rgb(cpu, 3, R_MAC3 >> 4);                                                                                                                                           \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
+#define NCCS(mac)                                                      \
+    {                                                                  \
+        R_MAC1 = gte_clamp_mac(cpu, 1, mac[0]);                        \
+        R_MAC2 = gte_clamp_mac(cpu, 2, mac[1]);                        \
+        R_MAC3 = gte_clamp_mac(cpu, 3, mac[2]);                        \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);             \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);             \
+        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);             \
+        R_MAC1 = gte_clamp_mac(cpu, 1, (I64(R_RC) * I64(R_IR1)) << 4); \
+        R_MAC2 = gte_clamp_mac(cpu, 2, (I64(R_GC) * I64(R_IR2)) << 4); \
+        R_MAC3 = gte_clamp_mac(cpu, 3, (I64(R_BC) * I64(R_IR3)) << 4); \
+        R_RGB0 = R_RGB1;                                               \
+        R_RGB1 = R_RGB2;                                               \
+        R_CD2 = R_CODE;                                                \
+        R_RC2 = gte_clamp_rgb(cpu, 1, R_MAC1 >> 4);                    \
+        R_GC2 = gte_clamp_rgb(cpu, 2, R_MAC2 >> 4);                    \
+        R_BC2 = gte_clamp_rgb(cpu, 3, R_MAC3 >> 4);                    \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);             \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);             \
+        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);             \
     }
 
 #define NCS(i)                                                                                                                                                                                \
@@ -2259,44 +2480,42 @@ static inline void psx_gte_i_invalid(psx_cpu_t *cpu)
         R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
     }
 
-#define NCDS(i)                                                                                                                                                                               \
-    {                                                                                                                                                                                         \
-        int64_t vx = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[0]);                                                                                                                              \
-        int64_t vy = (int64_t)((int16_t)cpu->cop2_dr.v[i].p[1]);                                                                                                                              \
-        int64_t vz = (int64_t)cpu->cop2_dr.v[i].z;                                                                                                                                            \
-        R_MAC1 = gte_clamp_mac(cpu, 1, (I64(R_L11) * vx) + (I64(R_L12) * vy) + (I64(R_L13) * vz));                                                                                            \
-        R_MAC2 = gte_clamp_mac(cpu, 2, (I64(R_L21) * vx) + (I64(R_L22) * vy) + (I64(R_L23) * vz));                                                                                            \
-        R_MAC3 = gte_clamp_mac(cpu, 3, (I64(R_L31) * vx) + (I64(R_L32) * vy) + (I64(R_L33) * vz));                                                                                            \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
-        R_MAC1 = gte_clamp_mac(cpu, 1, gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (I64(R_RBK) << 12) + (I64(R_LR1) * I64(R_IR1))) + (I64(R_LR2) * I64(R_IR2))) + (I64(R_LR3) * I64(R_IR3))); \
-        R_MAC2 = gte_clamp_mac(cpu, 2, gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (I64(R_GBK) << 12) + (I64(R_LG1) * I64(R_IR1))) + (I64(R_LG2) * I64(R_IR2))) + (I64(R_LG3) * I64(R_IR3))); \
-        R_MAC3 = gte_clamp_mac(cpu, 3, gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (I64(R_BBK) << 12) + (I64(R_LB1) * I64(R_IR1))) + (I64(R_LB2) * I64(R_IR2))) + (I64(R_LB3) * I64(R_IR3))); \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
-        int64_t ir1 = gte_clamp_ir(cpu, 1, gte_clamp_mac(cpu, 1, ((I64(R_RFC) << 12) - ((I64(R_RC << 4)) * I64(R_IR1)))), 0);                                                                 \
-        int64_t ir2 = gte_clamp_ir(cpu, 2, gte_clamp_mac(cpu, 2, ((I64(R_GFC) << 12) - ((I64(R_GC << 4)) * I64(R_IR2)))), 0);                                                                 \
-        int64_t ir3 = gte_clamp_ir(cpu, 3, gte_clamp_mac(cpu, 3, ((I64(R_BFC) << 12) - ((I64(R_BC << 4)) * I64(R_IR3)))), 0);                                                                 \
-        R_MAC1 = gte_clamp_mac(cpu, 1, ((I64(R_RC << 4)) * I64(R_IR1)) + (I64(R_IR0) * ir1));                                                                                                 \
-        R_MAC2 = gte_clamp_mac(cpu, 2, ((I64(R_GC << 4)) * I64(R_IR2)) + (I64(R_IR0) * ir2));                                                                                                 \
-        R_MAC3 = gte_clamp_mac(cpu, 3, ((I64(R_BC << 4)) * I64(R_IR3)) + (I64(R_IR0) * ir3));                                                                                                 \
-        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                                                                                    \
-        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                                                                                    \
-        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                                                                                    \
-        R_RGB0 = R_RGB1;                                                                                                                                                                      \
-        R_RGB1 = R_RGB2;                                                                                                                                                                      \
-        R_CD2 = R_CODE;                                                                                                                                                                       \
-        R_RC2 = gte_clamp_rgb(cpu, 1, R_MAC1 >> 4);                                                                                                                                           \
-        R_GC2 = gte_clamp_rgb(cpu, 2, R_MAC2 >> 4);                                                                                                                                           \
-        R_BC2 = gte_clamp_rgb(cpu, 3, R_MAC3 >> 4);                                                                                                                                           \
+#define NCDS(mac)                                                                                                             \
+    {                                                                                                                         \
+        R_MAC1 = gte_clamp_mac(cpu, 1, mac[0]);                                                                               \
+        R_MAC2 = gte_clamp_mac(cpu, 2, mac[1]);                                                                               \
+        R_MAC3 = gte_clamp_mac(cpu, 3, mac[2]);                                                                               \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                    \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                    \
+        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                    \
+        int64_t ir1 = gte_clamp_ir(cpu, 1, gte_clamp_mac(cpu, 1, ((I64(R_RFC) << 12) - ((I64(R_RC << 4)) * I64(R_IR1)))), 0); \
+        int64_t ir2 = gte_clamp_ir(cpu, 2, gte_clamp_mac(cpu, 2, ((I64(R_GFC) << 12) - ((I64(R_GC << 4)) * I64(R_IR2)))), 0); \
+        int64_t ir3 = gte_clamp_ir(cpu, 3, gte_clamp_mac(cpu, 3, ((I64(R_BFC) << 12) - ((I64(R_BC << 4)) * I64(R_IR3)))), 0); \
+        R_MAC1 = gte_clamp_mac(cpu, 1, ((I64(R_RC << 4)) * I64(R_IR1)) + (I64(R_IR0) * ir1));                                 \
+        R_MAC2 = gte_clamp_mac(cpu, 2, ((I64(R_GC << 4)) * I64(R_IR2)) + (I64(R_IR0) * ir2));                                 \
+        R_MAC3 = gte_clamp_mac(cpu, 3, ((I64(R_BC << 4)) * I64(R_IR3)) + (I64(R_IR0) * ir3));                                 \
+        R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);                                                                    \
+        R_IR2 = gte_clamp_ir(cpu, 2, R_MAC2, cpu->gte_lm);                                                                    \
+        R_IR3 = gte_clamp_ir(cpu, 3, R_MAC3, cpu->gte_lm);                                                                    \
+        R_RGB0 = R_RGB1;                                                                                                      \
+        R_RGB1 = R_RGB2;                                                                                                      \
+        R_CD2 = R_CODE;                                                                                                       \
+        R_RC2 = gte_clamp_rgb(cpu, 1, R_MAC1 >> 4);                                                                           \
+        R_GC2 = gte_clamp_rgb(cpu, 2, R_MAC2 >> 4);                                                                           \
+        R_BC2 = gte_clamp_rgb(cpu, 3, R_MAC3 >> 4);                                                                           \
     }
 
 static inline void psx_gte_i_rtps(psx_cpu_t *cpu)
 {
+    int16_t v[1][3];
+    int64_t mac[1][3];
+
     R_FLAG = 0;
-    GTE_RTP_DQ(0);
+
+    gte_load_vertices(cpu, v, 1);
+    gte_mul_scalar(cpu, mac, &cpu->cop2_cr.rt, &cpu->cop2_cr.tr, v, 1);
+
+    GTE_RTP_DQ(mac[0]);
 }
 
 static inline void psx_gte_i_nclip(psx_cpu_t *cpu)
@@ -2486,9 +2705,14 @@ static inline void psx_gte_i_mvmva(psx_cpu_t *cpu)
     }
     else
     {
-        R_MAC1 = gte_clamp_mac(cpu, 1, gte_check_mac(cpu, 1, gte_check_mac(cpu, 1, (I64(R_CV1) << 12) + (I64(R_MX11) * I64(R_VX))) + (I64(R_MX12) * I64(R_VY))) + (I64(R_MX13) * I64(R_VZ)));
-        R_MAC2 = gte_clamp_mac(cpu, 2, gte_check_mac(cpu, 2, gte_check_mac(cpu, 2, (I64(R_CV2) << 12) + (I64(R_MX21) * I64(R_VX))) + (I64(R_MX22) * I64(R_VY))) + (I64(R_MX23) * I64(R_VZ)));
-        R_MAC3 = gte_clamp_mac(cpu, 3, gte_check_mac(cpu, 3, gte_check_mac(cpu, 3, (I64(R_CV3) << 12) + (I64(R_MX31) * I64(R_VX))) + (I64(R_MX32) * I64(R_VY))) + (I64(R_MX33) * I64(R_VZ)));
+        int16_t vec[1][3] = {{R_VX, R_VY, R_VZ}};
+        int64_t mac[1][3];
+
+        gte_mul_scalar(cpu, mac, &mx, &cv, vec, 1);
+
+        R_MAC1 = gte_clamp_mac(cpu, 1, mac[0][0]);
+        R_MAC2 = gte_clamp_mac(cpu, 2, mac[0][1]);
+        R_MAC3 = gte_clamp_mac(cpu, 3, mac[0][2]);
     }
 
     R_IR1 = gte_clamp_ir(cpu, 1, R_MAC1, cpu->gte_lm);
@@ -2516,9 +2740,13 @@ static inline void psx_gte_i_mvmva(psx_cpu_t *cpu)
 // To-do: Fix flags
 static inline void psx_gte_i_ncds(psx_cpu_t *cpu)
 {
+    int64_t mac[1][3];
+
     R_FLAG = 0;
 
-    NCDS(0);
+    gte_light(cpu, mac, 1);
+
+    NCDS(mac[0]);
 }
 
 static inline void psx_gte_i_cdp(psx_cpu_t *cpu)
@@ -2549,16 +2777,26 @@ static inline void psx_gte_i_cdp(psx_cpu_t *cpu)
 
 static inline void psx_gte_i_ncdt(psx_cpu_t *cpu)
 {
+    int64_t mac[3][3];
+
     R_FLAG = 0;
-    NCDS(0);
-    NCDS(1);
-    NCDS(2);
+
+    gte_light(cpu, mac, 3);
+
+    NCDS(mac[0]);
+    NCDS(mac[1]);
+    NCDS(mac[2]);
 }
 
 static inline void psx_gte_i_nccs(psx_cpu_t *cpu)
 {
+    int64_t mac[1][3];
+
     R_FLAG = 0;
-    NCCS(0);
+
+    gte_light(cpu, mac, 1);
+
+    NCCS(mac[0]);
 }
 
 static inline void psx_gte_i_cc(psx_cpu_t *cpu)
@@ -2665,10 +2903,17 @@ static inline void psx_gte_i_avsz4(psx_cpu_t *cpu)
 
 static inline void psx_gte_i_rtpt(psx_cpu_t *cpu)
 {
+    int16_t v[3][3];
+    int64_t mac[3][3];
+
     R_FLAG = 0;
-    GTE_RTP(0);
-    GTE_RTP(1);
-    GTE_RTP_DQ(2);
+
+    gte_load_vertices(cpu, v, 3);
+    gte_mul(cpu, mac, &cpu->cop2_cr.rt, &cpu->cop2_cr.tr, v, 3);
+
+    GTE_RTP(mac[0]);
+    GTE_RTP(mac[1]);
+    GTE_RTP_DQ(mac[2]);
 }
 
 static inline void psx_gte_i_gpf(psx_cpu_t *cpu)
@@ -2709,12 +2954,255 @@ static inline void psx_gte_i_gpl(psx_cpu_t *cpu)
 
 static inline void psx_gte_i_ncct(psx_cpu_t *cpu)
 {
+    int64_t mac[3][3];
+
     R_FLAG = 0;
-    NCCS(0);
-    NCCS(1);
-    NCCS(2);
+
+    gte_light(cpu, mac, 3);
+
+    NCCS(mac[0]);
+    NCCS(mac[1]);
+    NCCS(mac[2]);
 }
 
+#ifdef PSX_CPU_USE_COMPUTED_GOTO
+int psx_cpu_execute(psx_cpu_t *cpu)
+{
+    // Indexed by opcode field, same layout as the switch below
+    static const void *const primary_table[64] = {
+        &&special, &&regimm, &&i_j, &&i_jal,
+        &&i_beq, &&i_bne, &&i_blez, &&i_bgtz,
+        &&i_addi, &&i_addiu, &&i_slti, &&i_sltiu,
+        &&i_andi, &&i_ori, &&i_xori, &&i_lui,
+        &&cop0, &&illegal, &&cop2, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&i_lb, &&i_lh, &&i_lwl, &&i_lw,
+        &&i_lbu, &&i_lhu, &&i_lwr, &&illegal,
+        &&i_sb, &&i_sh, &&i_swl, &&i_sw,
+        &&illegal, &&illegal, &&i_swr, &&illegal,
+        &&i_lwc0, &&i_lwc1, &&i_lwc2, &&i_lwc3,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&i_swc0, &&i_swc1, &&i_swc2, &&i_swc3,
+        &&illegal, &&illegal, &&illegal, &&illegal};
+
+    static const void *const special_table[64] = {
+        &&i_sll, &&illegal, &&i_srl, &&i_sra,
+        &&i_sllv, &&illegal, &&i_srlv, &&i_srav,
+        &&i_jr, &&i_jalr, &&illegal, &&illegal,
+        &&i_syscall, &&i_break, &&illegal, &&illegal,
+        &&i_mfhi, &&i_mthi, &&i_mflo, &&i_mtlo,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&i_mult, &&i_multu, &&i_div, &&i_divu,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&i_add, &&i_addu, &&i_sub, &&i_subu,
+        &&i_and, &&i_or, &&i_xor, &&i_nor,
+        &&illegal, &&illegal, &&i_slt, &&i_sltu,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal};
+
+    // Unlisted REGIMM opcodes are bltz/bgez dupes
+    static const void *const regimm_table[32] = {
+        &&i_bltz, &&i_bgez, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe,
+        &&i_bltzal, &&i_bgezal, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe,
+        &&regimm_dupe, &&regimm_dupe, &&regimm_dupe, &&regimm_dupe};
+
+    static const void *const cop0_table[32] = {
+        &&i_mfc0, &&illegal, &&illegal, &&illegal,
+        &&i_mtc0, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&i_rfe, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal,
+        &&illegal, &&illegal, &&illegal, &&illegal};
+
+    static const void *const cop2_table[32] = {
+        &&i_mfc2, &&gte, &&i_cfc2, &&gte,
+        &&i_mtc2, &&gte, &&i_ctc2, &&gte,
+        &&gte, &&gte, &&gte, &&gte,
+        &&gte, &&gte, &&gte, &&gte,
+        &&gte, &&gte, &&gte, &&gte,
+        &&gte, &&gte, &&gte, &&gte,
+        &&gte, &&gte, &&gte, &&gte,
+        &&gte, &&gte, &&gte, &&gte};
+
+    static const void *const gte_table[64] = {
+        &&gte_invalid, &&gte_rtps, &&gte_invalid, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_nclip, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_op, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_dpcs, &&gte_intpl, &&gte_mvmva, &&gte_ncds,
+        &&gte_cdp, &&gte_invalid, &&gte_ncdt, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_invalid, &&gte_nccs,
+        &&gte_cc, &&gte_invalid, &&gte_ncs, &&gte_invalid,
+        &&gte_nct, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_sqr, &&gte_dcpl, &&gte_dpct, &&gte_invalid,
+        &&gte_invalid, &&gte_avsz3, &&gte_avsz4, &&gte_invalid,
+        &&gte_rtpt, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_invalid, &&gte_invalid, &&gte_invalid, &&gte_invalid,
+        &&gte_invalid, &&gte_gpf, &&gte_gpl, &&gte_ncct};
+
+    goto *primary_table[cpu->opcode >> 26];
+
+special:
+    goto *special_table[cpu->opcode & 0x3f];
+
+regimm:
+    cpu->branch = 1;
+    cpu->branch_taken = 0;
+
+    goto *regimm_table[(cpu->opcode >> 16) & 0x1f];
+
+regimm_dupe:
+    if (cpu->opcode & 0x00010000)
+        goto i_bgez;
+
+    goto i_bltz;
+
+cop0:
+    goto *cop0_table[(cpu->opcode >> 21) & 0x1f];
+
+cop2:
+    goto *cop2_table[(cpu->opcode >> 21) & 0x1f];
+
+gte:
+    DO_PENDING_LOAD;
+
+    cpu->gte_sf = ((cpu->opcode & 0x80000) != 0) * 12;
+    cpu->gte_lm = (cpu->opcode & 0x400) != 0;
+    cpu->gte_cv = (cpu->opcode >> 13) & 3;
+    cpu->gte_v = (cpu->opcode >> 15) & 3;
+    cpu->gte_mx = (cpu->opcode >> 17) & 3;
+
+    goto *gte_table[cpu->opcode & 0x3f];
+
+#define DISPATCH(name, cycles) \
+    i_##name:                  \
+    psx_cpu_i_##name(cpu);     \
+    return cycles;
+#define GTE_DISPATCH(name, cycles) \
+    gte_##name:                    \
+    psx_gte_i_##name(cpu);         \
+    return cycles;
+
+    DISPATCH(sll, 2)
+    DISPATCH(srl, 2)
+    DISPATCH(sra, 2)
+    DISPATCH(sllv, 2)
+    DISPATCH(srlv, 2)
+    DISPATCH(srav, 2)
+    DISPATCH(jr, 2)
+    DISPATCH(jalr, 2)
+    DISPATCH(syscall, 2)
+    DISPATCH(break, 2)
+    DISPATCH(mfhi, 2)
+    DISPATCH(mthi, 2)
+    DISPATCH(mflo, 2)
+    DISPATCH(mtlo, 2)
+    DISPATCH(mult, 2)
+    DISPATCH(multu, 2)
+    DISPATCH(div, 2)
+    DISPATCH(divu, 2)
+    DISPATCH(add, 2)
+    DISPATCH(addu, 2)
+    DISPATCH(sub, 2)
+    DISPATCH(subu, 2)
+    DISPATCH(and, 2)
+    DISPATCH(or, 2)
+    DISPATCH(xor, 2)
+    DISPATCH(nor, 2)
+    DISPATCH(slt, 2)
+    DISPATCH(sltu, 2)
+    DISPATCH(bltz, 2)
+    DISPATCH(bgez, 2)
+    DISPATCH(bltzal, 2)
+    DISPATCH(bgezal, 2)
+    DISPATCH(j, 2)
+    DISPATCH(jal, 2)
+    DISPATCH(beq, 2)
+    DISPATCH(bne, 2)
+    DISPATCH(blez, 2)
+    DISPATCH(bgtz, 2)
+    DISPATCH(addi, 2)
+    DISPATCH(addiu, 2)
+    DISPATCH(slti, 2)
+    DISPATCH(sltiu, 2)
+    DISPATCH(andi, 2)
+    DISPATCH(ori, 2)
+    DISPATCH(xori, 2)
+    DISPATCH(lui, 2)
+    DISPATCH(mfc0, 2)
+    DISPATCH(mtc0, 2)
+    DISPATCH(rfe, 2)
+    DISPATCH(mfc2, 2)
+    DISPATCH(cfc2, 2)
+    DISPATCH(mtc2, 2)
+    DISPATCH(ctc2, 2)
+    DISPATCH(lb, 2)
+    DISPATCH(lh, 2)
+    DISPATCH(lwl, 2)
+    DISPATCH(lw, 2)
+    DISPATCH(lbu, 2)
+    DISPATCH(lhu, 2)
+    DISPATCH(lwr, 2)
+    DISPATCH(sb, 2)
+    DISPATCH(sh, 2)
+    DISPATCH(swl, 2)
+    DISPATCH(sw, 2)
+    DISPATCH(swr, 2)
+    DISPATCH(lwc0, 2)
+    DISPATCH(lwc1, 2)
+    DISPATCH(lwc2, 2)
+    DISPATCH(lwc3, 2)
+    DISPATCH(swc0, 2)
+    DISPATCH(swc1, 2)
+    DISPATCH(swc2, 2)
+    DISPATCH(swc3, 2)
+    GTE_DISPATCH(rtps, 15)
+    GTE_DISPATCH(nclip, 8)
+    GTE_DISPATCH(op, 6)
+    GTE_DISPATCH(dpcs, 8)
+    GTE_DISPATCH(intpl, 8)
+    GTE_DISPATCH(mvmva, 8)
+    GTE_DISPATCH(ncds, 19)
+    GTE_DISPATCH(cdp, 13)
+    GTE_DISPATCH(ncdt, 44)
+    GTE_DISPATCH(nccs, 17)
+    GTE_DISPATCH(cc, 11)
+    GTE_DISPATCH(ncs, 14)
+    GTE_DISPATCH(nct, 30)
+    GTE_DISPATCH(sqr, 5)
+    GTE_DISPATCH(dcpl, 8)
+    GTE_DISPATCH(dpct, 17)
+    GTE_DISPATCH(avsz3, 5)
+    GTE_DISPATCH(avsz4, 6)
+    GTE_DISPATCH(rtpt, 23)
+    GTE_DISPATCH(gpf, 5)
+    GTE_DISPATCH(gpl, 5)
+    GTE_DISPATCH(ncct, 39)
+
+#undef DISPATCH
+#undef GTE_DISPATCH
+
+gte_invalid:
+    psx_gte_i_invalid(cpu);
+
+illegal:
+    return 0;
+}
+#else
 int psx_cpu_execute(psx_cpu_t *cpu)
 {
     switch ((cpu->opcode & 0xfc000000) >> 26)
@@ -3072,6 +3560,930 @@ int psx_cpu_execute(psx_cpu_t *cpu)
 
     return 0;
 }
+#endif
+
+// Cached interpreter
+#define HANDLER(name, cycles)                     \
+    static int psx_cpu_h_##name(psx_cpu_t *cpu) \
+    {                                             \
+        psx_cpu_i_##name(cpu);                    \
+                                                  \
+        return cycles;                            \
+    }
+#define REGIMM_HANDLER(name)                      \
+    static int psx_cpu_h_##name(psx_cpu_t *cpu) \
+    {                                             \
+        cpu->branch = 1;                          \
+        cpu->branch_taken = 0;                    \
+                                                  \
+        psx_cpu_i_##name(cpu);                    \
+                                                  \
+        return 2;                                 \
+    }
+#define GTE_HANDLER(name, cycles)                                  \
+    static int psx_gte_h_##name(psx_cpu_t *cpu)                  \
+    {                                                              \
+        DO_PENDING_LOAD;                                           \
+                                                                   \
+        cpu->gte_sf = ((cpu->opcode & 0x80000) != 0) * 12;         \
+        cpu->gte_lm = (cpu->opcode & 0x400) != 0;                  \
+        cpu->gte_cv = (cpu->opcode >> 13) & 3;                     \
+        cpu->gte_v = (cpu->opcode >> 15) & 3;                      \
+        cpu->gte_mx = (cpu->opcode >> 17) & 3;                     \
+                                                                   \
+        psx_gte_i_##name(cpu);                                     \
+                                                                   \
+        return cycles;                                             \
+    }
+
+HANDLER(sll, 2)
+HANDLER(srl, 2)
+HANDLER(sra, 2)
+HANDLER(sllv, 2)
+HANDLER(srlv, 2)
+HANDLER(srav, 2)
+HANDLER(jr, 2)
+HANDLER(jalr, 2)
+HANDLER(syscall, 2)
+HANDLER(break, 2)
+HANDLER(mfhi, 2)
+HANDLER(mthi, 2)
+HANDLER(mflo, 2)
+HANDLER(mtlo, 2)
+HANDLER(mult, 2)
+HANDLER(multu, 2)
+HANDLER(div, 2)
+HANDLER(divu, 2)
+HANDLER(add, 2)
+HANDLER(addu, 2)
+HANDLER(sub, 2)
+HANDLER(subu, 2)
+HANDLER(and, 2)
+HANDLER(or, 2)
+HANDLER(xor, 2)
+HANDLER(nor, 2)
+HANDLER(slt, 2)
+HANDLER(sltu, 2)
+REGIMM_HANDLER(bltz)
+REGIMM_HANDLER(bgez)
+REGIMM_HANDLER(bltzal)
+REGIMM_HANDLER(bgezal)
+HANDLER(j, 2)
+HANDLER(jal, 2)
+HANDLER(beq, 2)
+HANDLER(bne, 2)
+HANDLER(blez, 2)
+HANDLER(bgtz, 2)
+HANDLER(addi, 2)
+HANDLER(addiu, 2)
+HANDLER(slti, 2)
+HANDLER(sltiu, 2)
+HANDLER(andi, 2)
+HANDLER(ori, 2)
+HANDLER(xori, 2)
+HANDLER(lui, 2)
+HANDLER(mfc0, 2)
+HANDLER(mtc0, 2)
+HANDLER(rfe, 2)
+HANDLER(mfc2, 2)
+HANDLER(cfc2, 2)
+HANDLER(mtc2, 2)
+HANDLER(ctc2, 2)
+HANDLER(lb, 2)
+HANDLER(lh, 2)
+HANDLER(lwl, 2)
+HANDLER(lw, 2)
+HANDLER(lbu, 2)
+HANDLER(lhu, 2)
+HANDLER(lwr, 2)
+HANDLER(sb, 2)
+HANDLER(sh, 2)
+HANDLER(swl, 2)
+HANDLER(sw, 2)
+HANDLER(swr, 2)
+HANDLER(lwc0, 2)
+HANDLER(lwc1, 2)
+HANDLER(lwc2, 2)
+HANDLER(lwc3, 2)
+HANDLER(swc0, 2)
+HANDLER(swc1, 2)
+HANDLER(swc2, 2)
+HANDLER(swc3, 2)
+GTE_HANDLER(rtps, 15)
+GTE_HANDLER(nclip, 8)
+GTE_HANDLER(op, 6)
+GTE_HANDLER(dpcs, 8)
+GTE_HANDLER(intpl, 8)
+GTE_HANDLER(mvmva, 8)
+GTE_HANDLER(ncds, 19)
+GTE_HANDLER(cdp, 13)
+GTE_HANDLER(ncdt, 44)
+GTE_HANDLER(nccs, 17)
+GTE_HANDLER(cc, 11)
+GTE_HANDLER(ncs, 14)
+GTE_HANDLER(nct, 30)
+GTE_HANDLER(sqr, 5)
+GTE_HANDLER(dcpl, 8)
+GTE_HANDLER(dpct, 17)
+GTE_HANDLER(avsz3, 5)
+GTE_HANDLER(avsz4, 6)
+GTE_HANDLER(rtpt, 23)
+GTE_HANDLER(gpf, 5)
+GTE_HANDLER(gpl, 5)
+GTE_HANDLER(ncct, 39)
+GTE_HANDLER(invalid, 0)
+
+static int psx_cpu_h_illegal(psx_cpu_t *cpu)
+{
+    return 0;
+}
+
+static const psx_cpu_handler_t g_psx_cpu_primary_table[64] = {
+    [0x02] = psx_cpu_h_j,
+    [0x03] = psx_cpu_h_jal,
+    [0x04] = psx_cpu_h_beq,
+    [0x05] = psx_cpu_h_bne,
+    [0x06] = psx_cpu_h_blez,
+    [0x07] = psx_cpu_h_bgtz,
+    [0x08] = psx_cpu_h_addi,
+    [0x09] = psx_cpu_h_addiu,
+    [0x0a] = psx_cpu_h_slti,
+    [0x0b] = psx_cpu_h_sltiu,
+    [0x0c] = psx_cpu_h_andi,
+    [0x0d] = psx_cpu_h_ori,
+    [0x0e] = psx_cpu_h_xori,
+    [0x0f] = psx_cpu_h_lui,
+    [0x20] = psx_cpu_h_lb,
+    [0x21] = psx_cpu_h_lh,
+    [0x22] = psx_cpu_h_lwl,
+    [0x23] = psx_cpu_h_lw,
+    [0x24] = psx_cpu_h_lbu,
+    [0x25] = psx_cpu_h_lhu,
+    [0x26] = psx_cpu_h_lwr,
+    [0x28] = psx_cpu_h_sb,
+    [0x29] = psx_cpu_h_sh,
+    [0x2a] = psx_cpu_h_swl,
+    [0x2b] = psx_cpu_h_sw,
+    [0x2e] = psx_cpu_h_swr,
+    [0x30] = psx_cpu_h_lwc0,
+    [0x31] = psx_cpu_h_lwc1,
+    [0x32] = psx_cpu_h_lwc2,
+    [0x33] = psx_cpu_h_lwc3,
+    [0x38] = psx_cpu_h_swc0,
+    [0x39] = psx_cpu_h_swc1,
+    [0x3a] = psx_cpu_h_swc2,
+    [0x3b] = psx_cpu_h_swc3};
+
+static const psx_cpu_handler_t g_psx_cpu_special_table[64] = {
+    [0x00] = psx_cpu_h_sll,
+    [0x02] = psx_cpu_h_srl,
+    [0x03] = psx_cpu_h_sra,
+    [0x04] = psx_cpu_h_sllv,
+    [0x06] = psx_cpu_h_srlv,
+    [0x07] = psx_cpu_h_srav,
+    [0x08] = psx_cpu_h_jr,
+    [0x09] = psx_cpu_h_jalr,
+    [0x0c] = psx_cpu_h_syscall,
+    [0x0d] = psx_cpu_h_break,
+    [0x10] = psx_cpu_h_mfhi,
+    [0x11] = psx_cpu_h_mthi,
+    [0x12] = psx_cpu_h_mflo,
+    [0x13] = psx_cpu_h_mtlo,
+    [0x18] = psx_cpu_h_mult,
+    [0x19] = psx_cpu_h_multu,
+    [0x1a] = psx_cpu_h_div,
+    [0x1b] = psx_cpu_h_divu,
+    [0x20] = psx_cpu_h_add,
+    [0x21] = psx_cpu_h_addu,
+    [0x22] = psx_cpu_h_sub,
+    [0x23] = psx_cpu_h_subu,
+    [0x24] = psx_cpu_h_and,
+    [0x25] = psx_cpu_h_or,
+    [0x26] = psx_cpu_h_xor,
+    [0x27] = psx_cpu_h_nor,
+    [0x2a] = psx_cpu_h_slt,
+    [0x2b] = psx_cpu_h_sltu};
+
+static const psx_cpu_handler_t g_psx_gte_table[64] = {
+    [0x01] = psx_gte_h_rtps,
+    [0x06] = psx_gte_h_nclip,
+    [0x0c] = psx_gte_h_op,
+    [0x10] = psx_gte_h_dpcs,
+    [0x11] = psx_gte_h_intpl,
+    [0x12] = psx_gte_h_mvmva,
+    [0x13] = psx_gte_h_ncds,
+    [0x14] = psx_gte_h_cdp,
+    [0x16] = psx_gte_h_ncdt,
+    [0x1b] = psx_gte_h_nccs,
+    [0x1c] = psx_gte_h_cc,
+    [0x1e] = psx_gte_h_ncs,
+    [0x20] = psx_gte_h_nct,
+    [0x28] = psx_gte_h_sqr,
+    [0x29] = psx_gte_h_dcpl,
+    [0x2a] = psx_gte_h_dpct,
+    [0x2d] = psx_gte_h_avsz3,
+    [0x2e] = psx_gte_h_avsz4,
+    [0x30] = psx_gte_h_rtpt,
+    [0x3d] = psx_gte_h_gpf,
+    [0x3e] = psx_gte_h_gpl,
+    [0x3f] = psx_gte_h_ncct};
+
+// Mirrors the decoding done by psx_cpu_execute
+psx_cpu_handler_t psx_cpu_decode(uint32_t opcode)
+{
+    psx_cpu_handler_t handler = NULL;
+
+    switch (opcode >> 26)
+    {
+    case 0x00:
+        handler = g_psx_cpu_special_table[opcode & 0x3f];
+        break;
+    case 0x01:
+    {
+        switch ((opcode >> 16) & 0x1f)
+        {
+        case 0x00:
+            handler = psx_cpu_h_bltz;
+            break;
+        case 0x01:
+            handler = psx_cpu_h_bgez;
+            break;
+        case 0x10:
+            handler = psx_cpu_h_bltzal;
+            break;
+        case 0x11:
+            handler = psx_cpu_h_bgezal;
+            break;
+        // bltz/bgez dupes
+        default:
+            handler = (opcode & 0x00010000) ? psx_cpu_h_bgez : psx_cpu_h_bltz;
+            break;
+        }
+    }
+    break;
+    case 0x10:
+    {
+        switch ((opcode >> 21) & 0x1f)
+        {
+        case 0x00:
+            handler = psx_cpu_h_mfc0;
+            break;
+        case 0x04:
+            handler = psx_cpu_h_mtc0;
+            break;
+        case 0x10:
+            handler = psx_cpu_h_rfe;
+            break;
+        }
+    }
+    break;
+    case 0x12:
+    {
+        switch ((opcode >> 21) & 0x1f)
+        {
+        case 0x00:
+            handler = psx_cpu_h_mfc2;
+            break;
+        case 0x02:
+            handler = psx_cpu_h_cfc2;
+            break;
+        case 0x04:
+            handler = psx_cpu_h_mtc2;
+            break;
+        case 0x06:
+            handler = psx_cpu_h_ctc2;
+            break;
+        default:
+        {
+            handler = g_psx_gte_table[opcode & 0x3f];
+
+            if (!handler)
+                handler = psx_gte_h_invalid;
+        }
+        break;
+        }
+    }
+    break;
+    default:
+        handler = g_psx_cpu_primary_table[opcode >> 26];
+        break;
+    }
+
+    return handler ? handler : psx_cpu_h_illegal;
+}
+
+/*
+    Fused pairs run the second instruction right after the first,
+    with the same bookkeeping psx_cpu_cycle does between the two.
+    The first instruction never branches, stores or traps, so only
+    a device update can raise an IRQ in between. Pairs are split
+    when an IRQ is already pending or a device event is due before
+    the second instruction, so both see the state they would have
+    seen stepping one at a time.
+
+    If the first instruction was in the delay slot of a taken
+    branch the second one isn't next, only the first runs then.
+*/
+#define FUSED_HANDLER(name, first, second, id)                         \
+    static int psx_cpu_f_##name(psx_cpu_t *cpu)                        \
+    {                                                                  \
+        psx_cpu_i_##first(cpu);                                        \
+                                                                       \
+        cpu->r[0] = 0;                                                 \
+                                                                       \
+        uint32_t fetch_cycles = cpu->block->fetch_cycles;              \
+                                                                       \
+        if (cpu->pc != cpu->block_pc)                                  \
+            return 2;                                                  \
+                                                                       \
+        if ((cpu->sched_budget <= (fetch_cycles + 2)) ||               \
+            (cpu->cop0_r[COP0_CAUSE] & 0x00000700))                    \
+            return 2;                                                  \
+                                                                       \
+        cpu->opcode = cpu->block->insn[cpu->block_index++].opcode;     \
+        cpu->block_pc += 4;                                            \
+        cpu->saved_pc = cpu->pc;                                       \
+        cpu->delay_slot = cpu->branch;                                 \
+        cpu->branch = 0;                                               \
+        cpu->branch_taken = 0;                                         \
+        cpu->pc = cpu->next_pc;                                        \
+        cpu->next_pc += 4;                                             \
+        cpu->last_instructions = 2;                                    \
+        cpu->fused[id]++;                                              \
+                                                                       \
+        psx_cpu_i_##second(cpu);                                       \
+                                                                       \
+        return 2 + fetch_cycles + 2;                                   \
+    }
+
+FUSED_HANDLER(lui_ori, lui, ori, PSX_CPU_FUSED_LUI_ORI)
+FUSED_HANDLER(lui_addiu, lui, addiu, PSX_CPU_FUSED_LUI_ADDIU)
+FUSED_HANDLER(lui_lw, lui, lw, PSX_CPU_FUSED_LUI_LW)
+FUSED_HANDLER(slt_beq, slt, beq, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(slt_bne, slt, bne, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(sltu_beq, sltu, beq, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(sltu_bne, sltu, bne, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(slti_beq, slti, beq, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(slti_bne, slti, bne, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(sltiu_beq, sltiu, beq, PSX_CPU_FUSED_SLT_BRANCH)
+FUSED_HANDLER(sltiu_bne, sltiu, bne, PSX_CPU_FUSED_SLT_BRANCH)
+
+// Returns the fused handler for a pair, or NULL if the second
+// instruction doesn't use the register the first one sets
+static psx_cpu_handler_t psx_cpu_fuse(uint32_t first, uint32_t second)
+{
+    uint32_t s = (second >> 21) & 0x1f;
+    uint32_t t = (second >> 16) & 0x1f;
+    uint32_t d = 0;
+    int bne = (second >> 26) == 0x05;
+
+    switch (first >> 26)
+    {
+    case 0x0f:
+    {
+        d = (first >> 16) & 0x1f;
+
+        if (!d || (s != d))
+            return NULL;
+
+        switch (second >> 26)
+        {
+        case 0x09:
+            return psx_cpu_f_lui_addiu;
+        case 0x0d:
+            return psx_cpu_f_lui_ori;
+        case 0x23:
+            return psx_cpu_f_lui_lw;
+        }
+    }
+    return NULL;
+    case 0x00:
+    case 0x0a:
+    case 0x0b:
+    {
+        if (((second >> 26) != 0x04) && !bne)
+            return NULL;
+
+        d = (first >> 26) ? ((first >> 16) & 0x1f) : ((first >> 11) & 0x1f);
+
+        if (!d || ((s != d) && (t != d)))
+            return NULL;
+
+        switch (first >> 26)
+        {
+        case 0x00:
+        {
+            if ((first & 0x3f) == 0x2a)
+                return bne ? psx_cpu_f_slt_bne : psx_cpu_f_slt_beq;
+
+            if ((first & 0x3f) == 0x2b)
+                return bne ? psx_cpu_f_sltu_bne : psx_cpu_f_sltu_beq;
+        }
+        break;
+        case 0x0a:
+            return bne ? psx_cpu_f_slti_bne : psx_cpu_f_slti_beq;
+        case 0x0b:
+            return bne ? psx_cpu_f_sltiu_bne : psx_cpu_f_sltiu_beq;
+        }
+    }
+    return NULL;
+    }
+
+    return NULL;
+}
+
+// Returns the cache page for a code address, or -1 if code
+// at that address is not cached (i.e. not in RAM or BIOS)
+int psx_cpu_get_code_page(psx_cpu_t *cpu, uint32_t addr)
+{
+    uint32_t seg = addr >> 29;
+
+    // KUSEG (first 512 MB), KSEG0 and KSEG1
+    if ((seg != 0) && (seg != 4) && (seg != 5))
+        return -1;
+
+    psx_bus_t *bus = cpu->bus;
+    uint32_t phys = addr & 0x1fffffff;
+
+    // Reads above 4 MB depend on the RAM_SIZE register
+    if ((phys < 0x400000) && bus->ram->buf)
+        return ((phys - bus->ram->io_base) & (bus->ram->size - 1)) >> PSX_CPU_CACHE_PAGE_SHIFT;
+
+    if ((phys >= bus->bios->io_base) && (phys < (bus->bios->io_base + bus->bios->io_size)) && bus->bios->buf)
+    {
+        uint32_t page = (phys - bus->bios->io_base) >> PSX_CPU_CACHE_PAGE_SHIFT;
+
+        // Anything past the largest known BIOS isn't cached
+        if (page < PSX_CPU_CACHE_BIOS_PAGES)
+            return PSX_CPU_CACHE_RAM_PAGES + page;
+    }
+
+    return -1;
+}
+
+static psx_cpu_block_t **psx_cpu_get_block_slot(psx_cpu_t *cpu, uint32_t addr)
+{
+    int page = psx_cpu_get_code_page(cpu, addr);
+
+    if (page == -1)
+        return NULL;
+
+    if (!cpu->block_page[page])
+        cpu->block_page[page] = (psx_cpu_block_t **)calloc(
+            PSX_CPU_CACHE_PAGE_SIZE >> 2,
+            sizeof(psx_cpu_block_t *));
+
+    return &cpu->block_page[page][(addr & (PSX_CPU_CACHE_PAGE_SIZE - 1)) >> 2];
+}
+
+static psx_cpu_block_t *psx_cpu_compile_block(psx_cpu_t *cpu, uint32_t addr)
+{
+    // Allocate for the rest of the page, then shrink to fit
+    uint32_t start = addr;
+    uint32_t end = (addr | (PSX_CPU_CACHE_PAGE_SIZE - 1)) + 1;
+
+    psx_cpu_block_t *block = (psx_cpu_block_t *)malloc(
+        sizeof(psx_cpu_block_t) + (((end - addr) >> 2) * sizeof(psx_cpu_insn_t)));
+
+    uint32_t fetch_cycles = 0;
+    uint32_t size = 0;
+    int delay_slot = 0;
+
+    // Stop after the delay slot of an unconditional jump, conditional
+    // branches are left in since the fallthrough path is still sequential
+    while (addr < end)
+    {
+        uint32_t opcode = psx_bus_read32(cpu->bus, addr);
+
+        if (!size)
+            fetch_cycles = psx_bus_get_access_cycles(cpu->bus);
+
+        psx_cpu_handler_t handler = psx_cpu_decode(opcode);
+
+        block->insn[size].handler = handler;
+        block->insn[size].opcode = opcode;
+
+        size++;
+        addr += 4;
+
+        if (delay_slot)
+            break;
+
+        if ((handler == psx_cpu_h_syscall) ||
+            (handler == psx_cpu_h_break) ||
+            (handler == psx_cpu_h_illegal))
+            break;
+
+        delay_slot = (handler == psx_cpu_h_j) ||
+                     (handler == psx_cpu_h_jal) ||
+                     (handler == psx_cpu_h_jr) ||
+                     (handler == psx_cpu_h_jalr);
+    }
+
+    // The second instruction of a pair keeps its own handler for
+    // jumps landing on it. Don't fuse over the kernel call vectors,
+    // psx_cpu_cycle has to see those
+    for (uint32_t i = 1; i < size; i++)
+    {
+        uint32_t pc = start + (i << 2);
+
+        if (((pc & 0x3fffffff) == 0x000000b4) || psx_hle_is_vector(pc))
+            continue;
+
+        psx_cpu_handler_t fused = psx_cpu_fuse(block->insn[i - 1].opcode, block->insn[i].opcode);
+
+        if (fused)
+            block->insn[i - 1].handler = fused;
+    }
+
+    block = (psx_cpu_block_t *)realloc(block,
+        sizeof(psx_cpu_block_t) + (size * sizeof(psx_cpu_insn_t)));
+
+    block->size = size;
+    block->fetch_cycles = fetch_cycles;
+
+    // Get notified when the code we just decoded is overwritten
+    psx_bus_protect_code(cpu->bus, start);
+
+    return block;
+}
+
+static inline psx_cpu_insn_t *psx_cpu_fetch_cached(psx_cpu_t *cpu)
+{
+    psx_cpu_block_t *block = cpu->block;
+
+    // Sequential fetch within the current block
+    if (block && (cpu->pc == cpu->block_pc) && (cpu->block_index < block->size))
+    {
+        cpu->block_pc += 4;
+
+        return &block->insn[cpu->block_index++];
+    }
+
+    psx_cpu_block_t **slot = psx_cpu_get_block_slot(cpu, cpu->pc);
+
+    if (!slot)
+    {
+        cpu->block = NULL;
+
+        return NULL;
+    }
+
+    if (!*slot)
+        *slot = psx_cpu_compile_block(cpu, cpu->pc);
+
+    cpu->block = *slot;
+    cpu->block_pc = cpu->pc + 4;
+    cpu->block_index = 1;
+
+    return &cpu->block->insn[0];
+}
+
+static void psx_cpu_free_page(psx_cpu_t *cpu, uint32_t page)
+{
+    psx_cpu_block_t **slots = cpu->block_page[page];
+
+    if (!slots)
+        return;
+
+    for (int i = 0; i < (PSX_CPU_CACHE_PAGE_SIZE >> 2); i++)
+    {
+        if (!slots[i])
+            continue;
+
+        if (slots[i] == cpu->block)
+            cpu->block = NULL;
+
+        free(slots[i]);
+    }
+
+    free(slots);
+
+    cpu->block_page[page] = NULL;
+}
+
+static void psx_cpu_code_write_cb(void *udata, uint32_t offset)
+{
+    psx_cpu_t *cpu = (psx_cpu_t *)udata;
+
+    psx_cpu_free_page(cpu, offset >> PSX_CPU_CACHE_PAGE_SHIFT);
+
+    if (cpu->jit)
+        psx_jit_invalidate_page(cpu->jit, offset >> PSX_CPU_CACHE_PAGE_SHIFT);
+}
+
+void psx_cpu_flush_cache(psx_cpu_t *cpu)
+{
+    for (int i = 0; i < PSX_CPU_CACHE_PAGES; i++)
+        psx_cpu_free_page(cpu, i);
+
+    cpu->block = NULL;
+
+    if (cpu->jit)
+        psx_jit_flush(cpu->jit);
+}
+
+void psx_cpu_set_mode(psx_cpu_t *cpu, int mode)
+{
+    psx_cpu_flush_cache(cpu);
+
+    if ((mode == PSX_CPU_JIT) && !cpu->jit)
+    {
+        cpu->jit = psx_jit_create();
+
+        if (psx_jit_init(cpu->jit, cpu))
+        {
+            log_error("JIT is not supported on this host, using the interpreter");
+
+            psx_jit_destroy(cpu->jit);
+
+            cpu->jit = NULL;
+
+            mode = PSX_CPU_INTERPRETER;
+        }
+    }
+
+    cpu->mode = mode;
+}
+
+// Results are the same either way, the scalar path is only useful
+// as a reference for the SIMD kernels
+void psx_cpu_set_gte_simd(psx_cpu_t *cpu, int enable)
+{
+    cpu->gte_mul = enable ? psx_gte_simd_select() : NULL;
+}
+
+void psx_cpu_set_hle(psx_cpu_t *cpu, int enable)
+{
+    cpu->hle = enable;
+}
+
+uint64_t psx_cpu_get_fused_count(psx_cpu_t *cpu, int pair)
+{
+    return cpu->fused[pair];
+}
+
+// GTE register access from outside the CPU, r is 0-31 for data
+// registers and 32-63 for control registers
+uint32_t psx_cpu_read_gte(psx_cpu_t *cpu, int r)
+{
+    return gte_read_register(cpu, r);
+}
+
+void psx_cpu_write_gte(psx_cpu_t *cpu, int r, uint32_t value)
+{
+    gte_write_register(cpu, r, value);
+}
+
+// Runs a single decoded instruction, the JIT uses this
+// for everything it doesn't translate to host code
+int psx_cpu_execute_decoded(psx_cpu_t *cpu, psx_cpu_handler_t handler, uint32_t opcode)
+{
+    cpu->opcode = opcode;
+
+    int cyc = handler(cpu);
+
+    if (!cyc)
+    {
+        printf("psxe: Illegal instruction %08x at %08x (next=%08x, saved=%08x)\n", cpu->opcode, cpu->pc, cpu->next_pc, cpu->saved_pc);
+
+        psx_cpu_exception(cpu, CAUSE_RI);
+    }
+
+    cpu->r[0] = 0;
+
+    return cyc;
+}
+
+// Decodes the registers read and written by instructions allowed
+// in idle loops, returns 0 for anything else
+static int psx_cpu_idle_decode(uint32_t opcode, uint32_t *reads, uint32_t *writes, int *load, int *branch)
+{
+    uint32_t rs = 1u << ((opcode >> 21) & 0x1f);
+    uint32_t rt = 1u << ((opcode >> 16) & 0x1f);
+    uint32_t rd = 1u << ((opcode >> 11) & 0x1f);
+
+    *reads = 0;
+    *writes = 0;
+    *load = 0;
+    *branch = 0;
+
+    switch (opcode >> 26)
+    {
+    case 0x00:
+    {
+        switch (opcode & 0x3f)
+        {
+        // sll, srl, sra
+        case 0x00: case 0x02: case 0x03:
+            *reads = rt;
+            *writes = rd;
+            return 1;
+
+        // sllv, srlv, srav, addu, subu, and, or, xor, nor, slt, sltu
+        case 0x04: case 0x06: case 0x07:
+        case 0x21: case 0x23: case 0x24: case 0x25:
+        case 0x26: case 0x27: case 0x2a: case 0x2b:
+            *reads = rs | rt;
+            *writes = rd;
+            return 1;
+        }
+    }
+    break;
+
+    // bltz, bgez (the linking variants are rejected)
+    case 0x01:
+    {
+        if (((opcode >> 16) & 0x1f) > 1)
+            return 0;
+
+        *reads = rs;
+        *branch = 1;
+    }
+    return 1;
+
+    // j
+    case 0x02:
+        *branch = 1;
+        return 1;
+
+    // beq, bne
+    case 0x04: case 0x05:
+        *reads = rs | rt;
+        *branch = 1;
+        return 1;
+
+    // blez, bgtz
+    case 0x06: case 0x07:
+        *reads = rs;
+        *branch = 1;
+        return 1;
+
+    // addiu, slti, sltiu, andi, ori, xori
+    case 0x09: case 0x0a: case 0x0b:
+    case 0x0c: case 0x0d: case 0x0e:
+        *reads = rs;
+        *writes = rt;
+        return 1;
+
+    // lui
+    case 0x0f:
+        *writes = rt;
+        return 1;
+
+    // lb, lh, lw, lbu, lhu
+    case 0x20: case 0x21: case 0x23: case 0x24: case 0x25:
+        *reads = rs;
+        *writes = rt;
+        *load = 1;
+        return 1;
+    }
+
+    return 0;
+}
+
+static inline uint32_t psx_cpu_idle_branch_target(uint32_t addr, uint32_t opcode)
+{
+    if ((opcode >> 26) == 0x02)
+        return ((addr + 4) & 0xf0000000) | ((opcode & 0x3ffffff) << 2);
+
+    return addr + 4 + ((uint32_t)(int16_t)opcode << 2);
+}
+
+// Checks whether the code at pc is a loop that can be skipped while
+// waiting for a device, returns the loop size in instructions or 0
+int psx_cpu_find_idle_loop(psx_cpu_t *cpu, uint32_t pc, psx_cpu_idle_loop_t *loop)
+{
+    loop->pc = pc;
+    loop->size = 0;
+    loop->loads = 0;
+
+    if (psx_cpu_get_code_page(cpu, pc) == -1)
+        return 0;
+
+    uint32_t live = 0;
+    uint32_t written = 0;
+    uint32_t bases = 0;
+    uint32_t pending = 0;
+    int delay_slot = 0;
+
+    for (uint32_t i = 0; i < PSX_CPU_IDLE_LOOP_MAX; i++)
+    {
+        uint32_t addr = pc + (i << 2);
+
+        // Don't follow the loop into another page
+        if ((addr >> PSX_CPU_CACHE_PAGE_SHIFT) != (pc >> PSX_CPU_CACHE_PAGE_SHIFT))
+            return 0;
+
+        uint32_t opcode = psx_bus_read32(cpu->bus, addr);
+        uint32_t reads, writes;
+        int load, branch;
+
+        loop->opcode[i] = opcode;
+
+        if (!psx_cpu_idle_decode(opcode, &reads, &writes, &load, &branch))
+            return 0;
+
+        // No branches or loads in delay slots
+        if (delay_slot && (branch || load))
+            return 0;
+
+        // Registers read before being written carry state
+        // between iterations
+        live |= reads & ~written;
+
+        // Load results land one instruction late
+        written |= pending;
+        pending = 0;
+
+        if (load)
+        {
+            loop->load[loop->loads].base = (opcode >> 21) & 0x1f;
+            loop->load[loop->loads].offset = (int16_t)opcode;
+            // 1, 2 or 4 bytes
+            loop->load[loop->loads].width = ((opcode >> 26) & 3) + 1;
+            loop->loads++;
+
+            bases |= reads;
+            pending = writes;
+        }
+        else
+        {
+            written |= writes;
+        }
+
+        if (delay_slot)
+        {
+            // r0 is always safe to "carry"
+            if ((live | bases) & written & ~1u)
+                return 0;
+
+            loop->size = i + 1;
+
+            return loop->size;
+        }
+
+        if (branch && (psx_cpu_idle_branch_target(addr, opcode) == pc))
+            delay_slot = 1;
+    }
+
+    return 0;
+}
+
+// Checks whether skipping iterations of an idle loop is safe right
+// now, i.e. the code is unchanged, no IRQ is about to be taken and
+// all loads hit memory that only changes through scheduled device
+// updates
+int psx_cpu_check_idle_loop(psx_cpu_t *cpu, psx_cpu_idle_loop_t *loop)
+{
+    if (!loop->size || psx_cpu_check_irq(cpu))
+        return 0;
+
+    // Self-modifying code or an overlay load replaced the loop, look
+    // at it again next time
+    for (uint32_t i = 0; i < loop->size; i++)
+    {
+        if (psx_bus_read32(cpu->bus, loop->pc + (i << 2)) != loop->opcode[i])
+        {
+            loop->pc = 0xffffffff;
+            loop->size = 0;
+
+            return 0;
+        }
+    }
+
+    for (uint32_t i = 0; i < loop->loads; i++)
+    {
+        uint32_t addr = cpu->r[loop->load[i].base] + loop->load[i].offset;
+        uint32_t width = loop->load[i].width;
+        uint32_t seg = addr >> 29;
+        uint32_t phys = addr & 0x1fffffff;
+
+        if (addr & (width - 1))
+            return 0;
+
+        if ((seg != 0) && (seg != 4) && (seg != 5))
+            return 0;
+
+        // RAM, scratchpad and I_STAT/I_MASK
+        if (phys < 0x800000)
+            continue;
+
+        if ((phys >= 0x1f800000) && (phys < 0x1f800400))
+            continue;
+
+        if ((phys >= 0x1f801070) && (phys < 0x1f801078))
+            continue;
+
+        return 0;
+    }
+
+    return 1;
+}
+
+#undef HANDLER
+#undef REGIMM_HANDLER
+#undef GTE_HANDLER
 
 #undef R_R0
 #undef R_A0
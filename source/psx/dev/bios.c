@@ -24,30 +24,31 @@ int psx_bios_load(psx_bios_t *bios, const char *path)
     if (!path)
         return 0;
 
-    FILE *file = NULL;
-    fopen_s(&file, path, "rb");
+    // Every instance that loads this BIOS shares the mapping
+    psx_image_t *image = psx_image_open(path);
 
-    if (!file)
+    if (!image)
         return 1;
 
+    if (image->size > PSX_BIOS_MAX_SIZE)
+    {
+        log_error("BIOS file is %zu bytes, larger than any known BIOS", image->size);
+
+        psx_image_close(image);
+
+        return 3;
+    }
+
+    psx_image_close(bios->image);
+
     // Almost all PS1 BIOS ROMs are 512 KiB in size.
     // There's (at least) one exception, and that is SCPH-5903.
     // This is a special asian model PS1 that had built-in support
     // for Video CD (VCD) playback. Its BIOS is double the normal
     // size
-    fseek(file, 0, SEEK_END);
-
-    size_t size = ftell(file);
-
-    fseek(file, 0, SEEK_SET);
-
-    bios->buf = malloc(size);
-    bios->io_size = size;
-
-    if (!fread(bios->buf, 1, size, file))
-        return 2;
-
-    fclose(file);
+    bios->image = image;
+    bios->buf = (uint8_t *)image->buf;
+    bios->io_size = image->size;
 
     return 0;
 }
@@ -84,6 +85,6 @@ void psx_bios_write8(psx_bios_t *bios, uint32_t offset, uint8_t value)
 
 void psx_bios_destroy(psx_bios_t *bios)
 {
-    free(bios->buf);
+    psx_image_close(bios->image);
     free(bios);
 }
\ No newline at end of file
@@ -37,7 +37,7 @@ void cdrom_cmd_getq(psx_cdrom_t *cdrom);
 void cdrom_cmd_readtoc(psx_cdrom_t *cdrom);
 void cdrom_cmd_videocd(psx_cdrom_t *cdrom);
 
-cdrom_cmd_func cdrom_cmd_table[] = {
+const cdrom_cmd_func cdrom_cmd_table[] = {
     (cdrom_cmd_func)0,
     cdrom_cmd_getstat,
     cdrom_cmd_setloc,
@@ -123,7 +123,26 @@ psx_cdrom_t *psx_cdrom_create(void)
     return malloc(sizeof(psx_cdrom_t));
 }
 
-void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic)
+static void cdrom_sched_update(void *udata, int cycles)
+{
+    psx_cdrom_update((psx_cdrom_t *)udata, cycles);
+}
+
+static uint64_t cdrom_sched_next(void *udata)
+{
+    psx_cdrom_t *cdrom = (psx_cdrom_t *)udata;
+
+    if ((cdrom->state == CD_STATE_IDLE) || (cdrom->state == CD_STATE_PLAY))
+        return PSX_SCHED_NEVER;
+
+    // Acknowledging the pending INT reschedules us
+    if (cdrom->ifr & 0x1f)
+        return PSX_SCHED_NEVER;
+
+    return (cdrom->delay > 0) ? (uint64_t)cdrom->delay : 1;
+}
+
+void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic, psx_sched_t *sched)
 {
     memset(cdrom, 0, sizeof(psx_cdrom_t));
 
@@ -134,6 +153,7 @@ void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic)
     cdrom->response = queue_create();
     cdrom->parameters = queue_create();
     cdrom->ic = ic;
+    cdrom->sched = sched;
 
     queue_init(cdrom->data, CD_SECTOR_SIZE);
     queue_init(cdrom->response, 32);
@@ -151,6 +171,8 @@ void psx_cdrom_init(psx_cdrom_t *cdrom, psx_ic_t *ic)
     cdrom->lba = 150;
     cdrom->seek_precision = 1;
     cdrom->fake_getlocl_data = 1;
+
+    psx_sched_register(sched, PSX_SCHED_CDROM, cdrom_sched_update, cdrom_sched_next, cdrom);
 }
 
 void psx_cdrom_reset(psx_cdrom_t *cdrom)
@@ -683,6 +705,8 @@ uint32_t psx_cdrom_read8(psx_cdrom_t *cdrom, uint32_t addr)
 
 void psx_cdrom_write8(psx_cdrom_t *cdrom, uint32_t addr, uint32_t value)
 {
+    psx_sched_sync(cdrom->sched, PSX_SCHED_CDROM);
+
     switch ((cdrom->index << 2) | addr)
     {
     case 0:
@@ -734,6 +758,77 @@ void psx_cdrom_write8(psx_cdrom_t *cdrom, uint32_t addr, uint32_t value)
         cdrom_write_vapp(cdrom, value);
         break;
     }
+
+    psx_sched_reschedule(cdrom->sched, PSX_SCHED_CDROM);
+}
+
+static void cdrom_save_queue(queue_t *queue, psx_state_t *state)
+{
+    psx_state_write(state, queue, sizeof(queue_t));
+    PSX_STATE_CLEAR(state, queue_t, buf);
+    psx_state_write(state, queue->buf, queue->size);
+}
+
+static void cdrom_load_queue(queue_t *queue, psx_state_t *state)
+{
+    uint8_t *buf = queue->buf;
+
+    psx_state_read(state, queue, sizeof(queue_t));
+
+    queue->buf = buf;
+
+    psx_state_read(state, queue->buf, queue->size);
+}
+
+void psx_cdrom_save_state(psx_cdrom_t *cdrom, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_CDROM);
+    psx_state_write(state, cdrom, sizeof(psx_cdrom_t));
+    PSX_STATE_CLEAR(state, psx_cdrom_t, disc);
+    PSX_STATE_CLEAR(state, psx_cdrom_t, ic);
+    PSX_STATE_CLEAR(state, psx_cdrom_t, sched);
+    PSX_STATE_CLEAR(state, psx_cdrom_t, data);
+    PSX_STATE_CLEAR(state, psx_cdrom_t, response);
+    PSX_STATE_CLEAR(state, psx_cdrom_t, parameters);
+
+    cdrom_save_queue(cdrom->data, state);
+    cdrom_save_queue(cdrom->response, state);
+    cdrom_save_queue(cdrom->parameters, state);
+    psx_state_end_chunk(state);
+}
+
+int psx_cdrom_load_state(psx_cdrom_t *cdrom, psx_state_t *state)
+{
+    psx_disc_t *disc = cdrom->disc;
+    psx_ic_t *ic = cdrom->ic;
+    psx_sched_t *sched = cdrom->sched;
+    queue_t *data = cdrom->data;
+    queue_t *response = cdrom->response;
+    queue_t *parameters = cdrom->parameters;
+    int disc_type = cdrom->disc_type;
+
+    size_t size = sizeof(psx_cdrom_t) + (3 * sizeof(queue_t)) +
+        data->size + response->size + parameters->size;
+
+    if (psx_state_next_chunk(state, PSX_STATE_CDROM) != (int)size)
+        return 1;
+
+    psx_state_read(state, cdrom, sizeof(psx_cdrom_t));
+
+    // The disc in the drive is whatever the frontend opened
+    cdrom->disc = disc;
+    cdrom->disc_type = disc_type;
+    cdrom->ic = ic;
+    cdrom->sched = sched;
+    cdrom->data = data;
+    cdrom->response = response;
+    cdrom->parameters = parameters;
+
+    cdrom_load_queue(cdrom->data, state);
+    cdrom_load_queue(cdrom->response, state);
+    cdrom_load_queue(cdrom->parameters, state);
+
+    return 0;
 }
 
 void psx_cdrom_destroy(psx_cdrom_t *cdrom)
@@ -244,6 +244,7 @@ cue_file_t *cue_parse_file(cue_t *cue, const char *p, const char *s)
 
     file->tracks = list_create();
     file->name = malloc(512);
+    file->image = NULL;
 
     // Append root path to track file path
     char *ptr = file->name;
@@ -377,8 +378,6 @@ size_t get_file_size(FILE *file)
 (155 - 190) + 316500 + 390    =
 */
 
-int prev_pregap = 0;
-
 uint32_t init_tracks(cue_file_t *file, uint32_t *lba)
 {
     node_t *node = list_front(file->tracks);
@@ -456,14 +455,15 @@ int cue_load(cue_t *cue, int mode)
 
         if (data->buf_mode == LD_BUFFERED)
         {
-            data->buf = malloc(data->size);
+            fclose(file);
 
-            fseek(file, 0, SEEK_SET);
+            // Shared with every other instance that has this disc open
+            data->image = psx_image_open(data->name);
 
-            if (!fread(data->buf, 1, data->size, file))
+            if (!data->image)
                 return CUE_TRACK_READ_ERROR;
 
-            fclose(file);
+            data->buf = (void *)data->image->buf;
         }
         else
         {
@@ -490,7 +490,7 @@ void cue_destroy(cue_t *cue)
 
         if (file->buf_mode == LD_BUFFERED)
         {
-            free(file->buf);
+            psx_image_close(file->image);
         }
         else
         {
@@ -85,7 +85,8 @@ int psx_disc_open_as(psx_disc_t *disc, const char *path, int type)
         if (cue_parse(cue, path))
             return CDT_ERROR;
 
-        if (cue_load(cue, LD_FILE))
+        // Track files are mapped, not read into memory
+        if (cue_load(cue, LD_BUFFERED))
             return CDT_ERROR;
     }
     break;
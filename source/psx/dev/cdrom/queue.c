@@ -82,6 +82,9 @@ int queue_max_size(queue_t *queue)
 
 void queue_destroy(queue_t *queue)
 {
+    if (!queue)
+        return;
+
     free(queue->buf);
     free(queue);
 }
\ No newline at end of file
@@ -33,7 +33,38 @@ const psx_dma_do_fn_t g_psx_dma_do_table[] = {
 
 #define CR(c, r) *((&dma->mdec_in.madr) + (c * 3) + r)
 
-void psx_dma_init(psx_dma_t *dma, psx_bus_t *bus, psx_ic_t *ic)
+static void dma_sched_update(void *udata, int cycles)
+{
+    psx_dma_update((psx_dma_t *)udata, cycles);
+}
+
+static uint64_t dma_sched_next(void *udata)
+{
+    psx_dma_t *dma = (psx_dma_t *)udata;
+
+    // Completion flags are raised on the next update
+    if (dma->cdrom_irq_delay || dma->spu_irq_delay || dma->gpu_irq_delay || dma->otc_irq_delay)
+        return 1;
+
+    // DICR writes can change the IRQ signal
+    int irq = (dma->dicr & DICR_FLAGS) != 0;
+    int irq_signal = ((dma->dicr & DICR_FORCE) != 0) || (irq && ((dma->dicr & DICR_IRQEN) != 0));
+
+    if (irq_signal != ((dma->dicr & DICR_IRQSI) != 0))
+        return 1;
+
+    uint64_t next = PSX_SCHED_NEVER;
+
+    if (dma->mdec_in_irq_delay)
+        next = dma->mdec_in_irq_delay;
+
+    if (dma->mdec_out_irq_delay && ((uint64_t)dma->mdec_out_irq_delay < next))
+        next = dma->mdec_out_irq_delay;
+
+    return next;
+}
+
+void psx_dma_init(psx_dma_t *dma, psx_bus_t *bus, psx_ic_t *ic, psx_sched_t *sched)
 {
     memset(dma, 0, sizeof(psx_dma_t));
 
@@ -42,8 +73,11 @@ void psx_dma_init(psx_dma_t *dma, psx_bus_t *bus, psx_ic_t *ic)
 
     dma->bus = bus;
     dma->ic = ic;
+    dma->sched = sched;
 
     dma->dpcr = 0x07654321;
+
+    psx_sched_register(sched, PSX_SCHED_DMA, dma_sched_update, dma_sched_next, dma);
 }
 
 uint32_t psx_dma_read32(psx_dma_t *dma, uint32_t offset)
@@ -144,6 +178,8 @@ void dma_write_dicr(psx_dma_t *dma, uint32_t value)
 
 void psx_dma_write32(psx_dma_t *dma, uint32_t offset, uint32_t value)
 {
+    psx_sched_sync(dma->sched, PSX_SCHED_DMA);
+
     if (offset < 0x70)
     {
         int channel = (offset >> 4) & 0x7;
@@ -177,10 +213,14 @@ void psx_dma_write32(psx_dma_t *dma, uint32_t offset, uint32_t value)
         break;
         }
     }
+
+    psx_sched_reschedule(dma->sched, PSX_SCHED_DMA);
 }
 
 void psx_dma_write16(psx_dma_t *dma, uint32_t offset, uint16_t value)
 {
+    psx_sched_sync(dma->sched, PSX_SCHED_DMA);
+
     switch (offset)
     {
     case 0x74:
@@ -195,10 +235,14 @@ void psx_dma_write16(psx_dma_t *dma, uint32_t offset, uint16_t value)
     }
     break;
     }
+
+    psx_sched_reschedule(dma->sched, PSX_SCHED_DMA);
 }
 
 void psx_dma_write8(psx_dma_t *dma, uint32_t offset, uint8_t value)
 {
+    psx_sched_sync(dma->sched, PSX_SCHED_DMA);
+
     switch (offset)
     {
     // DICR 8-bit???
@@ -222,6 +266,8 @@ void psx_dma_write8(psx_dma_t *dma, uint32_t offset, uint8_t value)
     }
     break;
     }
+
+    psx_sched_reschedule(dma->sched, PSX_SCHED_DMA);
 }
 
 const char *g_psx_dma_sync_type_name_table[] = {
@@ -365,7 +411,7 @@ void psx_dma_do_gpu_burst(psx_dma_t *dma)
     exit(1);
 }
 
-psx_dma_do_fn_t g_psx_dma_gpu_table[] = {
+const psx_dma_do_fn_t g_psx_dma_gpu_table[] = {
     psx_dma_do_gpu_burst,
     psx_dma_do_gpu_request,
     psx_dma_do_gpu_linked};
@@ -596,20 +642,28 @@ void psx_dma_update(psx_dma_t *dma, int cyc)
 
     if (dma->mdec_in_irq_delay)
     {
-        --dma->mdec_in_irq_delay;
+        dma->mdec_in_irq_delay -= cyc;
+
+        if (dma->mdec_in_irq_delay <= 0)
+        {
+            dma->mdec_in_irq_delay = 0;
 
-        if (!dma->mdec_in_irq_delay)
             if (dma->dicr & DICR_DMA0EN)
                 dma->dicr |= DICR_DMA0FL;
+        }
     }
 
     if (dma->mdec_out_irq_delay)
     {
-        --dma->mdec_out_irq_delay;
+        dma->mdec_out_irq_delay -= cyc;
+
+        if (dma->mdec_out_irq_delay <= 0)
+        {
+            dma->mdec_out_irq_delay = 0;
 
-        if (!dma->mdec_out_irq_delay)
             if (dma->dicr & DICR_DMA1EN)
                 dma->dicr |= DICR_DMA1FL;
+        }
     }
 
     int prev_irq_signal = (dma->dicr & DICR_IRQSI) != 0;
@@ -626,6 +680,32 @@ void psx_dma_update(psx_dma_t *dma, int cyc)
     dma->dicr |= irq_signal << 31;
 }
 
+void psx_dma_save_state(psx_dma_t *dma, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_DMA);
+    psx_state_write(state, dma, sizeof(psx_dma_t));
+    PSX_STATE_CLEAR(state, psx_dma_t, bus);
+    PSX_STATE_CLEAR(state, psx_dma_t, ic);
+    PSX_STATE_CLEAR(state, psx_dma_t, sched);
+    psx_state_end_chunk(state);
+}
+
+int psx_dma_load_state(psx_dma_t *dma, psx_state_t *state)
+{
+    psx_bus_t *bus = dma->bus;
+    psx_ic_t *ic = dma->ic;
+    psx_sched_t *sched = dma->sched;
+
+    if (psx_state_read_chunk(state, PSX_STATE_DMA, dma, sizeof(psx_dma_t)))
+        return 1;
+
+    dma->bus = bus;
+    dma->ic = ic;
+    dma->sched = sched;
+
+    return 0;
+}
+
 void psx_dma_destroy(psx_dma_t *dma)
 {
     free(dma);
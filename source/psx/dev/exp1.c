@@ -10,7 +10,8 @@ psx_exp1_t *psx_exp1_create(void)
     return (psx_exp1_t *)malloc(sizeof(psx_exp1_t));
 }
 
-int psx_exp1_init(psx_exp1_t *exp1, psx_mc1_t *mc1, const char *path)
+// rom is allocated here if NULL
+int psx_exp1_init(psx_exp1_t *exp1, psx_mc1_t *mc1, const char *path, uint8_t *rom)
 {
     memset(exp1, 0, sizeof(psx_exp1_t));
 
@@ -18,7 +19,7 @@ int psx_exp1_init(psx_exp1_t *exp1, psx_mc1_t *mc1, const char *path)
     exp1->io_size = PSX_EXP1_SIZE;
 
     exp1->mc1 = mc1;
-    exp1->rom = (uint8_t *)malloc(PSX_EXP1_SIZE);
+    exp1->rom = rom ? rom : (uint8_t *)malloc(PSX_EXP1_SIZE);
 
     memset(exp1->rom, 0xff, PSX_EXP1_SIZE);
 
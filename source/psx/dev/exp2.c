@@ -87,6 +87,32 @@ void psx_exp2_write8(psx_exp2_t *exp2, uint32_t offset, uint8_t value)
     log_warn("Unhandled 8-bit EXP2 write at offset %08x (%02x)", offset, value);
 }
 
+void psx_exp2_save_state(psx_exp2_t *exp2, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_EXP2);
+    psx_state_write(state, exp2, sizeof(psx_exp2_t));
+    PSX_STATE_CLEAR(state, psx_exp2_t, duart_udata);
+    PSX_STATE_CLEAR(state, psx_exp2_t, atcons_udata);
+    PSX_STATE_CLEAR(state, psx_exp2_t, duart_tx);
+    PSX_STATE_CLEAR(state, psx_exp2_t, atcons_tx);
+    psx_state_end_chunk(state);
+}
+
+int psx_exp2_load_state(psx_exp2_t *exp2, psx_state_t *state)
+{
+    psx_exp2_t copy = *exp2;
+
+    if (psx_state_read_chunk(state, PSX_STATE_EXP2, exp2, sizeof(psx_exp2_t)))
+        return 1;
+
+    exp2->duart_udata = copy.duart_udata;
+    exp2->atcons_udata = copy.atcons_udata;
+    exp2->duart_tx = copy.duart_tx;
+    exp2->atcons_tx = copy.atcons_tx;
+
+    return 0;
+}
+
 void psx_exp2_destroy(psx_exp2_t *exp2)
 {
     free(exp2);
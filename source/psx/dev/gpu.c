@@ -5,11 +5,14 @@
 #include <math.h>
 
 #include "psx/dev/gpu.h"
+#include "psx/dev/gpu_raster.h"
+#include "psx/dev/gpu_simd.h"
+#include "psx/dev/gpu_thread.h"
 #include "psx/log.h"
 
 #define SE10(v) ((int16_t)((v) << 5) >> 5)
 
-int g_psx_gpu_dither_kernel[] = {
+const int g_psx_gpu_dither_kernel[] = {
     -4,
     +0,
     -3,
@@ -42,6 +45,18 @@ uint16_t gpu_to_bgr555(uint32_t color)
 
 // #define BGR555(c) gpu_to_bgr555(c)
 
+// Every VRAM write goes through here so its line is marked dirty
+static inline void gpu_vram_write(psx_gpu_t *gpu, int x, int y, uint16_t color)
+{
+    psx_dirty_set(gpu->dirty, y & (PSX_GPU_FB_HEIGHT - 1));
+
+    gpu->vram[x + (y * 1024)] = color;
+}
+
+// With a worker thread the emulation thread only follows GP0 packets,
+// the worker does the drawing
+#define GPU_DRAWS(gpu) (!(gpu)->thread)
+
 int min3(int a, int b, int c)
 {
     int m = (a <= b) ? a : b;
@@ -68,22 +83,40 @@ uint32_t get_bits(uint32_t value, uint8_t start, uint8_t count)
     return (value >> start) & mask;
 }
 
+// Zeroed so psx_gpu_init can tell there are no workers to stop yet
 psx_gpu_t *psx_gpu_create(void)
 {
-    return (psx_gpu_t *)malloc(sizeof(psx_gpu_t));
+    return (psx_gpu_t *)calloc(1, sizeof(psx_gpu_t));
 }
 
-void psx_gpu_init(psx_gpu_t *gpu, psx_ic_t *ic)
+static void gpu_sched_update(void *udata, int cycles)
 {
+    psx_gpu_update((psx_gpu_t *)udata, cycles);
+}
+
+static uint64_t gpu_sched_next(void *udata);
+
+// buf holds PSX_GPU_BUF_SIZE bytes, it's allocated here if NULL
+void psx_gpu_init(psx_gpu_t *gpu, psx_ic_t *ic, psx_sched_t *sched, void *buf)
+{
+    // Workers from a previous init would keep drawing into VRAM
+    psx_gpu_release(gpu);
+
     memset(gpu, 0, sizeof(psx_gpu_t));
 
     gpu->io_base = PSX_GPU_BEGIN;
     gpu->io_size = PSX_GPU_SIZE;
 
-    gpu->vram = (uint16_t *)malloc(PSX_GPU_VRAM_SIZE);
-    gpu->empty = malloc(PSX_GPU_VRAM_SIZE);
+    if (!buf)
+        buf = malloc(PSX_GPU_BUF_SIZE);
+
+    gpu->vram = (uint16_t *)buf;
+    gpu->empty = gpu->vram + (PSX_GPU_VRAM_SIZE >> 1);
 
     memset(gpu->empty, 0, PSX_GPU_VRAM_SIZE);
+    memset(gpu->dirty, 0xff, sizeof(gpu->dirty));
+
+    psx_gpu_set_simd(gpu, 1);
 
     gpu->state = GPU_STATE_RECV_CMD;
 
@@ -93,6 +126,8 @@ void psx_gpu_init(psx_gpu_t *gpu, psx_ic_t *ic)
     gpu->display_mode = 1;
 
     gpu->ic = ic;
+
+    psx_sched_register(sched, PSX_SCHED_GPU, gpu_sched_update, gpu_sched_next, gpu);
 }
 
 uint32_t psx_gpu_read32(psx_gpu_t *gpu, uint32_t offset)
@@ -105,6 +140,8 @@ uint32_t psx_gpu_read32(psx_gpu_t *gpu, uint32_t offset)
 
         if (gpu->c0_tsiz)
         {
+            psx_gpu_sync(gpu);
+
             data |= gpu->vram[gpu->c0_addr + (gpu->c0_xcnt + (gpu->c0_ycnt * 1024))];
 
             gpu->c0_xcnt += 1;
@@ -247,7 +284,15 @@ int max(int x0, int x1)
 
 #define EDGE(a, b, c) ((b.x - a.x) * (c.y - a.y) - (b.y - a.y) * (c.x - a.x))
 
-uint16_t gpu_fetch_texel(psx_gpu_t *gpu, uint16_t tx, uint16_t ty, uint32_t tpx, uint32_t tpy, uint16_t clutx, uint16_t cluty, int depth)
+// Span kernels and texel fetches are specialized by inlining these
+// with constant attributes
+#ifdef __GNUC__
+#define GPU_INLINE static inline __attribute__((always_inline))
+#else
+#define GPU_INLINE static inline
+#endif
+
+GPU_INLINE uint16_t gpu_sample_texel(psx_gpu_t *gpu, uint16_t tx, uint16_t ty, uint32_t tpx, uint32_t tpy, uint16_t clutx, uint16_t cluty, int depth)
 {
     tx = (tx & ~gpu->texw_mx) | (gpu->texw_ox & gpu->texw_mx);
     ty = (ty & ~gpu->texw_my) | (gpu->texw_oy & gpu->texw_my);
@@ -287,72 +332,384 @@ uint16_t gpu_fetch_texel(psx_gpu_t *gpu, uint16_t tx, uint16_t ty, uint32_t tpx,
     }
 }
 
-uint16_t gpu_fetch_texel_bilinear(psx_gpu_t *gpu, float tx, float ty, uint32_t tpx, uint32_t tpy, uint16_t clutx, uint16_t cluty, int depth)
+uint16_t gpu_fetch_texel(psx_gpu_t *gpu, uint16_t tx, uint16_t ty, uint32_t tpx, uint32_t tpy, uint16_t clutx, uint16_t cluty, int depth)
 {
-    float txf = floorf(tx);
-    float tyf = floorf(ty);
-    float txc = txf + 1.0f;
-    float tyc = tyf + 1.0f;
+    return gpu_sample_texel(gpu, tx, ty, tpx, tpy, clutx, cluty, depth);
+}
 
-    int s0 = gpu_fetch_texel(gpu, (int)txf, (int)tyf, tpx, tpy, clutx, cluty, depth);
+#define GPU_FRAC_HALF (1 << (PSX_GPU_FRAC_BITS - 1))
 
-    if (!s0)
-        return 0;
+typedef struct
+{
+    int32_t dx, dy;
 
-    int s1 = gpu_fetch_texel(gpu, (int)txc, (int)tyf, tpx, tpy, clutx, cluty, depth);
-    int s2 = gpu_fetch_texel(gpu, (int)txf, (int)tyc, tpx, tpy, clutx, cluty, depth);
-    int s3 = gpu_fetch_texel(gpu, (int)txc, (int)tyc, tpx, tpy, clutx, cluty, depth);
-
-    float s0r = (s0 >> 0) & 0x1f;
-    float s0g = (s0 >> 5) & 0x1f;
-    float s0b = (s0 >> 10) & 0x1f;
-    float s1r = (s1 >> 0) & 0x1f;
-    float s1g = (s1 >> 5) & 0x1f;
-    float s1b = (s1 >> 10) & 0x1f;
-    float s2r = (s2 >> 0) & 0x1f;
-    float s2g = (s2 >> 5) & 0x1f;
-    float s2b = (s2 >> 10) & 0x1f;
-    float s3r = (s3 >> 0) & 0x1f;
-    float s3g = (s3 >> 5) & 0x1f;
-    float s3b = (s3 >> 10) & 0x1f;
-
-    float q1r = s0r * (txc - tx) + s1r * (tx - txf);
-    float q1g = s0g * (txc - tx) + s1g * (tx - txf);
-    float q1b = s0b * (txc - tx) + s1b * (tx - txf);
-    float q2r = s2r * (txc - tx) + s3r * (tx - txf);
-    float q2g = s2g * (txc - tx) + s3g * (tx - txf);
-    float q2b = s2b * (txc - tx) + s3b * (tx - txf);
-    int qr = q1r * (tyc - ty) + q2r * (ty - tyf);
-    int qg = q1g * (tyc - ty) + q2g * (ty - tyf);
-    int qb = q1b * (tyc - ty) + q2b * (ty - tyf);
-
-    return qr | (qg << 5) | (qb << 10) | (s0 & 0x8000) | (s1 & 0x8000) | (s2 & 0x8000) | (s3 & 0x8000);
-}
-
-#define TL(z, a, b) \
-    ((z < 0) || ((z == 0) && ((b.y > a.y) || ((b.y == a.y) && (b.x < a.x)))))
+    // E + 1 on edges whose pixels are drawn when E is 0, so a pixel
+    // is covered when this is positive
+    int32_t row;
+} gpu_edge_t;
 
-void gpu_render_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vertex_t v2, poly_data_t data, int edge)
+typedef struct
 {
-    vertex_t a, b, c, p;
+    int64_t dx, dy;
+    int64_t base;
+} gpu_gradient_t;
 
-    int tpx = (data.texp & 0xf) << 6;
-    int tpy = (data.texp & 0x10) << 4;
-    int clutx = (data.clut & 0x3f) << 4;
-    int cluty = (data.clut >> 6) & 0x1ff;
-    int depth = (data.texp >> 7) & 3;
-    int transp = (data.attrib & PA_TRANSP) != 0;
-    int transp_mode;
+// Edge function of p -> q, evaluated at (x, y)
+static inline void gpu_setup_edge(gpu_edge_t *e, vertex_t p, vertex_t q, int x, int y)
+{
+    e->dx = p.y - q.y;
+    e->dy = q.x - p.x;
+    e->row = (e->dx * (x - p.x)) + (e->dy * (y - p.y));
+
+    // Top-left rule, pixels exactly on other edges are left to the
+    // neighbouring triangle
+    if (!((q.y > p.y) || ((q.y == p.y) && (q.x < p.x))))
+        e->row += 1;
+}
 
-    if (data.attrib & PA_TEXTURED)
+// Narrows [*x0, *x1] to the pixels of the row inside the edge
+static inline void gpu_clip_span(const gpu_edge_t *e, int xmin, int *x0, int *x1)
+{
+    int32_t r = e->row;
+
+    if (e->dx > 0)
     {
-        transp_mode = (data.texp >> 5) & 3;
+        // r + dx * t > 0
+        if (r <= 0)
+        {
+            int t = (-r / e->dx) + 1;
+
+            if (*x0 < (xmin + t))
+                *x0 = xmin + t;
+        }
     }
-    else
+    else if (e->dx < 0)
+    {
+        // r - |dx| * t > 0
+        if (r <= 0)
+        {
+            *x1 = *x0 - 1;
+
+            return;
+        }
+
+        int t = (r - 1) / -e->dx;
+
+        if (*x1 > (xmin + t))
+            *x1 = xmin + t;
+    }
+    else if (r <= 0)
+    {
+        *x1 = *x0 - 1;
+    }
+}
+
+// Plane through the attribute at each vertex, base is the value at a
+// with the rounding bias added
+static inline void gpu_setup_gradient(gpu_gradient_t *g, vertex_t a, vertex_t b, vertex_t c, int ka, int kb, int kc, int64_t area)
+{
+    int64_t d1 = kb - ka;
+    int64_t d2 = kc - ka;
+
+    g->dx = ((d1 * (c.y - a.y)) - (d2 * (b.y - a.y))) * (1 << PSX_GPU_FRAC_BITS) / area;
+    g->dy = ((d2 * (b.x - a.x)) - (d1 * (c.x - a.x))) * (1 << PSX_GPU_FRAC_BITS) / area;
+    g->base = ((int64_t)ka * (1 << PSX_GPU_FRAC_BITS)) + GPU_FRAC_HALF;
+}
+
+static inline int64_t gpu_gradient_at(const gpu_gradient_t *g, vertex_t a, int x, int y)
+{
+    return g->base + (g->dx * (x - a.x)) + (g->dy * (y - a.y));
+}
+
+// RA_TEXTURED and RA_TRANSP match their PA_* flags
+static inline void gpu_init_span(psx_gpu_t *gpu, psx_gpu_span_t *span, int attrib, uint32_t color)
+{
+    memset(span, 0, sizeof(psx_gpu_span_t));
+
+    span->color = color;
+    span->attrib = attrib;
+    span->transp_mode = get_bits(gpu->gpustat, 6, 2);
+    span->set_mask = gpu->set_mask ? 0x8000 : 0;
+    span->check_mask = gpu->check_mask ? 0x8000 : 0;
+}
+
+static inline int gpu_clamp8(int c)
+{
+    return (c >= 255) ? 255 : ((c <= 0) ? 0 : c);
+}
+
+// Texel channel times the colour over 128, rounded and saturated
+static inline uint16_t gpu_modulate(uint16_t texel, int r, int g, int b)
+{
+    int mr = gpu_clamp8(((((texel >> 0) & 0x1f) << 3) * r + 64) >> 7);
+    int mg = gpu_clamp8(((((texel >> 5) & 0x1f) << 3) * g + 64) >> 7);
+    int mb = gpu_clamp8(((((texel >> 10) & 0x1f) << 3) * b + 64) >> 7);
+
+    return (mr >> 3) | ((mg >> 3) << 5) | ((mb >> 3) << 10);
+}
+
+static inline int gpu_blend5(int b, int f, int mode)
+{
+    switch (mode)
+    {
+    case 0:
+        return (b + f) >> 1;
+    case 1:
+        return ((b + f) >= 31) ? 31 : (b + f);
+    case 2:
+        return ((b - f) <= 0) ? 0 : (b - f);
+    }
+
+    return ((b + (f >> 2)) >= 31) ? 31 : (b + (f >> 2));
+}
+
+// Semi-transparency works on the 5-bit channels, bit 15 is dropped
+static inline uint16_t gpu_blend(uint16_t back, uint16_t front, int mode)
+{
+    int r = gpu_blend5((back >> 0) & 0x1f, (front >> 0) & 0x1f, mode);
+    int g = gpu_blend5((back >> 5) & 0x1f, (front >> 5) & 0x1f, mode);
+    int b = gpu_blend5((back >> 10) & 0x1f, (front >> 10) & 0x1f, mode);
+
+    return r | (g << 5) | (b << 10);
+}
+
+GPU_INLINE void gpu_shade_span(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span, int attrib, int mode)
+{
+    // Unsigned so stepping past the last pixel can't overflow
+    uint32_t r = (uint32_t)span->r;
+    uint32_t g = (uint32_t)span->g;
+    uint32_t b = (uint32_t)span->b;
+
+    for (int i = 0; i < count; i++, r += span->dr, g += span->dg, b += span->db)
+    {
+        uint16_t back = dst[i];
+
+        if (back & span->check_mask)
+            continue;
+
+        int cr = (span->color >> 0) & 0xff;
+        int cg = (span->color >> 8) & 0xff;
+        int cb = (span->color >> 16) & 0xff;
+
+        if (attrib & PA_SHADED)
+        {
+            int dither = span->dither[i & 3];
+
+            cr = gpu_clamp8(((int32_t)r >> PSX_GPU_FRAC_BITS) + dither);
+            cg = gpu_clamp8(((int32_t)g >> PSX_GPU_FRAC_BITS) + dither);
+            cb = gpu_clamp8(((int32_t)b >> PSX_GPU_FRAC_BITS) + dither);
+        }
+
+        int transp = (attrib & PA_TRANSP) != 0;
+        uint16_t color;
+
+        if (attrib & PA_TEXTURED)
+        {
+            uint16_t texel = texels[i];
+
+            if (!texel)
+                continue;
+
+            if (attrib & PA_TRANSP)
+                transp = (texel & 0x8000) != 0;
+
+            color = (attrib & PA_RAW) ? texel : gpu_modulate(texel, cr, cg, cb);
+        }
+        else
+        {
+            color = (cr >> 3) | ((cg >> 3) << 5) | ((cb >> 3) << 10);
+        }
+
+        if (transp)
+            color = gpu_blend(back, color, mode);
+
+        dst[i] = color | span->set_mask;
+    }
+}
+
+void psx_gpu_shade_span(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span)
+{
+    gpu_shade_span(dst, texels, count, span, span->attrib, span->transp_mode);
+}
+
+#define GPU_SPAN_KERNEL(index)                                                                                       \
+    static void gpu_shade_span_##index(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span) \
+    {                                                                                                                \
+        gpu_shade_span(dst, texels, count, span, PSX_GPU_SPAN_ATTRIB(index), PSX_GPU_SPAN_MODE(index));              \
+    }
+
+PSX_GPU_SPAN_LIST(GPU_SPAN_KERNEL)
+
+#define GPU_SPAN_ENTRY(index) gpu_shade_span_##index,
+
+const psx_gpu_span_fn_t g_psx_gpu_span_kernels[PSX_GPU_SPAN_KERNELS] = {PSX_GPU_SPAN_LIST(GPU_SPAN_ENTRY)};
+
+typedef struct gpu_texture_t gpu_texture_t;
+
+// Fetches count texels of a span, specialized per texture depth
+typedef void (*gpu_fetch_span_fn_t)(psx_gpu_t *, const gpu_texture_t *, uint16_t *texels, int count);
+
+struct gpu_texture_t
+{
+    // 12-bit fixed-point coordinates of the first pixel, and the step
+    uint32_t u, v;
+    uint32_t du, dv;
+
+    int tpx, tpy;
+    int clutx, cluty;
+    int depth;
+
+    gpu_fetch_span_fn_t fetch;
+};
+
+static inline int gpu_overlaps(int start, int end, int lo, int hi)
+{
+    return (start < hi) && (end > lo);
+}
+
+// Whether any texel or CLUT entry the span could sample lies in the
+// pixels it writes, fetches run past the end of a VRAM line
+static int gpu_span_samples_itself(const gpu_texture_t *tex, int x, int y, int count)
+{
+    static const int widths[] = {64, 128, 256, 256};
+
+    int lo = x + (y * 1024);
+    int hi = lo + count;
+    int width = widths[tex->depth & 3];
+
+    for (int ty = y - tex->tpy - 1; ty <= (y - tex->tpy); ty++)
+    {
+        if ((ty < 0) || (ty > 255))
+            continue;
+
+        int start = tex->tpx + ((tex->tpy + ty) * 1024);
+
+        if (gpu_overlaps(start, start + width, lo, hi))
+            return 1;
+    }
+
+    if (tex->depth < 2)
     {
-        transp_mode = get_bits(gpu->gpustat, 6, 2);
+        int start = tex->clutx + (tex->cluty * 1024);
+
+        if (gpu_overlaps(start, start + (tex->depth ? 256 : 16), lo, hi))
+            return 1;
+    }
+
+    return 0;
+}
+
+// Triangles sample the nearest texel, like the hardware. Up to the
+// fixed-point rasterizer they were filtered between four texels, so
+// textured polygons look sharper than they used to
+GPU_INLINE uint16_t gpu_fetch_span_texel(psx_gpu_t *gpu, const gpu_texture_t *tex, int i, int depth)
+{
+    int32_t u = (int32_t)(tex->u + (tex->du * (uint32_t)i));
+    int32_t v = (int32_t)(tex->v + (tex->dv * (uint32_t)i));
+
+    return gpu_sample_texel(gpu, u >> PSX_GPU_FRAC_BITS, v >> PSX_GPU_FRAC_BITS, tex->tpx, tex->tpy, tex->clutx, tex->cluty, depth);
+}
+
+#define GPU_FETCH_SPAN(depth)                                                                                 \
+    static void gpu_fetch_span_##depth(psx_gpu_t *gpu, const gpu_texture_t *tex, uint16_t *texels, int count) \
+    {                                                                                                         \
+        for (int i = 0; i < count; i++)                                                                       \
+            texels[i] = gpu_fetch_span_texel(gpu, tex, i, depth);                                             \
+    }
+
+GPU_FETCH_SPAN(0)
+GPU_FETCH_SPAN(1)
+GPU_FETCH_SPAN(2)
+
+// Depth 3 is reserved, it samples like 15-bit
+static const gpu_fetch_span_fn_t g_gpu_fetch_span[] = {
+    gpu_fetch_span_0,
+    gpu_fetch_span_1,
+    gpu_fetch_span_2,
+    gpu_fetch_span_2};
+
+// Fetches the texels of a span and shades it with the kernel picked
+// for the primitive
+static void gpu_draw_span(psx_gpu_t *gpu, int x, int y, int count, const psx_gpu_span_t *span, const gpu_texture_t *tex, psx_gpu_span_fn_t shade)
+{
+    uint16_t texels[PSX_GPU_FB_WIDTH];
+    uint16_t *dst = &gpu->vram[x + (y * 1024)];
+
+    psx_dirty_set(gpu->dirty, y);
+
+    if (!(span->attrib & PA_TEXTURED))
+    {
+        shade(dst, NULL, count, span);
+
+        return;
     }
 
+    // Later texels could be pixels this span draws first, go one
+    // pixel at a time
+    if (gpu_span_samples_itself(tex, x, y, count))
+    {
+        psx_gpu_span_t pixel = *span;
+
+        for (int i = 0; i < count; i++)
+        {
+            texels[0] = gpu_fetch_span_texel(gpu, tex, i, tex->depth);
+
+            psx_gpu_shade_span(dst + i, texels, 1, &pixel);
+
+            pixel.r = (int32_t)((uint32_t)pixel.r + (uint32_t)pixel.dr);
+            pixel.g = (int32_t)((uint32_t)pixel.g + (uint32_t)pixel.dg);
+            pixel.b = (int32_t)((uint32_t)pixel.b + (uint32_t)pixel.db);
+            pixel.dither[0] = span->dither[(i + 1) & 3];
+        }
+
+        return;
+    }
+
+    tex->fetch(gpu, tex, texels, count);
+
+    shade(dst, texels, count, span);
+}
+
+// A triangle set up for drawing, its lines can be drawn in any order
+typedef struct
+{
+    vertex_t a;
+    int xmin, ymin;
+
+    // Bounding box clipped to the drawing area
+    int x0, x1, y0, y1;
+
+    int attrib;
+
+    // Edges evaluated at (x0, y0)
+    gpu_edge_t e0, e1, e2;
+    gpu_gradient_t gr, gg, gb, gu, gv;
+
+    psx_gpu_span_t span;
+    gpu_texture_t tex;
+    psx_gpu_span_fn_t shade;
+} gpu_triangle_t;
+
+// Returns 0 if the triangle covers no pixels
+static int gpu_setup_triangle(psx_gpu_t *gpu, gpu_triangle_t *t, vertex_t v0, vertex_t v1, vertex_t v2, poly_data_t data)
+{
+    vertex_t a, b, c;
+
+    t->tex.tpx = (data.texp & 0xf) << 6;
+    t->tex.tpy = (data.texp & 0x10) << 4;
+    t->tex.clutx = (data.clut & 0x3f) << 4;
+    t->tex.cluty = (data.clut >> 6) & 0x1ff;
+    t->tex.depth = (data.texp >> 7) & 3;
+    t->tex.fetch = g_gpu_fetch_span[t->tex.depth];
+
+    gpu_init_span(gpu, &t->span, data.attrib, data.v[0].c);
+
+    if (data.attrib & PA_TEXTURED)
+        t->span.transp_mode = (data.texp >> 5) & 3;
+
+    t->shade = gpu->shade_span[PSX_GPU_SPAN_INDEX(t->span.attrib, t->span.transp_mode)];
+    t->attrib = data.attrib;
+
     a = v0;
 
     /* Ensure the winding order is correct */
@@ -380,372 +737,510 @@ void gpu_render_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vertex_t v2,
     int ymax = max3(a.y, b.y, c.y);
 
     if (((xmax - xmin) > 2048) || ((ymax - ymin) > 1024))
-        return;
+        return 0;
 
-    float area = EDGE(a, b, c);
+    int64_t area = EDGE(a, b, c);
 
-    for (int y = ymin; y < ymax; y++)
+    // Degenerate triangles cover nothing
+    if (!area)
+        return 0;
+
+    // Bounding box, which excludes its right and bottom edges, clipped
+    // to the drawing area
+    t->x0 = (xmin > (int)gpu->draw_x1) ? xmin : (int)gpu->draw_x1;
+    t->x1 = ((xmax - 1) < (int)gpu->draw_x2) ? (xmax - 1) : (int)gpu->draw_x2;
+    t->y0 = (ymin > (int)gpu->draw_y1) ? ymin : (int)gpu->draw_y1;
+    t->y1 = ((ymax - 1) < (int)gpu->draw_y2) ? (ymax - 1) : (int)gpu->draw_y2;
+
+    if ((t->x0 > t->x1) || (t->y0 > t->y1))
+        return 0;
+
+    t->a = a;
+    t->xmin = xmin;
+    t->ymin = ymin;
+
+    gpu_setup_edge(&t->e0, b, c, t->x0, t->y0);
+    gpu_setup_edge(&t->e1, c, a, t->x0, t->y0);
+    gpu_setup_edge(&t->e2, a, b, t->x0, t->y0);
+
+    if (data.attrib & PA_SHADED)
     {
-        for (int x = xmin; x < xmax; x++)
+        gpu_setup_gradient(&t->gr, a, b, c, (a.c >> 0) & 0xff, (b.c >> 0) & 0xff, (c.c >> 0) & 0xff, area);
+        gpu_setup_gradient(&t->gg, a, b, c, (a.c >> 8) & 0xff, (b.c >> 8) & 0xff, (c.c >> 8) & 0xff, area);
+        gpu_setup_gradient(&t->gb, a, b, c, (a.c >> 16) & 0xff, (b.c >> 16) & 0xff, (c.c >> 16) & 0xff, area);
+
+        t->span.dr = (int32_t)t->gr.dx;
+        t->span.dg = (int32_t)t->gg.dx;
+        t->span.db = (int32_t)t->gb.dx;
+    }
+
+    if (data.attrib & PA_TEXTURED)
+    {
+        gpu_setup_gradient(&t->gu, a, b, c, a.tx, b.tx, c.tx, area);
+        gpu_setup_gradient(&t->gv, a, b, c, a.ty, b.ty, c.ty, area);
+
+        t->tex.du = (uint32_t)t->gu.dx;
+        t->tex.dv = (uint32_t)t->gv.dx;
+    }
+
+    return 1;
+}
+
+// Draws the lines of the triangle in [ys, ye]
+static void gpu_raster_triangle(psx_gpu_t *gpu, const gpu_triangle_t *t, int ys, int ye)
+{
+    psx_gpu_span_t span = t->span;
+    gpu_texture_t tex = t->tex;
+
+    int y0 = (ys > t->y0) ? ys : t->y0;
+    int y1 = (ye < t->y1) ? ye : t->y1;
+
+    // Edges stepped down to the first line
+    gpu_edge_t e0 = t->e0;
+    gpu_edge_t e1 = t->e1;
+    gpu_edge_t e2 = t->e2;
+
+    e0.row += e0.dy * (y0 - t->y0);
+    e1.row += e1.dy * (y0 - t->y0);
+    e2.row += e2.dy * (y0 - t->y0);
+
+    for (int y = y0; y <= y1; y++)
+    {
+        int xs = t->x0;
+        int xe = t->x1;
+
+        gpu_clip_span(&e0, t->x0, &xs, &xe);
+        gpu_clip_span(&e1, t->x0, &xs, &xe);
+        gpu_clip_span(&e2, t->x0, &xs, &xe);
+
+        e0.row += e0.dy;
+        e1.row += e1.dy;
+        e2.row += e2.dy;
+
+        if (xs > xe)
+            continue;
+
+        if (t->attrib & PA_SHADED)
         {
-            int bc = (x >= gpu->draw_x1) && (x <= gpu->draw_x2) &&
-                     (y >= gpu->draw_y1) && (y <= gpu->draw_y2);
+            span.r = (int32_t)gpu_gradient_at(&t->gr, t->a, xs, y);
+            span.g = (int32_t)gpu_gradient_at(&t->gg, t->a, xs, y);
+            span.b = (int32_t)gpu_gradient_at(&t->gb, t->a, xs, y);
 
-            if (!bc)
-                continue;
+            for (int i = 0; i < 4; i++)
+                span.dither[i] = g_psx_gpu_dither_kernel[((xs + i - t->xmin) & 3) + (((y - t->ymin) & 3) * 4)];
+        }
 
-            p.x = x;
-            p.y = y;
+        // Stays in range over the covered pixels
+        if (t->attrib & PA_TEXTURED)
+        {
+            tex.u = (uint32_t)gpu_gradient_at(&t->gu, t->a, xs, y);
+            tex.v = (uint32_t)gpu_gradient_at(&t->gv, t->a, xs, y);
+        }
 
-            float z0 = EDGE(b, c, p);
+        gpu_draw_span(gpu, xs, y, (xe - xs) + 1, &span, &tex, t->shade);
+    }
+}
 
-            if (TL(z0, b, c))
-                continue;
+#define CLAMP(v, d, u) ((v) <= (d)) ? (d) : (((v) >= (u)) ? (u) : (v))
 
-            float z1 = EDGE(c, a, p);
+// A rectangle set up for drawing
+typedef struct
+{
+    vertex_t v0;
 
-            if (TL(z1, c, a))
-                continue;
+    // Clipped to the drawing area
+    int x0, x1, y0, y1;
 
-            float z2 = EDGE(a, b, p);
+    psx_gpu_span_t span;
+    gpu_texture_t tex;
+    psx_gpu_span_fn_t shade;
+} gpu_rect_t;
 
-            if (TL(z2, a, b))
-                continue;
+// Returns 0 if the rectangle covers no pixels
+static int gpu_setup_rect(psx_gpu_t *gpu, gpu_rect_t *r, rect_data_t data)
+{
+    if ((data.v0.x >= 1024) || (data.v0.y >= 512))
+        return 0;
 
-            uint16_t color = 0;
-            uint32_t mod = 0;
+    if ((data.v0.x <= -1024) || (data.v0.y <= -512))
+        return 0;
 
-            if (data.attrib & PA_SHADED)
-            {
-                float cr = (z0 * ((a.c >> 0) & 0xff) + z1 * ((b.c >> 0) & 0xff) + z2 * ((c.c >> 0) & 0xff)) / area;
-                float cg = (z0 * ((a.c >> 8) & 0xff) + z1 * ((b.c >> 8) & 0xff) + z2 * ((c.c >> 8) & 0xff)) / area;
-                float cb = (z0 * ((a.c >> 16) & 0xff) + z1 * ((b.c >> 16) & 0xff) + z2 * ((c.c >> 16) & 0xff)) / area;
+    uint16_t width, height;
 
-                int dy = (y - ymin) & 3;
-                int dx = (x - xmin) & 3;
+    switch ((data.attrib >> 3) & 3)
+    {
+    case RS_VARIABLE:
+    {
+        width = data.width;
+        height = data.height;
+    }
+    break;
+    case RS_1X1:
+    {
+        width = 1;
+        height = 1;
+    }
+    break;
+    case RS_8X8:
+    {
+        width = 8;
+        height = 8;
+    }
+    break;
+    case RS_16X16:
+    {
+        width = 16;
+        height = 16;
+    }
+    break;
+    }
 
-                int dither = g_psx_gpu_dither_kernel[dx + (dy * 4)];
+    // Rectangles always modulate their texels
+    gpu_init_span(gpu, &r->span, data.attrib & (RA_TEXTURED | RA_TRANSP), data.v0.c);
 
-                cr += dither;
-                cg += dither;
-                cb += dither;
+    r->tex.du = 1 << PSX_GPU_FRAC_BITS;
+    r->tex.dv = 0;
+    r->tex.tpx = gpu->texp_x;
+    r->tex.tpy = gpu->texp_y;
+    r->tex.clutx = (data.clut & 0x3f) << 4;
+    r->tex.cluty = (data.clut >> 6) & 0x1ff;
+    r->tex.depth = gpu->texp_d;
+    r->tex.fetch = g_gpu_fetch_span[r->tex.depth];
 
-                // Saturate (clamp) to 00-ff
-                cr = (cr >= 255.0f) ? 255.0f : ((cr <= 0.0f) ? 0.0f : cr);
-                cg = (cg >= 255.0f) ? 255.0f : ((cg <= 0.0f) ? 0.0f : cg);
-                cb = (cb >= 255.0f) ? 255.0f : ((cb <= 0.0f) ? 0.0f : cb);
+    r->shade = gpu->shade_span[PSX_GPU_SPAN_INDEX(r->span.attrib, r->span.transp_mode)];
 
-                unsigned int ucr = roundf(cr);
-                unsigned int ucg = roundf(cg);
-                unsigned int ucb = roundf(cb);
+    /* Offset coordinates */
+    data.v0.x += gpu->off_x;
+    data.v0.y += gpu->off_y;
 
-                uint32_t rgb = (ucb << 16) | (ucg << 8) | ucr;
+    /* Calculate bounding box */
+    int xmax = data.v0.x + width;
+    int ymax = data.v0.y + height;
 
-                mod = rgb;
-            }
-            else
-            {
-                mod = data.v[0].c;
-            }
+    xmax = CLAMP(xmax, -1024, 1024);
+    ymax = CLAMP(ymax, -1024, 1024);
+    data.v0.x = CLAMP(data.v0.x, -1024, 1024);
+    data.v0.y = CLAMP(data.v0.y, -1024, 1024);
 
-            if (data.attrib & PA_TEXTURED)
-            {
-                float tx = ((z0 * a.tx) + (z1 * b.tx) + (z2 * c.tx)) / area;
-                float ty = ((z0 * a.ty) + (z1 * b.ty) + (z2 * c.ty)) / area;
+    // Clip to the drawing area
+    r->x0 = (data.v0.x > (int)gpu->draw_x1) ? data.v0.x : (int)gpu->draw_x1;
+    r->x1 = ((xmax - 1) < (int)gpu->draw_x2) ? (xmax - 1) : (int)gpu->draw_x2;
+    r->y0 = (data.v0.y > (int)gpu->draw_y1) ? data.v0.y : (int)gpu->draw_y1;
+    r->y1 = ((ymax - 1) < (int)gpu->draw_y2) ? (ymax - 1) : (int)gpu->draw_y2;
 
-                uint16_t texel = gpu_fetch_texel_bilinear(gpu, tx, ty, tpx, tpy, clutx, cluty, depth);
+    r->v0 = data.v0;
 
-                if (!texel)
-                    continue;
+    return (r->x0 <= r->x1) && (r->y0 <= r->y1);
+}
 
-                if (data.attrib & PA_TRANSP)
-                    transp = (texel & 0x8000) != 0;
+// Draws the lines of the rectangle in [ys, ye]
+static void gpu_raster_rect(psx_gpu_t *gpu, const gpu_rect_t *r, int ys, int ye)
+{
+    gpu_texture_t tex = r->tex;
 
-                if (data.attrib & PA_RAW)
-                {
-                    color = texel;
-                }
-                else
-                {
-                    float tr = ((texel >> 0) & 0x1f) << 3;
-                    float tg = ((texel >> 5) & 0x1f) << 3;
-                    float tb = ((texel >> 10) & 0x1f) << 3;
+    int y0 = (ys > r->y0) ? ys : r->y0;
+    int y1 = (ye < r->y1) ? ye : r->y1;
 
-                    float mr = (mod >> 0) & 0xff;
-                    float mg = (mod >> 8) & 0xff;
-                    float mb = (mod >> 16) & 0xff;
+    for (int y = y0; y <= y1; y++)
+    {
+        tex.u = (uint32_t)(r->v0.tx + (r->x0 - r->v0.x)) << PSX_GPU_FRAC_BITS;
+        tex.v = (uint32_t)(r->v0.ty + (y - r->v0.y)) << PSX_GPU_FRAC_BITS;
 
-                    float cr = (tr * mr) / 128.0f;
-                    float cg = (tg * mg) / 128.0f;
-                    float cb = (tb * mb) / 128.0f;
+        gpu_draw_span(gpu, r->x0, y, (r->x1 - r->x0) + 1, &r->span, &tex, r->shade);
+    }
+}
 
-                    cr = (cr >= 255.0f) ? 255.0f : ((cr <= 0.0f) ? 0.0f : cr);
-                    cg = (cg >= 255.0f) ? 255.0f : ((cg <= 0.0f) ? 0.0f : cg);
-                    cb = (cb >= 255.0f) ? 255.0f : ((cb <= 0.0f) ? 0.0f : cb);
+/*
+    With raster threads, triangles and rectangles are set up as they
+    arrive but drawn later, in batches. A batch is split into bands of
+    VRAM lines and every band draws the whole batch in order, clipped
+    to its lines, so each pixel sees the primitives in the same order
+    as when drawing them one at a time.
+
+    A primitive sampling pixels that earlier primitives in the batch
+    draw, or drawing pixels they sample, flushes the batch first. One
+    sampling its own pixels is drawn alone. Everything else touching
+    VRAM, and texture window changes, flush the batch before they run.
+*/
 
-                    unsigned int ucr = roundf(cr);
-                    unsigned int ucg = roundf(cg);
-                    unsigned int ucb = roundf(cb);
+// Primitives per batch
+#define GPU_BATCH_SIZE 1024
 
-                    uint32_t rgb = ucr | (ucg << 8) | (ucb << 16);
+// Batched writes are tracked in tiles of 32x32 pixels
+#define GPU_TILE_SHIFT 5
+#define GPU_TILES_X (PSX_GPU_FB_WIDTH >> GPU_TILE_SHIFT)
+#define GPU_TILES_Y (PSX_GPU_FB_HEIGHT >> GPU_TILE_SHIFT)
 
-                    color = BGR555(rgb);
-                }
-            }
-            else
-            {
-                color = BGR555(mod);
-            }
+// More bands than threads evens out the load between them
+#define GPU_BANDS_PER_THREAD 4
 
-            float cr = ((color >> 0) & 0x1f) << 3;
-            float cg = ((color >> 5) & 0x1f) << 3;
-            float cb = ((color >> 10) & 0x1f) << 3;
+// Smaller batches aren't worth waking the other threads for
+#define GPU_BATCH_MIN_PIXELS 16384
 
-            if (transp)
-            {
-                uint16_t back = gpu->vram[x + (y * 1024)];
+enum
+{
+    GPU_JOB_TRIANGLE,
+    GPU_JOB_RECT
+};
 
-                float br = ((back >> 0) & 0x1f) << 3;
-                float bg = ((back >> 5) & 0x1f) << 3;
-                float bb = ((back >> 10) & 0x1f) << 3;
+typedef struct
+{
+    int type;
+    int y0, y1;
 
-                // Do we use transp or gpustat here?
-                switch (transp_mode)
-                {
-                case 0:
-                {
-                    cr = (0.5f * br) + (0.5f * cr);
-                    cg = (0.5f * bg) + (0.5f * cg);
-                    cb = (0.5f * bb) + (0.5f * cb);
-                }
-                break;
-                case 1:
-                {
-                    cr = br + cr;
-                    cg = bg + cg;
-                    cb = bb + cb;
-                }
-                break;
-                case 2:
-                {
-                    cr = br - cr;
-                    cg = bg - cg;
-                    cb = bb - cb;
-                }
-                break;
-                case 3:
-                {
-                    cr = br + (0.25 * cr);
-                    cg = bg + (0.25 * cg);
-                    cb = bb + (0.25 * cb);
-                }
-                break;
-                }
+    union
+    {
+        gpu_triangle_t triangle;
+        gpu_rect_t rect;
+    };
+} gpu_job_t;
+
+struct psx_gpu_batch_t
+{
+    gpu_job_t jobs[GPU_BATCH_SIZE];
+    int count;
+
+    // Lines and pixels covered, in bounding boxes
+    int ymin, ymax;
+    int64_t pixels;
+
+    // Bands of the batch being drawn
+    psx_gpu_t *gpu;
+    int base, height;
+
+    // Tiles drawn to and sampled by the batch
+    uint8_t written[GPU_TILES_Y][GPU_TILES_X];
+    uint8_t read[GPU_TILES_Y][GPU_TILES_X];
+};
+
+// Inclusive
+typedef struct
+{
+    int x0, y0, x1, y1;
+} gpu_area_t;
+
+static void gpu_batch_reset(psx_gpu_batch_t *b)
+{
+    b->count = 0;
+    b->ymin = PSX_GPU_FB_HEIGHT;
+    b->ymax = -1;
+    b->pixels = 0;
+
+    memset(b->written, 0, sizeof(b->written));
+    memset(b->read, 0, sizeof(b->read));
+}
+
+// width pixels from (x, y) on height lines, a span running past the
+// end of a line carries on at the start of the next one
+static int gpu_texture_area(gpu_area_t *area, int x, int y, int width, int height)
+{
+    area[0].x0 = x;
+    area[0].y0 = y;
+    area[0].x1 = (((x + width) < PSX_GPU_FB_WIDTH) ? (x + width) : PSX_GPU_FB_WIDTH) - 1;
+    area[0].y1 = (((y + height) < PSX_GPU_FB_HEIGHT) ? (y + height) : PSX_GPU_FB_HEIGHT) - 1;
+
+    if (((x + width) <= PSX_GPU_FB_WIDTH) || ((y + 1) >= PSX_GPU_FB_HEIGHT))
+        return 1;
+
+    area[1].x0 = 0;
+    area[1].y0 = y + 1;
+    area[1].x1 = (x + width) - PSX_GPU_FB_WIDTH - 1;
+    area[1].y1 = (((y + height + 1) < PSX_GPU_FB_HEIGHT) ? (y + height + 1) : PSX_GPU_FB_HEIGHT) - 1;
+
+    return 2;
+}
+
+// VRAM a textured primitive can sample, returns the number of areas
+static int gpu_texture_areas(const gpu_texture_t *tex, gpu_area_t *areas)
+{
+    static const int widths[] = {64, 128, 256, 256};
 
-                cr = (cr >= 255.0f) ? 255.0f : ((cr <= 0.0f) ? 0.0f : cr);
-                cg = (cg >= 255.0f) ? 255.0f : ((cg <= 0.0f) ? 0.0f : cg);
-                cb = (cb >= 255.0f) ? 255.0f : ((cb <= 0.0f) ? 0.0f : cb);
+    int n = gpu_texture_area(areas, tex->tpx, tex->tpy, widths[tex->depth & 3], 256);
 
-                unsigned int ucr = roundf(cr);
-                unsigned int ucg = roundf(cg);
-                unsigned int ucb = roundf(cb);
+    if (tex->depth < 2)
+        n += gpu_texture_area(areas + n, tex->clutx, tex->cluty, tex->depth ? 256 : 16, 1);
 
-                uint32_t rgb = ucr | (ucg << 8) | (ucb << 16);
+    return n;
+}
 
-                color = BGR555(rgb);
-            }
+static int gpu_tiles_test(uint8_t (*tiles)[GPU_TILES_X], const gpu_area_t *area)
+{
+    for (int ty = area->y0 >> GPU_TILE_SHIFT; ty <= (area->y1 >> GPU_TILE_SHIFT); ty++)
+        for (int tx = area->x0 >> GPU_TILE_SHIFT; tx <= (area->x1 >> GPU_TILE_SHIFT); tx++)
+            if (tiles[ty][tx])
+                return 1;
+
+    return 0;
+}
+
+static void gpu_tiles_set(uint8_t (*tiles)[GPU_TILES_X], const gpu_area_t *area)
+{
+    int x = area->x0 >> GPU_TILE_SHIFT;
+
+    for (int ty = area->y0 >> GPU_TILE_SHIFT; ty <= (area->y1 >> GPU_TILE_SHIFT); ty++)
+        memset(&tiles[ty][x], 1, (area->x1 >> GPU_TILE_SHIFT) - x + 1);
+}
+
+static void gpu_draw_band(void *udata, int band)
+{
+    psx_gpu_batch_t *b = (psx_gpu_batch_t *)udata;
+
+    int ys = b->base + (band * b->height);
+    int ye = ys + b->height - 1;
+
+    for (int i = 0; i < b->count; i++)
+    {
+        const gpu_job_t *job = &b->jobs[i];
+
+        if ((job->y1 < ys) || (job->y0 > ye))
+            continue;
 
-            gpu->vram[x + (y * 1024)] = color;
+        if (job->type == GPU_JOB_TRIANGLE)
+        {
+            gpu_raster_triangle(b->gpu, &job->triangle, ys, ye);
+        }
+        else
+        {
+            gpu_raster_rect(b->gpu, &job->rect, ys, ye);
         }
     }
 }
 
-#define CLAMP(v, d, u) ((v) <= (d)) ? (d) : (((v) >= (u)) ? (u) : (v))
-
-void gpu_render_rect(psx_gpu_t *gpu, rect_data_t data)
+// Draws the batched primitives
+static void gpu_flush(psx_gpu_t *gpu)
 {
-    if ((data.v0.x >= 1024) || (data.v0.y >= 512))
-        return;
+    psx_gpu_batch_t *b = gpu->batch;
 
-    if ((data.v0.x <= -1024) || (data.v0.y <= -512))
+    if (!b || !b->count)
         return;
 
-    uint16_t width, height;
+    int base = b->ymin & ~7;
+    int lines = (b->ymax - base) + 1;
+    int bands = 1;
 
-    switch ((data.attrib >> 3) & 3)
-    {
-    case RS_VARIABLE:
-    {
-        width = data.width;
-        height = data.height;
-    }
-    break;
-    case RS_1X1:
-    {
-        width = 1;
-        height = 1;
-    }
-    break;
-    case RS_8X8:
-    {
-        width = 8;
-        height = 8;
-    }
-    break;
-    case RS_16X16:
-    {
-        width = 16;
-        height = 16;
-    }
-    break;
-    }
+    if (b->pixels >= GPU_BATCH_MIN_PIXELS)
+        bands = psx_gpu_raster_get_threads(gpu->raster) * GPU_BANDS_PER_THREAD;
 
-    int textured = (data.attrib & RA_TEXTURED) != 0;
-    int transp = (data.attrib & RA_TRANSP) != 0;
-    int transp_mode = get_bits(gpu->gpustat, 6, 2);
+    // Bands start on a byte of the dirty map, so no two threads set
+    // bits in the same one
+    b->gpu = gpu;
+    b->base = base;
+    b->height = (((lines + bands - 1) / bands) + 7) & ~7;
 
-    int clutx = (data.clut & 0x3f) << 4;
-    int cluty = (data.clut >> 6) & 0x1ff;
+    bands = (lines + b->height - 1) / b->height;
 
-    /* Offset coordinates */
-    data.v0.x += gpu->off_x;
-    data.v0.y += gpu->off_y;
+    psx_gpu_raster_run(gpu->raster, bands, gpu_draw_band, b);
 
-    /* Calculate bounding box */
-    int xmax = data.v0.x + width;
-    int ymax = data.v0.y + height;
+    gpu_batch_reset(b);
+}
 
-    xmax = CLAMP(xmax, -1024, 1024);
-    ymax = CLAMP(ymax, -1024, 1024);
-    data.v0.x = CLAMP(data.v0.x, -1024, 1024);
-    data.v0.y = CLAMP(data.v0.y, -1024, 1024);
+// Queues a primitive covering [x0, x1] x [y0, y1], returns NULL if it
+// has to be drawn right away instead
+static gpu_job_t *gpu_batch_add(psx_gpu_t *gpu, const gpu_texture_t *tex, int textured, int x0, int y0, int x1, int y1)
+{
+    psx_gpu_batch_t *b = gpu->batch;
 
-    int32_t xc = 0, yc = 0;
+    gpu_area_t box = {x0, y0, x1, y1};
+    gpu_area_t areas[4];
 
-    for (int16_t y = data.v0.y; y < ymax; y++)
+    int n = textured ? gpu_texture_areas(tex, areas) : 0;
+
+    // Lines in one band could sample pixels another band draws
+    for (int i = 0; i < n; i++)
     {
-        for (int16_t x = data.v0.x; x < xmax; x++)
+        if ((areas[i].x0 <= x1) && (areas[i].x1 >= x0) && (areas[i].y0 <= y1) && (areas[i].y1 >= y0))
         {
-            int bc = (x >= gpu->draw_x1) && (x <= gpu->draw_x2) &&
-                     (y >= gpu->draw_y1) && (y <= gpu->draw_y2);
+            gpu_flush(gpu);
 
-            if (!bc)
-                goto skip;
+            return NULL;
+        }
+    }
 
-            uint16_t color;
+    // Drawing pixels earlier primitives sample, or sampling pixels
+    // they draw
+    int flush = (b->count == GPU_BATCH_SIZE) || gpu_tiles_test(b->read, &box);
 
-            if (textured)
-            {
-                uint16_t texel = gpu_fetch_texel(
-                    gpu,
-                    data.v0.tx + xc, data.v0.ty + yc,
-                    gpu->texp_x, gpu->texp_y,
-                    clutx, cluty,
-                    gpu->texp_d);
+    for (int i = 0; i < n; i++)
+        flush |= gpu_tiles_test(b->written, &areas[i]);
 
-                if (!texel)
-                    goto skip;
+    if (flush)
+        gpu_flush(gpu);
 
-                if ((data.attrib & RA_TRANSP) != 0)
-                    transp = (texel & 0x8000) != 0;
+    gpu_tiles_set(b->written, &box);
 
-                float tr = ((texel >> 0) & 0x1f) << 3;
-                float tg = ((texel >> 5) & 0x1f) << 3;
-                float tb = ((texel >> 10) & 0x1f) << 3;
+    for (int i = 0; i < n; i++)
+        gpu_tiles_set(b->read, &areas[i]);
 
-                float mr = (data.v0.c >> 0) & 0xff;
-                float mg = (data.v0.c >> 8) & 0xff;
-                float mb = (data.v0.c >> 16) & 0xff;
+    if (y0 < b->ymin)
+        b->ymin = y0;
 
-                float cr = (tr * mr) / 128.0f;
-                float cg = (tg * mg) / 128.0f;
-                float cb = (tb * mb) / 128.0f;
+    if (y1 > b->ymax)
+        b->ymax = y1;
 
-                cr = (cr >= 255.0f) ? 255.0f : ((cr <= 0.0f) ? 0.0f : cr);
-                cg = (cg >= 255.0f) ? 255.0f : ((cg <= 0.0f) ? 0.0f : cg);
-                cb = (cb >= 255.0f) ? 255.0f : ((cb <= 0.0f) ? 0.0f : cb);
+    b->pixels += (int64_t)((x1 - x0) + 1) * ((y1 - y0) + 1);
 
-                unsigned int ucr = roundf(cr);
-                unsigned int ucg = roundf(cg);
-                unsigned int ucb = roundf(cb);
+    gpu_job_t *job = &b->jobs[b->count++];
 
-                uint32_t rgb = ucr | (ucg << 8) | (ucb << 16);
+    job->y0 = y0;
+    job->y1 = y1;
 
-                color = BGR555(rgb);
-            }
-            else
-            {
-                color = BGR555(data.v0.c);
-            }
+    return job;
+}
 
-            float cr = ((color >> 0) & 0x1f) << 3;
-            float cg = ((color >> 5) & 0x1f) << 3;
-            float cb = ((color >> 10) & 0x1f) << 3;
+static psx_gpu_batch_t *gpu_batch_create(void)
+{
+    psx_gpu_batch_t *b = (psx_gpu_batch_t *)malloc(sizeof(psx_gpu_batch_t));
 
-            if (transp)
-            {
-                uint16_t back = gpu->vram[x + (y * 1024)];
+    if (b)
+        gpu_batch_reset(b);
 
-                float br = ((back >> 0) & 0x1f) << 3;
-                float bg = ((back >> 5) & 0x1f) << 3;
-                float bb = ((back >> 10) & 0x1f) << 3;
+    return b;
+}
 
-                switch (transp_mode)
-                {
-                case 0:
-                {
-                    cr = (0.5f * br) + (0.5f * cr);
-                    cg = (0.5f * bg) + (0.5f * cg);
-                    cb = (0.5f * bb) + (0.5f * cb);
-                }
-                break;
-                case 1:
-                {
-                    cr = br + cr;
-                    cg = bg + cg;
-                    cb = bb + cb;
-                }
-                break;
-                case 2:
-                {
-                    cr = br - cr;
-                    cg = bg - cg;
-                    cb = bb - cb;
-                }
-                break;
-                case 3:
-                {
-                    cr = br + (0.25f * cr);
-                    cg = bg + (0.25f * cg);
-                    cb = bb + (0.25f * cb);
-                }
-                break;
-                }
+void gpu_render_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vertex_t v2, poly_data_t data, int edge)
+{
+    if (!GPU_DRAWS(gpu))
+        return;
 
-                cr = (cr >= 255.0f) ? 255.0f : ((cr <= 0.0f) ? 0.0f : cr);
-                cg = (cg >= 255.0f) ? 255.0f : ((cg <= 0.0f) ? 0.0f : cg);
-                cb = (cb >= 255.0f) ? 255.0f : ((cb <= 0.0f) ? 0.0f : cb);
+    gpu_triangle_t t;
 
-                unsigned int ucr = roundf(cr);
-                unsigned int ucg = roundf(cg);
-                unsigned int ucb = roundf(cb);
+    if (!gpu_setup_triangle(gpu, &t, v0, v1, v2, data))
+        return;
 
-                uint32_t rgb = ucr | (ucg << 8) | (ucb << 16);
+    gpu_job_t *job = gpu->batch ? gpu_batch_add(gpu, &t.tex, data.attrib & PA_TEXTURED, t.x0, t.y0, t.x1, t.y1) : NULL;
 
-                color = BGR555(rgb);
-            }
+    if (!job)
+    {
+        gpu_raster_triangle(gpu, &t, t.y0, t.y1);
 
-            gpu->vram[x + (y * 1024)] = color;
+        return;
+    }
 
-        skip:
+    job->type = GPU_JOB_TRIANGLE;
+    job->triangle = t;
+}
 
-            ++xc;
-        }
+void gpu_render_rect(psx_gpu_t *gpu, rect_data_t data)
+{
+    if (!GPU_DRAWS(gpu))
+        return;
 
-        xc = 0;
+    gpu_rect_t r;
 
-        ++yc;
+    if (!gpu_setup_rect(gpu, &r, data))
+        return;
+
+    gpu_job_t *job = gpu->batch ? gpu_batch_add(gpu, &r.tex, data.attrib & RA_TEXTURED, r.x0, r.y0, r.x1, r.y1) : NULL;
+
+    if (!job)
+    {
+        gpu_raster_rect(gpu, &r, r.y0, r.y1);
+
+        return;
     }
+
+    job->type = GPU_JOB_RECT;
+    job->rect = r;
 }
 
 void plotLineLow(psx_gpu_t *gpu, int x0, int y0, int x1, int y1, uint16_t color)
@@ -767,7 +1262,7 @@ void plotLineLow(psx_gpu_t *gpu, int x0, int y0, int x1, int y1, uint16_t color)
                  (y >= gpu->draw_y1) && (y <= gpu->draw_y2);
 
         if ((x < 1024) && (y < 512) && (x >= 0) && (y >= 0) && bc)
-            gpu->vram[x + (y * 1024)] = color;
+            gpu_vram_write(gpu, x, y, color);
 
         if (d > 0)
         {
@@ -800,7 +1295,7 @@ void plotLineHigh(psx_gpu_t *gpu, int x0, int y0, int x1, int y1, uint16_t color
                  (y >= gpu->draw_y1) && (y <= gpu->draw_y2);
 
         if ((x < 1024) && (y < 512) && (x >= 0) && (y >= 0) && bc)
-            gpu->vram[x + (y * 1024)] = color;
+            gpu_vram_write(gpu, x, y, color);
 
         if (d > 0)
         {
@@ -842,6 +1337,11 @@ void plotLine(psx_gpu_t *gpu, int x0, int y0, int x1, int y1, uint16_t color)
 
 void gpu_render_flat_line(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, uint32_t color)
 {
+    if (!GPU_DRAWS(gpu))
+        return;
+
+    gpu_flush(gpu);
+
     v0.x += gpu->off_x;
     v0.y += gpu->off_y;
     v1.x += gpu->off_x;
@@ -872,7 +1372,7 @@ void gpu_render_flat_rectangle(psx_gpu_t *gpu, vertex_t v, uint32_t w, uint32_t
             if (!bc)
                 continue;
 
-            gpu->vram[x + (y * 1024)] = color;
+            gpu_vram_write(gpu, x, y, color);
         }
     }
 }
@@ -904,7 +1404,7 @@ void gpu_render_textured_rectangle(psx_gpu_t *gpu, vertex_t v, uint32_t w, uint3
 
             ++xc;
 
-            gpu->vram[x + (y * 1024)] = texel;
+            gpu_vram_write(gpu, x, y, texel);
         }
 
         xc = 0;
@@ -953,7 +1453,7 @@ void gpu_render_flat_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vertex_t
 
             if ((z0 >= 0) && (z1 >= 0) && (z2 >= 0))
             {
-                gpu->vram[x + (y * 1024)] = BGR555(color);
+                gpu_vram_write(gpu, x, y, BGR555(color));
             }
         }
     }
@@ -1033,7 +1533,7 @@ void gpu_render_shaded_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vertex
 
                 uint32_t color = (cb << 16) | (cg << 8) | cr;
 
-                gpu->vram[x + (y * 1024)] = BGR555(color);
+                gpu_vram_write(gpu, x, y, BGR555(color));
             }
         }
     }
@@ -1099,7 +1599,7 @@ void gpu_render_textured_triangle(psx_gpu_t *gpu, vertex_t v0, vertex_t v1, vert
                 if (!color)
                     continue;
 
-                gpu->vram[x + (y * 1024)] = color;
+                gpu_vram_write(gpu, x, y, color);
             }
         }
     }
@@ -1366,6 +1866,9 @@ void gpu_cmd_a0(psx_gpu_t *gpu)
             gpu->addr = gpu->xpos + (gpu->ypos * 1024);
             gpu->xcnt = 0;
             gpu->ycnt = 0;
+
+            if (GPU_DRAWS(gpu))
+                gpu_flush(gpu);
         }
     }
     break;
@@ -1375,7 +1878,8 @@ void gpu_cmd_a0(psx_gpu_t *gpu)
         unsigned int xpos = (gpu->xpos + gpu->xcnt) & 0x3ff;
         unsigned int ypos = (gpu->ypos + gpu->ycnt) & 0x1ff;
 
-        gpu->vram[xpos + (ypos * 1024)] = gpu->recv_data & 0xffff;
+        if (GPU_DRAWS(gpu))
+            gpu_vram_write(gpu, xpos, ypos, gpu->recv_data & 0xffff);
 
         ++gpu->xcnt;
 
@@ -1391,7 +1895,8 @@ void gpu_cmd_a0(psx_gpu_t *gpu)
             xpos = (gpu->xpos + gpu->xcnt) & 0x3ff;
         }
 
-        gpu->vram[xpos + (ypos * 1024)] = gpu->recv_data >> 16;
+        if (GPU_DRAWS(gpu))
+            gpu_vram_write(gpu, xpos, ypos, gpu->recv_data >> 16);
 
         ++gpu->xcnt;
 
@@ -1918,7 +2423,7 @@ void gpu_cmd_68(psx_gpu_t *gpu)
             gpu->v0.x += gpu->off_x;
             gpu->v0.y += gpu->off_y;
 
-            gpu->vram[gpu->v0.x + (gpu->v0.y * 1024)] = BGR555(gpu->color);
+            gpu_vram_write(gpu, gpu->v0.x, gpu->v0.y, BGR555(gpu->color));
 
             gpu->state = GPU_STATE_RECV_CMD;
         }
@@ -2033,6 +2538,15 @@ void gpu_cmd_02(psx_gpu_t *gpu)
             //     gpu->ysiz
             // );
 
+            if (!GPU_DRAWS(gpu))
+            {
+                gpu->state = GPU_STATE_RECV_CMD;
+
+                break;
+            }
+
+            gpu_flush(gpu);
+
             for (int y = gpu->v0.y; y < (gpu->v0.y + gpu->ysiz); y++)
             {
                 for (int x = gpu->v0.x; x < (gpu->v0.x + gpu->xsiz); x++)
@@ -2045,7 +2559,7 @@ void gpu_cmd_02(psx_gpu_t *gpu)
                     //     continue;
 
                     if ((x < 1024) && (y < 512) && (x >= 0) && (y >= 0))
-                        gpu->vram[x + (y * 1024)] = color;
+                        gpu_vram_write(gpu, x, y, color);
                 }
             }
 
@@ -2080,6 +2594,15 @@ void gpu_cmd_80(psx_gpu_t *gpu)
             uint32_t xsiz = gpu->buf[3] & 0xffff;
             uint32_t ysiz = gpu->buf[3] >> 16;
 
+            if (!GPU_DRAWS(gpu))
+            {
+                gpu->state = GPU_STATE_RECV_CMD;
+
+                break;
+            }
+
+            gpu_flush(gpu);
+
             for (int y = 0; y < ysiz; y++)
             {
                 for (int x = 0; x < xsiz; x++)
@@ -2088,7 +2611,7 @@ void gpu_cmd_80(psx_gpu_t *gpu)
                     int srcb = ((srcx + x) < 1024) && ((srcy + y) < 512);
 
                     if (dstb && srcb)
-                        gpu->vram[(dstx + x) + (dsty + y) * 1024] = gpu->vram[(srcx + x) + (srcy + y) * 1024];
+                        gpu_vram_write(gpu, dstx + x, dsty + y, gpu->vram[(srcx + x) + (srcy + y) * 1024]);
                 }
             }
 
@@ -2244,6 +2767,10 @@ void psx_gpu_update_cmd(psx_gpu_t *gpu)
     break;
     case 0xe2:
     {
+        // Batched primitives sample through the current window
+        if (GPU_DRAWS(gpu))
+            gpu_flush(gpu);
+
         gpu->texw_mx = ((gpu->buf[0] >> 0) & 0x1f) << 3;
         gpu->texw_my = ((gpu->buf[0] >> 5) & 0x1f) << 3;
         gpu->texw_ox = ((gpu->buf[0] >> 10) & 0x1f) << 3;
@@ -2270,9 +2797,8 @@ void psx_gpu_update_cmd(psx_gpu_t *gpu)
     break;
     case 0xe6:
     {
-        /* To-do: Implement mask bit thing */
-        gpu->set_mask = get_bit(gpu->buf[0], 0);
-        gpu->check_mask = get_bit(gpu->buf[0], 1);
+        gpu->set_mask = gpu->buf[0] & 1;
+        gpu->check_mask = (gpu->buf[0] >> 1) & 1;
     }
     break;
     default:
@@ -2294,6 +2820,9 @@ void psx_gpu_write32(psx_gpu_t *gpu, uint32_t offset, uint32_t value)
     // GP0
     case 0x00:
     {
+        if (gpu->thread)
+            psx_gpu_thread_push(gpu->thread, value);
+
         switch (gpu->state)
         {
         case GPU_STATE_RECV_CMD:
@@ -2323,6 +2852,10 @@ void psx_gpu_write32(psx_gpu_t *gpu, uint32_t offset, uint32_t value)
         break;
         }
 
+        // Hand whole packets to the worker
+        if (gpu->thread && (gpu->state == GPU_STATE_RECV_CMD))
+            psx_gpu_thread_publish(gpu->thread);
+
         return;
     }
     break;
@@ -2337,6 +2870,13 @@ void psx_gpu_write32(psx_gpu_t *gpu, uint32_t offset, uint32_t value)
         case 0x00:
         {
             gpu->gpustat = 0x14802000;
+
+            // The texture page and blending mode live in GPUSTAT
+            if (gpu->thread)
+            {
+                psx_gpu_sync(gpu);
+                psx_gpu_thread_reset(gpu->thread, gpu);
+            }
         }
         break;
         // Display enable
@@ -2422,13 +2962,16 @@ void psx_gpu_set_udata(psx_gpu_t *gpu, int index, void *udata)
     gpu->udata[index] = udata;
 }
 
-#define GPU_CYCLES_PER_HDRAW_NTSC 2560.0f
-#define GPU_CYCLES_PER_SCANL_NTSC 3413.0f
+#define GPU_CYCLES_PER_HDRAW_NTSC (2560 << 16)
+#define GPU_CYCLES_PER_SCANL_NTSC (3413 << 16)
 #define GPU_SCANS_PER_VDRAW_NTSC 240
 #define GPU_SCANS_PER_FRAME_NTSC 263
-#define GPU_CYCLES_PER_SCANL_PAL 3406.0f
+#define GPU_CYCLES_PER_SCANL_PAL (3406 << 16)
 #define GPU_SCANS_PER_FRAME_PAL 314
 
+// CPU (~33.8 MHz) to GPU (~53.7 MHz) cycles, 16.16 fixed-point
+#define GPU_CYCLES_PER_CPU_CYCLE ((uint32_t)(((uint64_t)PSX_GPU_CLOCK_NTSC << 16) / PSX_CPU_CPS))
+
 void gpu_hblank_event(psx_gpu_t *gpu)
 {
     if (gpu->line < GPU_SCANS_PER_VDRAW_NTSC)
@@ -2494,43 +3037,274 @@ void gpu_hblank_event(psx_gpu_t *gpu)
     }
 }
 
+// Runs every hblank start and end within the elapsed cycles, a long
+// stretch like a serviced kernel call can span several scanlines
 void psx_gpu_update(psx_gpu_t *gpu, int cyc)
 {
-    int prev_hblank = (gpu->cycles >= GPU_CYCLES_PER_HDRAW_NTSC) &&
-                      (gpu->cycles <= GPU_CYCLES_PER_SCANL_NTSC);
+    uint64_t remaining = (uint64_t)cyc * GPU_CYCLES_PER_CPU_CYCLE;
+
+    while (1)
+    {
+        int hblank = gpu->cycles >= GPU_CYCLES_PER_HDRAW_NTSC;
+        uint64_t edge = hblank ? (GPU_CYCLES_PER_SCANL_NTSC + 1) : GPU_CYCLES_PER_HDRAW_NTSC;
 
-    // Convert CPU (~33.8 MHz) cycles to GPU (~53.7 MHz) cycles
-    gpu->cycles += (float)cyc * (PSX_GPU_CLOCK_FREQ_NTSC / PSX_CPU_FREQ);
+        if ((gpu->cycles + remaining) < edge)
+        {
+            gpu->cycles += remaining;
+
+            return;
+        }
 
-    int curr_hblank = (gpu->cycles >= GPU_CYCLES_PER_HDRAW_NTSC) &&
-                      (gpu->cycles <= GPU_CYCLES_PER_SCANL_NTSC);
+        // Old states can be past the end of the scanline already
+        if (gpu->cycles < edge)
+            remaining -= edge - gpu->cycles;
 
-    if (curr_hblank && !prev_hblank)
-    {
-        if (gpu->event_cb_table[GPU_EVENT_HBLANK])
-            gpu->event_cb_table[GPU_EVENT_HBLANK](gpu);
+        gpu->cycles = edge;
 
-        gpu_hblank_event(gpu);
+        if (!hblank)
+        {
+            if (gpu->event_cb_table[GPU_EVENT_HBLANK])
+                gpu->event_cb_table[GPU_EVENT_HBLANK](gpu);
+
+            gpu_hblank_event(gpu);
+        }
+        else
+        {
+            if (gpu->event_cb_table[GPU_EVENT_HBLANK_END])
+                gpu->event_cb_table[GPU_EVENT_HBLANK_END](gpu);
+
+            gpu->cycles -= GPU_CYCLES_PER_SCANL_NTSC;
+        }
     }
-    else if (prev_hblank && !curr_hblank)
-    {
-        if (gpu->event_cb_table[GPU_EVENT_HBLANK_END])
-            gpu->event_cb_table[GPU_EVENT_HBLANK_END](gpu);
+}
+
+// CPU cycles until the next hblank start or end
+static uint64_t gpu_sched_next(void *udata)
+{
+    psx_gpu_t *gpu = (psx_gpu_t *)udata;
+
+    uint64_t target;
 
-        gpu->cycles -= (float)GPU_CYCLES_PER_SCANL_NTSC;
+    if (gpu->cycles < GPU_CYCLES_PER_HDRAW_NTSC)
+    {
+        target = GPU_CYCLES_PER_HDRAW_NTSC;
+    }
+    else if (gpu->cycles <= GPU_CYCLES_PER_SCANL_NTSC)
+    {
+        target = GPU_CYCLES_PER_SCANL_NTSC + 1;
+    }
+    else
+    {
+        return 1;
     }
+
+    return (target - gpu->cycles + GPU_CYCLES_PER_CPU_CYCLE - 1) / GPU_CYCLES_PER_CPU_CYCLE;
 }
 
 void *psx_gpu_get_display_buffer(psx_gpu_t *gpu)
 {
+    psx_gpu_sync(gpu);
+
     if (gpu->gpustat & 0x800000)
         return gpu->empty;
 
     return gpu->vram + (gpu->disp_x + (gpu->disp_y * 1024));
 }
 
+const uint8_t *psx_gpu_get_dirty(psx_gpu_t *gpu)
+{
+    psx_gpu_sync(gpu);
+
+    return gpu->dirty;
+}
+
+void psx_gpu_clear_dirty(psx_gpu_t *gpu)
+{
+    memset(gpu->dirty, 0, sizeof(gpu->dirty));
+}
+
+void psx_gpu_set_simd(psx_gpu_t *gpu, int enable)
+{
+    gpu->shade_span = enable ? psx_gpu_simd_select(PSX_GPU_SIMD_AVX2) : NULL;
+
+    if (!gpu->shade_span)
+        gpu->shade_span = g_psx_gpu_span_kernels;
+
+    if (gpu->thread)
+    {
+        psx_gpu_sync(gpu);
+
+        gpu->thread->gpu->shade_span = gpu->shade_span;
+    }
+}
+
+static void gpu_stop_thread(psx_gpu_t *gpu)
+{
+    if (!gpu->thread)
+        return;
+
+    psx_gpu_sync(gpu);
+    psx_gpu_thread_destroy(gpu->thread);
+
+    gpu->thread = NULL;
+}
+
+static void gpu_stop_raster(psx_gpu_t *gpu)
+{
+    if (gpu->raster)
+        psx_gpu_raster_destroy(gpu->raster);
+
+    free(gpu->batch);
+
+    gpu->raster = NULL;
+    gpu->batch = NULL;
+}
+
+void psx_gpu_set_thread(psx_gpu_t *gpu, int enable)
+{
+    if (!enable)
+    {
+        gpu_stop_thread(gpu);
+
+        return;
+    }
+
+    if (gpu->thread)
+        return;
+
+    gpu->thread = psx_gpu_thread_create(gpu);
+
+    if (!gpu->thread)
+        log_error("Couldn't start the GPU thread, drawing on the emulation thread");
+}
+
+void psx_gpu_set_raster_threads(psx_gpu_t *gpu, int threads)
+{
+    psx_gpu_sync(gpu);
+
+    gpu_stop_raster(gpu);
+
+    if (threads > 1)
+    {
+        gpu->raster = psx_gpu_raster_create(threads);
+        gpu->batch = gpu_batch_create();
+
+        if (!gpu->raster || !gpu->batch)
+        {
+            log_error("Couldn't start the GPU raster threads, drawing on one thread");
+
+            gpu_stop_raster(gpu);
+        }
+    }
+
+    // The worker thread draws with our pool
+    if (gpu->thread)
+        psx_gpu_thread_reset(gpu->thread, gpu);
+}
+
+void psx_gpu_sync(psx_gpu_t *gpu)
+{
+    if (!gpu->thread)
+    {
+        gpu_flush(gpu);
+
+        return;
+    }
+
+    psx_gpu_thread_sync(gpu->thread);
+
+    // The worker is idle until more words are published
+    psx_gpu_t *worker = gpu->thread->gpu;
+
+    gpu_flush(worker);
+
+    // Pick up the lines the worker drew
+    for (int i = 0; i < (int)sizeof(gpu->dirty); i++)
+        gpu->dirty[i] |= worker->dirty[i];
+
+    memset(worker->dirty, 0, sizeof(worker->dirty));
+}
+
+void psx_gpu_release(psx_gpu_t *gpu)
+{
+    gpu_stop_thread(gpu);
+    gpu_stop_raster(gpu);
+}
+
+void psx_gpu_save_state(psx_gpu_t *gpu, psx_state_t *state)
+{
+    psx_gpu_sync(gpu);
+
+    psx_state_begin_chunk(state, PSX_STATE_GPU);
+    psx_state_write(state, gpu, sizeof(psx_gpu_t));
+    PSX_STATE_CLEAR(state, psx_gpu_t, udata);
+    PSX_STATE_CLEAR(state, psx_gpu_t, vram);
+    PSX_STATE_CLEAR(state, psx_gpu_t, empty);
+    PSX_STATE_CLEAR(state, psx_gpu_t, dirty);
+    PSX_STATE_CLEAR(state, psx_gpu_t, shade_span);
+    PSX_STATE_CLEAR(state, psx_gpu_t, thread);
+    PSX_STATE_CLEAR(state, psx_gpu_t, raster);
+    PSX_STATE_CLEAR(state, psx_gpu_t, batch);
+    PSX_STATE_CLEAR(state, psx_gpu_t, ic);
+    PSX_STATE_CLEAR(state, psx_gpu_t, event_cb_table);
+
+    // Unmasked accesses can spill past the first 1 MiB, save all of it
+    psx_state_write(state, gpu->vram, PSX_GPU_VRAM_SIZE);
+    psx_state_end_chunk(state);
+}
+
+int psx_gpu_load_state(psx_gpu_t *gpu, psx_state_t *state)
+{
+    void *udata[4];
+    psx_gpu_event_callback_t event_cb_table[8];
+    uint16_t *vram = gpu->vram;
+    uint16_t *empty = gpu->empty;
+    psx_ic_t *ic = gpu->ic;
+    const psx_gpu_span_fn_t *shade_span = gpu->shade_span;
+    psx_gpu_thread_t *thread = gpu->thread;
+    psx_gpu_raster_t *raster = gpu->raster;
+    psx_gpu_batch_t *batch = gpu->batch;
+
+    if (psx_state_next_chunk(state, PSX_STATE_GPU) != (int)(sizeof(psx_gpu_t) + PSX_GPU_VRAM_SIZE))
+        return 1;
+
+    memcpy(udata, gpu->udata, sizeof(udata));
+    memcpy(event_cb_table, gpu->event_cb_table, sizeof(event_cb_table));
+
+    // The worker may still be drawing into VRAM
+    psx_gpu_sync(gpu);
+
+    psx_state_read(state, gpu, sizeof(psx_gpu_t));
+
+    memcpy(gpu->udata, udata, sizeof(udata));
+    memcpy(gpu->event_cb_table, event_cb_table, sizeof(event_cb_table));
+
+    gpu->vram = vram;
+    gpu->empty = empty;
+    gpu->ic = ic;
+    gpu->shade_span = shade_span;
+    gpu->thread = thread;
+    gpu->raster = raster;
+    gpu->batch = batch;
+
+    psx_state_read(state, gpu->vram, PSX_GPU_VRAM_SIZE);
+
+    if (gpu->thread)
+        psx_gpu_thread_reset(gpu->thread, gpu);
+
+    memset(gpu->dirty, 0xff, sizeof(gpu->dirty));
+
+    // Let the frontend pick up the restored display mode
+    if (gpu->event_cb_table[GPU_EVENT_DMODE])
+        gpu->event_cb_table[GPU_EVENT_DMODE](gpu);
+
+    return 0;
+}
+
 void psx_gpu_destroy(psx_gpu_t *gpu)
 {
+    psx_gpu_release(gpu);
+
     free(gpu->vram);
     free(gpu);
 }
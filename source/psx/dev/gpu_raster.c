@@ -0,0 +1,194 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/dev/gpu_raster.h"
+
+#ifdef _WIN32
+#define GPU_RASTER_LOCK(r) AcquireSRWLockExclusive(&(r)->lock)
+#define GPU_RASTER_UNLOCK(r) ReleaseSRWLockExclusive(&(r)->lock)
+#define GPU_RASTER_WAIT(r) SleepConditionVariableSRW(&(r)->cond, &(r)->lock, INFINITE, 0)
+#define GPU_RASTER_WAKE_ALL(r) WakeAllConditionVariable(&(r)->cond)
+#define GPU_RASTER_YIELD SwitchToThread()
+#else
+#include <sched.h>
+
+#define GPU_RASTER_LOCK(r) pthread_mutex_lock(&(r)->lock)
+#define GPU_RASTER_UNLOCK(r) pthread_mutex_unlock(&(r)->lock)
+#define GPU_RASTER_WAIT(r) pthread_cond_wait(&(r)->cond, &(r)->lock)
+#define GPU_RASTER_WAKE_ALL(r) pthread_cond_broadcast(&(r)->cond)
+#define GPU_RASTER_YIELD sched_yield()
+#endif
+
+// Claims the next band of the given run, -1 once there are none left
+static int gpu_raster_claim(psx_gpu_raster_t *r, uint32_t run, int bands)
+{
+    uint64_t work = atomic_load(&r->work);
+
+    while (((uint32_t)(work >> 32) == run) && ((int)(uint32_t)work < bands))
+    {
+        if (atomic_compare_exchange_weak(&r->work, &work, work + 1))
+            return (int)(uint32_t)work;
+    }
+
+    return -1;
+}
+
+static void gpu_raster_draw(psx_gpu_raster_t *r, uint32_t run, int bands, psx_gpu_raster_fn_t fn, void *udata)
+{
+    int band;
+
+    while ((band = gpu_raster_claim(r, run, bands)) != -1)
+    {
+        fn(udata, band);
+
+        atomic_fetch_add(&r->done, 1);
+    }
+}
+
+#ifdef _WIN32
+static DWORD WINAPI gpu_raster_main(LPVOID udata)
+#else
+static void *gpu_raster_main(void *udata)
+#endif
+{
+    psx_gpu_raster_t *r = (psx_gpu_raster_t *)udata;
+
+    uint32_t run = 0;
+
+    while (1)
+    {
+        GPU_RASTER_LOCK(r);
+
+        while ((r->run == run) && !r->quit)
+            GPU_RASTER_WAIT(r);
+
+        if (r->quit)
+        {
+            GPU_RASTER_UNLOCK(r);
+
+            break;
+        }
+
+        run = r->run;
+
+        int bands = r->bands;
+        psx_gpu_raster_fn_t fn = r->fn;
+        void *fn_udata = r->udata;
+
+        GPU_RASTER_UNLOCK(r);
+
+        gpu_raster_draw(r, run, bands, fn, fn_udata);
+    }
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+psx_gpu_raster_t *psx_gpu_raster_create(int threads)
+{
+#ifdef _WIN32
+    psx_gpu_raster_t *r = (psx_gpu_raster_t *)_aligned_malloc(sizeof(psx_gpu_raster_t), _Alignof(psx_gpu_raster_t));
+#else
+    psx_gpu_raster_t *r = (psx_gpu_raster_t *)aligned_alloc(_Alignof(psx_gpu_raster_t), sizeof(psx_gpu_raster_t));
+#endif
+
+    if (!r)
+        return NULL;
+
+    memset(r, 0, sizeof(psx_gpu_raster_t));
+
+    if (threads > PSX_GPU_RASTER_MAX_THREADS)
+        threads = PSX_GPU_RASTER_MAX_THREADS;
+
+#ifdef _WIN32
+    InitializeSRWLock(&r->lock);
+    InitializeConditionVariable(&r->cond);
+#else
+    pthread_mutex_init(&r->lock, NULL);
+    pthread_cond_init(&r->cond, NULL);
+#endif
+
+    // The caller of psx_gpu_raster_run is the first thread
+    for (r->count = 1; r->count < threads; r->count++)
+    {
+#ifdef _WIN32
+        r->threads[r->count] = CreateThread(NULL, 0, gpu_raster_main, r, 0, NULL);
+
+        if (!r->threads[r->count])
+            break;
+#else
+        if (pthread_create(&r->threads[r->count], NULL, gpu_raster_main, r))
+            break;
+#endif
+    }
+
+    return r;
+}
+
+void psx_gpu_raster_run(psx_gpu_raster_t *r, int bands, psx_gpu_raster_fn_t fn, void *udata)
+{
+    if (r->count == 1)
+    {
+        for (int band = 0; band < bands; band++)
+            fn(udata, band);
+
+        return;
+    }
+
+    GPU_RASTER_LOCK(r);
+
+    uint32_t run = ++r->run;
+
+    r->bands = bands;
+    r->fn = fn;
+    r->udata = udata;
+
+    atomic_store(&r->done, 0);
+    atomic_store(&r->work, (uint64_t)run << 32);
+
+    GPU_RASTER_WAKE_ALL(r);
+    GPU_RASTER_UNLOCK(r);
+
+    gpu_raster_draw(r, run, bands, fn, udata);
+
+    // The last bands may still be on other threads
+    while (atomic_load(&r->done) != bands)
+        GPU_RASTER_YIELD;
+}
+
+int psx_gpu_raster_get_threads(psx_gpu_raster_t *r)
+{
+    return r->count;
+}
+
+void psx_gpu_raster_destroy(psx_gpu_raster_t *r)
+{
+    GPU_RASTER_LOCK(r);
+    r->quit = 1;
+    GPU_RASTER_WAKE_ALL(r);
+    GPU_RASTER_UNLOCK(r);
+
+    for (int i = 1; i < r->count; i++)
+    {
+#ifdef _WIN32
+        WaitForSingleObject(r->threads[i], INFINITE);
+        CloseHandle(r->threads[i]);
+#else
+        pthread_join(r->threads[i], NULL);
+#endif
+    }
+
+#ifndef _WIN32
+    pthread_cond_destroy(&r->cond);
+    pthread_mutex_destroy(&r->lock);
+#endif
+
+#ifdef _WIN32
+    _aligned_free(r);
+#else
+    free(r);
+#endif
+}
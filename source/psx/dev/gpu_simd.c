@@ -0,0 +1,402 @@
+#include "psx/dev/gpu_simd.h"
+
+#ifdef PSX_GPU_SIMD_X86
+#include <immintrin.h>
+
+/*
+    Spans are shaded with one 16-bit lane per pixel, same integer
+    math as psx_gpu_shade_span:
+
+      modulate(t, c) = min(255, ((t << 3) * c + 64) >> 7) >> 3
+
+    (t << 3) * c fits in 16 bits unsigned. Colour gradients need 32-bit
+    lanes and are packed down after the shift. Pixels that are left
+    alone (transparent texels, masked pixels) get their old value
+    blended back in before the store. Leftover pixels go through the
+    scalar kernel.
+*/
+
+// Every kernel is inlined into one function per PSX_GPU_SPAN_INDEX,
+// with the attributes and blending mode as constants
+#define GPU_INLINE(isa) static inline __attribute__((always_inline, target(isa)))
+
+// Continues a span from pixel i with the scalar kernel
+static void gpu_shade_tail(uint16_t *dst, const uint16_t *texels, int i, int count, const psx_gpu_span_t *span, int index)
+{
+    if (i >= count)
+        return;
+
+    psx_gpu_span_t tail = *span;
+
+    // i is a multiple of 4, so the dither pattern lines up
+    tail.r = (int32_t)((uint32_t)span->r + ((uint32_t)span->dr * (uint32_t)i));
+    tail.g = (int32_t)((uint32_t)span->g + ((uint32_t)span->dg * (uint32_t)i));
+    tail.b = (int32_t)((uint32_t)span->b + ((uint32_t)span->db * (uint32_t)i));
+
+    g_psx_gpu_span_kernels[index](dst + i, texels ? (texels + i) : NULL, count - i, &tail);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gpu_step_avx2(int32_t c, int32_t dc, int first)
+{
+    __m256i lane = _mm256_setr_epi32(0, 1, 2, 3, 4, 5, 6, 7);
+
+    lane = _mm256_add_epi32(lane, _mm256_set1_epi32(first));
+
+    return _mm256_add_epi32(_mm256_set1_epi32(c), _mm256_mullo_epi32(lane, _mm256_set1_epi32(dc)));
+}
+
+// Integer part of 16 fixed-point colours, dithered and saturated
+__attribute__((target("avx2")))
+static inline __m256i gpu_channel_avx2(__m256i lo, __m256i hi, __m256i dither)
+{
+    __m256i c = _mm256_packs_epi32(_mm256_srai_epi32(lo, PSX_GPU_FRAC_BITS), _mm256_srai_epi32(hi, PSX_GPU_FRAC_BITS));
+
+    // Packing interleaves the 128-bit halves
+    c = _mm256_permute4x64_epi64(c, _MM_SHUFFLE(3, 1, 2, 0));
+    c = _mm256_add_epi16(c, dither);
+
+    return _mm256_min_epi16(_mm256_max_epi16(c, _mm256_setzero_si256()), _mm256_set1_epi16(255));
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gpu_modulate_avx2(__m256i t, __m256i c)
+{
+    __m256i m = _mm256_mullo_epi16(_mm256_slli_epi16(t, 3), c);
+
+    m = _mm256_srli_epi16(_mm256_add_epi16(m, _mm256_set1_epi16(64)), 7);
+
+    return _mm256_srli_epi16(_mm256_min_epu16(m, _mm256_set1_epi16(255)), 3);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gpu_blend_avx2(__m256i b, __m256i f, int mode)
+{
+    const __m256i max = _mm256_set1_epi16(31);
+
+    switch (mode)
+    {
+    case 0:
+        return _mm256_srli_epi16(_mm256_add_epi16(b, f), 1);
+    case 1:
+        return _mm256_min_epi16(_mm256_add_epi16(b, f), max);
+    case 2:
+        return _mm256_subs_epu16(b, f);
+    }
+
+    return _mm256_min_epi16(_mm256_add_epi16(b, _mm256_srli_epi16(f, 2)), max);
+}
+
+GPU_INLINE("avx2")
+void gpu_shade_span_avx2(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span, int index)
+{
+    const int attrib = PSX_GPU_SPAN_ATTRIB(index);
+    const int mode = PSX_GPU_SPAN_MODE(index);
+
+    const __m256i c5 = _mm256_set1_epi16(0x1f);
+    const __m256i check = _mm256_set1_epi16(span->check_mask);
+    const __m256i set = _mm256_set1_epi16(span->set_mask);
+    const int8_t *d = span->dither;
+    const __m256i dither = _mm256_setr_epi16(
+        d[0], d[1], d[2], d[3], d[0], d[1], d[2], d[3],
+        d[0], d[1], d[2], d[3], d[0], d[1], d[2], d[3]);
+
+    const int shaded = (attrib & PA_SHADED) != 0;
+    const int textured = (attrib & PA_TEXTURED) != 0;
+    const int transp = (attrib & PA_TRANSP) != 0;
+    const int raw = (attrib & PA_RAW) != 0;
+
+    __m256i r_lo = gpu_step_avx2(span->r, span->dr, 0);
+    __m256i g_lo = gpu_step_avx2(span->g, span->dg, 0);
+    __m256i b_lo = gpu_step_avx2(span->b, span->db, 0);
+    __m256i r_hi = gpu_step_avx2(span->r, span->dr, 8);
+    __m256i g_hi = gpu_step_avx2(span->g, span->dg, 8);
+    __m256i b_hi = gpu_step_avx2(span->b, span->db, 8);
+    __m256i r_step = _mm256_set1_epi32((int32_t)((uint32_t)span->dr * 16));
+    __m256i g_step = _mm256_set1_epi32((int32_t)((uint32_t)span->dg * 16));
+    __m256i b_step = _mm256_set1_epi32((int32_t)((uint32_t)span->db * 16));
+
+    __m256i cr = _mm256_set1_epi16((span->color >> 0) & 0xff);
+    __m256i cg = _mm256_set1_epi16((span->color >> 8) & 0xff);
+    __m256i cb = _mm256_set1_epi16((span->color >> 16) & 0xff);
+
+    // Untextured spans blend every pixel or none
+    __m256i transp_all = _mm256_set1_epi16((transp && !textured) ? -1 : 0);
+
+    int i = 0;
+
+    for (; (i + 16) <= count; i += 16)
+    {
+        __m256i back = _mm256_loadu_si256((const __m256i *)&dst[i]);
+        __m256i keep = _mm256_srai_epi16(_mm256_and_si256(back, check), 15);
+        __m256i blend = transp_all;
+        __m256i fr, fg, fb, color;
+
+        if (shaded)
+        {
+            cr = gpu_channel_avx2(r_lo, r_hi, dither);
+            cg = gpu_channel_avx2(g_lo, g_hi, dither);
+            cb = gpu_channel_avx2(b_lo, b_hi, dither);
+
+            r_lo = _mm256_add_epi32(r_lo, r_step);
+            g_lo = _mm256_add_epi32(g_lo, g_step);
+            b_lo = _mm256_add_epi32(b_lo, b_step);
+            r_hi = _mm256_add_epi32(r_hi, r_step);
+            g_hi = _mm256_add_epi32(g_hi, g_step);
+            b_hi = _mm256_add_epi32(b_hi, b_step);
+        }
+
+        if (textured)
+        {
+            __m256i tex = _mm256_loadu_si256((const __m256i *)&texels[i]);
+
+            keep = _mm256_or_si256(keep, _mm256_cmpeq_epi16(tex, _mm256_setzero_si256()));
+
+            if (transp)
+                blend = _mm256_srai_epi16(tex, 15);
+
+            fr = _mm256_and_si256(tex, c5);
+            fg = _mm256_and_si256(_mm256_srli_epi16(tex, 5), c5);
+            fb = _mm256_and_si256(_mm256_srli_epi16(tex, 10), c5);
+
+            if (!raw)
+            {
+                fr = gpu_modulate_avx2(fr, cr);
+                fg = gpu_modulate_avx2(fg, cg);
+                fb = gpu_modulate_avx2(fb, cb);
+            }
+
+            color = raw ? tex : _mm256_or_si256(fr, _mm256_or_si256(_mm256_slli_epi16(fg, 5), _mm256_slli_epi16(fb, 10)));
+        }
+        else
+        {
+            fr = _mm256_srli_epi16(cr, 3);
+            fg = _mm256_srli_epi16(cg, 3);
+            fb = _mm256_srli_epi16(cb, 3);
+
+            color = _mm256_or_si256(fr, _mm256_or_si256(_mm256_slli_epi16(fg, 5), _mm256_slli_epi16(fb, 10)));
+        }
+
+        if (transp)
+        {
+            __m256i br = _mm256_and_si256(back, c5);
+            __m256i bg = _mm256_and_si256(_mm256_srli_epi16(back, 5), c5);
+            __m256i bb = _mm256_and_si256(_mm256_srli_epi16(back, 10), c5);
+
+            br = gpu_blend_avx2(br, fr, mode);
+            bg = gpu_blend_avx2(bg, fg, mode);
+            bb = gpu_blend_avx2(bb, fb, mode);
+
+            __m256i mixed = _mm256_or_si256(br, _mm256_or_si256(_mm256_slli_epi16(bg, 5), _mm256_slli_epi16(bb, 10)));
+
+            color = _mm256_blendv_epi8(color, mixed, blend);
+        }
+
+        color = _mm256_or_si256(color, set);
+
+        _mm256_storeu_si256((__m256i *)&dst[i], _mm256_blendv_epi8(color, back, keep));
+    }
+
+    gpu_shade_tail(dst, texels, i, count, span, index);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i gpu_step_sse41(int32_t c, int32_t dc, int first)
+{
+    __m128i lane = _mm_setr_epi32(0, 1, 2, 3);
+
+    lane = _mm_add_epi32(lane, _mm_set1_epi32(first));
+
+    return _mm_add_epi32(_mm_set1_epi32(c), _mm_mullo_epi32(lane, _mm_set1_epi32(dc)));
+}
+
+// Integer part of 8 fixed-point colours, dithered and saturated
+__attribute__((target("sse4.1")))
+static inline __m128i gpu_channel_sse41(__m128i lo, __m128i hi, __m128i dither)
+{
+    __m128i c = _mm_packs_epi32(_mm_srai_epi32(lo, PSX_GPU_FRAC_BITS), _mm_srai_epi32(hi, PSX_GPU_FRAC_BITS));
+
+    c = _mm_add_epi16(c, dither);
+
+    return _mm_min_epi16(_mm_max_epi16(c, _mm_setzero_si128()), _mm_set1_epi16(255));
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i gpu_modulate_sse41(__m128i t, __m128i c)
+{
+    __m128i m = _mm_mullo_epi16(_mm_slli_epi16(t, 3), c);
+
+    m = _mm_srli_epi16(_mm_add_epi16(m, _mm_set1_epi16(64)), 7);
+
+    return _mm_srli_epi16(_mm_min_epu16(m, _mm_set1_epi16(255)), 3);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i gpu_blend_sse41(__m128i b, __m128i f, int mode)
+{
+    const __m128i max = _mm_set1_epi16(31);
+
+    switch (mode)
+    {
+    case 0:
+        return _mm_srli_epi16(_mm_add_epi16(b, f), 1);
+    case 1:
+        return _mm_min_epi16(_mm_add_epi16(b, f), max);
+    case 2:
+        return _mm_subs_epu16(b, f);
+    }
+
+    return _mm_min_epi16(_mm_add_epi16(b, _mm_srli_epi16(f, 2)), max);
+}
+
+GPU_INLINE("sse4.1")
+void gpu_shade_span_sse41(uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span, int index)
+{
+    const int attrib = PSX_GPU_SPAN_ATTRIB(index);
+    const int mode = PSX_GPU_SPAN_MODE(index);
+
+    const __m128i c5 = _mm_set1_epi16(0x1f);
+    const __m128i check = _mm_set1_epi16(span->check_mask);
+    const __m128i set = _mm_set1_epi16(span->set_mask);
+    const int8_t *d = span->dither;
+    const __m128i dither = _mm_setr_epi16(d[0], d[1], d[2], d[3], d[0], d[1], d[2], d[3]);
+
+    const int shaded = (attrib & PA_SHADED) != 0;
+    const int textured = (attrib & PA_TEXTURED) != 0;
+    const int transp = (attrib & PA_TRANSP) != 0;
+    const int raw = (attrib & PA_RAW) != 0;
+
+    __m128i r_lo = gpu_step_sse41(span->r, span->dr, 0);
+    __m128i g_lo = gpu_step_sse41(span->g, span->dg, 0);
+    __m128i b_lo = gpu_step_sse41(span->b, span->db, 0);
+    __m128i r_hi = gpu_step_sse41(span->r, span->dr, 4);
+    __m128i g_hi = gpu_step_sse41(span->g, span->dg, 4);
+    __m128i b_hi = gpu_step_sse41(span->b, span->db, 4);
+    __m128i r_step = _mm_set1_epi32((int32_t)((uint32_t)span->dr * 8));
+    __m128i g_step = _mm_set1_epi32((int32_t)((uint32_t)span->dg * 8));
+    __m128i b_step = _mm_set1_epi32((int32_t)((uint32_t)span->db * 8));
+
+    __m128i cr = _mm_set1_epi16((span->color >> 0) & 0xff);
+    __m128i cg = _mm_set1_epi16((span->color >> 8) & 0xff);
+    __m128i cb = _mm_set1_epi16((span->color >> 16) & 0xff);
+
+    // Untextured spans blend every pixel or none
+    __m128i transp_all = _mm_set1_epi16((transp && !textured) ? -1 : 0);
+
+    int i = 0;
+
+    for (; (i + 8) <= count; i += 8)
+    {
+        __m128i back = _mm_loadu_si128((const __m128i *)&dst[i]);
+        __m128i keep = _mm_srai_epi16(_mm_and_si128(back, check), 15);
+        __m128i blend = transp_all;
+        __m128i fr, fg, fb, color;
+
+        if (shaded)
+        {
+            cr = gpu_channel_sse41(r_lo, r_hi, dither);
+            cg = gpu_channel_sse41(g_lo, g_hi, dither);
+            cb = gpu_channel_sse41(b_lo, b_hi, dither);
+
+            r_lo = _mm_add_epi32(r_lo, r_step);
+            g_lo = _mm_add_epi32(g_lo, g_step);
+            b_lo = _mm_add_epi32(b_lo, b_step);
+            r_hi = _mm_add_epi32(r_hi, r_step);
+            g_hi = _mm_add_epi32(g_hi, g_step);
+            b_hi = _mm_add_epi32(b_hi, b_step);
+        }
+
+        if (textured)
+        {
+            __m128i tex = _mm_loadu_si128((const __m128i *)&texels[i]);
+
+            keep = _mm_or_si128(keep, _mm_cmpeq_epi16(tex, _mm_setzero_si128()));
+
+            if (transp)
+                blend = _mm_srai_epi16(tex, 15);
+
+            fr = _mm_and_si128(tex, c5);
+            fg = _mm_and_si128(_mm_srli_epi16(tex, 5), c5);
+            fb = _mm_and_si128(_mm_srli_epi16(tex, 10), c5);
+
+            if (!raw)
+            {
+                fr = gpu_modulate_sse41(fr, cr);
+                fg = gpu_modulate_sse41(fg, cg);
+                fb = gpu_modulate_sse41(fb, cb);
+            }
+
+            color = raw ? tex : _mm_or_si128(fr, _mm_or_si128(_mm_slli_epi16(fg, 5), _mm_slli_epi16(fb, 10)));
+        }
+        else
+        {
+            fr = _mm_srli_epi16(cr, 3);
+            fg = _mm_srli_epi16(cg, 3);
+            fb = _mm_srli_epi16(cb, 3);
+
+            color = _mm_or_si128(fr, _mm_or_si128(_mm_slli_epi16(fg, 5), _mm_slli_epi16(fb, 10)));
+        }
+
+        if (transp)
+        {
+            __m128i br = _mm_and_si128(back, c5);
+            __m128i bg = _mm_and_si128(_mm_srli_epi16(back, 5), c5);
+            __m128i bb = _mm_and_si128(_mm_srli_epi16(back, 10), c5);
+
+            br = gpu_blend_sse41(br, fr, mode);
+            bg = gpu_blend_sse41(bg, fg, mode);
+            bb = gpu_blend_sse41(bb, fb, mode);
+
+            __m128i mixed = _mm_or_si128(br, _mm_or_si128(_mm_slli_epi16(bg, 5), _mm_slli_epi16(bb, 10)));
+
+            color = _mm_blendv_epi8(color, mixed, blend);
+        }
+
+        color = _mm_or_si128(color, set);
+
+        _mm_storeu_si128((__m128i *)&dst[i], _mm_blendv_epi8(color, back, keep));
+    }
+
+    gpu_shade_tail(dst, texels, i, count, span, index);
+}
+
+#define GPU_SPAN_KERNEL_AVX2(index)                                                   \
+    __attribute__((target("avx2"))) static void gpu_shade_span_avx2_##index(          \
+        uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span) \
+    {                                                                                 \
+        gpu_shade_span_avx2(dst, texels, count, span, index);                         \
+    }
+
+#define GPU_SPAN_KERNEL_SSE41(index)                                                  \
+    __attribute__((target("sse4.1"))) static void gpu_shade_span_sse41_##index(       \
+        uint16_t *dst, const uint16_t *texels, int count, const psx_gpu_span_t *span) \
+    {                                                                                 \
+        gpu_shade_span_sse41(dst, texels, count, span, index);                        \
+    }
+
+PSX_GPU_SPAN_LIST(GPU_SPAN_KERNEL_AVX2)
+PSX_GPU_SPAN_LIST(GPU_SPAN_KERNEL_SSE41)
+
+#define GPU_SPAN_ENTRY_AVX2(index) gpu_shade_span_avx2_##index,
+#define GPU_SPAN_ENTRY_SSE41(index) gpu_shade_span_sse41_##index,
+
+static const psx_gpu_span_fn_t g_gpu_span_kernels_avx2[PSX_GPU_SPAN_KERNELS] = {PSX_GPU_SPAN_LIST(GPU_SPAN_ENTRY_AVX2)};
+static const psx_gpu_span_fn_t g_gpu_span_kernels_sse41[PSX_GPU_SPAN_KERNELS] = {PSX_GPU_SPAN_LIST(GPU_SPAN_ENTRY_SSE41)};
+#endif
+
+const psx_gpu_span_fn_t *psx_gpu_simd_select(int level)
+{
+#ifdef PSX_GPU_SIMD_X86
+    __builtin_cpu_init();
+
+    if ((level >= PSX_GPU_SIMD_AVX2) && __builtin_cpu_supports("avx2"))
+        return g_gpu_span_kernels_avx2;
+
+    if ((level >= PSX_GPU_SIMD_SSE41) && __builtin_cpu_supports("sse4.1"))
+        return g_gpu_span_kernels_sse41;
+#else
+    (void)level;
+#endif
+
+    return NULL;
+}
@@ -0,0 +1,228 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/dev/gpu_thread.h"
+
+#ifdef _WIN32
+#define GPU_THREAD_LOCK(t) AcquireSRWLockExclusive(&(t)->lock)
+#define GPU_THREAD_UNLOCK(t) ReleaseSRWLockExclusive(&(t)->lock)
+#define GPU_THREAD_WAIT(t) SleepConditionVariableSRW(&(t)->cond, &(t)->lock, INFINITE, 0)
+#define GPU_THREAD_WAKE(t) WakeConditionVariable(&(t)->cond)
+#define GPU_THREAD_YIELD SwitchToThread()
+#else
+#include <sched.h>
+
+#define GPU_THREAD_LOCK(t) pthread_mutex_lock(&(t)->lock)
+#define GPU_THREAD_UNLOCK(t) pthread_mutex_unlock(&(t)->lock)
+#define GPU_THREAD_WAIT(t) pthread_cond_wait(&(t)->cond, &(t)->lock)
+#define GPU_THREAD_WAKE(t) pthread_cond_signal(&(t)->cond)
+#define GPU_THREAD_YIELD sched_yield()
+#endif
+
+// Polls of an empty ring before the worker goes to sleep
+#define GPU_THREAD_SPIN 256
+
+static void gpu_thread_free(psx_gpu_thread_t *t)
+{
+#ifdef _WIN32
+    _aligned_free(t);
+#else
+    free(t);
+#endif
+}
+
+// The worker never sees GP1 writes and must not call back into the
+// frontend, it only keeps what drawing needs
+static void gpu_thread_copy(psx_gpu_thread_t *t, psx_gpu_t *gpu)
+{
+    memcpy(t->gpu, gpu, sizeof(psx_gpu_t));
+
+    t->gpu->thread = NULL;
+
+    memset(t->gpu->udata, 0, sizeof(t->gpu->udata));
+    memset(t->gpu->event_cb_table, 0, sizeof(t->gpu->event_cb_table));
+    memset(t->gpu->dirty, 0, sizeof(t->gpu->dirty));
+}
+
+// Sleeps until the emulation thread publishes words past tail, returns
+// non-zero when asked to quit instead
+static int gpu_thread_wait(psx_gpu_thread_t *t, uint32_t tail)
+{
+    for (int i = 0; i < GPU_THREAD_SPIN; i++)
+    {
+        if (atomic_load_explicit(&t->head, memory_order_acquire) != tail)
+            return 0;
+
+        GPU_THREAD_YIELD;
+    }
+
+    GPU_THREAD_LOCK(t);
+
+    // Pairs with the head store in psx_gpu_thread_publish, either we
+    // see the new head or the publisher sees sleeping set
+    atomic_store(&t->sleeping, 1);
+
+    while ((atomic_load(&t->head) == tail) && !atomic_load(&t->quit))
+        GPU_THREAD_WAIT(t);
+
+    atomic_store(&t->sleeping, 0);
+
+    GPU_THREAD_UNLOCK(t);
+
+    return atomic_load(&t->head) == tail;
+}
+
+#ifdef _WIN32
+static DWORD WINAPI gpu_thread_main(LPVOID udata)
+#else
+static void *gpu_thread_main(void *udata)
+#endif
+{
+    psx_gpu_thread_t *t = (psx_gpu_thread_t *)udata;
+
+    uint32_t tail = atomic_load_explicit(&t->tail, memory_order_relaxed);
+
+    while (1)
+    {
+        uint32_t head = atomic_load_explicit(&t->head, memory_order_acquire);
+
+        if (head == tail)
+        {
+            if (gpu_thread_wait(t, tail))
+                break;
+
+            continue;
+        }
+
+        while (tail != head)
+        {
+            psx_gpu_write32(t->gpu, 0, t->ring[tail & PSX_GPU_THREAD_RING_MASK]);
+
+            ++tail;
+        }
+
+        atomic_store_explicit(&t->tail, tail, memory_order_release);
+    }
+
+#ifdef _WIN32
+    return 0;
+#else
+    return NULL;
+#endif
+}
+
+psx_gpu_thread_t *psx_gpu_thread_create(psx_gpu_t *gpu)
+{
+#ifdef _WIN32
+    psx_gpu_thread_t *t = (psx_gpu_thread_t *)_aligned_malloc(sizeof(psx_gpu_thread_t), _Alignof(psx_gpu_thread_t));
+#else
+    psx_gpu_thread_t *t = (psx_gpu_thread_t *)aligned_alloc(_Alignof(psx_gpu_thread_t), sizeof(psx_gpu_thread_t));
+#endif
+
+    if (!t)
+        return NULL;
+
+    memset(t, 0, sizeof(psx_gpu_thread_t));
+
+    t->gpu = (psx_gpu_t *)malloc(sizeof(psx_gpu_t));
+
+    if (!t->gpu)
+    {
+        gpu_thread_free(t);
+
+        return NULL;
+    }
+
+    gpu_thread_copy(t, gpu);
+
+#ifdef _WIN32
+    InitializeSRWLock(&t->lock);
+    InitializeConditionVariable(&t->cond);
+
+    t->thread = CreateThread(NULL, 0, gpu_thread_main, t, 0, NULL);
+
+    if (t->thread)
+        return t;
+#else
+    pthread_mutex_init(&t->lock, NULL);
+    pthread_cond_init(&t->cond, NULL);
+
+    if (!pthread_create(&t->thread, NULL, gpu_thread_main, t))
+        return t;
+
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+#endif
+
+    free(t->gpu);
+    gpu_thread_free(t);
+
+    return NULL;
+}
+
+void psx_gpu_thread_publish(psx_gpu_thread_t *t)
+{
+    if (atomic_load_explicit(&t->head, memory_order_relaxed) == t->next)
+        return;
+
+    atomic_store(&t->head, t->next);
+
+    if (!atomic_load(&t->sleeping))
+        return;
+
+    GPU_THREAD_LOCK(t);
+    GPU_THREAD_WAKE(t);
+    GPU_THREAD_UNLOCK(t);
+}
+
+void psx_gpu_thread_push(psx_gpu_thread_t *t, uint32_t value)
+{
+    // Only reload the worker's tail when the cached one says the ring
+    // is full
+    if ((t->next - t->tail_cache) == PSX_GPU_THREAD_RING_SIZE)
+    {
+        psx_gpu_thread_publish(t);
+
+        while ((t->next - (t->tail_cache = atomic_load_explicit(&t->tail, memory_order_acquire))) == PSX_GPU_THREAD_RING_SIZE)
+            GPU_THREAD_YIELD;
+    }
+
+    t->ring[t->next & PSX_GPU_THREAD_RING_MASK] = value;
+
+    ++t->next;
+}
+
+void psx_gpu_thread_sync(psx_gpu_thread_t *t)
+{
+    psx_gpu_thread_publish(t);
+
+    while ((t->tail_cache = atomic_load_explicit(&t->tail, memory_order_acquire)) != t->next)
+        GPU_THREAD_YIELD;
+}
+
+void psx_gpu_thread_reset(psx_gpu_thread_t *t, psx_gpu_t *gpu)
+{
+    gpu_thread_copy(t, gpu);
+}
+
+void psx_gpu_thread_destroy(psx_gpu_thread_t *t)
+{
+    psx_gpu_thread_sync(t);
+
+    GPU_THREAD_LOCK(t);
+    atomic_store(&t->quit, 1);
+    GPU_THREAD_WAKE(t);
+    GPU_THREAD_UNLOCK(t);
+
+#ifdef _WIN32
+    WaitForSingleObject(t->thread, INFINITE);
+    CloseHandle(t->thread);
+#else
+    pthread_join(t->thread, NULL);
+    pthread_cond_destroy(&t->cond);
+    pthread_mutex_destroy(&t->lock);
+#endif
+
+    free(t->gpu);
+    gpu_thread_free(t);
+}
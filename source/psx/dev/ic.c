@@ -188,6 +188,26 @@ void psx_ic_irq(psx_ic_t *ic, int id)
         psx_cpu_set_irq_pending(ic->cpu);
 }
 
+void psx_ic_save_state(psx_ic_t *ic, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_IC);
+    psx_state_write(state, ic, sizeof(psx_ic_t));
+    PSX_STATE_CLEAR(state, psx_ic_t, cpu);
+    psx_state_end_chunk(state);
+}
+
+int psx_ic_load_state(psx_ic_t *ic, psx_state_t *state)
+{
+    psx_cpu_t *cpu = ic->cpu;
+
+    if (psx_state_read_chunk(state, PSX_STATE_IC, ic, sizeof(psx_ic_t)))
+        return 1;
+
+    ic->cpu = cpu;
+
+    return 0;
+}
+
 void psx_ic_destroy(psx_ic_t *ic)
 {
     free(ic);
@@ -308,6 +308,18 @@ uint32_t psx_mc1_get_pad_write_delay(psx_mc1_t *mc1)
     return DEFAULT_DLY;
 }
 
+void psx_mc1_save_state(psx_mc1_t *mc1, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_MC1);
+    psx_state_write(state, mc1, sizeof(psx_mc1_t));
+    psx_state_end_chunk(state);
+}
+
+int psx_mc1_load_state(psx_mc1_t *mc1, psx_state_t *state)
+{
+    return psx_state_read_chunk(state, PSX_STATE_MC1, mc1, sizeof(psx_mc1_t));
+}
+
 void psx_mc1_destroy(psx_mc1_t *mc1)
 {
     free(mc1);
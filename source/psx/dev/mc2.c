@@ -77,6 +77,18 @@ void psx_mc2_write8(psx_mc2_t *mc2, uint32_t offset, uint8_t value)
     log_warn("Unhandled 8-bit MC2 write at offset %08x (%02x)", offset, value);
 }
 
+void psx_mc2_save_state(psx_mc2_t *mc2, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_MC2);
+    psx_state_write(state, mc2, sizeof(psx_mc2_t));
+    psx_state_end_chunk(state);
+}
+
+int psx_mc2_load_state(psx_mc2_t *mc2, psx_state_t *state)
+{
+    return psx_state_read_chunk(state, PSX_STATE_MC2, mc2, sizeof(psx_mc2_t));
+}
+
 void psx_mc2_destroy(psx_mc2_t *mc2)
 {
     free(mc2);
@@ -74,6 +74,18 @@ void psx_mc3_write8(psx_mc3_t *mc3, uint32_t offset, uint8_t value)
     log_warn("Unhandled 8-bit MC3 write at offset %08x (%02x)", offset, value);
 }
 
+void psx_mc3_save_state(psx_mc3_t *mc3, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_MC3);
+    psx_state_write(state, mc3, sizeof(psx_mc3_t));
+    psx_state_end_chunk(state);
+}
+
+int psx_mc3_load_state(psx_mc3_t *mc3, psx_state_t *state)
+{
+    return psx_state_read_chunk(state, PSX_STATE_MC3, mc3, sizeof(psx_mc3_t));
+}
+
 void psx_mc3_destroy(psx_mc3_t *mc3)
 {
     free(mc3);
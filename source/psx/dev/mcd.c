@@ -257,6 +257,30 @@ void psx_mcd_reset(psx_mcd_t *mcd)
     mcd->state = MCD_STATE_TX_HIZ;
 }
 
+// Written into the pad's MCD chunks, the card's contents go with it
+void psx_mcd_save_state(psx_mcd_t *mcd, psx_state_t *state)
+{
+    psx_state_write(state, mcd, sizeof(psx_mcd_t));
+    PSX_STATE_CLEAR(state, psx_mcd_t, path);
+    PSX_STATE_CLEAR(state, psx_mcd_t, buf);
+    psx_state_write(state, mcd->buf, MCD_MEMORY_SIZE);
+}
+
+int psx_mcd_load_state(psx_mcd_t *mcd, psx_state_t *state)
+{
+    const char *path = mcd->path;
+    uint8_t *buf = mcd->buf;
+
+    psx_state_read(state, mcd, sizeof(psx_mcd_t));
+
+    mcd->path = path;
+    mcd->buf = buf;
+
+    psx_state_read(state, mcd->buf, MCD_MEMORY_SIZE);
+
+    return 0;
+}
+
 void psx_mcd_destroy(psx_mcd_t *mcd)
 {
     FILE *file = NULL;
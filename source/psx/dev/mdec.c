@@ -5,7 +5,7 @@
 #include <string.h>
 #include <stdlib.h>
 
-int zigzag[] = {
+const int zigzag[] = {
     0, 1, 5, 6, 14, 15, 27, 28,
     2, 4, 7, 13, 16, 26, 29, 42,
     3, 8, 12, 17, 25, 30, 41, 43,
@@ -15,7 +15,7 @@ int zigzag[] = {
     21, 34, 37, 47, 50, 56, 59, 61,
     35, 36, 48, 49, 57, 58, 62, 63};
 
-int zagzig[] = {
+const int zagzig[] = {
     0, 1, 8, 16, 9, 2, 3, 10,
     17, 24, 32, 25, 18, 11, 4, 5,
     12, 19, 26, 33, 40, 48, 41, 34,
@@ -25,7 +25,7 @@ int zagzig[] = {
     58, 59, 52, 45, 38, 31, 39, 46,
     53, 60, 61, 54, 47, 55, 62, 63};
 
-float scalezag[] = {
+const float scalezag[] = {
     0.125000, 0.173380, 0.173380, 0.163320, 0.240485, 0.163320, 0.146984, 0.226532,
     0.226532, 0.146984, 0.125000, 0.203873, 0.213388, 0.203873, 0.125000, 0.098212,
     0.173380, 0.192044, 0.192044, 0.173380, 0.098212, 0.067650, 0.136224, 0.163320,
@@ -285,7 +285,7 @@ void mdec_set_scale(psx_mdec_t *mdec)
     memcpy(mdec->scale_table, mdec->input, 128);
 }
 
-mdec_fn_t g_mdec_cmd_table[] = {
+const mdec_fn_t g_mdec_cmd_table[] = {
     mdec_nop,
     mdec_decode_macroblock,
     mdec_set_iqtab,
@@ -407,6 +407,8 @@ void psx_mdec_write32(psx_mdec_t *mdec, uint32_t offset, uint32_t value)
                 g_mdec_cmd_table[mdec->cmd >> 29](mdec);
 
                 free(mdec->input);
+
+                mdec->input = NULL;
             }
 
             break;
@@ -521,6 +523,52 @@ void psx_mdec_write8(psx_mdec_t *mdec, uint32_t offset, uint8_t value)
     printf("Unhandled 8-bit MDEC write offset=%u, value=%02x\n", offset, value);
 }
 
+void psx_mdec_save_state(psx_mdec_t *mdec, psx_state_t *state)
+{
+    // Only the part of the output that's still to be read is saved
+    uint32_t input_size = mdec->input ? (uint32_t)mdec->input_size : 0;
+    uint32_t output_size = mdec->output ? ((mdec->output_index + mdec->output_words_remaining) << 2) : 0;
+
+    psx_state_begin_chunk(state, PSX_STATE_MDEC);
+    psx_state_write(state, &input_size, sizeof(uint32_t));
+    psx_state_write(state, &output_size, sizeof(uint32_t));
+    psx_state_write(state, mdec, sizeof(psx_mdec_t));
+    PSX_STATE_CLEAR(state, psx_mdec_t, input);
+    PSX_STATE_CLEAR(state, psx_mdec_t, output);
+    psx_state_write(state, mdec->input, input_size);
+    psx_state_write(state, mdec->output, output_size);
+    psx_state_end_chunk(state);
+}
+
+int psx_mdec_load_state(psx_mdec_t *mdec, psx_state_t *state)
+{
+    uint32_t input_size, output_size;
+
+    int size = psx_state_next_chunk(state, PSX_STATE_MDEC);
+
+    if (size < (int)(sizeof(psx_mdec_t) + (2 * sizeof(uint32_t))))
+        return 1;
+
+    psx_state_read(state, &input_size, sizeof(uint32_t));
+    psx_state_read(state, &output_size, sizeof(uint32_t));
+
+    if ((size_t)size != (sizeof(psx_mdec_t) + (2 * sizeof(uint32_t)) + input_size + output_size))
+        return 1;
+
+    free(mdec->input);
+    free(mdec->output);
+
+    psx_state_read(state, mdec, sizeof(psx_mdec_t));
+
+    mdec->input = input_size ? malloc(input_size) : NULL;
+    mdec->output = output_size ? malloc(output_size) : NULL;
+
+    psx_state_read(state, mdec->input, input_size);
+    psx_state_read(state, mdec->output, output_size);
+
+    return 0;
+}
+
 void psx_mdec_destroy(psx_mdec_t *mdec)
 {
     free(mdec);
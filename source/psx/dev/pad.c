@@ -62,8 +62,18 @@ uint32_t pad_read_rx(psx_pad_t *pad)
     return 0xffffffff;
 }
 
+static void pad_schedule_irq(psx_pad_t *pad, int cycles)
+{
+    pad->cycles_until_irq = cycles;
+
+    psx_sched_reschedule(pad->sched, PSX_SCHED_PAD);
+}
+
 void pad_write_tx(psx_pad_t *pad, uint16_t data)
 {
+    // Bring a pending IRQ countdown up to date
+    psx_sched_sync(pad->sched, PSX_SCHED_PAD);
+
     int slot = (pad->ctrl >> 13) & 1;
 
     psx_input_t *joy = pad->joy_slot[slot];
@@ -85,7 +95,7 @@ void pad_write_tx(psx_pad_t *pad, uint16_t data)
                 return;
 
             if (pad->ctrl & CTRL_ACIE)
-                pad->cycles_until_irq = JOY_IRQ_DELAY;
+                pad_schedule_irq(pad, JOY_IRQ_DELAY);
         }
     }
     else
@@ -122,7 +132,7 @@ void pad_write_tx(psx_pad_t *pad, uint16_t data)
             if (pad->ctrl & CTRL_ACIE)
             {
                 pad->irq_bit = 1;
-                pad->cycles_until_irq = 1024;
+                pad_schedule_irq(pad, 1024);
 
                 return;
             }
@@ -136,7 +146,7 @@ void pad_write_tx(psx_pad_t *pad, uint16_t data)
         if (pad->ctrl & CTRL_ACIE)
         {
             pad->irq_bit = 1;
-            pad->cycles_until_irq = (pad->dest[slot] == DEST_MCD) ? 2048 : JOY_IRQ_DELAY;
+            pad_schedule_irq(pad, (pad->dest[slot] == DEST_MCD) ? 2048 : JOY_IRQ_DELAY);
         }
     }
 }
@@ -173,11 +183,24 @@ psx_pad_t *psx_pad_create(void)
     return (psx_pad_t *)malloc(sizeof(psx_pad_t));
 }
 
-void psx_pad_init(psx_pad_t *pad, psx_ic_t *ic)
+static void pad_sched_update(void *udata, int cycles)
+{
+    psx_pad_update((psx_pad_t *)udata, cycles);
+}
+
+static uint64_t pad_sched_next(void *udata)
+{
+    psx_pad_t *pad = (psx_pad_t *)udata;
+
+    return pad->cycles_until_irq ? (uint64_t)pad->cycles_until_irq : PSX_SCHED_NEVER;
+}
+
+void psx_pad_init(psx_pad_t *pad, psx_ic_t *ic, psx_sched_t *sched)
 {
     memset(pad, 0, sizeof(psx_pad_t));
 
     pad->ic = ic;
+    pad->sched = sched;
 
     pad->io_base = PSX_PAD_BEGIN;
     pad->io_size = PSX_PAD_SIZE;
@@ -186,6 +209,8 @@ void psx_pad_init(psx_pad_t *pad, psx_ic_t *ic)
     pad->joy_slot[1] = NULL;
     pad->mcd_slot[0] = NULL;
     pad->mcd_slot[1] = NULL;
+
+    psx_sched_register(sched, PSX_SCHED_PAD, pad_sched_update, pad_sched_next, pad);
 }
 
 uint32_t psx_pad_read32(psx_pad_t *pad, uint32_t offset)
@@ -447,6 +472,71 @@ void psx_pad_update(psx_pad_t *pad, int cyc)
     }
 }
 
+void psx_pad_save_state(psx_pad_t *pad, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_PAD);
+    psx_state_write(state, pad, sizeof(psx_pad_t));
+    PSX_STATE_CLEAR(state, psx_pad_t, ic);
+    PSX_STATE_CLEAR(state, psx_pad_t, sched);
+    PSX_STATE_CLEAR(state, psx_pad_t, joy_slot);
+    PSX_STATE_CLEAR(state, psx_pad_t, mcd_slot);
+    psx_state_end_chunk(state);
+
+    // One chunk per slot, empty if there's no card in it
+    for (int i = 0; i < 2; i++)
+    {
+        psx_state_begin_chunk(state, PSX_STATE_MCD);
+
+        if (pad->mcd_slot[i])
+            psx_mcd_save_state(pad->mcd_slot[i], state);
+
+        psx_state_end_chunk(state);
+    }
+}
+
+int psx_pad_load_state(psx_pad_t *pad, psx_state_t *state)
+{
+    psx_pad_t copy = *pad;
+
+    if (psx_state_read_chunk(state, PSX_STATE_PAD, pad, sizeof(psx_pad_t)))
+        return 1;
+
+    // Controllers and memory cards stay plugged in
+    pad->ic = copy.ic;
+    pad->sched = copy.sched;
+    pad->joy_slot[0] = copy.joy_slot[0];
+    pad->joy_slot[1] = copy.joy_slot[1];
+    pad->mcd_slot[0] = copy.mcd_slot[0];
+    pad->mcd_slot[1] = copy.mcd_slot[1];
+
+    for (int i = 0; i < 2; i++)
+    {
+        int size = psx_state_next_chunk(state, PSX_STATE_MCD);
+
+        if (size < 0)
+            return 1;
+
+        if (!size)
+            continue;
+
+        if (size != (int)(sizeof(psx_mcd_t) + MCD_MEMORY_SIZE))
+            return 1;
+
+        if (!pad->mcd_slot[i])
+        {
+            log_warn("State has a memory card in slot %u, but the slot is empty", i + 1);
+
+            psx_state_skip(state, size);
+
+            continue;
+        }
+
+        psx_mcd_load_state(pad->mcd_slot[i], state);
+    }
+
+    return 0;
+}
+
 void psx_pad_destroy(psx_pad_t *pad)
 {
     psx_pad_detach_joy(pad, 0);
@@ -10,7 +10,8 @@ psx_ram_t *psx_ram_create(void)
     return (psx_ram_t *)malloc(sizeof(psx_ram_t));
 }
 
-void psx_ram_init(psx_ram_t *ram, psx_mc2_t *mc2, int size)
+// buf is allocated here if NULL
+void psx_ram_init(psx_ram_t *ram, psx_mc2_t *mc2, int size, uint8_t *buf)
 {
     memset(ram, 0, sizeof(psx_ram_t));
 
@@ -18,7 +19,7 @@ void psx_ram_init(psx_ram_t *ram, psx_mc2_t *mc2, int size)
     ram->io_size = PSX_RAM_SIZE;
 
     ram->mc2 = mc2;
-    ram->buf = (uint8_t *)malloc(size);
+    ram->buf = buf ? buf : (uint8_t *)malloc(size);
     ram->size = size;
 
     // Size has to be a multiple of 2MB, default to 2MB
@@ -26,6 +27,7 @@ void psx_ram_init(psx_ram_t *ram, psx_mc2_t *mc2, int size)
         size = RAM_SIZE_2MB;
 
     memset(ram->buf, RAM_INIT_FILL, size);
+    memset(ram->dirty, 0xff, sizeof(ram->dirty));
 }
 
 uint32_t psx_ram_read32(psx_ram_t *ram, uint32_t offset)
@@ -65,6 +67,8 @@ void psx_ram_write32(psx_ram_t *ram, uint32_t offset, uint32_t value)
 {
     offset &= ram->size - 1;
 
+    psx_dirty_set(ram->dirty, offset >> PSX_RAM_PAGE_SHIFT);
+
     *((uint32_t *)(ram->buf + offset)) = value;
 }
 
@@ -72,6 +76,8 @@ void psx_ram_write16(psx_ram_t *ram, uint32_t offset, uint16_t value)
 {
     offset &= ram->size - 1;
 
+    psx_dirty_set(ram->dirty, offset >> PSX_RAM_PAGE_SHIFT);
+
     *((uint16_t *)(ram->buf + offset)) = value;
 }
 
@@ -79,9 +85,71 @@ void psx_ram_write8(psx_ram_t *ram, uint32_t offset, uint8_t value)
 {
     offset &= ram->size - 1;
 
+    psx_dirty_set(ram->dirty, offset >> PSX_RAM_PAGE_SHIFT);
+
     ram->buf[offset] = value;
 }
 
+const uint8_t *psx_ram_get_dirty(psx_ram_t *ram)
+{
+    return ram->dirty;
+}
+
+void psx_ram_mark_dirty(psx_ram_t *ram, uint32_t offset, uint32_t size)
+{
+    if (!size)
+        return;
+
+    uint32_t first = (offset & (ram->size - 1)) >> PSX_RAM_PAGE_SHIFT;
+    uint32_t last = ((offset + size - 1) & (ram->size - 1)) >> PSX_RAM_PAGE_SHIFT;
+
+    // Ranges that wrap around the end of RAM mark everything
+    if ((last < first) || (size >= ram->size))
+    {
+        first = 0;
+        last = (ram->size >> PSX_RAM_PAGE_SHIFT) - 1;
+    }
+
+    psx_dirty_set_range(ram->dirty, first, last - first + 1);
+}
+
+void psx_ram_clear_dirty(psx_ram_t *ram)
+{
+    memset(ram->dirty, 0, sizeof(ram->dirty));
+}
+
+void psx_ram_save_state(psx_ram_t *ram, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_RAM);
+    psx_state_write(state, ram, sizeof(psx_ram_t));
+    PSX_STATE_CLEAR(state, psx_ram_t, mc2);
+    PSX_STATE_CLEAR(state, psx_ram_t, buf);
+    PSX_STATE_CLEAR(state, psx_ram_t, dirty);
+    psx_state_write(state, ram->buf, ram->size);
+    psx_state_end_chunk(state);
+}
+
+int psx_ram_load_state(psx_ram_t *ram, psx_state_t *state)
+{
+    psx_mc2_t *mc2 = ram->mc2;
+    uint8_t *buf = ram->buf;
+
+    if (psx_state_next_chunk(state, PSX_STATE_RAM) != (int)(sizeof(psx_ram_t) + ram->size))
+        return 1;
+
+    psx_state_read(state, ram, sizeof(psx_ram_t));
+
+    ram->mc2 = mc2;
+    ram->buf = buf;
+
+    psx_state_read(state, ram->buf, ram->size);
+
+    // Everything may have changed
+    memset(ram->dirty, 0xff, sizeof(ram->dirty));
+
+    return 0;
+}
+
 void psx_ram_destroy(psx_ram_t *ram)
 {
     free(ram->buf);
@@ -10,14 +10,15 @@ psx_scratchpad_t *psx_scratchpad_create(void)
     return (psx_scratchpad_t *)malloc(sizeof(psx_scratchpad_t));
 }
 
-void psx_scratchpad_init(psx_scratchpad_t *scratchpad)
+// buf is allocated here if NULL
+void psx_scratchpad_init(psx_scratchpad_t *scratchpad, uint8_t *buf)
 {
     memset(scratchpad, 0, sizeof(psx_scratchpad_t));
 
     scratchpad->io_base = PSX_SCRATCHPAD_BEGIN;
     scratchpad->io_size = PSX_SCRATCHPAD_SIZE;
 
-    scratchpad->buf = (uint8_t *)malloc(PSX_SCRATCHPAD_SIZE);
+    scratchpad->buf = buf ? buf : (uint8_t *)malloc(PSX_SCRATCHPAD_SIZE);
 }
 
 uint32_t psx_scratchpad_read32(psx_scratchpad_t *scratchpad, uint32_t offset)
@@ -50,6 +51,31 @@ void psx_scratchpad_write8(psx_scratchpad_t *scratchpad, uint32_t offset, uint8_
     scratchpad->buf[offset] = value;
 }
 
+void psx_scratchpad_save_state(psx_scratchpad_t *scratchpad, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_SCRATCHPAD);
+    psx_state_write(state, scratchpad, sizeof(psx_scratchpad_t));
+    PSX_STATE_CLEAR(state, psx_scratchpad_t, buf);
+    psx_state_write(state, scratchpad->buf, PSX_SCRATCHPAD_SIZE);
+    psx_state_end_chunk(state);
+}
+
+int psx_scratchpad_load_state(psx_scratchpad_t *scratchpad, psx_state_t *state)
+{
+    uint8_t *buf = scratchpad->buf;
+
+    if (psx_state_next_chunk(state, PSX_STATE_SCRATCHPAD) != (int)(sizeof(psx_scratchpad_t) + PSX_SCRATCHPAD_SIZE))
+        return 1;
+
+    psx_state_read(state, scratchpad, sizeof(psx_scratchpad_t));
+
+    scratchpad->buf = buf;
+
+    psx_state_read(state, scratchpad->buf, PSX_SCRATCHPAD_SIZE);
+
+    return 0;
+}
+
 void psx_scratchpad_destroy(psx_scratchpad_t *scratchpad)
 {
     free(scratchpad->buf);
@@ -10,6 +10,9 @@
 
 #define VOICE_COUNT 24
 
+#define SPU_MARK_DIRTY(addr) \
+    psx_dirty_set(spu->dirty, ((addr) & (SPU_RAM_SIZE - 1)) >> SPU_RAM_PAGE_SHIFT)
+
 // static float interpolate_hermite(float a, float b, float c, float d, float t) {
 //     float x = -a/2.0f + (3.0f*b)/2.0f - (3.0f*c)/2.0f + d/2.0f;
 //     float y = a - (5.0f*b)/2.0f + 2.0f*c - d / 2.0f;
@@ -96,7 +99,8 @@ psx_spu_t *psx_spu_create(void)
     return (psx_spu_t *)malloc(sizeof(psx_spu_t));
 }
 
-void psx_spu_init(psx_spu_t *spu, psx_ic_t *ic)
+// buf is allocated here if NULL
+void psx_spu_init(psx_spu_t *spu, psx_ic_t *ic, uint8_t *buf)
 {
     memset(spu, 0, sizeof(psx_spu_t));
 
@@ -104,9 +108,10 @@ void psx_spu_init(psx_spu_t *spu, psx_ic_t *ic)
     spu->io_size = PSX_SPU_SIZE;
 
     spu->ic = ic;
-    spu->ram = (uint8_t *)malloc(SPU_RAM_SIZE);
+    spu->ram = buf ? buf : (uint8_t *)malloc(SPU_RAM_SIZE);
 
     memset(spu->ram, 0, SPU_RAM_SIZE);
+    memset(spu->dirty, 0xff, sizeof(spu->dirty));
 
     // Mute all voices
     spu->endx = 0x00ffffff;
@@ -438,6 +443,8 @@ int spu_handle_write(psx_spu_t *spu, uint32_t offset, uint32_t value)
             {
                 for (int i = 0; i < spu->tfifo_index; i++)
                 {
+                    SPU_MARK_DIRTY(spu->taddr);
+
                     spu->ram[spu->taddr++] = spu->tfifo[i] & 0xff;
                     spu->ram[spu->taddr++] = spu->tfifo[i] >> 8;
                 }
@@ -458,6 +465,8 @@ int spu_handle_write(psx_spu_t *spu, uint32_t offset, uint32_t value)
         {
             for (int i = 0; i < spu->tfifo_index; i++)
             {
+                SPU_MARK_DIRTY(spu->taddr);
+
                 spu->ram[spu->taddr++] = spu->tfifo[i] & 0xff;
                 spu->ram[spu->taddr++] = spu->tfifo[i] >> 8;
             }
@@ -506,6 +515,47 @@ void psx_spu_write8(psx_spu_t *spu, uint32_t offset, uint8_t value)
     printf("Unhandled 8-bit SPU write at offset %08x (%02x)\n", offset, value);
 }
 
+const uint8_t *psx_spu_get_dirty(psx_spu_t *spu)
+{
+    return spu->dirty;
+}
+
+void psx_spu_clear_dirty(psx_spu_t *spu)
+{
+    memset(spu->dirty, 0, sizeof(spu->dirty));
+}
+
+void psx_spu_save_state(psx_spu_t *spu, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_SPU);
+    psx_state_write(state, spu, sizeof(psx_spu_t));
+    PSX_STATE_CLEAR(state, psx_spu_t, ic);
+    PSX_STATE_CLEAR(state, psx_spu_t, ram);
+    PSX_STATE_CLEAR(state, psx_spu_t, dirty);
+    psx_state_write(state, spu->ram, SPU_RAM_SIZE);
+    psx_state_end_chunk(state);
+}
+
+int psx_spu_load_state(psx_spu_t *spu, psx_state_t *state)
+{
+    psx_ic_t *ic = spu->ic;
+    uint8_t *ram = spu->ram;
+
+    if (psx_state_next_chunk(state, PSX_STATE_SPU) != (int)(sizeof(psx_spu_t) + SPU_RAM_SIZE))
+        return 1;
+
+    psx_state_read(state, spu, sizeof(psx_spu_t));
+
+    spu->ic = ic;
+    spu->ram = ram;
+
+    psx_state_read(state, spu->ram, SPU_RAM_SIZE);
+
+    memset(spu->dirty, 0xff, sizeof(spu->dirty));
+
+    return 0;
+}
+
 void psx_spu_destroy(psx_spu_t *spu)
 {
     free(spu->ram);
@@ -531,6 +581,8 @@ void spu_write_reverb(psx_spu_t *spu, uint32_t addr, int16_t value)
     uint32_t relative = (addr + spu->revbaddr - mbase) % (0x80000 - mbase);
     uint32_t wrapped = (mbase + relative) & 0x7fffe;
 
+    SPU_MARK_DIRTY(wrapped);
+
     *(int16_t *)(spu->ram + wrapped) = value;
 }
 
@@ -779,8 +831,6 @@ uint32_t psx_spu_get_sample(psx_spu_t *spu)
     return clampl | (((uint32_t)clampr) << 16);
 }
 
-int counter = 0;
-
 void psx_spu_update_cdda_buffer(psx_spu_t *spu, void *buf)
 {
     int16_t *ptr = buf;
@@ -792,6 +842,9 @@ void psx_spu_update_cdda_buffer(psx_spu_t *spu, void *buf)
         ram[i + 0x400] = *ptr++;
     }
 
+    // The capture buffers fill the first 4 KiB
+    psx_dirty_set_range(spu->dirty, 0, 0x1000 >> SPU_RAM_PAGE_SHIFT);
+
     // Little bit of lowpass/smoothing
     for (int i = 0; i < 0x400; i += 8)
     {
@@ -812,16 +865,17 @@ void psx_spu_update_cdda_buffer(psx_spu_t *spu, void *buf)
     {
         if (spu->irq9addr <= 0x1ff)
         {
-            if (!counter)
+            if (!spu->cdda_irq_counter)
             {
                 psx_ic_irq(spu->ic, IC_SPU);
             }
 
-            counter++;
-            counter &= 0x1;
+            spu->cdda_irq_counter++;
+            spu->cdda_irq_counter &= 0x1;
         }
     }
 }
 
 #undef CLAMP
-#undef MAX
\ No newline at end of file
+#undef MAX
+#undef SPU_MARK_DIRTY
\ No newline at end of file
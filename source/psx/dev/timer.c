@@ -1,6 +1,7 @@
 #include <stdint.h>
 #include <stdlib.h>
 #include <string.h>
+#include <limits.h>
 
 #include "psx/dev/timer.h"
 #include "psx/log.h"
@@ -161,7 +162,10 @@ psx_timer_t *psx_timer_create(void)
     return (psx_timer_t *)malloc(sizeof(psx_timer_t));
 }
 
-void psx_timer_init(psx_timer_t *timer, psx_ic_t *ic, psx_gpu_t *gpu)
+static void timer_sched_update(void *udata, int cycles);
+static uint64_t timer_sched_next(void *udata);
+
+void psx_timer_init(psx_timer_t *timer, psx_ic_t *ic, psx_gpu_t *gpu, psx_sched_t *sched)
 {
     memset(timer, 0, sizeof(psx_timer_t));
 
@@ -170,17 +174,23 @@ void psx_timer_init(psx_timer_t *timer, psx_ic_t *ic, psx_gpu_t *gpu)
 
     timer->ic = ic;
     timer->gpu = gpu;
+    timer->sched = sched;
+    timer->last_instructions = sched->instructions;
+
+    psx_sched_register(sched, PSX_SCHED_TIMER, timer_sched_update, timer_sched_next, timer);
 }
 
 uint32_t psx_timer_read32(psx_timer_t *timer, uint32_t offset)
 {
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
     int index = offset >> 4;
     int reg = offset & 0xf;
 
     switch (reg)
     {
     case 0:
-        return timer->timer[index].counter;
+        return timer->timer[index].counter >> 16;
     case 4:
         return timer_get_mode(timer, index);
     case 8:
@@ -194,13 +204,15 @@ uint32_t psx_timer_read32(psx_timer_t *timer, uint32_t offset)
 
 uint16_t psx_timer_read16(psx_timer_t *timer, uint32_t offset)
 {
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
     int index = offset >> 4;
     int reg = offset & 0xf;
 
     switch (reg)
     {
     case 0:
-        return timer->timer[index].counter;
+        return timer->timer[index].counter >> 16;
     case 4:
         return timer_get_mode(timer, index);
     case 8:
@@ -223,13 +235,15 @@ void timer_handle_irq(psx_timer_t *timer, int i);
 
 void psx_timer_write32(psx_timer_t *timer, uint32_t offset, uint32_t value)
 {
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
     int index = offset >> 4;
     int reg = offset & 0xf;
 
     switch (reg)
     {
     case 0:
-        timer->timer[index].counter = value & 0xffff;
+        timer->timer[index].counter = (value & 0xffff) << 16;
         break;
     case 4:
         timer_set_mode(timer, index, value);
@@ -240,17 +254,21 @@ void psx_timer_write32(psx_timer_t *timer, uint32_t offset, uint32_t value)
     }
 
     timer_handle_irq(timer, index);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
 }
 
 void psx_timer_write16(psx_timer_t *timer, uint32_t offset, uint16_t value)
 {
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
     int index = offset >> 4;
     int reg = offset & 0xf;
 
     switch (reg)
     {
     case 0:
-        timer->timer[index].counter = value & 0xffff;
+        timer->timer[index].counter = (value & 0xffff) << 16;
         break;
     case 4:
         timer_set_mode(timer, index, value);
@@ -261,6 +279,8 @@ void psx_timer_write16(psx_timer_t *timer, uint32_t offset, uint16_t value)
     }
 
     timer_handle_irq(timer, index);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
 }
 
 void psx_timer_write8(psx_timer_t *timer, uint32_t offset, uint8_t value)
@@ -272,15 +292,15 @@ void timer_handle_irq(psx_timer_t *timer, int i)
 {
     int irq = 0;
 
-    int target_reached = timer->timer[i].counter > timer->timer[i].target;
-    int max_reached = timer->timer[i].counter > 65535.0f;
+    int target_reached = timer->timer[i].counter > ((uint64_t)timer->timer[i].target << 16);
+    int max_reached = timer->timer[i].counter > (0xffffull << 16);
 
     if (target_reached)
     {
         timer->timer[i].target_reached = 1;
 
         // if ((i == 1) && (T1_CLKSRC == 1))
-        //     printf("target %04x (%f) reached\n", timer->timer[i].target, timer->timer[i].counter);
+        //     printf("target %04x (%u) reached\n", timer->timer[i].target, (uint32_t)(timer->timer[i].counter >> 16));
 
         if (timer->timer[i].reset_target)
             timer->timer[i].counter = 0;
@@ -332,18 +352,19 @@ void timer_handle_irq(psx_timer_t *timer, int i)
     }
 }
 
-float timer_get_dotclock_div(psx_timer_t *timer)
+// Dotclock ticks per system clock tick, 16.16 fixed-point
+uint32_t timer_get_dotclock_step(psx_timer_t *timer)
 {
-    static const float dmode_dotclk_div_table[] = {
-        10.0f, 8.0f, 5.0f, 4.0f};
+    static const uint32_t dmode_dotclk_div_table[] = {
+        10, 8, 5, 4};
 
     if (timer->gpu->display_mode & 0x40)
     {
-        return 11.0f / 7.0f / 7.0f;
+        return (11 << 16) / (7 * 7);
     }
     else
     {
-        return 11.0f / 7.0f / dmode_dotclk_div_table[timer->gpu->display_mode & 0x3];
+        return (11 << 16) / (7 * dmode_dotclk_div_table[timer->gpu->display_mode & 0x3]);
     }
 }
 
@@ -355,11 +376,11 @@ void timer_update_timer0(psx_timer_t *timer, int cyc)
     if (T0_CLKSRC & 1)
     {
         // Dotclock test
-        T0_COUNTER += (float)cyc * timer_get_dotclock_div(timer);
+        T0_COUNTER += (uint64_t)cyc * timer_get_dotclock_step(timer);
     }
     else
     {
-        T0_COUNTER += (float)cyc;
+        T0_COUNTER += (uint64_t)cyc << 16;
     }
 
     timer_handle_irq(timer, 0);
@@ -376,7 +397,7 @@ void timer_update_timer1(psx_timer_t *timer, int cyc)
     }
     else
     {
-        T1_COUNTER += (float)cyc;
+        T1_COUNTER += (uint64_t)cyc << 16;
     }
 
     timer_handle_irq(timer, 1);
@@ -389,11 +410,11 @@ void timer_update_timer2(psx_timer_t *timer, int cyc)
 
     if (T2_CLKSRC <= 1)
     {
-        T2_COUNTER += (float)cyc;
+        T2_COUNTER += (uint64_t)cyc << 16;
     }
     else
     {
-        T2_COUNTER += ((float)cyc) / 8.0f;
+        T2_COUNTER += (uint64_t)cyc << 13;
     }
 
     timer_handle_irq(timer, 2);
@@ -404,20 +425,95 @@ void psx_timer_update(psx_timer_t *timer, int cyc)
     timer->prev_hblank = timer->hblank;
     timer->prev_vblank = timer->vblank;
 
-    timer_update_timer0(timer, 2);
-    timer_update_timer1(timer, 2);
-    timer_update_timer2(timer, 2);
+    timer_update_timer0(timer, cyc);
+    timer_update_timer1(timer, cyc);
+    timer_update_timer2(timer, cyc);
 }
 
-void psxe_gpu_hblank_event_cb(psx_gpu_t *gpu)
+static void timer_sched_update(void *udata, int cycles)
 {
-    psx_timer_t *timer = gpu->udata[1];
+    psx_timer_t *timer = (psx_timer_t *)udata;
+
+    uint64_t elapsed = timer->sched->instructions - timer->last_instructions;
+
+    timer->last_instructions = timer->sched->instructions;
+
+    if (elapsed > (INT_MAX / 2))
+        elapsed = INT_MAX / 2;
+
+    psx_timer_update(timer, (int)elapsed * 2);
+}
+
+// Counter increment per tick, 16.16 fixed-point
+static uint32_t timer_get_step(psx_timer_t *timer, int i)
+{
+    switch (i)
+    {
+    case 0:
+        return (T0_CLKSRC & 1) ? timer_get_dotclock_step(timer) : (1 << 16);
+    case 1:
+        return (T1_CLKSRC & 1) ? 0 : (1 << 16);
+    case 2:
+        return (T2_CLKSRC <= 1) ? (1 << 16) : (1 << 13);
+    }
+
+    return 0;
+}
 
+// Ticks until the counter goes past value
+static uint64_t timer_get_ticks_until(psx_timer_t *timer, int i, uint64_t value, uint32_t step)
+{
+    if (timer->timer[i].counter > value)
+        return PSX_SCHED_NEVER;
+
+    return ((value - timer->timer[i].counter) / step) + 1;
+}
+
+/*
+    Ticks are counted per instruction while the scheduler runs on
+    CPU cycles. Most instructions take 2 cycles or more, so this is
+    rarely late, an early update just schedules the remaining ticks.
+*/
+static uint64_t timer_sched_next(void *udata)
+{
+    psx_timer_t *timer = (psx_timer_t *)udata;
+
+    uint64_t next = PSX_SCHED_NEVER;
+
+    for (int i = 0; i < 3; i++)
+    {
+        uint32_t step = timer_get_step(timer, i);
+
+        if (timer->timer[i].paused || !step)
+            continue;
+
+        uint64_t target = (uint64_t)timer->timer[i].target << 16;
+        uint64_t ticks = timer_get_ticks_until(timer, i, target, step);
+
+        // Already past the target, IRQs fire on every update
+        if ((ticks == PSX_SCHED_NEVER) && timer->timer[i].irq_target)
+            if (timer->timer[i].irq_repeat || !timer->timer[i].irq_fired)
+                ticks = 1;
+
+        uint64_t max = timer_get_ticks_until(timer, i, 0xffffull << 16, step);
+
+        if (max < ticks)
+            ticks = max;
+
+        if (ticks < next)
+            next = ticks;
+    }
+
+    return next;
+}
+
+static void timer_hblank_event(psx_timer_t *timer)
+{
     timer->hblank = 1;
 
     if ((T1_CLKSRC & 1) && !T1_PAUSED)
     {
-        ++T1_COUNTER;
+        T1_COUNTER += 1 << 16;
 
         timer_handle_irq(timer, 1);
     }
@@ -450,10 +546,8 @@ void psxe_gpu_hblank_event_cb(psx_gpu_t *gpu)
     }
 }
 
-void psxe_gpu_hblank_end_event_cb(psx_gpu_t *gpu)
+static void timer_hblank_end_event(psx_timer_t *timer)
 {
-    psx_timer_t *timer = gpu->udata[1];
-
     timer->hblank = 0;
 
     if (!T0_SYNC_EN)
@@ -470,10 +564,8 @@ void psxe_gpu_hblank_end_event_cb(psx_gpu_t *gpu)
     }
 }
 
-void psxe_gpu_vblank_timer_event_cb(psx_gpu_t *gpu)
+static void timer_vblank_event(psx_timer_t *timer)
 {
-    psx_timer_t *timer = gpu->udata[1];
-
     timer->vblank = 1;
 
     if (!T1_SYNC_EN)
@@ -504,10 +596,8 @@ void psxe_gpu_vblank_timer_event_cb(psx_gpu_t *gpu)
     }
 }
 
-void psxe_gpu_vblank_end_event_cb(psx_gpu_t *gpu)
+static void timer_vblank_end_event(psx_timer_t *timer)
 {
-    psx_timer_t *timer = gpu->udata[1];
-
     timer->vblank = 0;
 
     if (!T1_SYNC_EN)
@@ -524,6 +614,76 @@ void psxe_gpu_vblank_end_event_cb(psx_gpu_t *gpu)
     }
 }
 
+void psxe_gpu_hblank_event_cb(psx_gpu_t *gpu)
+{
+    psx_timer_t *timer = gpu->udata[1];
+
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
+    timer_hblank_event(timer);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
+}
+
+void psxe_gpu_hblank_end_event_cb(psx_gpu_t *gpu)
+{
+    psx_timer_t *timer = gpu->udata[1];
+
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
+    timer_hblank_end_event(timer);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
+}
+
+void psxe_gpu_vblank_timer_event_cb(psx_gpu_t *gpu)
+{
+    psx_timer_t *timer = gpu->udata[1];
+
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
+    timer_vblank_event(timer);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
+}
+
+void psxe_gpu_vblank_end_event_cb(psx_gpu_t *gpu)
+{
+    psx_timer_t *timer = gpu->udata[1];
+
+    psx_sched_sync(timer->sched, PSX_SCHED_TIMER);
+
+    timer_vblank_end_event(timer);
+
+    psx_sched_reschedule(timer->sched, PSX_SCHED_TIMER);
+}
+
+void psx_timer_save_state(psx_timer_t *timer, psx_state_t *state)
+{
+    psx_state_begin_chunk(state, PSX_STATE_TIMER);
+    psx_state_write(state, timer, sizeof(psx_timer_t));
+    PSX_STATE_CLEAR(state, psx_timer_t, ic);
+    PSX_STATE_CLEAR(state, psx_timer_t, gpu);
+    PSX_STATE_CLEAR(state, psx_timer_t, sched);
+    psx_state_end_chunk(state);
+}
+
+int psx_timer_load_state(psx_timer_t *timer, psx_state_t *state)
+{
+    psx_ic_t *ic = timer->ic;
+    psx_gpu_t *gpu = timer->gpu;
+    psx_sched_t *sched = timer->sched;
+
+    if (psx_state_read_chunk(state, PSX_STATE_TIMER, timer, sizeof(psx_timer_t)))
+        return 1;
+
+    timer->ic = ic;
+    timer->gpu = gpu;
+    timer->sched = sched;
+
+    return 0;
+}
+
 void psx_timer_destroy(psx_timer_t *timer)
 {
     free(timer);
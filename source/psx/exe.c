@@ -29,6 +29,10 @@ int psx_exe_load(psx_cpu_t *cpu, const char *path)
     if (!fread(cpu->bus->ram->buf + offset, 1, hdr.filesz, file))
         return 3;
 
+    // RAM was written behind the bus' back, drop any decoded code
+    psx_ram_mark_dirty(cpu->bus->ram, offset, hdr.filesz);
+    psx_cpu_flush_cache(cpu);
+
     // Load initial register values
     cpu->pc = hdr.ipc;
     cpu->next_pc = cpu->pc + 4;
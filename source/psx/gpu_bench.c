@@ -0,0 +1,346 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "psx/gpu_bench.h"
+#include "psx/dev/gpu.h"
+#include "psx/dev/ic.h"
+#include "psx/sched.h"
+#include "psx/log.h"
+
+// VRAM is compared after every batch of primitives
+#define GPU_BENCH_BATCH 64
+
+typedef struct
+{
+    psx_gpu_t *gpu;
+    psx_ic_t *ic;
+    psx_sched_t *sched;
+} psx_gpu_bench_t;
+
+typedef struct
+{
+    const char *name;
+
+    // One GP0 command per frame, covering the whole drawing area
+    uint32_t cmd[16];
+    int size;
+
+    // E1 set before the command, sets the blending mode
+    uint32_t texpage;
+} psx_gpu_bench_scene_t;
+
+#define XY(x, y) (((uint32_t)(y) << 16) | (uint32_t)(x))
+#define UV(u, v, hi) (((uint32_t)(hi) << 16) | ((uint32_t)(v) << 8) | (uint32_t)(u))
+
+// Texture page 0 at x 512, 15-bit, semi-transparency mode in bits 5-6
+#define TEXPAGE(mode) (0x108 | ((mode) << 5))
+
+static const psx_gpu_bench_scene_t g_psx_gpu_bench_scenes[] = {
+    {"flat quad", {0x28204060, XY(0, 0), XY(640, 0), XY(0, 480), XY(640, 480)}, 5, TEXPAGE(0)},
+    {"fade quad", {0x2a101010, XY(0, 0), XY(640, 0), XY(0, 480), XY(640, 480)}, 5, TEXPAGE(2)},
+    {"average quad", {0x2a8040c0, XY(0, 0), XY(640, 0), XY(0, 480), XY(640, 480)}, 5, TEXPAGE(0)},
+    {"gouraud quad", {0x38ff0000, XY(0, 0), 0x0000ff00, XY(640, 0), 0x000000ff, XY(0, 480), 0x00ffffff, XY(640, 480)}, 8, TEXPAGE(0)},
+    {"gouraud add", {0x3aff0000, XY(0, 0), 0x0000ff00, XY(640, 0), 0x000000ff, XY(0, 480), 0x00ffffff, XY(640, 480)}, 8, TEXPAGE(1)},
+    {"textured quad", {0x2c808080, XY(0, 0), UV(0, 0, 0), XY(640, 0), UV(255, 0, TEXPAGE(0)), XY(0, 480), UV(0, 255, 0), XY(640, 480), UV(255, 255, 0)}, 9, TEXPAGE(0)},
+    {"textured add", {0x2e606060, XY(0, 0), UV(0, 0, 0), XY(640, 0), UV(255, 0, TEXPAGE(1)), XY(0, 480), UV(0, 255, 0), XY(640, 480), UV(255, 255, 0)}, 9, TEXPAGE(1)},
+    {"sprite quarter", {0x66808080, XY(0, 0), UV(0, 0, 0), XY(512, 480)}, 4, TEXPAGE(3)},
+    {"fade rect", {0x62202020, XY(0, 0), XY(640, 480)}, 3, TEXPAGE(2)}};
+
+#define GPU_BENCH_SCENES (sizeof(g_psx_gpu_bench_scenes) / sizeof(psx_gpu_bench_scene_t))
+
+static uint32_t gpu_bench_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *seed = x;
+}
+
+static double gpu_bench_now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static void gpu_bench_create(psx_gpu_bench_t *b, int simd)
+{
+    b->ic = psx_ic_create();
+    b->sched = psx_sched_create();
+    b->gpu = psx_gpu_create();
+
+    psx_ic_init(b->ic, NULL);
+    psx_sched_init(b->sched);
+    psx_gpu_init(b->gpu, b->ic, b->sched, NULL);
+    psx_gpu_set_simd(b->gpu, simd);
+}
+
+static void gpu_bench_destroy(psx_gpu_bench_t *b)
+{
+    psx_gpu_destroy(b->gpu);
+    psx_sched_destroy(b->sched);
+    psx_ic_destroy(b->ic);
+}
+
+static void gpu_bench_send(psx_gpu_t *gpu, const uint32_t *cmd, int size)
+{
+    for (int i = 0; i < size; i++)
+        psx_gpu_write32(gpu, 0, cmd[i]);
+}
+
+// Fills VRAM with the same noise on both GPUs and sets up a drawing
+// area covering all of it
+static void gpu_bench_reset(psx_gpu_t *gpu)
+{
+    uint32_t seed = 0x9e3779b9;
+
+    psx_gpu_sync(gpu);
+
+    for (int i = 0; i < (PSX_GPU_FB_WIDTH * PSX_GPU_FB_HEIGHT); i++)
+        gpu->vram[i] = gpu_bench_rand(&seed) >> 16;
+
+    static const uint32_t setup[] = {0xe1000000, 0xe3000000, 0xe407fdff, 0xe5000000, 0xe6000000};
+
+    gpu_bench_send(gpu, setup, sizeof(setup) / sizeof(uint32_t));
+}
+
+// Coordinates mostly on screen, some reaching past the drawing area
+static uint32_t gpu_bench_rand_xy(uint32_t *seed)
+{
+    int x = (int)(gpu_bench_rand(seed) % 1100) - 40;
+    int y = (int)(gpu_bench_rand(seed) % 600) - 40;
+
+    return XY(x & 0x7ff, y & 0x7ff);
+}
+
+// Builds a random polygon or rectangle, returns its size in words
+static int gpu_bench_rand_primitive(uint32_t *seed, uint32_t *cmd)
+{
+    uint32_t r = gpu_bench_rand(seed);
+    uint32_t color = gpu_bench_rand(seed) & 0xffffff;
+    uint32_t clut = gpu_bench_rand(seed) & 0x7fff;
+    uint32_t texpage = gpu_bench_rand(seed) & 0x1ff;
+    int n = 0;
+
+    // Rectangles, 0x60-0x7f
+    if (r & 1)
+    {
+        int op = 0x60 | ((r >> 1) & 0x1f);
+        int size = (op >> 3) & 3;
+
+        cmd[n++] = (op << 24) | color;
+        cmd[n++] = gpu_bench_rand_xy(seed);
+
+        if (op & RA_TEXTURED)
+            cmd[n++] = (clut << 16) | (gpu_bench_rand(seed) & 0xffff);
+
+        if (!size)
+            cmd[n++] = XY(gpu_bench_rand(seed) % 300, gpu_bench_rand(seed) % 300);
+
+        return n;
+    }
+
+    // Polygons, 0x20-0x3f
+    int op = 0x20 | ((r >> 1) & 0x1f);
+    int vertices = (op & PA_QUAD) ? 4 : 3;
+
+    cmd[n++] = (op << 24) | color;
+
+    for (int v = 0; v < vertices; v++)
+    {
+        if (v && (op & PA_SHADED))
+            cmd[n++] = gpu_bench_rand(seed) & 0xffffff;
+
+        cmd[n++] = gpu_bench_rand_xy(seed);
+
+        if (op & PA_TEXTURED)
+            cmd[n++] = (gpu_bench_rand(seed) & 0xffff) | ((v == 0) ? (clut << 16) : 0) | ((v == 1) ? (texpage << 16) : 0);
+    }
+
+    return n;
+}
+
+// Random E1 and E6 settings between primitives, for the blending
+// modes of untextured primitives and the mask bits, and small fills,
+// copies and uploads
+static int gpu_bench_rand_state(uint32_t *seed, uint32_t *cmd)
+{
+    uint32_t r = gpu_bench_rand(seed);
+
+    switch (r & 7)
+    {
+    case 0:
+        cmd[0] = 0x02000000 | (gpu_bench_rand(seed) & 0xffffff);
+        cmd[1] = XY(gpu_bench_rand(seed) % 1024, gpu_bench_rand(seed) % 512);
+        cmd[2] = XY(gpu_bench_rand(seed) % 128, gpu_bench_rand(seed) % 128);
+
+        return 3;
+
+    case 1:
+        cmd[0] = 0x80000000;
+        cmd[1] = XY(gpu_bench_rand(seed) % 1024, gpu_bench_rand(seed) % 512);
+        cmd[2] = XY(gpu_bench_rand(seed) % 1024, gpu_bench_rand(seed) % 512);
+        cmd[3] = XY(gpu_bench_rand(seed) % 128, gpu_bench_rand(seed) % 128);
+
+        return 4;
+
+    case 2:
+        // 4x6 pixels, 12 words
+        cmd[0] = 0xa0000000;
+        cmd[1] = XY(gpu_bench_rand(seed) % 1024, gpu_bench_rand(seed) % 512);
+        cmd[2] = XY(4, 6);
+
+        for (int i = 0; i < 12; i++)
+            cmd[3 + i] = gpu_bench_rand(seed);
+
+        return 15;
+    }
+
+    cmd[0] = (r & 8) ? (0xe1000000 | ((r >> 4) & 0x1ff)) : (0xe6000000 | ((r >> 4) & 3));
+
+    return 1;
+}
+
+static int gpu_bench_compare(psx_gpu_t *simd, psx_gpu_t *scalar, int primitive)
+{
+    psx_gpu_sync(simd);
+
+    for (int i = 0; i < (PSX_GPU_FB_WIDTH * PSX_GPU_FB_HEIGHT); i++)
+    {
+        if (simd->vram[i] == scalar->vram[i])
+            continue;
+
+        printf("gpu: primitives up to %d: pixel %d,%d = %04x, scalar %04x\n",
+            primitive, i % PSX_GPU_FB_WIDTH, i / PSX_GPU_FB_WIDTH, simd->vram[i], scalar->vram[i]);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+static int gpu_bench_check_random(psx_gpu_t *simd, psx_gpu_t *scalar, int count)
+{
+    int mismatches = 0;
+    uint32_t seed = 0x2545f491;
+    uint32_t cmd[16];
+
+    gpu_bench_reset(simd);
+    gpu_bench_reset(scalar);
+
+    for (int p = 0; p < count; p++)
+    {
+        int size = ((gpu_bench_rand(&seed) & 7) == 0) ? gpu_bench_rand_state(&seed, cmd) : gpu_bench_rand_primitive(&seed, cmd);
+
+        gpu_bench_send(simd, cmd, size);
+        gpu_bench_send(scalar, cmd, size);
+
+        if (((p + 1) % GPU_BENCH_BATCH) && ((p + 1) != count))
+            continue;
+
+        if (!gpu_bench_compare(simd, scalar, p))
+            continue;
+
+        // Start over from the same VRAM so one difference isn't
+        // reported for every batch after it
+        memcpy(simd->vram, scalar->vram, PSX_GPU_VRAM_SIZE);
+
+        if (++mismatches >= 16)
+            break;
+    }
+
+    return mismatches;
+}
+
+static double gpu_bench_time_scene(psx_gpu_t *gpu, const psx_gpu_bench_scene_t *scene, int frames)
+{
+    uint32_t texpage = 0xe1000000 | scene->texpage;
+
+    gpu_bench_reset(gpu);
+    gpu_bench_send(gpu, &texpage, 1);
+
+    double start = gpu_bench_now();
+
+    for (int i = 0; i < frames; i++)
+        gpu_bench_send(gpu, scene->cmd, scene->size);
+
+    psx_gpu_sync(gpu);
+
+    return (gpu_bench_now() - start) / (frames * 1e6);
+}
+
+int psx_gpu_bench_run(int primitives, int frames, int threads)
+{
+    psx_gpu_bench_t simd, scalar, banded;
+
+    gpu_bench_create(&simd, 1);
+    gpu_bench_create(&scalar, 0);
+    gpu_bench_create(&banded, 1);
+
+    psx_gpu_set_raster_threads(banded.gpu, threads);
+
+    int has_simd = simd.gpu->shade_span != g_psx_gpu_span_kernels;
+
+    int mismatches = 0;
+
+    if (has_simd)
+    {
+        mismatches = gpu_bench_check_random(simd.gpu, scalar.gpu, primitives);
+    }
+    else
+    {
+        log_info("No SIMD span kernels for this host, timing the scalar path only");
+    }
+
+    printf("gpu: %d mismatches\n", mismatches);
+
+    // The same stream drawn on a GPU thread, VRAM is read back through
+    // psx_gpu_sync like the frontend does
+    psx_gpu_bench_t threaded;
+
+    gpu_bench_create(&threaded, 1);
+    psx_gpu_set_thread(threaded.gpu, 1);
+
+    int thread_mismatches = gpu_bench_check_random(threaded.gpu, scalar.gpu, primitives);
+
+    printf("gpu: %d mismatches on the GPU thread\n", thread_mismatches);
+
+    mismatches += thread_mismatches;
+
+    gpu_bench_destroy(&threaded);
+
+    int band_mismatches = gpu_bench_check_random(banded.gpu, scalar.gpu, primitives);
+
+    printf("gpu: %d mismatches on %d raster threads\n", band_mismatches, threads);
+
+    mismatches += band_mismatches;
+
+    for (unsigned int i = 0; i < GPU_BENCH_SCENES; i++)
+    {
+        const psx_gpu_bench_scene_t *scene = &g_psx_gpu_bench_scenes[i];
+
+        double t = gpu_bench_time_scene(scalar.gpu, scene, frames);
+        double tb = gpu_bench_time_scene(banded.gpu, scene, frames);
+
+        if (has_simd)
+        {
+            printf("gpu: %-16s %8.3f ms/frame, scalar %8.3f ms/frame, %d threads %8.3f ms/frame\n", scene->name, gpu_bench_time_scene(simd.gpu, scene, frames), t, threads, tb);
+        }
+        else
+        {
+            printf("gpu: %-16s %8.3f ms/frame, %d threads %8.3f ms/frame\n", scene->name, t, threads, tb);
+        }
+    }
+
+    gpu_bench_destroy(&banded);
+    gpu_bench_destroy(&simd);
+    gpu_bench_destroy(&scalar);
+
+    return mismatches;
+}
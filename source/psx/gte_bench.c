@@ -0,0 +1,307 @@
+#include <stdio.h>
+#include <string.h>
+#include <time.h>
+
+#include "psx/gte_bench.h"
+#include "psx/cpu.h"
+#include "psx/log.h"
+
+#define GTE_CMD(func, fields) (0x4a000000 | (fields) | (func))
+#define GTE_SF 0x80000
+#define GTE_LM 0x400
+#define GTE_MX(x) ((x) << 17)
+#define GTE_V(x) ((x) << 15)
+#define GTE_CV(x) ((x) << 13)
+
+typedef struct
+{
+    const char *name;
+    uint32_t opcode;
+} psx_gte_bench_op_t;
+
+static const psx_gte_bench_op_t g_psx_gte_bench_ops[] = {
+    {"rtps", GTE_CMD(0x01, GTE_SF)},
+    {"nclip", GTE_CMD(0x06, 0)},
+    {"op", GTE_CMD(0x0c, GTE_SF)},
+    {"dpcs", GTE_CMD(0x10, GTE_SF)},
+    {"intpl", GTE_CMD(0x11, GTE_SF)},
+    {"mvmva", GTE_CMD(0x12, GTE_SF | GTE_MX(0) | GTE_V(0) | GTE_CV(0))},
+    {"mvmva lr", GTE_CMD(0x12, GTE_SF | GTE_LM | GTE_MX(2) | GTE_V(3) | GTE_CV(1))},
+    {"mvmva fc", GTE_CMD(0x12, GTE_SF | GTE_MX(1) | GTE_V(1) | GTE_CV(2))},
+    {"ncds", GTE_CMD(0x13, GTE_SF | GTE_LM)},
+    {"cdp", GTE_CMD(0x14, GTE_SF | GTE_LM)},
+    {"ncdt", GTE_CMD(0x16, GTE_SF | GTE_LM)},
+    {"nccs", GTE_CMD(0x1b, GTE_SF | GTE_LM)},
+    {"cc", GTE_CMD(0x1c, GTE_SF | GTE_LM)},
+    {"ncs", GTE_CMD(0x1e, GTE_SF | GTE_LM)},
+    {"nct", GTE_CMD(0x20, GTE_SF | GTE_LM)},
+    {"sqr", GTE_CMD(0x28, GTE_SF)},
+    {"dcpl", GTE_CMD(0x29, GTE_SF)},
+    {"dpct", GTE_CMD(0x2a, GTE_SF)},
+    {"avsz3", GTE_CMD(0x2d, 0)},
+    {"avsz4", GTE_CMD(0x2e, 0)},
+    {"rtpt", GTE_CMD(0x30, GTE_SF)},
+    {"gpf", GTE_CMD(0x3d, GTE_SF)},
+    {"gpl", GTE_CMD(0x3e, GTE_SF)},
+    {"ncct", GTE_CMD(0x3f, GTE_SF | GTE_LM)}};
+
+#define GTE_BENCH_OPS (sizeof(g_psx_gte_bench_ops) / sizeof(psx_gte_bench_op_t))
+#define GTE_BENCH_STATES 3
+
+/*
+    Register states are indexed like MFC2/CFC2: 0-31 data, 32-63
+    control. SXYP, IRGB, ORGB and LZCR aren't written, they would
+    overwrite the FIFO and IR registers set up before them.
+*/
+static const uint32_t g_psx_gte_bench_states[GTE_BENCH_STATES][64] = {
+    // Perspective transform of a small triangle, 15 degree rotation
+    {
+        0xff9cff9c, 0x00000032, 0xff9c0064, 0x00000032, 0x00640000, 0xffffffce, 0x30806040, 0x00000000,
+        0x00000800, 0x00000400, 0x00000800, 0x00000c00, 0x00100010, 0x00200020, 0x00300030, 0x00000000,
+        0x00000100, 0x00000200, 0x00000300, 0x00000400, 0x00102030, 0x00405060, 0x00708090, 0x00000000,
+        0x00000000, 0x00001000, 0x00002000, 0x00003000, 0x00000000, 0x00000000, 0x00001234, 0x00000000,
+        0x00000f74, 0x00000424, 0x00001000, 0x0000fbdc, 0x00000f74, 0x00000000, 0x00000000, 0x000003e8,
+        0x08000800, 0x0000f4b0, 0x0b500000, 0xf8000000, 0x00000800, 0x00000200, 0x00000180, 0x00000100,
+        0x00001000, 0x00000000, 0x00000c00, 0x00000000, 0x00000a00, 0x00000800, 0x00000400, 0x00000200,
+        0x00a00000, 0x00780000, 0x00000200, 0xfffffec8, 0x01400000, 0x00000155, 0x00000100, 0x00000000,
+    },
+    // Lighting of unit normals with a colored light matrix
+    {
+        0x00000000, 0x00001000, 0x00000b50, 0x00000b50, 0xf0000000, 0x00000000, 0x20ff8040, 0x00000000,
+        0x00000400, 0x00000600, 0x00000300, 0x00000100, 0x00400040, 0x00500050, 0x00600060, 0x00000000,
+        0x00000800, 0x00000900, 0x00000a00, 0x00000b00, 0x00808080, 0x00404040, 0x00c0c0c0, 0x00000000,
+        0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0x00000000, 0xfff00000, 0x00000000,
+        0x00001000, 0x00000000, 0x00001000, 0x00000000, 0x00001000, 0x00000010, 0xffffffe0, 0x00000800,
+        0x093c093c, 0xf6c4093c, 0x093c0000, 0x0000f000, 0x00000000, 0x00000400, 0x00000300, 0x00000200,
+        0x08001000, 0x04000400, 0x04000c00, 0x02000200, 0x00000e00, 0x00000100, 0x00000080, 0x00000040,
+        0x00a00000, 0x00780000, 0x00000155, 0xffffff00, 0x00800000, 0x00000155, 0x00000100, 0x00000000,
+    },
+    // Values at the edges of every range, sets most FLAG bits
+    {
+        0x7fff8000, 0x00007fff, 0x80007fff, 0xffff8000, 0x7fff7fff, 0x00007fff, 0xffffffff, 0x0000ffff,
+        0x00007fff, 0xffff8000, 0x00007fff, 0xffff8000, 0x7fff8000, 0x80007fff, 0x7fff7fff, 0x00000000,
+        0x0000ffff, 0x00000000, 0x00000001, 0x00000001, 0xffffffff, 0x00000000, 0x00ffffff, 0xffffffff,
+        0x7fffffff, 0x80000000, 0x7fffffff, 0x80000000, 0x00000000, 0x00000000, 0x80000000, 0x00000000,
+        0x7fff7fff, 0x80007fff, 0x7fff8000, 0x7fff7fff, 0x00007fff, 0x7fffffff, 0x80000000, 0x7fffffff,
+        0x80008000, 0x7fff8000, 0x80007fff, 0x80008000, 0xffff8000, 0x7fffffff, 0x80000000, 0x7fffffff,
+        0x7fff7fff, 0x7fff7fff, 0x7fff7fff, 0x7fff7fff, 0x00007fff, 0x80000000, 0x7fffffff, 0x80000000,
+        0x7fffffff, 0x80000000, 0x0000ffff, 0x00007fff, 0x7fffffff, 0x00007fff, 0xffff8000, 0x00000000,
+    }};
+
+// FNV-1a of all 64 registers after running each operation on each
+// recorded state through the original interpreter's GTE, from before
+// the scalar and SIMD rework. A mismatch means results changed,
+// regenerate these only for intended accuracy fixes.
+static const uint32_t g_psx_gte_bench_hashes[GTE_BENCH_STATES][GTE_BENCH_OPS] = {
+    {
+        0x456fb552, 0x28a3f65b, 0x8b7d7e9b, 0x7dfd0383, 0x72f92393, 0x13dea85b, 0x9eb0df73, 0xfcac6ef3,
+        0x022a6498, 0x7f3cb453, 0xdea98068, 0xc8e3759a, 0x0eb13fec, 0x916a29ed, 0xb04424e9, 0xa8d0a077,
+        0x4cd384eb, 0x77e12587, 0x52160154, 0x774a6f15, 0xa996b0a0, 0xc39e1173, 0xa297aac2, 0x4979d502,
+    },
+    {
+        0x2e8d3041, 0x9caa6860, 0x8744a5c4, 0x22c6d082, 0x42c6818f, 0x31f0d894, 0xb5a73934, 0xc3733be8,
+        0x6a92b8f4, 0x2e7a05cf, 0xa28f89f1, 0x5cfa0638, 0x5dd0e5dc, 0xac6b16b6, 0x3c4b7a44, 0xb3c46f74,
+        0x43e9e7fa, 0x77723a2b, 0x8a58d5ac, 0x515241a8, 0xca8ecaa4, 0xea5407bc, 0xea5407bc, 0xd15456d3,
+    },
+    {
+        0x4731d5b7, 0x42973294, 0x586e3961, 0x42cbbbcb, 0x35d46b46, 0x2506b696, 0xc30faa4d, 0x7b96f264,
+        0x95a497c4, 0x79caa1dc, 0x04602a11, 0x96a4699b, 0x4ff6211e, 0x2eaf3307, 0x0a49e530, 0xc79b9656,
+        0x712a05c6, 0xd6140e6a, 0x979e82e1, 0xb862fb7f, 0x349d799e, 0xd4a3b12a, 0xe2cc9746, 0xc60c6b76,
+    }};
+
+static int gte_bench_is_written(int r)
+{
+    return (r != 15) && (r != 28) && (r != 29) && (r != 31);
+}
+
+static void gte_bench_load(psx_cpu_t *cpu, const uint32_t *state)
+{
+    for (int r = 0; r < 64; r++)
+        if (gte_bench_is_written(r))
+            psx_cpu_write_gte(cpu, r, state[r]);
+}
+
+static uint32_t gte_bench_store(psx_cpu_t *cpu, uint32_t *regs)
+{
+    uint32_t hash = 0x811c9dc5;
+
+    for (int r = 0; r < 64; r++)
+    {
+        regs[r] = psx_cpu_read_gte(cpu, r);
+
+        for (int i = 0; i < 32; i += 8)
+            hash = (hash ^ ((regs[r] >> i) & 0xff)) * 0x01000193;
+    }
+
+    return hash;
+}
+
+static void gte_bench_exec(psx_cpu_t *cpu, uint32_t opcode)
+{
+    psx_cpu_execute_decoded(cpu, psx_cpu_decode(opcode), opcode);
+}
+
+static uint32_t gte_bench_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *seed = x;
+}
+
+// Mostly plain random values, with enough extremes mixed in to
+// exercise the saturation and overflow paths
+static uint32_t gte_bench_rand_value(uint32_t *seed)
+{
+    uint32_t v = gte_bench_rand(seed);
+
+    switch (gte_bench_rand(seed) & 7)
+    {
+    case 0:
+        return v & 0x00ff00ff;
+    case 1:
+        return v | 0x70007000;
+    case 2:
+        return (v & 1) ? 0x7fff7fff : 0x80008000;
+    case 3:
+        return (v & 1) ? 0x7fffffff : 0x80000000;
+    }
+
+    return v;
+}
+
+static double gte_bench_now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+static int gte_bench_check_recorded(psx_cpu_t *cpu)
+{
+    int mismatches = 0;
+    uint32_t regs[64];
+
+    for (int s = 0; s < GTE_BENCH_STATES; s++)
+    {
+        for (unsigned int i = 0; i < GTE_BENCH_OPS; i++)
+        {
+            const psx_gte_bench_op_t *op = &g_psx_gte_bench_ops[i];
+
+            gte_bench_load(cpu, g_psx_gte_bench_states[s]);
+            gte_bench_exec(cpu, op->opcode);
+
+            uint32_t hash = gte_bench_store(cpu, regs);
+
+            if (hash == g_psx_gte_bench_hashes[s][i])
+                continue;
+
+            printf("gte: %s on state %d: hash %08x, expected %08x\n", op->name, s, hash, g_psx_gte_bench_hashes[s][i]);
+
+            mismatches++;
+        }
+    }
+
+    return mismatches;
+}
+
+static int gte_bench_check_random(psx_cpu_t *simd, psx_cpu_t *scalar, int count)
+{
+    int mismatches = 0;
+    uint32_t seed = 0x2545f491;
+    uint32_t state[64];
+    uint32_t a[64], b[64];
+
+    for (int n = 0; n < count; n++)
+    {
+        for (int r = 0; r < 64; r++)
+            state[r] = gte_bench_rand_value(&seed);
+
+        const psx_gte_bench_op_t *op = &g_psx_gte_bench_ops[gte_bench_rand(&seed) % GTE_BENCH_OPS];
+
+        // Random sf, lm, mx, v and cv fields
+        uint32_t opcode = (op->opcode & 0xfe00003f) | (gte_bench_rand(&seed) & 0x001ffc00);
+
+        gte_bench_load(simd, state);
+        gte_bench_load(scalar, state);
+        gte_bench_exec(simd, opcode);
+        gte_bench_exec(scalar, opcode);
+
+        if (gte_bench_store(simd, a) == gte_bench_store(scalar, b) && !memcmp(a, b, sizeof(a)))
+            continue;
+
+        if (mismatches++ >= 16)
+            continue;
+
+        for (int r = 0; r < 64; r++)
+            if (a[r] != b[r])
+                printf("gte: %s (%08x) random state %d: r%d = %08x, scalar %08x\n", op->name, opcode, n, r, a[r], b[r]);
+    }
+
+    return mismatches;
+}
+
+static double gte_bench_time_op(psx_cpu_t *cpu, const psx_gte_bench_op_t *op, int iterations)
+{
+    psx_cpu_handler_t handler = psx_cpu_decode(op->opcode);
+
+    // Lighting operations get the lighting state, everything else
+    // the perspective transform
+    gte_bench_load(cpu, g_psx_gte_bench_states[(op->opcode & GTE_LM) ? 1 : 0]);
+
+    double start = gte_bench_now();
+
+    for (int i = 0; i < iterations; i++)
+        psx_cpu_execute_decoded(cpu, handler, op->opcode);
+
+    return (gte_bench_now() - start) / iterations;
+}
+
+int psx_gte_bench_run(int random_states, int iterations)
+{
+    psx_cpu_t *simd = psx_cpu_create();
+    psx_cpu_t *scalar = psx_cpu_create();
+
+    psx_cpu_set_gte_simd(scalar, 0);
+
+    int has_simd = simd->gte_mul != NULL;
+
+    if (!has_simd)
+        log_info("No SIMD GTE kernels for this host, checking the scalar path only");
+
+    int mismatches = gte_bench_check_recorded(scalar);
+
+    if (has_simd)
+    {
+        mismatches += gte_bench_check_recorded(simd);
+        mismatches += gte_bench_check_random(simd, scalar, random_states);
+    }
+
+    printf("gte: %d mismatches\n", mismatches);
+
+    for (unsigned int i = 0; i < GTE_BENCH_OPS; i++)
+    {
+        const psx_gte_bench_op_t *op = &g_psx_gte_bench_ops[i];
+
+        double t = gte_bench_time_op(scalar, op, iterations);
+
+        if (has_simd)
+        {
+            printf("gte: %-10s %8.1f ns/op, scalar %8.1f ns/op\n", op->name, gte_bench_time_op(simd, op, iterations), t);
+        }
+        else
+        {
+            printf("gte: %-10s %8.1f ns/op\n", op->name, t);
+        }
+    }
+
+    psx_cpu_destroy(simd);
+    psx_cpu_destroy(scalar);
+
+    return mismatches;
+}
@@ -0,0 +1,166 @@
+#include "psx/gte_simd.h"
+
+#ifdef PSX_GTE_SIMD_X86
+#include <immintrin.h>
+
+/*
+    One 64-bit lane per matrix row. Partial sums are wrapped to 44
+    bits after every check, same as gte_check_mac:
+
+      wrap(x) = ((x & (2^44 - 1)) ^ 2^43) - 2^43
+
+    A lane overflowed if wrapping changed its value, the sign of the
+    unwrapped sum picks the positive or negative overflow flag.
+*/
+#define GTE_MAC_MASK 0xfffffffffffll
+#define GTE_MAC_SIGN 0x80000000000ll
+
+#define GTE_MAC1_NEG 0x8000000
+#define GTE_MAC2_NEG 0x4000000
+#define GTE_MAC3_NEG 0x2000000
+#define GTE_MAC1_POS 0x40000000
+#define GTE_MAC2_POS 0x20000000
+#define GTE_MAC3_POS 0x10000000
+
+__attribute__((target("avx2")))
+static inline __m256i gte_wrap_avx2(__m256i x)
+{
+    const __m256i mask = _mm256_set1_epi64x(GTE_MAC_MASK);
+    const __m256i sign = _mm256_set1_epi64x(GTE_MAC_SIGN);
+
+    return _mm256_sub_epi64(_mm256_xor_si256(_mm256_and_si256(x, mask), sign), sign);
+}
+
+__attribute__((target("avx2")))
+static inline __m256i gte_check_avx2(__m256i x, __m256i *flags)
+{
+    const __m256i neg_flags = _mm256_setr_epi64x(GTE_MAC1_NEG, GTE_MAC2_NEG, GTE_MAC3_NEG, 0);
+    const __m256i pos_flags = _mm256_setr_epi64x(GTE_MAC1_POS, GTE_MAC2_POS, GTE_MAC3_POS, 0);
+
+    __m256i w = gte_wrap_avx2(x);
+    __m256i ovf = _mm256_cmpeq_epi64(w, x);
+    __m256i neg = _mm256_cmpgt_epi64(_mm256_setzero_si256(), x);
+    __m256i f = _mm256_blendv_epi8(pos_flags, neg_flags, neg);
+
+    *flags = _mm256_or_si256(*flags, _mm256_andnot_si256(ovf, f));
+
+    return w;
+}
+
+__attribute__((target("avx2")))
+static uint32_t gte_mul_avx2(int64_t (*out)[3], const gte_matrix_t *m, const gte_vec3_t *t, int16_t (*v)[3], int n)
+{
+    __m256i c1 = _mm256_setr_epi64x(m->m[0].c[0], m->m[1].c[1], m->m[3].c[0], 0);
+    __m256i c2 = _mm256_setr_epi64x(m->m[0].c[1], m->m[2].c[0], m->m[3].c[1], 0);
+    __m256i c3 = _mm256_setr_epi64x(m->m[1].c[0], m->m[2].c[1], m->m33, 0);
+    __m256i tr = _mm256_setr_epi64x(((int64_t)t->x) << 12, ((int64_t)t->y) << 12, ((int64_t)t->z) << 12, 0);
+    __m256i flags = _mm256_setzero_si256();
+
+    for (int k = 0; k < n; k++)
+    {
+        __m256i acc = _mm256_add_epi64(tr, _mm256_mul_epi32(c1, _mm256_set1_epi64x(v[k][0])));
+
+        acc = gte_check_avx2(acc, &flags);
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(c2, _mm256_set1_epi64x(v[k][1])));
+        acc = gte_check_avx2(acc, &flags);
+        acc = _mm256_add_epi64(acc, _mm256_mul_epi32(c3, _mm256_set1_epi64x(v[k][2])));
+
+        // Rows 1 and 2, then row 3, the fourth lane is padding
+        _mm_storeu_si128((__m128i *)out[k], _mm256_castsi256_si128(acc));
+        _mm_storel_epi64((__m128i *)&out[k][2], _mm256_extracti128_si256(acc, 1));
+    }
+
+    // Flags only use the low dword of each lane
+    __m128i f = _mm_or_si128(_mm256_castsi256_si128(flags), _mm256_extracti128_si256(flags, 1));
+
+    f = _mm_or_si128(f, _mm_unpackhi_epi64(f, f));
+
+    return (uint32_t)_mm_cvtsi128_si32(f);
+}
+
+// SSE4.1 has no 64-bit compares other than equality, rows 1 and 2
+// go in one register and row 3 in the low lane of another
+
+__attribute__((target("sse4.1")))
+static inline __m128i gte_wrap_sse41(__m128i x)
+{
+    const __m128i mask = _mm_set1_epi64x(GTE_MAC_MASK);
+    const __m128i sign = _mm_set1_epi64x(GTE_MAC_SIGN);
+
+    return _mm_sub_epi64(_mm_xor_si128(_mm_and_si128(x, mask), sign), sign);
+}
+
+__attribute__((target("sse4.1")))
+static inline __m128i gte_check_sse41(__m128i x, __m128i neg_flags, __m128i pos_flags, __m128i *flags)
+{
+    __m128i w = gte_wrap_sse41(x);
+    __m128i ovf = _mm_cmpeq_epi64(w, x);
+
+    // Broadcast the sign of each 64-bit lane
+    __m128i neg = _mm_shuffle_epi32(_mm_srai_epi32(x, 31), _MM_SHUFFLE(3, 3, 1, 1));
+    __m128i f = _mm_blendv_epi8(pos_flags, neg_flags, neg);
+
+    *flags = _mm_or_si128(*flags, _mm_andnot_si128(ovf, f));
+
+    return w;
+}
+
+__attribute__((target("sse4.1")))
+static uint32_t gte_mul_sse41(int64_t (*out)[3], const gte_matrix_t *m, const gte_vec3_t *t, int16_t (*v)[3], int n)
+{
+    const __m128i neg_lo = _mm_set_epi64x(GTE_MAC2_NEG, GTE_MAC1_NEG);
+    const __m128i pos_lo = _mm_set_epi64x(GTE_MAC2_POS, GTE_MAC1_POS);
+    const __m128i neg_hi = _mm_set_epi64x(0, GTE_MAC3_NEG);
+    const __m128i pos_hi = _mm_set_epi64x(0, GTE_MAC3_POS);
+
+    __m128i c1_lo = _mm_set_epi64x(m->m[1].c[1], m->m[0].c[0]);
+    __m128i c2_lo = _mm_set_epi64x(m->m[2].c[0], m->m[0].c[1]);
+    __m128i c3_lo = _mm_set_epi64x(m->m[2].c[1], m->m[1].c[0]);
+    __m128i c1_hi = _mm_set_epi64x(0, m->m[3].c[0]);
+    __m128i c2_hi = _mm_set_epi64x(0, m->m[3].c[1]);
+    __m128i c3_hi = _mm_set_epi64x(0, m->m33);
+    __m128i tr_lo = _mm_set_epi64x(((int64_t)t->y) << 12, ((int64_t)t->x) << 12);
+    __m128i tr_hi = _mm_set_epi64x(0, ((int64_t)t->z) << 12);
+    __m128i flags = _mm_setzero_si128();
+
+    for (int k = 0; k < n; k++)
+    {
+        __m128i vx = _mm_set1_epi64x(v[k][0]);
+        __m128i vy = _mm_set1_epi64x(v[k][1]);
+        __m128i vz = _mm_set1_epi64x(v[k][2]);
+        __m128i lo = _mm_add_epi64(tr_lo, _mm_mul_epi32(c1_lo, vx));
+        __m128i hi = _mm_add_epi64(tr_hi, _mm_mul_epi32(c1_hi, vx));
+
+        lo = gte_check_sse41(lo, neg_lo, pos_lo, &flags);
+        hi = gte_check_sse41(hi, neg_hi, pos_hi, &flags);
+        lo = _mm_add_epi64(lo, _mm_mul_epi32(c2_lo, vy));
+        hi = _mm_add_epi64(hi, _mm_mul_epi32(c2_hi, vy));
+        lo = gte_check_sse41(lo, neg_lo, pos_lo, &flags);
+        hi = gte_check_sse41(hi, neg_hi, pos_hi, &flags);
+        lo = _mm_add_epi64(lo, _mm_mul_epi32(c3_lo, vz));
+        hi = _mm_add_epi64(hi, _mm_mul_epi32(c3_hi, vz));
+
+        _mm_storeu_si128((__m128i *)out[k], lo);
+        _mm_storel_epi64((__m128i *)&out[k][2], hi);
+    }
+
+    flags = _mm_or_si128(flags, _mm_unpackhi_epi64(flags, flags));
+
+    return (uint32_t)_mm_cvtsi128_si32(flags);
+}
+#endif
+
+psx_gte_mul_t psx_gte_simd_select(void)
+{
+#ifdef PSX_GTE_SIMD_X86
+    __builtin_cpu_init();
+
+    if (__builtin_cpu_supports("avx2"))
+        return gte_mul_avx2;
+
+    if (__builtin_cpu_supports("sse4.1"))
+        return gte_mul_sse41;
+#endif
+
+    return NULL;
+}
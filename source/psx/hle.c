@@ -0,0 +1,553 @@
+#include "psx/hle.h"
+
+#include <stdio.h>
+#include <string.h>
+
+#define R_V0 (cpu->r[2])
+#define R_A0 (cpu->r[4])
+#define R_A1 (cpu->r[5])
+#define R_A2 (cpu->r[6])
+#define R_A3 (cpu->r[7])
+#define R_T1 (cpu->r[9])
+#define R_SP (cpu->r[29])
+#define R_RA (cpu->r[31])
+
+/*
+    Approximate cost of the BIOS routines, measured in cycles for
+    the kernel running from RAM. The call itself goes through the
+    vector, the function table lookup and the prologue/epilogue.
+*/
+#define HLE_CALL_CYCLES 20
+#define HLE_COPY_CYCLES 6
+#define HLE_FILL_CYCLES 4
+#define HLE_SCAN_CYCLES 4
+#define HLE_COMPARE_CYCLES 8
+#define HLE_RAND_CYCLES 30
+#define HLE_PRINTF_CYCLES 60
+#define HLE_EVENT_CYCLES 12
+
+// Event control blocks, see the table of tables at 100h
+#define HLE_EVCB_TABLE 0x00000120
+#define HLE_EVCB_TABLE_SIZE 0x00000124
+#define HLE_EVCB_SIZE 0x1c
+
+#define EVCB_CLASS 0x00
+#define EVCB_STATUS 0x04
+#define EVCB_SPEC 0x08
+#define EVCB_MODE 0x0c
+#define EVCB_FUNC 0x10
+
+#define EVCB_STATUS_FREE 0x0000
+#define EVCB_STATUS_DISABLED 0x1000
+#define EVCB_STATUS_BUSY 0x2000
+#define EVCB_STATUS_READY 0x4000
+
+#define EVCB_MODE_CALLBACK 0x1000
+#define EVCB_MODE_READY 0x2000
+
+// Longest string printf will read from guest memory
+#define HLE_PRINTF_MAX 1024
+
+// Most a single call is charged, about a frame. Devices catch up on
+// the elapsed cycles in one go, so keep that bounded
+#define HLE_MAX_CYCLES 0x80000
+
+typedef int (*psx_hle_func_t)(psx_cpu_t *);
+
+// Cost of a call doing count steps, done in 64 bits since count comes
+// from the guest
+static int hle_cost(uint64_t count, int cycles)
+{
+    uint64_t total = HLE_CALL_CYCLES + (count * cycles);
+
+    return (total > HLE_MAX_CYCLES) ? HLE_MAX_CYCLES : (int)total;
+}
+
+static int hle_strcmp(psx_cpu_t *cpu)
+{
+    uint32_t s1 = R_A0;
+    uint32_t s2 = R_A1;
+
+    if (!s1 || !s2)
+    {
+        R_V0 = (s1 == s2) ? 0 : (s1 ? 1 : -1);
+
+        return HLE_CALL_CYCLES;
+    }
+
+    int n = 0;
+
+    while (1)
+    {
+        uint8_t c1 = psx_bus_read8(cpu->bus, s1 + n);
+        uint8_t c2 = psx_bus_read8(cpu->bus, s2 + n);
+
+        n++;
+
+        if (c1 != c2)
+        {
+            R_V0 = (int32_t)c1 - (int32_t)c2;
+
+            break;
+        }
+
+        if (!c1)
+        {
+            R_V0 = 0;
+
+            break;
+        }
+    }
+
+    return hle_cost(n, HLE_COMPARE_CYCLES);
+}
+
+static int hle_strcpy(psx_cpu_t *cpu)
+{
+    uint32_t dst = R_A0;
+    uint32_t src = R_A1;
+
+    if (!dst || !src)
+    {
+        R_V0 = 0;
+
+        return HLE_CALL_CYCLES;
+    }
+
+    int n = 0;
+    uint8_t c;
+
+    do
+    {
+        c = psx_bus_read8(cpu->bus, src + n);
+
+        psx_bus_write8(cpu->bus, dst + n, c);
+
+        n++;
+    } while (c);
+
+    R_V0 = dst;
+
+    return hle_cost(n, HLE_COPY_CYCLES);
+}
+
+static int hle_strlen(psx_cpu_t *cpu)
+{
+    uint32_t src = R_A0;
+    uint32_t n = 0;
+
+    if (src)
+        while (psx_bus_read8(cpu->bus, src + n))
+            n++;
+
+    R_V0 = n;
+
+    return hle_cost(n, HLE_SCAN_CYCLES);
+}
+
+static int hle_bzero(psx_cpu_t *cpu)
+{
+    uint32_t dst = R_A0;
+    int32_t len = R_A1;
+
+    if (!dst || (len <= 0))
+    {
+        R_V0 = 0;
+
+        return HLE_CALL_CYCLES;
+    }
+
+    for (int32_t i = 0; i < len; i++)
+        psx_bus_write8(cpu->bus, dst + i, 0);
+
+    R_V0 = dst;
+
+    return hle_cost(len, HLE_FILL_CYCLES);
+}
+
+static int hle_memcpy(psx_cpu_t *cpu)
+{
+    uint32_t dst = R_A0;
+    uint32_t src = R_A1;
+    int32_t len = R_A2;
+
+    if (!dst || (len <= 0))
+    {
+        R_V0 = 0;
+
+        return HLE_CALL_CYCLES;
+    }
+
+    // Byte by byte forwards, overlapping copies behave the same
+    for (int32_t i = 0; i < len; i++)
+        psx_bus_write8(cpu->bus, dst + i, psx_bus_read8(cpu->bus, src + i));
+
+    R_V0 = dst;
+
+    return hle_cost(len, HLE_COPY_CYCLES);
+}
+
+static int hle_memset(psx_cpu_t *cpu)
+{
+    uint32_t dst = R_A0;
+    uint8_t fill = R_A1;
+    int32_t len = R_A2;
+
+    if (!dst || (len <= 0))
+    {
+        R_V0 = 0;
+
+        return HLE_CALL_CYCLES;
+    }
+
+    for (int32_t i = 0; i < len; i++)
+        psx_bus_write8(cpu->bus, dst + i, fill);
+
+    R_V0 = dst;
+
+    return hle_cost(len, HLE_FILL_CYCLES);
+}
+
+static int hle_rand(psx_cpu_t *cpu)
+{
+    cpu->hle_seed = (cpu->hle_seed * 0x41c64e6d) + 0x3039;
+
+    R_V0 = (cpu->hle_seed >> 16) & 0x7fff;
+
+    return HLE_RAND_CYCLES;
+}
+
+static int hle_srand(psx_cpu_t *cpu)
+{
+    cpu->hle_seed = R_A0;
+
+    return HLE_CALL_CYCLES;
+}
+
+// printf arguments follow the o32 convention, the first four are
+// in a0-a3 and the rest on the stack above their home slots
+static uint32_t hle_printf_arg(psx_cpu_t *cpu, int index)
+{
+    if (index < 4)
+        return cpu->r[4 + index];
+
+    return psx_bus_read32(cpu->bus, R_SP + (index << 2));
+}
+
+static int hle_printf(psx_cpu_t *cpu)
+{
+    uint32_t fmt = R_A0;
+    int arg = 1;
+    int count = 0;
+
+    char buf[HLE_PRINTF_MAX];
+    char spec[32];
+
+    while (count < HLE_PRINTF_MAX)
+    {
+        char c = psx_bus_read8(cpu->bus, fmt++);
+
+        if (!c)
+            break;
+
+        if (c != '%')
+        {
+            putchar(c);
+
+            count++;
+
+            continue;
+        }
+
+        // Rebuild the conversion for the host printf, ignoring
+        // length modifiers since every argument is 32-bit
+        int n = 0;
+
+        spec[n++] = '%';
+
+        c = psx_bus_read8(cpu->bus, fmt++);
+
+        while (c && strchr("-+ #0", c) && (n < 8))
+        {
+            spec[n++] = c;
+            c = psx_bus_read8(cpu->bus, fmt++);
+        }
+
+        if (c == '*')
+        {
+            n += snprintf(spec + n, 12, "%d", (int32_t)hle_printf_arg(cpu, arg++));
+            c = psx_bus_read8(cpu->bus, fmt++);
+        }
+
+        while ((c >= '0') && (c <= '9') && (n < 20))
+        {
+            spec[n++] = c;
+            c = psx_bus_read8(cpu->bus, fmt++);
+        }
+
+        if (c == '.')
+        {
+            spec[n++] = c;
+            c = psx_bus_read8(cpu->bus, fmt++);
+
+            while ((c >= '0') && (c <= '9') && (n < 28))
+            {
+                spec[n++] = c;
+                c = psx_bus_read8(cpu->bus, fmt++);
+            }
+        }
+
+        while ((c == 'l') || (c == 'h'))
+            c = psx_bus_read8(cpu->bus, fmt++);
+
+        spec[n++] = c;
+        spec[n] = '\0';
+
+        int len = 0;
+
+        switch (c)
+        {
+        case 'd':
+        case 'i':
+            len = snprintf(buf, sizeof(buf), spec, (int32_t)hle_printf_arg(cpu, arg++));
+            break;
+        case 'u':
+        case 'o':
+        case 'x':
+        case 'X':
+            len = snprintf(buf, sizeof(buf), spec, hle_printf_arg(cpu, arg++));
+            break;
+        case 'c':
+            len = snprintf(buf, sizeof(buf), spec, (int)(uint8_t)hle_printf_arg(cpu, arg++));
+            break;
+        case 'p':
+            spec[n - 1] = 'x';
+            len = snprintf(buf, sizeof(buf), spec, hle_printf_arg(cpu, arg++));
+            break;
+        case 's':
+        {
+            char str[HLE_PRINTF_MAX];
+            uint32_t src = hle_printf_arg(cpu, arg++);
+            int i = 0;
+
+            if (src)
+                while ((i < (HLE_PRINTF_MAX - 1)) && (str[i] = psx_bus_read8(cpu->bus, src + i)))
+                    i++;
+
+            str[i] = '\0';
+
+            len = snprintf(buf, sizeof(buf), spec, str);
+        }
+        break;
+        case '%':
+            buf[0] = '%';
+            len = 1;
+            break;
+        case '\0':
+            fmt--;
+            break;
+        default:
+            len = snprintf(buf, sizeof(buf), "%s", spec);
+            break;
+        }
+
+        if (len > (int)sizeof(buf) - 1)
+            len = sizeof(buf) - 1;
+
+        fwrite(buf, 1, len, stdout);
+
+        count += len;
+    }
+
+    R_V0 = count;
+
+    return hle_cost(count, HLE_PRINTF_CYCLES);
+}
+
+static inline uint32_t hle_get_evcb(psx_cpu_t *cpu, uint32_t event)
+{
+    return psx_bus_read32(cpu->bus, HLE_EVCB_TABLE) + ((event & 0xffff) * HLE_EVCB_SIZE);
+}
+
+static int hle_deliver_event(psx_cpu_t *cpu)
+{
+    uint32_t table = psx_bus_read32(cpu->bus, HLE_EVCB_TABLE);
+    uint32_t count = psx_bus_read32(cpu->bus, HLE_EVCB_TABLE_SIZE) / HLE_EVCB_SIZE;
+
+    // Events that run a callback need guest code, leave those
+    // to the BIOS before changing anything
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t evcb = table + (i * HLE_EVCB_SIZE);
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) != EVCB_STATUS_BUSY)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_CLASS) != R_A0)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_SPEC) != R_A1)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_MODE) == EVCB_MODE_CALLBACK)
+            return 0;
+    }
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t evcb = table + (i * HLE_EVCB_SIZE);
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) != EVCB_STATUS_BUSY)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_CLASS) != R_A0)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_SPEC) != R_A1)
+            continue;
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_MODE) == EVCB_MODE_READY)
+            psx_bus_write32(cpu->bus, evcb + EVCB_STATUS, EVCB_STATUS_READY);
+    }
+
+    return hle_cost(count, HLE_EVENT_CYCLES);
+}
+
+static int hle_open_event(psx_cpu_t *cpu)
+{
+    uint32_t table = psx_bus_read32(cpu->bus, HLE_EVCB_TABLE);
+    uint32_t count = psx_bus_read32(cpu->bus, HLE_EVCB_TABLE_SIZE) / HLE_EVCB_SIZE;
+
+    for (uint32_t i = 0; i < count; i++)
+    {
+        uint32_t evcb = table + (i * HLE_EVCB_SIZE);
+
+        if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) != EVCB_STATUS_FREE)
+            continue;
+
+        psx_bus_write32(cpu->bus, evcb + EVCB_CLASS, R_A0);
+        psx_bus_write32(cpu->bus, evcb + EVCB_STATUS, EVCB_STATUS_DISABLED);
+        psx_bus_write32(cpu->bus, evcb + EVCB_SPEC, R_A1);
+        psx_bus_write32(cpu->bus, evcb + EVCB_MODE, R_A2);
+        psx_bus_write32(cpu->bus, evcb + EVCB_FUNC, R_A3);
+
+        R_V0 = 0xf1000000 | i;
+
+        return hle_cost(i + 1, HLE_EVENT_CYCLES);
+    }
+
+    // The BIOS reports running out of EvCBs itself
+    return 0;
+}
+
+static int hle_close_event(psx_cpu_t *cpu)
+{
+    psx_bus_write32(cpu->bus, hle_get_evcb(cpu, R_A0) + EVCB_STATUS, EVCB_STATUS_FREE);
+
+    R_V0 = 1;
+
+    return HLE_CALL_CYCLES;
+}
+
+static int hle_test_event(psx_cpu_t *cpu)
+{
+    uint32_t evcb = hle_get_evcb(cpu, R_A0);
+
+    R_V0 = 0;
+
+    if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) == EVCB_STATUS_READY)
+    {
+        psx_bus_write32(cpu->bus, evcb + EVCB_STATUS, EVCB_STATUS_BUSY);
+
+        R_V0 = 1;
+    }
+
+    return HLE_CALL_CYCLES;
+}
+
+static int hle_enable_event(psx_cpu_t *cpu)
+{
+    uint32_t evcb = hle_get_evcb(cpu, R_A0);
+
+    if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) != EVCB_STATUS_FREE)
+        psx_bus_write32(cpu->bus, evcb + EVCB_STATUS, EVCB_STATUS_BUSY);
+
+    R_V0 = 1;
+
+    return HLE_CALL_CYCLES;
+}
+
+static int hle_disable_event(psx_cpu_t *cpu)
+{
+    uint32_t evcb = hle_get_evcb(cpu, R_A0);
+
+    if (psx_bus_read32(cpu->bus, evcb + EVCB_STATUS) != EVCB_STATUS_FREE)
+        psx_bus_write32(cpu->bus, evcb + EVCB_STATUS, EVCB_STATUS_DISABLED);
+
+    R_V0 = 1;
+
+    return HLE_CALL_CYCLES;
+}
+
+// Indexed by function number, see the symbol tables in cpu_debug.h
+static const psx_hle_func_t g_psx_hle_a_table[0x40] = {
+    [0x17] = hle_strcmp,
+    [0x19] = hle_strcpy,
+    [0x1b] = hle_strlen,
+    [0x28] = hle_bzero,
+    [0x2a] = hle_memcpy,
+    [0x2b] = hle_memset,
+    [0x2f] = hle_rand,
+    [0x30] = hle_srand,
+    [0x3f] = hle_printf
+};
+
+static const psx_hle_func_t g_psx_hle_b_table[0x10] = {
+    [0x07] = hle_deliver_event,
+    [0x08] = hle_open_event,
+    [0x09] = hle_close_event,
+    [0x0b] = hle_test_event,
+    [0x0c] = hle_enable_event,
+    [0x0d] = hle_disable_event
+};
+
+int psx_hle_call(psx_cpu_t *cpu)
+{
+    // Loads and stores go to the data cache while it's isolated
+    if (cpu->cop0_r[COP0_SR] & SR_ISC)
+        return 0;
+
+    psx_hle_func_t func = NULL;
+
+    switch (cpu->pc & 0x3fffffff)
+    {
+    case PSX_HLE_A0:
+        if (R_T1 < (sizeof(g_psx_hle_a_table) / sizeof(psx_hle_func_t)))
+            func = g_psx_hle_a_table[R_T1];
+        break;
+    case PSX_HLE_B0:
+        if (R_T1 < (sizeof(g_psx_hle_b_table) / sizeof(psx_hle_func_t)))
+            func = g_psx_hle_b_table[R_T1];
+        break;
+    }
+
+    if (!func)
+        return 0;
+
+    // The jump's delay slot might have left a load pending
+    cpu->r[cpu->load_d] = cpu->load_v;
+    cpu->r[0] = 0;
+    cpu->load_v = 0xffffffff;
+    cpu->load_d = 0;
+
+    int cycles = func(cpu);
+
+    if (!cycles)
+        return 0;
+
+    cpu->r[0] = 0;
+    cpu->pc = R_RA;
+    cpu->next_pc = cpu->pc + 4;
+
+    return cycles;
+}
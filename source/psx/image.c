@@ -0,0 +1,212 @@
+// Needed for realpath
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/image.h"
+#include "psx/log.h"
+
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <fcntl.h>
+#include <limits.h>
+#include <pthread.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <unistd.h>
+#endif
+
+// The one piece of state shared between instances, guarded by the lock
+static psx_image_t *g_psx_image_list;
+
+#ifdef _WIN32
+static SRWLOCK g_psx_image_lock = SRWLOCK_INIT;
+
+#define IMAGE_LOCK AcquireSRWLockExclusive(&g_psx_image_lock)
+#define IMAGE_UNLOCK ReleaseSRWLockExclusive(&g_psx_image_lock)
+#else
+static pthread_mutex_t g_psx_image_lock = PTHREAD_MUTEX_INITIALIZER;
+
+#define IMAGE_LOCK pthread_mutex_lock(&g_psx_image_lock)
+#define IMAGE_UNLOCK pthread_mutex_unlock(&g_psx_image_lock)
+#endif
+
+static int image_map(psx_image_t *image)
+{
+#ifdef _WIN32
+    HANDLE file = CreateFileA(image->path, GENERIC_READ, FILE_SHARE_READ, NULL, OPEN_EXISTING, FILE_ATTRIBUTE_NORMAL, NULL);
+
+    if (file == INVALID_HANDLE_VALUE)
+        return 1;
+
+    LARGE_INTEGER size;
+
+    if (!GetFileSizeEx(file, &size) || !size.QuadPart)
+    {
+        CloseHandle(file);
+
+        return 1;
+    }
+
+    HANDLE mapping = CreateFileMappingA(file, NULL, PAGE_READONLY, 0, 0, NULL);
+
+    if (!mapping)
+    {
+        CloseHandle(file);
+
+        return 1;
+    }
+
+    void *buf = MapViewOfFile(mapping, FILE_MAP_READ, 0, 0, 0);
+
+    if (!buf)
+    {
+        CloseHandle(mapping);
+        CloseHandle(file);
+
+        return 1;
+    }
+
+    image->file = file;
+    image->mapping = mapping;
+    image->buf = (const uint8_t *)buf;
+    image->size = (size_t)size.QuadPart;
+#else
+    int fd = open(image->path, O_RDONLY);
+
+    if (fd == -1)
+        return 1;
+
+    struct stat st;
+
+    if (fstat(fd, &st) || !st.st_size)
+    {
+        close(fd);
+
+        return 1;
+    }
+
+    void *buf = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+
+    // The mapping keeps the file alive
+    close(fd);
+
+    if (buf == MAP_FAILED)
+        return 1;
+
+    image->buf = (const uint8_t *)buf;
+    image->size = st.st_size;
+#endif
+
+    return 0;
+}
+
+static void image_unmap(psx_image_t *image)
+{
+#ifdef _WIN32
+    UnmapViewOfFile((void *)image->buf);
+    CloseHandle(image->mapping);
+    CloseHandle(image->file);
+#else
+    munmap((void *)image->buf, image->size);
+#endif
+}
+
+psx_image_t *psx_image_open(const char *path)
+{
+    // Different spellings of the same path share an image
+#ifdef _WIN32
+    char *full = _fullpath(NULL, path, 0);
+#else
+    char *full = realpath(path, NULL);
+#endif
+
+    if (!full)
+        return NULL;
+
+    IMAGE_LOCK;
+
+    psx_image_t *image = g_psx_image_list;
+
+    while (image)
+    {
+        if (!strcmp(image->path, full))
+            break;
+
+        image = image->next;
+    }
+
+    if (image)
+    {
+        ++image->refs;
+
+        free(full);
+
+        IMAGE_UNLOCK;
+
+        return image;
+    }
+
+    image = (psx_image_t *)malloc(sizeof(psx_image_t));
+
+    memset(image, 0, sizeof(psx_image_t));
+
+    image->path = full;
+
+    if (image_map(image))
+    {
+        log_error("Couldn't map \'%s\'", full);
+
+        free(full);
+        free(image);
+
+        IMAGE_UNLOCK;
+
+        return NULL;
+    }
+
+    image->refs = 1;
+    image->next = g_psx_image_list;
+
+    g_psx_image_list = image;
+
+    IMAGE_UNLOCK;
+
+    return image;
+}
+
+void psx_image_close(psx_image_t *image)
+{
+    if (!image)
+        return;
+
+    IMAGE_LOCK;
+
+    if (--image->refs)
+    {
+        IMAGE_UNLOCK;
+
+        return;
+    }
+
+    psx_image_t **link = &g_psx_image_list;
+
+    while (*link != image)
+        link = &(*link)->next;
+
+    *link = image->next;
+
+    IMAGE_UNLOCK;
+
+    image_unmap(image);
+
+    free(image->path);
+    free(image);
+}
+
+#undef IMAGE_LOCK
+#undef IMAGE_UNLOCK
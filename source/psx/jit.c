@@ -0,0 +1,866 @@
+// Needed for MAP_ANONYMOUS
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/jit.h"
+#include "psx/bus.h"
+#include "psx/hle.h"
+#include "psx/log.h"
+
+#ifdef PSX_JIT_X64
+#ifdef _WIN32
+#include <windows.h>
+#else
+#include <sys/mman.h>
+#endif
+#endif
+
+psx_jit_t *psx_jit_create(void)
+{
+    return (psx_jit_t *)malloc(sizeof(psx_jit_t));
+}
+
+void psx_jit_invalidate_page(psx_jit_t *jit, int page)
+{
+    if (!jit->entry_page[page])
+        return;
+
+    free(jit->entry_page[page]);
+
+    jit->entry_page[page] = NULL;
+    jit->invalidated = 1;
+}
+
+void psx_jit_flush(psx_jit_t *jit)
+{
+    for (int i = 0; i < PSX_CPU_CACHE_PAGES; i++)
+        psx_jit_invalidate_page(jit, i);
+
+    jit->code_used = 0;
+}
+
+#ifdef PSX_JIT_X64
+
+/*
+    Translated blocks keep guest state in psx_cpu_t, rbx holds the
+    CPU pointer and eax, ecx and edx are used as scratch registers.
+    Simple ALU instructions are translated to host code, everything
+    else is handed to the interpreter's handlers through psx_jit_call.
+
+    pc, next_pc and saved_pc are only written back before calling a
+    handler and when leaving the block, delay slots are the only
+    instructions whose PC isn't known at translation time.
+*/
+
+#define EAX 0
+#define ECX 1
+#define EDX 2
+#define EBX 3
+
+#define CPU_OFF(field) ((int32_t)offsetof(psx_cpu_t, field))
+#define GPR_OFF(idx) (CPU_OFF(r) + ((idx) * 4))
+
+typedef struct
+{
+    uint8_t *ptr;
+} psx_jit_emitter_t;
+
+static inline void emit8(psx_jit_emitter_t *e, uint8_t v)
+{
+    *e->ptr++ = v;
+}
+
+static inline void emit32(psx_jit_emitter_t *e, uint32_t v)
+{
+    memcpy(e->ptr, &v, 4);
+
+    e->ptr += 4;
+}
+
+static inline void emit64(psx_jit_emitter_t *e, uint64_t v)
+{
+    memcpy(e->ptr, &v, 8);
+
+    e->ptr += 8;
+}
+
+// op reg, [rbx + disp32]
+static inline void emit_rm(psx_jit_emitter_t *e, uint8_t op, int reg, int32_t disp)
+{
+    emit8(e, op);
+    emit8(e, 0x80 | (reg << 3) | EBX);
+    emit32(e, disp);
+}
+
+static inline void emit_load(psx_jit_emitter_t *e, int reg, int32_t disp)
+{
+    emit_rm(e, 0x8b, reg, disp);
+}
+
+static inline void emit_store(psx_jit_emitter_t *e, int reg, int32_t disp)
+{
+    emit_rm(e, 0x89, reg, disp);
+}
+
+// mov dword [rbx + disp32], imm32
+static inline void emit_store_imm(psx_jit_emitter_t *e, int32_t disp, uint32_t imm)
+{
+    emit_rm(e, 0xc7, 0, disp);
+    emit32(e, imm);
+}
+
+// add dword [rbx + disp32], imm32
+static inline void emit_add_mem_imm(psx_jit_emitter_t *e, int32_t disp, uint32_t imm)
+{
+    emit_rm(e, 0x81, 0, disp);
+    emit32(e, imm);
+}
+
+// Group 1 ALU op with an immediate (add, or, and, sub, xor, cmp)
+static inline void emit_alu_imm(psx_jit_emitter_t *e, int ext, int reg, uint32_t imm)
+{
+    emit8(e, 0x81);
+    emit8(e, 0xc0 | (ext << 3) | reg);
+    emit32(e, imm);
+}
+
+// Group 2 shift by an immediate (shl, shr, sar)
+static inline void emit_shift_imm(psx_jit_emitter_t *e, int ext, int reg, uint8_t imm)
+{
+    emit8(e, 0xc1);
+    emit8(e, 0xc0 | (ext << 3) | reg);
+    emit8(e, imm);
+}
+
+// Group 2 shift by cl
+static inline void emit_shift_cl(psx_jit_emitter_t *e, int ext, int reg)
+{
+    emit8(e, 0xd3);
+    emit8(e, 0xc0 | (ext << 3) | reg);
+}
+
+// setcc al, movzx eax, al
+static inline void emit_setcc(psx_jit_emitter_t *e, uint8_t cc)
+{
+    emit8(e, 0x0f);
+    emit8(e, cc);
+    emit8(e, 0xc0);
+    emit8(e, 0x0f);
+    emit8(e, 0xb6);
+    emit8(e, 0xc0);
+}
+
+#define ALU_ADD 0x03
+#define ALU_OR 0x0b
+#define ALU_AND 0x23
+#define ALU_SUB 0x2b
+#define ALU_XOR 0x33
+#define ALU_CMP 0x3b
+
+#define EXT_ADD 0
+#define EXT_OR 1
+#define EXT_AND 4
+#define EXT_XOR 6
+#define EXT_CMP 7
+
+#define EXT_SHL 4
+#define EXT_SHR 5
+#define EXT_SAR 7
+
+#define CC_B 0x92
+#define CC_L 0x9c
+
+// Same as DO_PENDING_LOAD in cpu.c
+static void emit_pending_load(psx_jit_emitter_t *e)
+{
+    emit_load(e, EDX, CPU_OFF(load_d));
+    emit_load(e, ECX, CPU_OFF(load_v));
+
+    // mov [rbx + rdx * 4 + disp32], ecx
+    emit8(e, 0x89);
+    emit8(e, 0x8c);
+    emit8(e, 0x93);
+    emit32(e, GPR_OFF(0));
+
+    emit_store_imm(e, GPR_OFF(0), 0);
+    emit_store_imm(e, CPU_OFF(load_v), 0xffffffff);
+    emit_store_imm(e, CPU_OFF(load_d), 0);
+}
+
+static void emit_prologue(psx_jit_emitter_t *e)
+{
+    emit8(e, 0x53);                         // push rbx
+    emit8(e, 0x48), emit8(e, 0x83);         // sub rsp, 32
+    emit8(e, 0xec), emit8(e, 0x20);
+#ifdef _WIN32
+    emit8(e, 0x48), emit8(e, 0x89);         // mov rbx, rcx
+    emit8(e, 0xcb);
+#else
+    emit8(e, 0x48), emit8(e, 0x89);         // mov rbx, rdi
+    emit8(e, 0xfb);
+#endif
+}
+
+static void emit_epilogue(psx_jit_emitter_t *e)
+{
+    emit8(e, 0x48), emit8(e, 0x83);         // add rsp, 32
+    emit8(e, 0xc4), emit8(e, 0x20);
+    emit8(e, 0x5b);                         // pop rbx
+    emit8(e, 0xc3);                         // ret
+}
+
+// Returns non-zero if the block has to be left after this instruction
+static int psx_jit_call(psx_cpu_t *cpu, psx_cpu_handler_t handler, uint32_t opcode, uint32_t pc)
+{
+    cpu->last_cycles += psx_cpu_execute_decoded(cpu, handler, opcode);
+
+    return (cpu->pc != pc) || psx_cpu_check_irq(cpu) || cpu->jit->invalidated;
+}
+
+static void emit_call(psx_jit_emitter_t *e, psx_cpu_handler_t handler, uint32_t opcode, uint32_t pc)
+{
+#ifdef _WIN32
+    emit8(e, 0x48), emit8(e, 0x89), emit8(e, 0xd9); // mov rcx, rbx
+    emit8(e, 0x48), emit8(e, 0xba);                 // mov rdx, imm64
+    emit64(e, (uint64_t)(uintptr_t)handler);
+    emit8(e, 0x41), emit8(e, 0xb8);                 // mov r8d, imm32
+    emit32(e, opcode);
+    emit8(e, 0x41), emit8(e, 0xb9);                 // mov r9d, imm32
+    emit32(e, pc);
+#else
+    emit8(e, 0x48), emit8(e, 0x89), emit8(e, 0xdf); // mov rdi, rbx
+    emit8(e, 0x48), emit8(e, 0xbe);                 // mov rsi, imm64
+    emit64(e, (uint64_t)(uintptr_t)handler);
+    emit8(e, 0xba);                                 // mov edx, imm32
+    emit32(e, opcode);
+    emit8(e, 0xb9);                                 // mov ecx, imm32
+    emit32(e, pc);
+#endif
+    emit8(e, 0x48), emit8(e, 0xb8);                 // mov rax, imm64
+    emit64(e, (uint64_t)(uintptr_t)psx_jit_call);
+    emit8(e, 0xff), emit8(e, 0xd0);                 // call rax
+}
+
+// Write back the PC state the interpreter would have after
+// fetching the instruction at addr
+static void emit_sync_pc(psx_jit_emitter_t *e, uint32_t addr)
+{
+    emit_store_imm(e, CPU_OFF(saved_pc), addr);
+    emit_store_imm(e, CPU_OFF(pc), addr + 4);
+    emit_store_imm(e, CPU_OFF(next_pc), addr + 8);
+}
+
+// The delay slot's prologue depends on whether the branch was taken
+static void emit_delay_slot_prologue(psx_jit_emitter_t *e, uint32_t addr)
+{
+    emit_load(e, EAX, CPU_OFF(branch));
+    emit_store(e, EAX, CPU_OFF(delay_slot));
+    emit_store_imm(e, CPU_OFF(branch), 0);
+    emit_store_imm(e, CPU_OFF(branch_taken), 0);
+    emit_store_imm(e, CPU_OFF(saved_pc), addr);
+    emit_load(e, EAX, CPU_OFF(next_pc));
+    emit_store(e, EAX, CPU_OFF(pc));
+    emit_alu_imm(e, EXT_ADD, EAX, 4);
+    emit_store(e, EAX, CPU_OFF(next_pc));
+}
+
+static void emit_flush_counters(psx_jit_emitter_t *e, uint32_t cycles, uint32_t insns)
+{
+    if (cycles)
+        emit_add_mem_imm(e, CPU_OFF(last_cycles), cycles);
+
+    if (insns)
+        emit_add_mem_imm(e, CPU_OFF(last_instructions), insns);
+}
+
+// rd = rs op rt
+static void emit_alu_rrr(psx_jit_emitter_t *e, uint8_t op, int d, int s, int t, int pending)
+{
+    if (d)
+    {
+        emit_load(e, EAX, GPR_OFF(s));
+        emit_rm(e, op, EAX, GPR_OFF(t));
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (d)
+        emit_store(e, EAX, GPR_OFF(d));
+}
+
+// rt = rs op imm
+static void emit_alu_rri(psx_jit_emitter_t *e, int ext, int t, int s, uint32_t imm, int pending)
+{
+    if (t)
+    {
+        emit_load(e, EAX, GPR_OFF(s));
+        emit_alu_imm(e, ext, EAX, imm);
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (t)
+        emit_store(e, EAX, GPR_OFF(t));
+}
+
+// rd = rs < rt
+static void emit_slt_rrr(psx_jit_emitter_t *e, uint8_t cc, int d, int s, int t, int pending)
+{
+    if (d)
+    {
+        emit_load(e, EAX, GPR_OFF(s));
+        emit_rm(e, ALU_CMP, EAX, GPR_OFF(t));
+        emit_setcc(e, cc);
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (d)
+        emit_store(e, EAX, GPR_OFF(d));
+}
+
+// rt = rs < imm
+static void emit_slt_rri(psx_jit_emitter_t *e, uint8_t cc, int t, int s, uint32_t imm, int pending)
+{
+    if (t)
+    {
+        emit_load(e, EAX, GPR_OFF(s));
+        emit_alu_imm(e, EXT_CMP, EAX, imm);
+        emit_setcc(e, cc);
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (t)
+        emit_store(e, EAX, GPR_OFF(t));
+}
+
+// rd = rt shift sa
+static void emit_shift_rri(psx_jit_emitter_t *e, int ext, int d, int t, int sa, int pending)
+{
+    if (d)
+    {
+        emit_load(e, EAX, GPR_OFF(t));
+        emit_shift_imm(e, ext, EAX, sa);
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (d)
+        emit_store(e, EAX, GPR_OFF(d));
+}
+
+// rd = rt shift (rs & 31)
+static void emit_shift_rrr(psx_jit_emitter_t *e, int ext, int d, int t, int s, int pending)
+{
+    if (d)
+    {
+        emit_load(e, EAX, GPR_OFF(t));
+        emit_load(e, ECX, GPR_OFF(s));
+        emit_shift_cl(e, ext, EAX);
+    }
+
+    if (pending)
+        emit_pending_load(e);
+
+    if (d)
+        emit_store(e, EAX, GPR_OFF(d));
+}
+
+// hi:lo = rs * rt
+static void emit_mult(psx_jit_emitter_t *e, int ext, int s, int t, int pending)
+{
+    emit_load(e, EAX, GPR_OFF(s));
+    emit_rm(e, 0xf7, ext, GPR_OFF(t));
+    emit_store(e, EAX, CPU_OFF(lo));
+    emit_store(e, EDX, CPU_OFF(hi));
+
+    if (pending)
+        emit_pending_load(e);
+}
+
+// Translates instructions that can't fault, take a branch or access
+// memory. Operands are read before the pending load is retired and
+// results written after, same as the interpreter's handlers
+static int psx_jit_emit_native(psx_jit_emitter_t *e, uint32_t opcode, int pending)
+{
+    int s = (opcode >> 21) & 0x1f;
+    int t = (opcode >> 16) & 0x1f;
+    int d = (opcode >> 11) & 0x1f;
+    int sa = (opcode >> 6) & 0x1f;
+    uint32_t imm = opcode & 0xffff;
+    uint32_t simm = (uint32_t)((int32_t)((int16_t)imm));
+
+    switch (opcode >> 26)
+    {
+    case 0x00:
+    {
+        switch (opcode & 0x3f)
+        {
+        case 0x00:
+            emit_shift_rri(e, EXT_SHL, d, t, sa, pending);
+            return 1;
+        case 0x02:
+            emit_shift_rri(e, EXT_SHR, d, t, sa, pending);
+            return 1;
+        case 0x03:
+            emit_shift_rri(e, EXT_SAR, d, t, sa, pending);
+            return 1;
+        case 0x04:
+            emit_shift_rrr(e, EXT_SHL, d, t, s, pending);
+            return 1;
+        case 0x06:
+            emit_shift_rrr(e, EXT_SHR, d, t, s, pending);
+            return 1;
+        case 0x07:
+            emit_shift_rrr(e, EXT_SAR, d, t, s, pending);
+            return 1;
+        case 0x10:
+        case 0x12:
+        {
+            if (pending)
+                emit_pending_load(e);
+
+            if (d)
+            {
+                emit_load(e, EAX, ((opcode & 0x3f) == 0x10) ? CPU_OFF(hi) : CPU_OFF(lo));
+                emit_store(e, EAX, GPR_OFF(d));
+            }
+        }
+            return 1;
+        case 0x11:
+        case 0x13:
+        {
+            // mthi/mtlo read rs after the pending load is retired
+            if (pending)
+                emit_pending_load(e);
+
+            emit_load(e, EAX, GPR_OFF(s));
+            emit_store(e, EAX, ((opcode & 0x3f) == 0x11) ? CPU_OFF(hi) : CPU_OFF(lo));
+        }
+            return 1;
+        case 0x18:
+            emit_mult(e, 5, s, t, pending);
+            return 1;
+        case 0x19:
+            emit_mult(e, 4, s, t, pending);
+            return 1;
+        case 0x21:
+            emit_alu_rrr(e, ALU_ADD, d, s, t, pending);
+            return 1;
+        case 0x23:
+            emit_alu_rrr(e, ALU_SUB, d, s, t, pending);
+            return 1;
+        case 0x24:
+            emit_alu_rrr(e, ALU_AND, d, s, t, pending);
+            return 1;
+        case 0x25:
+            emit_alu_rrr(e, ALU_OR, d, s, t, pending);
+            return 1;
+        case 0x26:
+            emit_alu_rrr(e, ALU_XOR, d, s, t, pending);
+            return 1;
+        case 0x27:
+        {
+            if (d)
+            {
+                emit_load(e, EAX, GPR_OFF(s));
+                emit_rm(e, ALU_OR, EAX, GPR_OFF(t));
+
+                // not eax
+                emit8(e, 0xf7);
+                emit8(e, 0xd0);
+            }
+
+            if (pending)
+                emit_pending_load(e);
+
+            if (d)
+                emit_store(e, EAX, GPR_OFF(d));
+        }
+            return 1;
+        case 0x2a:
+            emit_slt_rrr(e, CC_L, d, s, t, pending);
+            return 1;
+        case 0x2b:
+            emit_slt_rrr(e, CC_B, d, s, t, pending);
+            return 1;
+        }
+    }
+    break;
+    case 0x09:
+        emit_alu_rri(e, EXT_ADD, t, s, simm, pending);
+        return 1;
+    case 0x0a:
+        emit_slt_rri(e, CC_L, t, s, simm, pending);
+        return 1;
+    case 0x0b:
+        emit_slt_rri(e, CC_B, t, s, simm, pending);
+        return 1;
+    case 0x0c:
+        emit_alu_rri(e, EXT_AND, t, s, imm, pending);
+        return 1;
+    case 0x0d:
+        emit_alu_rri(e, EXT_OR, t, s, imm, pending);
+        return 1;
+    case 0x0e:
+        emit_alu_rri(e, EXT_XOR, t, s, imm, pending);
+        return 1;
+    case 0x0f:
+    {
+        if (pending)
+            emit_pending_load(e);
+
+        if (t)
+            emit_store_imm(e, GPR_OFF(t), imm << 16);
+    }
+        return 1;
+    }
+
+    return 0;
+}
+
+static int psx_jit_is_branch(uint32_t opcode)
+{
+    switch (opcode >> 26)
+    {
+    case 0x00:
+        return ((opcode & 0x3f) == 0x08) || ((opcode & 0x3f) == 0x09);
+    case 0x01:
+    case 0x02:
+    case 0x03:
+    case 0x04:
+    case 0x05:
+    case 0x06:
+    case 0x07:
+        return 1;
+    }
+
+    return 0;
+}
+
+// syscall and break always raise an exception
+static int psx_jit_is_trap(uint32_t opcode)
+{
+    return ((opcode >> 26) == 0x00) &&
+           (((opcode & 0x3f) == 0x0c) || ((opcode & 0x3f) == 0x0d));
+}
+
+static psx_jit_block_t psx_jit_compile(psx_jit_t *jit, uint32_t pc)
+{
+    psx_cpu_t *cpu = jit->cpu;
+    psx_jit_emitter_t e;
+
+    uint8_t *exits[PSX_JIT_MAX_INSNS + 1];
+    int exit_count = 0;
+
+    e.ptr = jit->code + jit->code_used;
+
+    uint8_t *start = e.ptr;
+
+    emit_prologue(&e);
+
+    // Blocks are only entered with no branch pending
+    emit_store_imm(&e, CPU_OFF(delay_slot), 0);
+
+    uint32_t end = (pc | (PSX_CPU_CACHE_PAGE_SIZE - 1)) + 1;
+    uint32_t addr = pc;
+    uint32_t fetch_cycles = 0;
+    uint32_t cycles = 0;
+    uint32_t insns = 0;
+    uint32_t budget = 0;
+    int count = 0;
+    int pending = 1;
+    int native = 0;
+    int delay_slot = 0;
+    int last_delay_slot = 0;
+
+    while (addr < end)
+    {
+        // The B0 hook and HLE kernel calls run from the interpreter
+        if (count && (((addr & 0x3fffffff) == 0x000000b4) || psx_hle_is_vector(addr)))
+            break;
+
+        uint32_t opcode = psx_bus_read32(cpu->bus, addr);
+
+        if (!count)
+            fetch_cycles = psx_bus_get_access_cycles(cpu->bus);
+
+        if (delay_slot)
+            emit_delay_slot_prologue(&e, addr);
+
+        cycles += fetch_cycles;
+        insns++;
+
+        native = psx_jit_emit_native(&e, opcode, pending);
+
+        if (native)
+        {
+            cycles += 2;
+            pending = 0;
+        }
+        else
+        {
+            if (!delay_slot)
+                emit_sync_pc(&e, addr);
+
+            emit_flush_counters(&e, cycles, insns);
+
+            cycles = 0;
+            insns = 0;
+
+            emit_call(&e, psx_cpu_decode(opcode), opcode, addr + 4);
+
+            // Nothing left to skip after a delay slot
+            if (!delay_slot)
+            {
+                emit8(&e, 0x85), emit8(&e, 0xc0); // test eax, eax
+                emit8(&e, 0x0f), emit8(&e, 0x85); // jnz exit
+                emit32(&e, 0);
+
+                exits[exit_count++] = e.ptr;
+            }
+
+            pending = 1;
+        }
+
+        // GTE commands take up to 44 cycles
+        budget += fetch_cycles + ((((opcode >> 25) & 0x7f) == 0x25) ? 44 : 2);
+
+        count++;
+        addr += 4;
+
+        last_delay_slot = delay_slot;
+
+        if (delay_slot)
+            break;
+
+        delay_slot = psx_jit_is_branch(opcode);
+
+        if (psx_jit_is_trap(opcode))
+            break;
+
+        if (!delay_slot && ((count >= PSX_JIT_MAX_INSNS) || (budget >= PSX_JIT_MAX_CYCLES)))
+            break;
+    }
+
+    if (native && !last_delay_slot)
+        emit_sync_pc(&e, addr - 4);
+
+    emit_flush_counters(&e, cycles, insns);
+
+    for (int i = 0; i < exit_count; i++)
+    {
+        int32_t rel = (int32_t)(e.ptr - exits[i]);
+
+        memcpy(exits[i] - 4, &rel, 4);
+    }
+
+    emit_epilogue(&e);
+
+    jit->code_used += e.ptr - start;
+
+    // Get notified when the code we just translated is overwritten
+    psx_bus_protect_code(cpu->bus, pc);
+
+    return (psx_jit_block_t)start;
+}
+
+// Pages in [offset, offset + size) become writable or executable,
+// never both
+static int psx_jit_protect(psx_jit_t *jit, size_t offset, size_t size, int exec)
+{
+    size_t start = offset & ~(size_t)(PSX_JIT_PAGE_SIZE - 1);
+    size_t end = (offset + size + PSX_JIT_PAGE_SIZE - 1) & ~(size_t)(PSX_JIT_PAGE_SIZE - 1);
+
+    if (end > PSX_JIT_CODE_SIZE)
+        end = PSX_JIT_CODE_SIZE;
+
+#ifdef _WIN32
+    DWORD old;
+
+    if (!VirtualProtect(jit->code + start, end - start, exec ? PAGE_EXECUTE_READ : PAGE_READWRITE, &old))
+        return 1;
+
+    if (exec)
+        FlushInstructionCache(GetCurrentProcess(), jit->code + start, end - start);
+
+    return 0;
+#else
+    return mprotect(jit->code + start, end - start, exec ? (PROT_READ | PROT_EXEC) : (PROT_READ | PROT_WRITE)) != 0;
+#endif
+}
+
+static psx_jit_entry_t *psx_jit_get_entry(psx_jit_t *jit, uint32_t pc)
+{
+    int page = psx_cpu_get_code_page(jit->cpu, pc);
+
+    if (page == -1)
+        return NULL;
+
+    if (!jit->entry_page[page])
+        jit->entry_page[page] = (psx_jit_entry_t *)calloc(
+            PSX_CPU_CACHE_PAGE_SIZE >> 2,
+            sizeof(psx_jit_entry_t));
+
+    return &jit->entry_page[page][(pc & (PSX_CPU_CACHE_PAGE_SIZE - 1)) >> 2];
+}
+
+int psx_jit_init(psx_jit_t *jit, psx_cpu_t *cpu)
+{
+    memset(jit, 0, sizeof(psx_jit_t));
+
+    jit->cpu = cpu;
+
+    // Never mapped writable and executable at once, psx_jit_run
+    // flips pages around each compile
+#ifdef _WIN32
+    jit->code = (uint8_t *)VirtualAlloc(NULL, PSX_JIT_CODE_SIZE, MEM_COMMIT | MEM_RESERVE, PAGE_READWRITE);
+#else
+    int flags = MAP_PRIVATE | MAP_ANONYMOUS;
+
+#ifdef MAP_JIT
+    // Hardened runtimes only allow executable mappings made with MAP_JIT
+    flags |= MAP_JIT;
+#endif
+
+    jit->code = (uint8_t *)mmap(NULL, PSX_JIT_CODE_SIZE, PROT_READ | PROT_WRITE, flags, -1, 0);
+
+    if (jit->code == MAP_FAILED)
+        jit->code = NULL;
+#endif
+
+    if (!jit->code)
+    {
+        log_error("Couldn't allocate JIT code buffer");
+
+        return 1;
+    }
+
+    return 0;
+}
+
+// Returns 0 if the current instruction has to be run by the interpreter
+int psx_jit_run(psx_jit_t *jit)
+{
+    psx_cpu_t *cpu = jit->cpu;
+
+    // Pending delay slots, misaligned PCs, the B0 hook, HLE and
+    // interrupts are all handled by the interpreter
+    if (cpu->branch || (cpu->pc & 3) || (cpu->next_pc != (cpu->pc + 4)))
+        return 0;
+
+    if ((cpu->pc & 0x3fffffff) == 0x000000b4)
+        return 0;
+
+    if (cpu->hle && psx_hle_is_vector(cpu->pc))
+        return 0;
+
+    if (psx_cpu_check_irq(cpu))
+        return 0;
+
+    psx_jit_entry_t *entry = psx_jit_get_entry(jit, cpu->pc);
+
+    if (!entry)
+        return 0;
+
+    if (!entry->entry || (entry->pc != cpu->pc))
+    {
+        if ((jit->code_used + PSX_JIT_BLOCK_SIZE) > PSX_JIT_CODE_SIZE)
+        {
+            psx_jit_flush(jit);
+
+            entry = psx_jit_get_entry(jit, cpu->pc);
+        }
+
+        size_t offset = jit->code_used;
+
+        if (psx_jit_protect(jit, offset, PSX_JIT_BLOCK_SIZE, 0))
+        {
+            log_error("Couldn't make the JIT code buffer writable");
+
+            return 0;
+        }
+
+        psx_jit_block_t block = psx_jit_compile(jit, cpu->pc);
+
+        if (psx_jit_protect(jit, offset, jit->code_used - offset, 1))
+        {
+            log_error("Couldn't make the JIT code buffer executable");
+
+            return 0;
+        }
+
+        entry->pc = cpu->pc;
+        entry->entry = block;
+    }
+
+    cpu->last_cycles = 0;
+    cpu->last_instructions = 0;
+
+    jit->invalidated = 0;
+
+    entry->entry(cpu);
+
+    cpu->total_cycles += cpu->last_cycles;
+
+    return 1;
+}
+
+void psx_jit_destroy(psx_jit_t *jit)
+{
+    psx_jit_flush(jit);
+
+    if (jit->code)
+    {
+#ifdef _WIN32
+        VirtualFree(jit->code, 0, MEM_RELEASE);
+#else
+        munmap(jit->code, PSX_JIT_CODE_SIZE);
+#endif
+    }
+
+    free(jit);
+}
+
+#undef EAX
+#undef ECX
+#undef EDX
+#undef EBX
+#undef CPU_OFF
+#undef GPR_OFF
+
+#else
+
+int psx_jit_init(psx_jit_t *jit, psx_cpu_t *cpu)
+{
+    memset(jit, 0, sizeof(psx_jit_t));
+
+    jit->cpu = cpu;
+
+    return 1;
+}
+
+int psx_jit_run(psx_jit_t *jit)
+{
+    return 0;
+}
+
+void psx_jit_destroy(psx_jit_t *jit)
+{
+    psx_jit_flush(jit);
+
+    free(jit);
+}
+
+#endif
@@ -0,0 +1,389 @@
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <time.h>
+
+#include "psx/jit_bench.h"
+#include "psx/psx.h"
+#include "psx/log.h"
+
+#define JIT_BENCH_CODE 0x80010000
+#define JIT_BENCH_DATA 0x80100000
+#define JIT_BENCH_DATA_SIZE 0x400
+#define JIT_BENCH_MAX_STEPS 0x100000
+
+// Loop counter and data pointer, random code never writes these
+#define JIT_BENCH_COUNTER 27
+#define JIT_BENCH_BASE 28
+
+// Shifts, HI/LO moves, multiply/divide and ALU ops
+static const uint8_t g_psx_jit_bench_functs[] = {
+    0x00, 0x02, 0x03, 0x04, 0x06, 0x07, 0x10, 0x11, 0x12, 0x13, 0x18,
+    0x19, 0x1a, 0x1b, 0x21, 0x23, 0x24, 0x25, 0x26, 0x27, 0x2a, 0x2b};
+
+// addiu, slti, sltiu, andi, ori, xori and lui
+static const uint8_t g_psx_jit_bench_imm_ops[] = {
+    0x09, 0x0a, 0x0b, 0x0c, 0x0d, 0x0e, 0x0f};
+
+// Load and store opcodes with their alignment masks
+static const uint8_t g_psx_jit_bench_mem_ops[][2] = {
+    {0x20, 0}, {0x21, 1}, {0x22, 0}, {0x23, 3}, {0x24, 0}, {0x25, 1}, {0x26, 0},
+    {0x28, 0}, {0x29, 1}, {0x2a, 0}, {0x2b, 3}, {0x2e, 0}};
+
+#define JIT_BENCH_FUNCTS (sizeof(g_psx_jit_bench_functs) / sizeof(uint8_t))
+#define JIT_BENCH_IMM_OPS (sizeof(g_psx_jit_bench_imm_ops) / sizeof(uint8_t))
+#define JIT_BENCH_MEM_OPS (sizeof(g_psx_jit_bench_mem_ops) / sizeof(g_psx_jit_bench_mem_ops[0]))
+
+static uint32_t jit_bench_rand(uint32_t *seed)
+{
+    uint32_t x = *seed;
+
+    x ^= x << 13;
+    x ^= x >> 17;
+    x ^= x << 5;
+
+    return *seed = x;
+}
+
+// Mostly plain random values, with enough extremes mixed in to
+// exercise sign extension and the comparisons
+static uint32_t jit_bench_rand_value(uint32_t *seed)
+{
+    uint32_t v = jit_bench_rand(seed);
+
+    switch (jit_bench_rand(seed) & 7)
+    {
+    case 0:
+        return v & 0xff;
+    case 1:
+        return (v & 1) ? 0x7fffffff : 0x80000000;
+    case 2:
+        return (v & 1) ? 0xffffffff : 0;
+    }
+
+    return v;
+}
+
+// Any register but the loop counter and the data pointer, r0 included
+static uint32_t jit_bench_rand_dest(uint32_t *seed)
+{
+    uint32_t r = jit_bench_rand(seed) & 0x1f;
+
+    return ((r == JIT_BENCH_COUNTER) || (r == JIT_BENCH_BASE)) ? 0 : r;
+}
+
+static double jit_bench_now(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (ts.tv_sec * 1e9) + ts.tv_nsec;
+}
+
+// Branches only go forward, to at most the loop counter at length
+static uint32_t jit_bench_gen_branch(uint32_t *seed, int i, int length)
+{
+    int target = i + 2 + (jit_bench_rand(seed) & 7);
+
+    if (target > length)
+        target = length;
+
+    uint32_t s = jit_bench_rand(seed) & 0x1f;
+    uint32_t t = jit_bench_rand(seed) & 0x1f;
+    uint32_t offset = (uint32_t)(target - (i + 1)) & 0xffff;
+
+    switch (jit_bench_rand(seed) % 6)
+    {
+    case 0:
+        return 0x10000000 | (s << 21) | (t << 16) | offset; // beq
+    case 1:
+        return 0x14000000 | (s << 21) | (t << 16) | offset; // bne
+    case 2:
+        return 0x18000000 | (s << 21) | offset; // blez
+    case 3:
+        return 0x1c000000 | (s << 21) | offset; // bgtz
+    case 4:
+    {
+        // bltz, bgez, bltzal and bgezal
+        static const uint32_t rt[] = {0x00, 0x01, 0x10, 0x11};
+
+        return 0x04000000 | (s << 21) | (rt[t & 3] << 16) | offset;
+    }
+    }
+
+    // j or jal
+    uint32_t addr = JIT_BENCH_CODE + (target << 2);
+
+    return ((t & 1) ? 0x0c000000 : 0x08000000) | ((addr >> 2) & 0x3ffffff);
+}
+
+static uint32_t jit_bench_gen(uint32_t *seed, int i, int length, int delay_slot)
+{
+    uint32_t s = jit_bench_rand(seed) & 0x1f;
+    uint32_t t = jit_bench_rand_dest(seed);
+    uint32_t d = jit_bench_rand_dest(seed);
+    uint32_t sa = jit_bench_rand(seed) & 0x1f;
+    uint32_t imm = jit_bench_rand_value(seed) & 0xffff;
+
+    uint32_t kind = jit_bench_rand(seed) & 15;
+
+    // No branches in delay slots
+    if ((kind >= 13) && delay_slot)
+        kind = 0;
+
+    if (kind < 6)
+    {
+        uint32_t funct = g_psx_jit_bench_functs[jit_bench_rand(seed) % JIT_BENCH_FUNCTS];
+
+        return (s << 21) | ((jit_bench_rand(seed) & 0x1f) << 16) | (d << 11) | (sa << 6) | funct;
+    }
+
+    if (kind < 9)
+    {
+        uint32_t op = g_psx_jit_bench_imm_ops[jit_bench_rand(seed) % JIT_BENCH_IMM_OPS];
+
+        return (op << 26) | (s << 21) | (t << 16) | imm;
+    }
+
+    if (kind < 13)
+    {
+        const uint8_t *op = g_psx_jit_bench_mem_ops[jit_bench_rand(seed) % JIT_BENCH_MEM_OPS];
+
+        uint32_t offset = (jit_bench_rand(seed) % JIT_BENCH_DATA_SIZE) & ~(uint32_t)op[1];
+
+        // Stores read rt, any register will do
+        if (op[0] >= 0x28)
+            t = jit_bench_rand(seed) & 0x1f;
+
+        return ((uint32_t)op[0] << 26) | (JIT_BENCH_BASE << 21) | (t << 16) | offset;
+    }
+
+    return jit_bench_gen_branch(seed, i, length);
+}
+
+/*
+    length random instructions, the last one a nop so no load is left
+    pending, then:
+
+        addiu $27, $27, -1
+        bne   $27, $0, start
+        nop
+    end:
+        beq   $0, $0, end
+        nop
+*/
+static void jit_bench_gen_program(uint32_t *seed, uint32_t *code, int length)
+{
+    int delay_slot = 0;
+
+    for (int i = 0; i < length - 1; i++)
+    {
+        code[i] = jit_bench_gen(seed, i, length, delay_slot);
+
+        delay_slot = (code[i] >> 26) && ((code[i] >> 26) < 0x08);
+    }
+
+    code[length - 1] = 0;
+    code[length + 0] = 0x24000000 | (JIT_BENCH_COUNTER << 21) | (JIT_BENCH_COUNTER << 16) | 0xffff;
+    code[length + 1] = 0x14000000 | (JIT_BENCH_COUNTER << 21) | ((uint32_t)-(length + 2) & 0xffff);
+    code[length + 2] = 0;
+    code[length + 3] = 0x1000ffff;
+    code[length + 4] = 0;
+}
+
+static void jit_bench_load(psx_t *psx, const uint32_t *code, int size, const uint32_t *state, int passes)
+{
+    psx_bus_t *bus = psx_get_bus(psx);
+    psx_cpu_t *cpu = psx_get_cpu(psx);
+
+    // Goes through the bus so stale blocks are dropped
+    for (int i = 0; i < size; i++)
+        psx_bus_write32(bus, JIT_BENCH_CODE + (i << 2), code[i]);
+
+    for (int i = 0; i < (JIT_BENCH_DATA_SIZE >> 2); i++)
+        psx_bus_write32(bus, JIT_BENCH_DATA + (i << 2), state[34 + i]);
+
+    memcpy(cpu->r, state, sizeof(cpu->r));
+
+    cpu->r[0] = 0;
+    cpu->r[JIT_BENCH_COUNTER] = passes;
+    cpu->r[JIT_BENCH_BASE] = JIT_BENCH_DATA;
+    cpu->hi = state[32];
+    cpu->lo = state[33];
+    cpu->load_d = 0;
+    cpu->load_v = 0xffffffff;
+    cpu->pc = JIT_BENCH_CODE;
+    cpu->next_pc = JIT_BENCH_CODE + 4;
+    cpu->branch = 0;
+    cpu->delay_slot = 0;
+    cpu->branch_taken = 0;
+}
+
+// Returns non-zero if the program doesn't reach its end
+static int jit_bench_exec(psx_t *psx, uint32_t end)
+{
+    psx_cpu_t *cpu = psx_get_cpu(psx);
+
+    for (int i = 0; i < JIT_BENCH_MAX_STEPS; i++)
+    {
+        if ((cpu->pc == end) && !cpu->branch)
+            return 0;
+
+        psx_cpu_cycle(cpu);
+    }
+
+    return 1;
+}
+
+// Everything the program can change, in the same layout as the state
+static void jit_bench_store(psx_t *psx, uint32_t *regs)
+{
+    psx_bus_t *bus = psx_get_bus(psx);
+    psx_cpu_t *cpu = psx_get_cpu(psx);
+
+    memcpy(regs, cpu->r, sizeof(cpu->r));
+
+    regs[32] = cpu->hi;
+    regs[33] = cpu->lo;
+
+    for (int i = 0; i < (JIT_BENCH_DATA_SIZE >> 2); i++)
+        regs[34 + i] = psx_bus_read32(bus, JIT_BENCH_DATA + (i << 2));
+
+    regs[34 + (JIT_BENCH_DATA_SIZE >> 2)] = cpu->pc;
+    regs[35 + (JIT_BENCH_DATA_SIZE >> 2)] = cpu->cop0_r[COP0_SR];
+    regs[36 + (JIT_BENCH_DATA_SIZE >> 2)] = cpu->cop0_r[COP0_CAUSE];
+    regs[37 + (JIT_BENCH_DATA_SIZE >> 2)] = cpu->cop0_r[COP0_EPC];
+}
+
+#define JIT_BENCH_STATE_SIZE (38 + (JIT_BENCH_DATA_SIZE >> 2))
+
+static const char *jit_bench_reg_name(int r, char *buf)
+{
+    static const char *names[] = {"pc", "sr", "cause", "epc"};
+
+    if (r < 32)
+    {
+        sprintf(buf, "r%d", r);
+    }
+    else if (r < 34)
+    {
+        return (r == 32) ? "hi" : "lo";
+    }
+    else if (r < (34 + (JIT_BENCH_DATA_SIZE >> 2)))
+    {
+        sprintf(buf, "[%08x]", JIT_BENCH_DATA + ((r - 34) << 2));
+    }
+    else
+    {
+        return names[r - (34 + (JIT_BENCH_DATA_SIZE >> 2))];
+    }
+
+    return buf;
+}
+
+static psx_t *jit_bench_create(int mode)
+{
+    psx_t *psx = psx_create();
+
+    // No BIOS, programs run straight from RAM
+    if (psx_init(psx, NULL, NULL))
+    {
+        psx_destroy(psx);
+
+        return NULL;
+    }
+
+    psx_cpu_set_mode(psx_get_cpu(psx), mode);
+
+    return psx;
+}
+
+int psx_jit_bench_run(int programs, int length, int passes)
+{
+    psx_t *jit = jit_bench_create(PSX_CPU_JIT);
+
+    if (!jit)
+        return 1;
+
+    if (psx_get_cpu(jit)->mode != PSX_CPU_JIT)
+    {
+        log_info("No JIT for this host, nothing to check");
+
+        psx_destroy(jit);
+
+        return 0;
+    }
+
+    psx_t *interp = jit_bench_create(PSX_CPU_INTERPRETER);
+
+    if (!interp)
+    {
+        psx_destroy(jit);
+
+        return 1;
+    }
+
+    int size = length + 5;
+    uint32_t end = JIT_BENCH_CODE + ((length + 3) << 2);
+
+    uint32_t *code = (uint32_t *)malloc(size * sizeof(uint32_t));
+    uint32_t state[JIT_BENCH_STATE_SIZE];
+    uint32_t a[JIT_BENCH_STATE_SIZE], b[JIT_BENCH_STATE_SIZE];
+    uint32_t seed = 0x2545f491;
+    char name[16];
+
+    int mismatches = 0;
+    double jit_time = 0.0;
+    double interp_time = 0.0;
+
+    for (int n = 0; n < programs; n++)
+    {
+        jit_bench_gen_program(&seed, code, length);
+
+        for (int r = 0; r < JIT_BENCH_STATE_SIZE; r++)
+            state[r] = jit_bench_rand_value(&seed);
+
+        jit_bench_load(jit, code, size, state, passes);
+        jit_bench_load(interp, code, size, state, passes);
+
+        double start = jit_bench_now();
+
+        int jit_stuck = jit_bench_exec(jit, end);
+
+        double mid = jit_bench_now();
+
+        int interp_stuck = jit_bench_exec(interp, end);
+
+        jit_time += mid - start;
+        interp_time += jit_bench_now() - mid;
+
+        jit_bench_store(jit, a);
+        jit_bench_store(interp, b);
+
+        if (!jit_stuck && !interp_stuck && !memcmp(a, b, sizeof(a)))
+            continue;
+
+        if (mismatches++ >= 16)
+            continue;
+
+        if (jit_stuck || interp_stuck)
+            printf("jit: program %d didn't finish on the %s\n", n, jit_stuck ? "JIT" : "interpreter");
+
+        for (int r = 0; r < JIT_BENCH_STATE_SIZE; r++)
+            if (a[r] != b[r])
+                printf("jit: program %d: %s = %08x, interpreter %08x\n", n, jit_bench_reg_name(r, name), a[r], b[r]);
+    }
+
+    printf("jit: %d mismatches\n", mismatches);
+
+    if (programs)
+        printf("jit: %8.1f us/program, interpreter %8.1f us/program\n", jit_time / programs / 1e3, interp_time / programs / 1e3);
+
+    free(code);
+
+    psx_destroy(jit);
+    psx_destroy(interp);
+
+    return mismatches;
+}
@@ -20,6 +20,11 @@
  * IN THE SOFTWARE.
  */
 
+// Needed for localtime_r
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
 #include "psx/log.h"
 
 #define MAX_CALLBACKS 32
@@ -132,12 +137,19 @@ int log_add_fp(FILE *fp, int level)
     return log_add_callback(file_callback, fp, level);
 }
 
-static void init_event(log_Event *ev, void *udata)
+// The time is converted into the caller's buffer, localtime's
+// static buffer isn't safe with several emulator threads logging
+static void init_event(log_Event *ev, void *udata, struct tm *tm)
 {
     if (!ev->time)
     {
         time_t t = time(NULL);
-        ev->time = localtime(&t);
+#ifdef _WIN32
+        localtime_s(tm, &t);
+#else
+        localtime_r(&t, tm);
+#endif
+        ev->time = tm;
     }
     ev->udata = udata;
 }
@@ -151,11 +163,13 @@ void log_log(int level, const char *file, int line, const char *fmt, ...)
         .level = level,
     };
 
+    struct tm tm;
+
     lock();
 
     if (!L.quiet && level >= L.level)
     {
-        init_event(&ev, stderr);
+        init_event(&ev, stderr, &tm);
         va_start(ev.ap, fmt);
         stdout_callback(&ev);
         va_end(ev.ap);
@@ -166,7 +180,7 @@ void log_log(int level, const char *file, int line, const char *fmt, ...)
         Callback *cb = &L.callbacks[i];
         if (level >= cb->level)
         {
-            init_event(&ev, cb->udata);
+            init_event(&ev, cb->udata, &tm);
             va_start(ev.ap, fmt);
             cb->fn(&ev);
             va_end(ev.ap);
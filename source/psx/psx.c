@@ -1,27 +1,373 @@
 #include "psx/psx.h"
 
+#include <time.h>
+
 psx_t *psx_create(void)
 {
-    return (psx_t *)malloc(sizeof(psx_t));
+    psx_t *psx = (psx_t *)malloc(sizeof(psx_t));
+
+    psx->arena.base = NULL;
+
+    return psx;
+}
+
+// Hottest devices first so they end up close together
+static size_t psx_get_arena_size(void)
+{
+    return psx_arena_footprint(sizeof(psx_t)) +
+           psx_arena_footprint(sizeof(psx_cpu_t)) +
+           psx_arena_footprint(sizeof(psx_bus_t)) +
+           psx_arena_footprint(sizeof(psx_sched_t)) +
+           psx_arena_footprint(sizeof(psx_ic_t)) +
+           psx_arena_footprint(sizeof(psx_timer_t)) +
+           psx_arena_footprint(sizeof(psx_dma_t)) +
+           psx_arena_footprint(sizeof(psx_gpu_t)) +
+           psx_arena_footprint(sizeof(psx_spu_t)) +
+           psx_arena_footprint(sizeof(psx_scratchpad_t)) +
+           psx_arena_footprint(sizeof(psx_ram_t)) +
+           psx_arena_footprint(sizeof(psx_mc1_t)) +
+           psx_arena_footprint(sizeof(psx_mc2_t)) +
+           psx_arena_footprint(sizeof(psx_mc3_t)) +
+           psx_arena_footprint(sizeof(psx_exp1_t)) +
+           psx_arena_footprint(sizeof(psx_exp2_t)) +
+           psx_arena_footprint(sizeof(psx_bios_t)) +
+           psx_arena_footprint(PSX_SCRATCHPAD_SIZE) +
+           psx_arena_footprint(RAM_SIZE_2MB) +
+           psx_arena_footprint(PSX_GPU_BUF_SIZE) +
+           psx_arena_footprint(SPU_RAM_SIZE) +
+           psx_arena_footprint(PSX_EXP1_SIZE);
+}
+
+psx_t *psx_create_arena(int flags)
+{
+    psx_arena_t arena;
+
+    if (psx_arena_init(&arena, psx_get_arena_size(), flags))
+        return NULL;
+
+    psx_t *psx = (psx_t *)psx_arena_alloc(&arena, sizeof(psx_t));
+
+    psx->arena = arena;
+
+    return psx;
+}
+
+static uint64_t psx_hash(uint64_t hash, const void *buf, size_t size)
+{
+    const uint8_t *p = (const uint8_t *)buf;
+
+    for (size_t i = 0; i < size; i++)
+    {
+        hash ^= p[i];
+        hash *= 0x100000001b3ull;
+    }
+
+    return hash;
+}
+
+// Save files are keyed on it, so it's worked out once per BIOS
+static void psx_update_bios_hash(psx_t *psx)
+{
+    psx->bios_hash = 0;
+
+    if (psx->bios->image)
+        psx->bios_hash = psx_hash(0xcbf29ce484222325ull, psx->bios->image->buf, psx->bios->image->size);
+}
+
+static void psx_update_exp1_hash(psx_t *psx)
+{
+    psx->exp1_hash = psx_hash(0xcbf29ce484222325ull, psx->exp1->rom, PSX_EXP1_SIZE);
 }
 
 int psx_load_bios(psx_t *psx, const char *path)
 {
-    return psx_bios_load(psx->bios, path);
+    int ret = psx_bios_load(psx->bios, path);
+
+    psx_update_bios_hash(psx);
+
+    psx_bus_init_page_table(psx->bus);
+    psx_cpu_flush_cache(psx->cpu);
+
+    return ret;
 }
 
-void psx_load_state(psx_t *psx, const char *path)
+// States only load into a build with the same struct sizes
+static uint32_t psx_get_state_layout(void)
 {
-    log_fatal("State saving/loading is not yet supported");
+    const uint32_t sizes[] = {
+        PSX_STATE_VERSION,
+        sizeof(psx_sched_t),
+        offsetof(psx_cpu_t, bus),
+        sizeof(psx_ram_t),
+        sizeof(psx_scratchpad_t),
+        sizeof(psx_mc1_t),
+        sizeof(psx_mc2_t),
+        sizeof(psx_mc3_t),
+        sizeof(psx_exp2_t),
+        sizeof(psx_ic_t),
+        sizeof(psx_dma_t),
+        sizeof(psx_timer_t),
+        sizeof(psx_gpu_t),
+        sizeof(psx_spu_t),
+        sizeof(psx_cdrom_t),
+        sizeof(psx_pad_t),
+        sizeof(psx_mcd_t),
+        sizeof(psx_mdec_t)
+    };
 
-    exit(1);
+    return (uint32_t)psx_hash(0xcbf29ce484222325ull, sizes, sizeof(sizes));
 }
 
-void psx_save_state(psx_t *psx, const char *path)
+int psx_capture_state(psx_t *psx, psx_state_t *state, uint64_t key)
 {
-    log_fatal("State saving/loading is not yet supported");
+    psx_state_begin(state, psx_get_state_layout(), key);
 
-    exit(1);
+    psx_sched_save_state(psx->sched, state);
+    psx_cpu_save_state(psx->cpu, state);
+    psx_bus_save_state(psx->bus, state);
+    psx_ram_save_state(psx->ram, state);
+    psx_scratchpad_save_state(psx->scratchpad, state);
+    psx_mc1_save_state(psx->mc1, state);
+    psx_mc2_save_state(psx->mc2, state);
+    psx_mc3_save_state(psx->mc3, state);
+    psx_exp2_save_state(psx->exp2, state);
+    psx_ic_save_state(psx->ic, state);
+    psx_dma_save_state(psx->dma, state);
+    psx_timer_save_state(psx->timer, state);
+    psx_gpu_save_state(psx->gpu, state);
+    psx_spu_save_state(psx->spu, state);
+    psx_cdrom_save_state(psx->cdrom, state);
+    psx_pad_save_state(psx->pad, state);
+    psx_mdec_save_state(psx->mdec, state);
+
+    return psx_state_end(state);
+}
+
+int psx_restore_state(psx_t *psx, psx_state_t *state, uint64_t *key)
+{
+    if (psx_state_open(state, psx_get_state_layout(), key))
+        return 1;
+
+    int ret = psx_sched_load_state(psx->sched, state) ||
+              psx_cpu_load_state(psx->cpu, state) ||
+              psx_bus_load_state(psx->bus, state) ||
+              psx_ram_load_state(psx->ram, state) ||
+              psx_scratchpad_load_state(psx->scratchpad, state) ||
+              psx_mc1_load_state(psx->mc1, state) ||
+              psx_mc2_load_state(psx->mc2, state) ||
+              psx_mc3_load_state(psx->mc3, state) ||
+              psx_exp2_load_state(psx->exp2, state) ||
+              psx_ic_load_state(psx->ic, state) ||
+              psx_dma_load_state(psx->dma, state) ||
+              psx_timer_load_state(psx->timer, state) ||
+              psx_gpu_load_state(psx->gpu, state) ||
+              psx_spu_load_state(psx->spu, state) ||
+              psx_cdrom_load_state(psx->cdrom, state) ||
+              psx_pad_load_state(psx->pad, state) ||
+              psx_mdec_load_state(psx->mdec, state);
+
+    // MC1 and RAM size registers decide the memory map
+    psx_bus_init_page_table(psx->bus);
+
+    psx->idle.pc = 0xffffffff;
+    psx->idle_dirty = 1;
+
+    return ret;
+}
+
+uint64_t psx_get_boot_key(psx_t *psx)
+{
+    uint64_t hash = 0xcbf29ce484222325ull;
+
+    uint32_t config[] = {
+        PSX_STATE_VERSION,
+        psx->cpu->mode,
+        psx->cpu->hle,
+        psx->idle_skip,
+        psx->ram->size,
+        psx->cdrom->disc != NULL,
+        psx->cdrom->disc_type,
+        psx->cdrom->version,
+        psx->cdrom->region
+    };
+
+    // The ROMs were hashed when they were loaded
+    hash = psx_hash(hash, &psx->bios_hash, sizeof(psx->bios_hash));
+    hash = psx_hash(hash, &psx->exp1_hash, sizeof(psx->exp1_hash));
+    hash = psx_hash(hash, config, sizeof(config));
+
+    return hash;
+}
+
+int psx_capture_save_state(psx_t *psx, psx_state_t *state)
+{
+    return psx_capture_state(psx, state, psx->bios_hash);
+}
+
+int psx_apply_save_state(psx_t *psx, psx_state_t *state, const char *path)
+{
+    uint64_t key;
+
+    if (psx_state_open(state, psx_get_state_layout(), &key))
+    {
+        log_error("Couldn\'t load state \'%s\'", path);
+
+        return 1;
+    }
+
+    if (key != psx->bios_hash)
+        log_warn("State \'%s\' was saved with a different BIOS", path);
+
+    // Keep the running machine around in case the state is bad
+    psx_state_t backup;
+
+    psx_state_init(&backup);
+
+    if (psx_capture_state(psx, &backup, 0))
+    {
+        log_error("Couldn\'t back up the running machine, not loading \'%s\'", path);
+
+        psx_state_destroy(&backup);
+
+        return 1;
+    }
+
+    int ret = psx_restore_state(psx, state, NULL);
+
+    if (ret)
+    {
+        log_error("State \'%s\' is corrupt", path);
+
+        psx_restore_state(psx, &backup, NULL);
+    }
+
+    psx_state_destroy(&backup);
+
+    return ret;
+}
+
+int psx_save_state(psx_t *psx, const char *path)
+{
+    psx_state_t state;
+
+    psx_state_init(&state);
+
+    int ret = psx_capture_save_state(psx, &state) || psx_state_write_file(&state, path);
+
+    if (ret)
+        log_error("Couldn\'t write state \'%s\'", path);
+
+    psx_state_destroy(&state);
+
+    return ret;
+}
+
+int psx_load_state(psx_t *psx, const char *path)
+{
+    psx_state_t state;
+
+    psx_state_init(&state);
+
+    int ret = psx_state_read_file(&state, path);
+
+    if (ret)
+    {
+        log_error("Couldn\'t load state \'%s\'", path);
+    }
+    else
+    {
+        ret = psx_apply_save_state(psx, &state, path);
+    }
+
+    psx_state_destroy(&state);
+
+    return ret;
+}
+
+static double psx_get_time_ms(void)
+{
+    struct timespec ts;
+
+    timespec_get(&ts, TIME_UTC);
+
+    return (ts.tv_sec * 1000.0) + (ts.tv_nsec / 1000000.0);
+}
+
+// Memory cards keep what's on them across launches, so boot snapshots
+// are taken and restored with the slots looking empty
+static void psx_unplug_cards(psx_t *psx, psx_mcd_t **cards)
+{
+    for (int i = 0; i < 2; i++)
+    {
+        cards[i] = psx->pad->mcd_slot[i];
+
+        psx->pad->mcd_slot[i] = NULL;
+    }
+}
+
+static void psx_plug_cards(psx_t *psx, psx_mcd_t **cards)
+{
+    for (int i = 0; i < 2; i++)
+        psx->pad->mcd_slot[i] = cards[i];
+}
+
+int psx_boot_to_shell(psx_t *psx, const char *cache_path)
+{
+    double start = psx_get_time_ms();
+    uint64_t key = psx_get_boot_key(psx);
+
+    psx_mcd_t *cards[2];
+    psx_state_t state;
+
+    psx_state_init(&state);
+
+    if (cache_path && !psx_state_read_file(&state, cache_path))
+    {
+        uint64_t cached_key;
+
+        if (!psx_state_open(&state, psx_get_state_layout(), &cached_key) && (cached_key == key))
+        {
+            psx_unplug_cards(psx, cards);
+
+            int ret = psx_restore_state(psx, &state, NULL);
+
+            psx_plug_cards(psx, cards);
+
+            if (!ret)
+            {
+                log_info("Restored boot snapshot in %.2f ms", psx_get_time_ms() - start);
+
+                psx_state_destroy(&state);
+
+                return 0;
+            }
+
+            // The BIOS sets every device up again on its way to the shell
+            log_error("Boot snapshot '%s' is corrupt, booting from reset", cache_path);
+
+            psx_soft_reset(psx);
+        }
+    }
+
+    while (psx->cpu->pc != PSX_SHELL_ENTRY)
+        psx_update(psx);
+
+    log_info("Booted to the shell in %.2f ms", psx_get_time_ms() - start);
+
+    if (cache_path)
+    {
+        psx_unplug_cards(psx, cards);
+        int ret = psx_capture_state(psx, &state, key);
+
+        psx_plug_cards(psx, cards);
+
+        if (ret || psx_state_write_file(&state, cache_path))
+            log_error("Couldn't write boot snapshot '%s'", cache_path);
+    }
+
+    psx_state_destroy(&state);
+
+    return 1;
 }
 
 void psx_load_exe(psx_t *psx, const char *path)
@@ -29,15 +375,77 @@ void psx_load_exe(psx_t *psx, const char *path)
     psx_exe_load(psx->cpu, path);
 }
 
+static void psx_skip_idle_loop(psx_t *psx)
+{
+    psx_cpu_t *cpu = psx->cpu;
+    psx_sched_t *sched = psx->sched;
+
+    if (psx->idle.pc != cpu->pc)
+        psx_cpu_find_idle_loop(cpu, cpu->pc, &psx->idle);
+
+    if (!psx->idle.size)
+        return;
+
+    uint64_t cycles = sched->now - psx->idle_now;
+    uint64_t instructions = sched->instructions - psx->idle_instructions;
+    int dirty = psx->idle_dirty;
+
+    psx->idle_now = sched->now;
+    psx->idle_instructions = sched->instructions;
+    psx->idle_dirty = 0;
+
+    // Only skip after a full iteration ran without leaving the loop
+    // and without a device update, the loop might not have seen it
+    // yet. This also gives us the cycles taken per iteration
+    if (dirty || (instructions != psx->idle.size) || !cycles)
+        return;
+
+    if ((sched->deadline == PSX_SCHED_NEVER) || (sched->deadline <= sched->now))
+        return;
+
+    if (!psx_cpu_check_idle_loop(cpu, &psx->idle))
+        return;
+
+    // Whole iterations only, so timers see the same instruction
+    // count they would have seen running the loop
+    uint64_t iterations = (sched->deadline - sched->now) / cycles;
+
+    if (!iterations)
+        return;
+
+    sched->now += iterations * cycles;
+    sched->instructions += iterations * psx->idle.size;
+    cpu->total_cycles += iterations * cycles;
+
+    psx->idle_skipped += iterations * cycles;
+    psx->idle_now = sched->now;
+    psx->idle_instructions = sched->instructions;
+}
+
 void psx_update(psx_t *psx)
 {
+    uint32_t pc = psx->cpu->pc;
+
+    psx_sched_t *sched = psx->sched;
+
+    psx->cpu->sched_budget = (sched->deadline > sched->now) ? (sched->deadline - sched->now) : 0;
+
     psx_cpu_cycle(psx->cpu);
 
-    psx_cdrom_update(psx->cdrom, psx->cpu->last_cycles);
-    psx_gpu_update(psx->gpu, psx->cpu->last_cycles);
-    psx_pad_update(psx->pad, psx->cpu->last_cycles);
-    psx_timer_update(psx->timer, psx->cpu->last_cycles);
-    psx_dma_update(psx->dma, psx->cpu->last_cycles);
+    psx->sched->now += psx->cpu->last_cycles;
+    psx->sched->instructions += psx->cpu->last_instructions;
+
+    // Look for idle loops on short backward jumps
+    if (psx->idle_skip && ((pc - psx->cpu->pc) < (PSX_CPU_IDLE_LOOP_MAX << 2)))
+        psx_skip_idle_loop(psx);
+
+    // Devices are only updated when one of their events is due
+    if (psx->sched->now >= psx->sched->deadline)
+    {
+        psx_sched_run(psx->sched);
+
+        psx->idle_dirty = 1;
+    }
 }
 
 void psx_run_frame(psx_t *psx)
@@ -47,12 +455,30 @@ void psx_run_frame(psx_t *psx)
 
     unsigned int counter = (float)PSX_CPU_CPS / framerate;
 
+    psx_clear_idle_skipped_cycles(psx);
+
     while (counter--)
     {
         psx_update(psx);
     }
 }
 
+void psx_set_idle_skip(psx_t *psx, int enable)
+{
+    psx->idle_skip = enable;
+    psx->idle.pc = 0xffffffff;
+}
+
+uint64_t psx_get_idle_skipped_cycles(psx_t *psx)
+{
+    return psx->idle_skipped;
+}
+
+void psx_clear_idle_skipped_cycles(psx_t *psx)
+{
+    psx->idle_skipped = 0;
+}
+
 void *psx_get_display_buffer(psx_t *psx)
 {
     return psx_gpu_get_display_buffer(psx->gpu);
@@ -60,6 +486,8 @@ void *psx_get_display_buffer(psx_t *psx)
 
 void *psx_get_vram(psx_t *psx)
 {
+    psx_gpu_sync(psx->gpu);
+
     return psx->gpu->vram;
 }
 
@@ -85,7 +513,7 @@ uint32_t psx_get_display_format(psx_t *psx)
 
 uint32_t psx_get_dmode_width(psx_t *psx)
 {
-    static int dmode_hres_table[] = {
+    static const int dmode_hres_table[] = {
         256, 320, 512, 640};
 
     if (psx->gpu->display_mode & 0x40)
@@ -132,29 +560,88 @@ void atcons_tx(void *udata, unsigned char c)
     putchar(c);
 }
 
+// Device structs and buffers come out of the arena if there is one
+// Devices start out zeroed, so psx_destroy is safe after psx_init fails
+static void *psx_zero(void *buf, size_t size)
+{
+    if (buf)
+        memset(buf, 0, size);
+
+    return buf;
+}
+
+#define PSX_CREATE(psx, dev) \
+    ((psx_##dev##_t *)psx_zero((psx)->arena.base ? psx_arena_alloc(&(psx)->arena, sizeof(psx_##dev##_t)) : psx_##dev##_create(), sizeof(psx_##dev##_t)))
+
+#define PSX_BUF(psx, size) \
+    ((psx)->arena.base ? psx_arena_alloc(&(psx)->arena, size) : NULL)
+
+// In arena mode only these live outside the arena, everything else
+// goes away with it
+static void psx_release(psx_t *psx)
+{
+    psx_cpu_release(psx->cpu);
+    psx_gpu_release(psx->gpu);
+    psx_image_close(psx->bios->image);
+    psx_cdrom_destroy(psx->cdrom);
+    psx_pad_destroy(psx->pad);
+    psx_mdec_destroy(psx->mdec);
+
+    psx->bios->image = NULL;
+}
+
 int psx_init(psx_t *psx, const char *bios_path, const char *exp_path)
 {
+    // A fresh arena is zero filled, a CPU means psx was initialized before
+    if (psx->arena.base && psx->cpu)
+        psx_release(psx);
+
+    psx_arena_t arena = psx->arena;
+
     memset(psx, 0, sizeof(psx_t));
 
-    psx->bios = psx_bios_create();
-    psx->ram = psx_ram_create();
-    psx->dma = psx_dma_create();
-    psx->exp1 = psx_exp1_create();
-    psx->exp2 = psx_exp2_create();
-    psx->mc1 = psx_mc1_create();
-    psx->mc2 = psx_mc2_create();
-    psx->mc3 = psx_mc3_create();
-    psx->ic = psx_ic_create();
-    psx->scratchpad = psx_scratchpad_create();
-    psx->gpu = psx_gpu_create();
-    psx->spu = psx_spu_create();
-    psx->bus = psx_bus_create();
-    psx->cpu = psx_cpu_create();
-    psx->timer = psx_timer_create();
-    psx->cdrom = psx_cdrom_create();
-    psx->pad = psx_pad_create();
-    psx->mdec = psx_mdec_create();
+    psx->arena = arena;
+
+    // Reinitializing reuses the arena from the start
+    if (psx->arena.base)
+    {
+        psx->arena.used = psx_arena_footprint(sizeof(psx_t));
 
+        psx->cpu = psx_cpu_create_at(psx_arena_alloc(&psx->arena, sizeof(psx_cpu_t)));
+    }
+    else
+    {
+        psx->cpu = psx_cpu_create();
+    }
+
+    psx->bus = PSX_CREATE(psx, bus);
+    psx->sched = PSX_CREATE(psx, sched);
+    psx->ic = PSX_CREATE(psx, ic);
+    psx->timer = PSX_CREATE(psx, timer);
+    psx->dma = PSX_CREATE(psx, dma);
+    psx->gpu = PSX_CREATE(psx, gpu);
+    psx->spu = PSX_CREATE(psx, spu);
+    psx->scratchpad = PSX_CREATE(psx, scratchpad);
+    psx->ram = PSX_CREATE(psx, ram);
+    psx->mc1 = PSX_CREATE(psx, mc1);
+    psx->mc2 = PSX_CREATE(psx, mc2);
+    psx->mc3 = PSX_CREATE(psx, mc3);
+    psx->exp1 = PSX_CREATE(psx, exp1);
+    psx->exp2 = PSX_CREATE(psx, exp2);
+    psx->bios = PSX_CREATE(psx, bios);
+
+    uint8_t *scratchpad_buf = PSX_BUF(psx, PSX_SCRATCHPAD_SIZE);
+    uint8_t *ram_buf = PSX_BUF(psx, RAM_SIZE_2MB);
+    void *gpu_buf = PSX_BUF(psx, PSX_GPU_BUF_SIZE);
+    uint8_t *spu_buf = PSX_BUF(psx, SPU_RAM_SIZE);
+    uint8_t *exp1_buf = PSX_BUF(psx, PSX_EXP1_SIZE);
+
+    // These own files and buffers that come and go, they stay on the heap
+    psx->cdrom = (psx_cdrom_t *)psx_zero(psx_cdrom_create(), sizeof(psx_cdrom_t));
+    psx->pad = (psx_pad_t *)psx_zero(psx_pad_create(), sizeof(psx_pad_t));
+    psx->mdec = (psx_mdec_t *)psx_zero(psx_mdec_create(), sizeof(psx_mdec_t));
+
+    psx_sched_init(psx->sched);
     psx_bus_init(psx->bus);
 
     psx_bus_init_bios(psx->bus, psx->bios);
@@ -180,32 +667,49 @@ int psx_init(psx_t *psx, const char *bios_path, const char *exp_path)
     if (psx_bios_load(psx->bios, bios_path))
         return 1;
 
+    psx_update_bios_hash(psx);
+
     psx_mc1_init(psx->mc1);
     psx_mc2_init(psx->mc2);
     psx_mc3_init(psx->mc3);
-    psx_ram_init(psx->ram, psx->mc2, RAM_SIZE_2MB);
-    psx_dma_init(psx->dma, psx->bus, psx->ic);
+    psx_ram_init(psx->ram, psx->mc2, RAM_SIZE_2MB, ram_buf);
+    psx_dma_init(psx->dma, psx->bus, psx->ic, psx->sched);
 
-    if (psx_exp1_init(psx->exp1, psx->mc1, exp_path))
+    if (psx_exp1_init(psx->exp1, psx->mc1, exp_path, exp1_buf))
         return 2;
 
+    psx_update_exp1_hash(psx);
+
     psx_exp2_init(psx->exp2, atcons_tx, NULL);
     psx_ic_init(psx->ic, psx->cpu);
-    psx_scratchpad_init(psx->scratchpad);
-    psx_gpu_init(psx->gpu, psx->ic);
-    psx_spu_init(psx->spu, psx->ic);
-    psx_timer_init(psx->timer, psx->ic, psx->gpu);
-    psx_cdrom_init(psx->cdrom, psx->ic);
-    psx_pad_init(psx->pad, psx->ic);
+    psx_scratchpad_init(psx->scratchpad, scratchpad_buf);
+    psx_gpu_init(psx->gpu, psx->ic, psx->sched, gpu_buf);
+    psx_spu_init(psx->spu, psx->ic, spu_buf);
+    psx_timer_init(psx->timer, psx->ic, psx->gpu, psx->sched);
+    psx_cdrom_init(psx->cdrom, psx->ic, psx->sched);
+    psx_pad_init(psx->pad, psx->ic, psx->sched);
     psx_mdec_init(psx->mdec);
     psx_cpu_init(psx->cpu, psx->bus);
 
+    psx_bus_init_page_table(psx->bus);
+
+    psx_set_idle_skip(psx, 1);
+
     return 0;
 }
 
+#undef PSX_CREATE
+#undef PSX_BUF
+
 int psx_load_expansion(psx_t *psx, const char *path)
 {
-    return psx_exp1_init(psx->exp1, psx->mc1, path);
+    int ret = psx_exp1_init(psx->exp1, psx->mc1, path, psx->exp1->rom);
+
+    psx_update_exp1_hash(psx);
+
+    psx_bus_init_page_table(psx->bus);
+
+    return ret;
 }
 
 void psx_hard_reset(psx_t *psx)
@@ -235,18 +739,34 @@ int psx_swap_disc(psx_t *psx, const char *path)
 
     psx_bus_init_cdrom(psx->bus, psx->cdrom);
 
-    psx_cdrom_init(psx->cdrom, psx->ic);
+    psx_cdrom_init(psx->cdrom, psx->ic, psx->sched);
+
+    psx_bus_init_page_table(psx->bus);
 
     return psx_cdrom_open(psx->cdrom, path);
 }
 
 void psx_destroy(psx_t *psx)
 {
+    if (psx->arena.base)
+    {
+        psx_release(psx);
+
+        // psx lives in the arena too
+        psx_arena_t arena = psx->arena;
+
+        psx_arena_destroy(&arena);
+
+        return;
+    }
+
     psx_cpu_destroy(psx->cpu);
     psx_bios_destroy(psx->bios);
     psx_bus_destroy(psx->bus);
     psx_ram_destroy(psx->ram);
+    psx_dma_destroy(psx->dma);
     psx_exp1_destroy(psx->exp1);
+    psx_exp2_destroy(psx->exp2);
     psx_mc1_destroy(psx->mc1);
     psx_mc2_destroy(psx->mc2);
     psx_mc3_destroy(psx->mc3);
@@ -258,6 +778,7 @@ void psx_destroy(psx_t *psx)
     psx_cdrom_destroy(psx->cdrom);
     psx_pad_destroy(psx->pad);
     psx_mdec_destroy(psx->mdec);
+    psx_sched_destroy(psx->sched);
 
     free(psx);
 }
@@ -350,4 +871,9 @@ psx_mdec_t *psx_get_mdec(psx_t *psx)
 psx_cpu_t *psx_get_cpu(psx_t *psx)
 {
     return psx->cpu;
+}
+
+psx_sched_t *psx_get_sched(psx_t *psx)
+{
+    return psx->sched;
 }
\ No newline at end of file
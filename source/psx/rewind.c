@@ -0,0 +1,272 @@
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/rewind.h"
+#include "psx/log.h"
+
+psx_rewind_t *psx_rewind_create(void)
+{
+    return (psx_rewind_t *)malloc(sizeof(psx_rewind_t));
+}
+
+void psx_rewind_init(psx_rewind_t *rewind, size_t budget, int interval)
+{
+    memset(rewind, 0, sizeof(psx_rewind_t));
+
+    psx_state_init(&rewind->current);
+    psx_state_init(&rewind->next);
+
+    rewind->entries = (psx_rewind_entry_t *)malloc(PSX_REWIND_MAX_ENTRIES * sizeof(psx_rewind_entry_t));
+    rewind->budget = budget;
+    rewind->interval = interval;
+}
+
+static uint8_t *rewind_put_size(uint8_t *out, size_t value)
+{
+    while (value >= 0x80)
+    {
+        *out++ = (value & 0x7f) | 0x80;
+
+        value >>= 7;
+    }
+
+    *out++ = (uint8_t)value;
+
+    return out;
+}
+
+static const uint8_t *rewind_get_size(const uint8_t *in, size_t *value)
+{
+    size_t v = 0;
+    int shift = 0;
+
+    while (*in & 0x80)
+    {
+        v |= (size_t)(*in++ & 0x7f) << shift;
+
+        shift += 7;
+    }
+
+    *value = v | ((size_t)*in++ << shift);
+
+    return in;
+}
+
+static inline int rewind_same_word(const uint8_t *a, const uint8_t *b)
+{
+    uint64_t x, y;
+
+    memcpy(&x, a, sizeof(uint64_t));
+    memcpy(&y, b, sizeof(uint64_t));
+
+    return x == y;
+}
+
+/*
+    Encodes old ^ cur as pairs of (unchanged bytes, changed bytes)
+    followed by the changed bytes XORed. A changed run only ends at a
+    whole unchanged word, so there's at most one pair per 8 bytes.
+*/
+static size_t rewind_encode(uint8_t *out, const uint8_t *cur, const uint8_t *old, size_t size)
+{
+    uint8_t *p = out;
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        size_t start = pos;
+
+        while (((pos + 8) <= size) && rewind_same_word(cur + pos, old + pos))
+            pos += 8;
+
+        while ((pos < size) && (cur[pos] == old[pos]))
+            ++pos;
+
+        p = rewind_put_size(p, pos - start);
+
+        start = pos;
+
+        while ((pos < size) && !(((pos + 8) <= size) && rewind_same_word(cur + pos, old + pos)))
+            ++pos;
+
+        p = rewind_put_size(p, pos - start);
+
+        for (size_t i = start; i < pos; i++)
+            *p++ = cur[i] ^ old[i];
+    }
+
+    return p - out;
+}
+
+static void rewind_decode(uint8_t *old, const uint8_t *cur, const uint8_t *in, size_t size)
+{
+    size_t pos = 0;
+
+    while (pos < size)
+    {
+        size_t same, changed;
+
+        in = rewind_get_size(in, &same);
+
+        memcpy(old + pos, cur + pos, same);
+
+        pos += same;
+
+        in = rewind_get_size(in, &changed);
+
+        for (size_t i = 0; i < changed; i++)
+            old[pos + i] = cur[pos + i] ^ in[i];
+
+        in += changed;
+        pos += changed;
+    }
+}
+
+static void rewind_swap(psx_rewind_t *rewind)
+{
+    psx_state_t state = rewind->current;
+
+    rewind->current = rewind->next;
+    rewind->next = state;
+}
+
+static void rewind_drop_oldest(psx_rewind_t *rewind)
+{
+    psx_rewind_entry_t *entry = &rewind->entries[rewind->head];
+
+    rewind->used -= entry->size;
+
+    free(entry->buf);
+
+    rewind->head = (rewind->head + 1) % PSX_REWIND_MAX_ENTRIES;
+    rewind->count--;
+}
+
+// Stores current as a delta against next, which becomes current
+static void rewind_push(psx_rewind_t *rewind)
+{
+    psx_state_t *cur = &rewind->next;
+    psx_state_t *old = &rewind->current;
+
+    // States differ in size if MDEC buffers changed, the rest of a
+    // longer old state is stored as is
+    size_t common = (cur->size < old->size) ? cur->size : old->size;
+    size_t tail = old->size - common;
+    size_t bound = common + (((common >> 3) + 2) * 20) + tail;
+
+    if (rewind->scratch_size < bound)
+    {
+        rewind->scratch = (uint8_t *)realloc(rewind->scratch, bound);
+        rewind->scratch_size = bound;
+    }
+
+    size_t size = rewind_encode(rewind->scratch, cur->buf, old->buf, common);
+
+    memcpy(rewind->scratch + size, old->buf + common, tail);
+
+    size += tail;
+
+    while (rewind->count && ((rewind->count == PSX_REWIND_MAX_ENTRIES) || ((rewind->used + size) > rewind->budget)))
+        rewind_drop_oldest(rewind);
+
+    if (size > rewind->budget)
+        return;
+
+    psx_rewind_entry_t *entry = &rewind->entries[(rewind->head + rewind->count) % PSX_REWIND_MAX_ENTRIES];
+
+    entry->buf = (uint8_t *)malloc(size);
+    entry->size = size;
+    entry->base_size = old->size;
+
+    memcpy(entry->buf, rewind->scratch, size);
+
+    rewind->used += size;
+    rewind->count++;
+}
+
+void psx_rewind_frame(psx_rewind_t *rewind, psx_t *psx)
+{
+    if (++rewind->frames < rewind->interval)
+        return;
+
+    rewind->frames = 0;
+
+    // Out of memory, try again next interval
+    if (psx_capture_state(psx, &rewind->next, 0))
+        return;
+
+    if (rewind->current.size)
+        rewind_push(rewind);
+
+    rewind_swap(rewind);
+}
+
+int psx_rewind_step(psx_rewind_t *rewind, psx_t *psx)
+{
+    if (!rewind->current.size)
+        return 1;
+
+    // The machine is at the newest capture, rebuild the one before it
+    if (!rewind->frames)
+    {
+        if (!rewind->count)
+            return 1;
+
+        int index = (rewind->head + rewind->count - 1) % PSX_REWIND_MAX_ENTRIES;
+
+        psx_rewind_entry_t *entry = &rewind->entries[index];
+        psx_state_t *cur = &rewind->current;
+        psx_state_t *old = &rewind->next;
+
+        size_t common = (cur->size < entry->base_size) ? cur->size : entry->base_size;
+
+        if (psx_state_resize(old, entry->base_size))
+            return 1;
+
+        rewind_decode(old->buf, cur->buf, entry->buf, common);
+
+        memcpy(old->buf + common, entry->buf + entry->size - (entry->base_size - common), entry->base_size - common);
+
+        rewind->used -= entry->size;
+        rewind->count--;
+
+        free(entry->buf);
+
+        rewind_swap(rewind);
+    }
+
+    rewind->frames = 0;
+
+    if (psx_restore_state(psx, &rewind->current, NULL))
+    {
+        log_error("Couldn't restore rewind state");
+
+        psx_rewind_clear(rewind);
+
+        return 1;
+    }
+
+    return 0;
+}
+
+void psx_rewind_clear(psx_rewind_t *rewind)
+{
+    while (rewind->count)
+        rewind_drop_oldest(rewind);
+
+    rewind->head = 0;
+    rewind->frames = 0;
+    rewind->current.size = 0;
+}
+
+void psx_rewind_destroy(psx_rewind_t *rewind)
+{
+    psx_rewind_clear(rewind);
+
+    psx_state_destroy(&rewind->current);
+    psx_state_destroy(&rewind->next);
+
+    free(rewind->entries);
+    free(rewind->scratch);
+    free(rewind);
+}
@@ -0,0 +1,172 @@
+#include <stdlib.h>
+#include <string.h>
+#include <limits.h>
+
+#include "psx/sched.h"
+
+psx_sched_t *psx_sched_create(void)
+{
+    return (psx_sched_t *)malloc(sizeof(psx_sched_t));
+}
+
+void psx_sched_init(psx_sched_t *sched)
+{
+    memset(sched, 0, sizeof(psx_sched_t));
+
+    for (int i = 0; i < PSX_SCHED_EVENT_COUNT; i++)
+    {
+        sched->event[i].time = PSX_SCHED_NEVER;
+        sched->event[i].index = -1;
+    }
+
+    sched->deadline = PSX_SCHED_NEVER;
+}
+
+static inline int sched_before(psx_sched_t *sched, int a, int b)
+{
+    if (sched->event[a].time != sched->event[b].time)
+        return sched->event[a].time < sched->event[b].time;
+
+    return a < b;
+}
+
+static inline void sched_swap(psx_sched_t *sched, int i, int j)
+{
+    int a = sched->heap[i];
+    int b = sched->heap[j];
+
+    sched->heap[i] = b;
+    sched->heap[j] = a;
+    sched->event[a].index = j;
+    sched->event[b].index = i;
+}
+
+static void sched_fix(psx_sched_t *sched, int i)
+{
+    // Sift up
+    while (i)
+    {
+        int parent = (i - 1) >> 1;
+
+        if (!sched_before(sched, sched->heap[i], sched->heap[parent]))
+            break;
+
+        sched_swap(sched, i, parent);
+
+        i = parent;
+    }
+
+    // Sift down
+    while (1)
+    {
+        int l = (i << 1) + 1;
+        int r = l + 1;
+        int m = i;
+
+        if ((l < sched->heap_size) && sched_before(sched, sched->heap[l], sched->heap[m]))
+            m = l;
+
+        if ((r < sched->heap_size) && sched_before(sched, sched->heap[r], sched->heap[m]))
+            m = r;
+
+        if (m == i)
+            break;
+
+        sched_swap(sched, i, m);
+
+        i = m;
+    }
+
+    sched->deadline = sched->event[sched->heap[0]].time;
+}
+
+void psx_sched_register(psx_sched_t *sched, int id, psx_sched_update_t update, psx_sched_next_t next, void *udata)
+{
+    psx_sched_event_t *event = &sched->event[id];
+
+    event->update = update;
+    event->next = next;
+    event->udata = udata;
+    event->last = sched->now;
+
+    if (event->index == -1)
+    {
+        event->index = sched->heap_size;
+
+        sched->heap[sched->heap_size++] = id;
+    }
+
+    psx_sched_reschedule(sched, id);
+}
+
+void psx_sched_reschedule(psx_sched_t *sched, int id)
+{
+    psx_sched_event_t *event = &sched->event[id];
+
+    uint64_t cycles = event->next(event->udata);
+
+    // Always make progress
+    if (!cycles)
+        cycles = 1;
+
+    event->time = (cycles == PSX_SCHED_NEVER) ? PSX_SCHED_NEVER : (sched->now + cycles);
+
+    sched_fix(sched, event->index);
+}
+
+void psx_sched_sync(psx_sched_t *sched, int id)
+{
+    psx_sched_event_t *event = &sched->event[id];
+
+    uint64_t elapsed = sched->now - event->last;
+
+    event->last = sched->now;
+    event->update(event->udata, (elapsed > INT_MAX) ? INT_MAX : (int)elapsed);
+
+    psx_sched_reschedule(sched, id);
+}
+
+void psx_sched_run(psx_sched_t *sched)
+{
+    while (sched->deadline <= sched->now)
+        psx_sched_sync(sched, sched->heap[0]);
+}
+
+void psx_sched_save_state(psx_sched_t *sched, psx_state_t *state)
+{
+    psx_sched_t copy = *sched;
+
+    for (int i = 0; i < PSX_SCHED_EVENT_COUNT; i++)
+    {
+        copy.event[i].update = NULL;
+        copy.event[i].next = NULL;
+        copy.event[i].udata = NULL;
+    }
+
+    psx_state_begin_chunk(state, PSX_STATE_SCHED);
+    psx_state_write(state, &copy, sizeof(psx_sched_t));
+    psx_state_end_chunk(state);
+}
+
+int psx_sched_load_state(psx_sched_t *sched, psx_state_t *state)
+{
+    psx_sched_t copy = *sched;
+
+    if (psx_state_read_chunk(state, PSX_STATE_SCHED, sched, sizeof(psx_sched_t)))
+        return 1;
+
+    // Devices keep their registrations, only the times come from the state
+    for (int i = 0; i < PSX_SCHED_EVENT_COUNT; i++)
+    {
+        sched->event[i].update = copy.event[i].update;
+        sched->event[i].next = copy.event[i].next;
+        sched->event[i].udata = copy.event[i].udata;
+    }
+
+    return 0;
+}
+
+void psx_sched_destroy(psx_sched_t *sched)
+{
+    free(sched);
+}
@@ -0,0 +1,617 @@
+// Needed for fileno and fsync
+#ifndef _WIN32
+#define _DEFAULT_SOURCE
+#endif
+
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+#include "psx/state.h"
+#include "psx/log.h"
+
+#ifdef _WIN32
+#include <io.h>
+#include <windows.h>
+#else
+#include <unistd.h>
+#endif
+
+#define STATE_ALIGN(x) (((x) + 7) & ~(size_t)7)
+
+// LZ77 with LZ4's block layout: a token holding the literal and match
+// lengths, the literals, then a 16-bit match offset
+#define STATE_LZ_HASH_BITS 14
+#define STATE_LZ_MIN_MATCH 4
+#define STATE_LZ_WINDOW 0xffff
+
+// The last bytes of the input are always literals
+#define STATE_LZ_TAIL 12
+
+// A length byte never stands for more than 255 bytes of output
+#define STATE_LZ_MAX_RATIO 255
+
+void psx_state_init(psx_state_t *state)
+{
+    memset(state, 0, sizeof(psx_state_t));
+}
+
+// Keeps the old buffer and sets error if it can't grow
+static int state_reserve(psx_state_t *state, size_t size)
+{
+    if (state->error)
+        return 1;
+
+    if ((state->size + size) <= state->cap)
+        return 0;
+
+    size_t cap = state->cap ? state->cap : 0x100000;
+
+    while (cap < (state->size + size))
+        cap <<= 1;
+
+    uint8_t *buf = (uint8_t *)realloc(state->buf, cap);
+
+    if (!buf)
+    {
+        log_error("Couldn't grow state buffer to %zu bytes", cap);
+
+        state->error = 1;
+
+        return 1;
+    }
+
+    state->buf = buf;
+    state->cap = cap;
+
+    return 0;
+}
+
+int psx_state_resize(psx_state_t *state, size_t size)
+{
+    state->error = 0;
+
+    if ((size > state->size) && state_reserve(state, size - state->size))
+        return 1;
+
+    state->size = size;
+    state->pos = 0;
+
+    return 0;
+}
+
+void psx_state_begin(psx_state_t *state, uint32_t layout, uint64_t key)
+{
+    psx_state_header_t header;
+
+    memset(&header, 0, sizeof(header));
+
+    header.magic = PSX_STATE_MAGIC;
+    header.version = PSX_STATE_VERSION;
+    header.layout = layout;
+    header.key = key;
+
+    state->size = 0;
+    state->pos = 0;
+    state->error = 0;
+
+    psx_state_write(state, &header, sizeof(header));
+}
+
+void psx_state_begin_chunk(psx_state_t *state, uint32_t id)
+{
+    psx_state_chunk_t chunk;
+
+    chunk.id = id;
+    chunk.size = 0;
+
+    state->chunk = state->size;
+
+    psx_state_write(state, &chunk, sizeof(chunk));
+}
+
+void psx_state_write(psx_state_t *state, const void *buf, size_t size)
+{
+    if (state_reserve(state, size))
+        return;
+
+    state->last = state->size;
+
+    if (size)
+        memcpy(state->buf + state->size, buf, size);
+
+    state->size += size;
+}
+
+void psx_state_clear(psx_state_t *state, size_t offset, size_t size)
+{
+    if (state->error)
+        return;
+
+    memset(state->buf + state->last + offset, 0, size);
+}
+
+void psx_state_end_chunk(psx_state_t *state)
+{
+    if (state->error)
+        return;
+
+    size_t size = state->size - state->chunk - sizeof(psx_state_chunk_t);
+    size_t pad = STATE_ALIGN(state->size) - state->size;
+
+    ((psx_state_chunk_t *)(state->buf + state->chunk))->size = (uint32_t)size;
+
+    // Keep every chunk 8-byte aligned
+    if (state_reserve(state, pad))
+        return;
+
+    memset(state->buf + state->size, 0, pad);
+
+    state->size += pad;
+}
+
+int psx_state_end(psx_state_t *state)
+{
+    // Left empty so it can't be opened or written out
+    if (state->error)
+    {
+        state->size = 0;
+
+        return 1;
+    }
+
+    ((psx_state_header_t *)state->buf)->size = (uint32_t)state->size;
+
+    return 0;
+}
+
+int psx_state_open(psx_state_t *state, uint32_t layout, uint64_t *key)
+{
+    if (state->size < sizeof(psx_state_header_t))
+        return 1;
+
+    psx_state_header_t *header = (psx_state_header_t *)state->buf;
+
+    if (header->magic != PSX_STATE_MAGIC)
+    {
+        log_error("Not a state file");
+
+        return 1;
+    }
+
+    if ((header->version != PSX_STATE_VERSION) || (header->layout != layout))
+    {
+        log_error("State was saved by a different version (%u, expected %u)", header->version, PSX_STATE_VERSION);
+
+        return 1;
+    }
+
+    if (header->size != state->size)
+        return 1;
+
+    // Walk the chunks so a truncated state is caught before any of it is applied
+    size_t pos = sizeof(psx_state_header_t);
+
+    while (pos < state->size)
+    {
+        if ((state->size - pos) < sizeof(psx_state_chunk_t))
+            return 1;
+
+        psx_state_chunk_t *chunk = (psx_state_chunk_t *)(state->buf + pos);
+
+        pos += STATE_ALIGN(sizeof(psx_state_chunk_t) + chunk->size);
+
+        if (pos > state->size)
+            return 1;
+    }
+
+    if (key)
+        *key = header->key;
+
+    state->pos = sizeof(psx_state_header_t);
+
+    return 0;
+}
+
+int psx_state_next_chunk(psx_state_t *state, uint32_t id)
+{
+    if ((state->size - state->pos) < sizeof(psx_state_chunk_t))
+        return -1;
+
+    psx_state_chunk_t *chunk = (psx_state_chunk_t *)(state->buf + state->pos);
+
+    if (chunk->id != id)
+    {
+        log_error("Expected state chunk %08x, found %08x", id, chunk->id);
+
+        return -1;
+    }
+
+    state->chunk = state->pos;
+    state->pos += sizeof(psx_state_chunk_t);
+
+    return (int)chunk->size;
+}
+
+void psx_state_read(psx_state_t *state, void *buf, size_t size)
+{
+    if (buf && size)
+        memcpy(buf, state->buf + state->pos, size);
+
+    state->pos += size;
+
+    // Skip the padding after the last read of a chunk
+    size_t end = state->chunk + sizeof(psx_state_chunk_t) + ((psx_state_chunk_t *)(state->buf + state->chunk))->size;
+
+    if (state->pos == end)
+        state->pos = STATE_ALIGN(state->pos);
+}
+
+void psx_state_skip(psx_state_t *state, size_t size)
+{
+    psx_state_read(state, NULL, size);
+}
+
+int psx_state_read_chunk(psx_state_t *state, uint32_t id, void *buf, size_t size)
+{
+    if (psx_state_next_chunk(state, id) != (int)size)
+        return 1;
+
+    psx_state_read(state, buf, size);
+
+    return 0;
+}
+
+static size_t state_lz_bound(size_t size)
+{
+    return size + (size / 255) + 16;
+}
+
+static inline uint32_t state_lz_hash(const uint8_t *p)
+{
+    uint32_t v;
+
+    memcpy(&v, p, sizeof(v));
+
+    return (v * 2654435761u) >> (32 - STATE_LZ_HASH_BITS);
+}
+
+static inline uint8_t *state_lz_put_length(uint8_t *op, size_t len)
+{
+    while (len >= 255)
+    {
+        *op++ = 255;
+        len -= 255;
+    }
+
+    *op++ = (uint8_t)len;
+
+    return op;
+}
+
+// Token and literals, the caller adds the match
+static uint8_t *state_lz_put_sequence(uint8_t *op, const uint8_t *lit, size_t lit_len, size_t match_len)
+{
+    uint8_t *token = op++;
+
+    *token = (uint8_t)((((lit_len >= 15) ? 15 : lit_len) << 4) | ((match_len >= 15) ? 15 : match_len));
+
+    if (lit_len >= 15)
+        op = state_lz_put_length(op, lit_len - 15);
+
+    memcpy(op, lit, lit_len);
+
+    return op + lit_len;
+}
+
+// dst holds state_lz_bound(size) bytes, returns the packed size
+static size_t state_lz_pack(const uint8_t *src, size_t size, uint8_t *dst, uint32_t *table)
+{
+    const uint8_t *ip = src;
+    const uint8_t *anchor = src;
+    const uint8_t *end = src + size;
+    const uint8_t *limit = (size > STATE_LZ_TAIL) ? (end - STATE_LZ_TAIL) : src;
+    uint8_t *op = dst;
+
+    memset(table, 0, sizeof(uint32_t) << STATE_LZ_HASH_BITS);
+
+    unsigned int misses = 0;
+
+    while (ip < limit)
+    {
+        uint32_t h = state_lz_hash(ip);
+        const uint8_t *ref = src + table[h];
+
+        table[h] = (uint32_t)(ip - src);
+
+        if ((ref >= ip) || ((size_t)(ip - ref) > STATE_LZ_WINDOW) || memcmp(ref, ip, STATE_LZ_MIN_MATCH))
+        {
+            // Speed through data that doesn't compress
+            ip += 1 + (misses++ >> 6);
+
+            continue;
+        }
+
+        misses = 0;
+
+        const uint8_t *mp = ip + STATE_LZ_MIN_MATCH;
+        const uint8_t *mr = ref + STATE_LZ_MIN_MATCH;
+
+        while ((mp < (end - 5)) && (*mp == *mr))
+        {
+            ++mp;
+            ++mr;
+        }
+
+        size_t match_len = (mp - ip) - STATE_LZ_MIN_MATCH;
+        size_t offset = ip - ref;
+
+        op = state_lz_put_sequence(op, anchor, ip - anchor, match_len);
+
+        *op++ = offset & 0xff;
+        *op++ = offset >> 8;
+
+        if (match_len >= 15)
+            op = state_lz_put_length(op, match_len - 15);
+
+        ip = mp;
+        anchor = ip;
+    }
+
+    // The stream ends on a sequence without a match
+    op = state_lz_put_sequence(op, anchor, end - anchor, 0);
+
+    return op - dst;
+}
+
+static int state_lz_get_length(const uint8_t **ip, const uint8_t *end, size_t *len)
+{
+    uint8_t b;
+
+    do
+    {
+        if (*ip >= end)
+            return 1;
+
+        b = *(*ip)++;
+        *len += b;
+    } while (b == 255);
+
+    return 0;
+}
+
+// Returns 0 if src unpacks to exactly size bytes
+static int state_lz_unpack(const uint8_t *src, size_t src_size, uint8_t *dst, size_t size)
+{
+    const uint8_t *ip = src;
+    const uint8_t *end = src + src_size;
+    uint8_t *op = dst;
+    uint8_t *op_end = dst + size;
+
+    while (ip < end)
+    {
+        uint8_t token = *ip++;
+        size_t lit_len = token >> 4;
+
+        if ((lit_len == 15) && state_lz_get_length(&ip, end, &lit_len))
+            return 1;
+
+        if ((lit_len > (size_t)(end - ip)) || (lit_len > (size_t)(op_end - op)))
+            return 1;
+
+        memcpy(op, ip, lit_len);
+
+        ip += lit_len;
+        op += lit_len;
+
+        if (ip == end)
+            break;
+
+        if ((end - ip) < 2)
+            return 1;
+
+        size_t offset = ip[0] | (ip[1] << 8);
+        size_t match_len = token & 15;
+
+        ip += 2;
+
+        if ((match_len == 15) && state_lz_get_length(&ip, end, &match_len))
+            return 1;
+
+        match_len += STATE_LZ_MIN_MATCH;
+
+        if (!offset || (offset > (size_t)(op - dst)) || (match_len > (size_t)(op_end - op)))
+            return 1;
+
+        const uint8_t *ref = op - offset;
+
+        // Matches can overlap what they produce, runs are the common case
+        if (offset == 1)
+        {
+            memset(op, *ref, match_len);
+        }
+        else if (offset >= match_len)
+        {
+            memcpy(op, ref, match_len);
+        }
+        else
+        {
+            for (size_t i = 0; i < match_len; i++)
+                op[i] = ref[i];
+        }
+
+        op += match_len;
+    }
+
+    return op != op_end;
+}
+
+// Flushes the file to disk so the rename can't land before the data
+static int state_sync_file(FILE *file)
+{
+    if (fflush(file))
+        return 1;
+
+#ifdef _WIN32
+    return _commit(_fileno(file)) != 0;
+#else
+    return fsync(fileno(file)) != 0;
+#endif
+}
+
+static int state_replace_file(const char *from, const char *to)
+{
+#ifdef _WIN32
+    return !MoveFileExA(from, to, MOVEFILE_REPLACE_EXISTING);
+#else
+    return rename(from, to) != 0;
+#endif
+}
+
+int psx_state_write_file(psx_state_t *state, const char *path)
+{
+    psx_state_file_header_t header;
+
+    memset(&header, 0, sizeof(header));
+
+    header.magic = PSX_STATE_FILE_MAGIC;
+    header.size = state->size;
+
+    uint8_t *packed = (uint8_t *)malloc(state_lz_bound(state->size));
+    uint32_t *table = (uint32_t *)malloc(sizeof(uint32_t) << STATE_LZ_HASH_BITS);
+
+    if (!packed || !table)
+    {
+        free(packed);
+        free(table);
+
+        return 1;
+    }
+
+    size_t packed_size = state_lz_pack(state->buf, state->size, packed, table);
+
+    free(table);
+
+    // Write next to the old file and swap it in, so a crash mid-write
+    // never leaves a truncated state behind
+    size_t len = strlen(path);
+    char *tmp = (char *)malloc(len + 5);
+
+    memcpy(tmp, path, len);
+    memcpy(tmp + len, ".tmp", 5);
+
+    FILE *file = NULL;
+    fopen_s(&file, tmp, "wb");
+
+    int ret = 1;
+
+    if (file)
+    {
+        ret = (fwrite(&header, sizeof(header), 1, file) != 1) ||
+              (fwrite(packed, 1, packed_size, file) != packed_size) ||
+              state_sync_file(file);
+
+        ret |= fclose(file) != 0;
+        ret = ret || state_replace_file(tmp, path);
+
+        if (ret)
+            remove(tmp);
+    }
+
+    free(tmp);
+    free(packed);
+
+    return ret;
+}
+
+int psx_state_read_file(psx_state_t *state, const char *path)
+{
+    FILE *file = NULL;
+    fopen_s(&file, path, "rb");
+
+    if (!file)
+        return 1;
+
+    fseek(file, 0, SEEK_END);
+
+    long size = ftell(file);
+
+    fseek(file, 0, SEEK_SET);
+
+    psx_state_file_header_t header;
+
+    if ((size <= (long)sizeof(header)) || (fread(&header, sizeof(header), 1, file) != 1))
+    {
+        fclose(file);
+
+        return 1;
+    }
+
+    // Raw states are still accepted
+    if (header.magic != PSX_STATE_FILE_MAGIC)
+    {
+        fseek(file, 0, SEEK_SET);
+
+        if (psx_state_resize(state, size))
+        {
+            fclose(file);
+
+            return 1;
+        }
+
+        state->size = fread(state->buf, 1, size, file);
+
+        fclose(file);
+
+        return state->size != (size_t)size;
+    }
+
+    size_t packed_size = size - sizeof(header);
+
+    // Don't allocate for more than the packed data can unpack to
+    if ((header.size > UINT32_MAX) || (header.size > ((uint64_t)packed_size * STATE_LZ_MAX_RATIO)))
+    {
+        log_error("State file claims %llu bytes from %zu packed", (unsigned long long)header.size, packed_size);
+
+        fclose(file);
+
+        return 1;
+    }
+
+    uint8_t *packed = (uint8_t *)malloc(packed_size);
+
+    int ret = !packed || (fread(packed, 1, packed_size, file) != packed_size);
+
+    fclose(file);
+
+    if (!ret)
+        ret = psx_state_resize(state, (size_t)header.size);
+
+    if (!ret)
+    {
+        ret = state_lz_unpack(packed, packed_size, state->buf, state->size);
+    }
+
+    free(packed);
+
+    if (ret)
+        state->size = 0;
+
+    return ret;
+}
+
+void psx_state_destroy(psx_state_t *state)
+{
+    free(state->buf);
+
+    state->buf = NULL;
+    state->size = 0;
+    state->cap = 0;
+}
+
+#undef STATE_ALIGN
+#undef STATE_LZ_HASH_BITS
+#undef STATE_LZ_MIN_MATCH
+#undef STATE_LZ_WINDOW
+#undef STATE_LZ_TAIL
+#undef STATE_LZ_MAX_RATIO